@@ -10,22 +10,28 @@ namespace pragma {
 
 // BlockHeader implementation
 std::vector<uint8_t> BlockHeader::serialize() const {
-    std::vector<std::vector<uint8_t>> parts;
-    
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void BlockHeader::serializeInto(std::vector<uint8_t>& out) const {
     // Serialize all fields in order
-    parts.push_back(Serialize::encodeUint32LE(version));
-    parts.push_back(Serialize::encodeString(prevHash));
-    parts.push_back(Serialize::encodeString(merkleRoot));
-    parts.push_back(Serialize::encodeUint64LE(timestamp));
-    parts.push_back(Serialize::encodeUint32LE(bits));
-    parts.push_back(Serialize::encodeUint32LE(nonce));
-    
-    return Serialize::combine(parts);
+    Serialize::appendUint32LE(out, version);
+    Serialize::appendString(out, prevHash);
+    Serialize::appendString(out, merkleRoot);
+    Serialize::appendUint64LE(out, timestamp);
+    Serialize::appendUint32LE(out, bits);
+    Serialize::appendUint32LE(out, nonce);
 }
 
 BlockHeader BlockHeader::deserialize(const std::vector<uint8_t>& data) {
-    BlockHeader header;
     size_t offset = 0;
+    return deserialize(ByteSpan(data), offset);
+}
+
+BlockHeader BlockHeader::deserialize(ByteSpan data, size_t& offset) {
+    BlockHeader header;
     
     // Deserialize all fields in order
     header.version = Serialize::decodeUint32LE(data, offset);
@@ -46,6 +52,7 @@ BlockHeader BlockHeader::deserialize(const std::vector<uint8_t>& data) {
     offset += 4;
     
     header.nonce = Serialize::decodeUint32LE(data, offset);
+    offset += 4;
     
     return header;
 }
@@ -114,49 +121,43 @@ Block Block::create(const Block& prevBlock, const std::vector<Transaction>& txs,
 }
 
 std::vector<uint8_t> Block::serialize() const {
-    std::vector<std::vector<uint8_t>> parts;
-    
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void Block::serializeInto(std::vector<uint8_t>& out) const {
     // Serialize header
-    parts.push_back(header.serialize());
+    header.serializeInto(out);
     
     // Serialize transaction count
-    parts.push_back(Serialize::encodeVarInt(transactions.size()));
+    Serialize::appendVarInt(out, transactions.size());
     
     // Serialize each transaction
     for (const auto& tx : transactions) {
-        parts.push_back(tx.serialize());
+        tx.serializeInto(out);
     }
-    
-    return Serialize::combine(parts);
 }
 
 Block Block::deserialize(const std::vector<uint8_t>& data) {
-    Block block;
     size_t offset = 0;
+    return deserialize(ByteSpan(data), offset);
+}
+
+Block Block::deserialize(ByteSpan data, size_t& offset) {
+    Block block;
     
-    // Deserialize header first to get its size
-    auto headerData = std::vector<uint8_t>(data.begin(), data.end());
-    block.header = BlockHeader::deserialize(headerData);
-    
-    // Skip past header (approximate - we need to recalculate this properly)
-    // For now, let's serialize the header again to get its exact size
-    auto headerSerialized = block.header.serialize();
-    offset = headerSerialized.size();
+    // Deserialize header
+    block.header = BlockHeader::deserialize(data, offset);
     
     // Deserialize transaction count
     auto [txCount, txCountSize] = Serialize::decodeVarInt(data, offset);
     offset += txCountSize;
     
-    // Deserialize each transaction
+    // Deserialize each transaction in place; each one advances the offset
+    block.transactions.reserve(std::min<uint64_t>(txCount, data.size()));
     for (uint64_t i = 0; i < txCount; ++i) {
-        // Extract transaction data from current offset
-        std::vector<uint8_t> txData(data.begin() + offset, data.end());
-        Transaction tx = Transaction::deserialize(txData);
-        block.transactions.push_back(tx);
-        
-        // Move offset past this transaction
-        auto txSerialized = tx.serialize();
-        offset += txSerialized.size();
+        block.transactions.push_back(Transaction::deserialize(data, offset));
     }
     
     // Compute block hash
@@ -27,7 +27,9 @@ struct BlockHeader {
     
     // Serialization
     std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
     static BlockHeader deserialize(const std::vector<uint8_t>& data);
+    static BlockHeader deserialize(ByteSpan data, size_t& offset);
     
     // Hash computation
     std::string computeHash() const;
@@ -58,7 +60,9 @@ struct Block {
     
     // Serialization
     std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
     static Block deserialize(const std::vector<uint8_t>& data);
+    static Block deserialize(ByteSpan data, size_t& offset);
     
     // Hash computation and validation
     void computeHash();
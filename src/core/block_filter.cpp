@@ -0,0 +1,255 @@
+#include "block_filter.h"
+#include "../primitives/hash.h"
+#include "../primitives/siphash.h"
+#include "../primitives/serialize.h"
+#include "../primitives/utils.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace pragma {
+
+namespace {
+
+// MSB-first bit stream, as BIP158 lays out Golomb-Rice codes
+class BitWriter {
+private:
+    std::vector<uint8_t>& out;
+    uint8_t current = 0;
+    uint8_t used = 0;
+
+public:
+    explicit BitWriter(std::vector<uint8_t>& target) : out(target) {}
+
+    void write(uint64_t value, uint8_t bits) {
+        while (bits > 0) {
+            uint8_t take = std::min<uint8_t>(bits, 8 - used);
+            uint8_t chunk = static_cast<uint8_t>((value >> (bits - take)) & ((1u << take) - 1));
+            current = static_cast<uint8_t>(current | (chunk << (8 - used - take)));
+            used += take;
+            bits -= take;
+            if (used == 8) {
+                out.push_back(current);
+                current = 0;
+                used = 0;
+            }
+        }
+    }
+
+    void flush() {
+        if (used > 0) {
+            out.push_back(current);
+            current = 0;
+            used = 0;
+        }
+    }
+};
+
+class BitReader {
+private:
+    const std::vector<uint8_t>& in;
+    size_t position;    // In bits
+
+public:
+    BitReader(const std::vector<uint8_t>& source, size_t byteOffset) : in(source), position(byteOffset * 8) {}
+
+    bool readBit() {
+        if (position >= in.size() * 8) {
+            throw std::runtime_error("GCS decode: unexpected end of filter");
+        }
+        bool bit = (in[position / 8] >> (7 - position % 8)) & 1;
+        position++;
+        return bit;
+    }
+
+    uint64_t read(uint8_t bits) {
+        uint64_t value = 0;
+        for (uint8_t i = 0; i < bits; ++i) {
+            value = (value << 1) | (readBit() ? 1 : 0);
+        }
+        return value;
+    }
+};
+
+uint64_t readKeyWord(const std::vector<uint8_t>& bytes, size_t offset) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        word |= static_cast<uint64_t>(bytes[offset + i]) << (8 * i);
+    }
+    return word;
+}
+
+} // namespace
+
+// GCSFilter implementation
+GCSFilter::GCSFilter() : k0(0), k1(0), n(0) {
+    Serialize::appendVarInt(encoded, 0);
+}
+
+GCSFilter::GCSFilter(uint64_t key0, uint64_t key1, const std::vector<std::string>& elements)
+    : k0(key0), k1(key1), n(0) {
+    // Duplicates would make N disagree with what a client expects
+    std::vector<std::string> unique(elements);
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+    n = static_cast<uint32_t>(unique.size());
+
+    std::vector<uint64_t> values;
+    values.reserve(unique.size());
+    for (const auto& element : unique) {
+        values.push_back(hashToRange(element));
+    }
+    std::sort(values.begin(), values.end());
+
+    Serialize::appendVarInt(encoded, n);
+    BitWriter writer(encoded);
+    uint64_t last = 0;
+    for (uint64_t value : values) {
+        uint64_t delta = value - last;
+        for (uint64_t q = delta >> P; q > 0; --q) {
+            writer.write(1, 1);
+        }
+        writer.write(0, 1);
+        writer.write(delta, P);
+        last = value;
+    }
+    writer.flush();
+}
+
+GCSFilter::GCSFilter(uint64_t key0, uint64_t key1, std::vector<uint8_t> encodedFilter)
+    : k0(key0), k1(key1), n(0), encoded(std::move(encodedFilter)) {
+    auto count = Serialize::decodeVarInt(ByteSpan(encoded), 0);
+    if (count.first > encoded.size() * 8) {
+        throw std::runtime_error("GCS decode: element count exceeds filter size");
+    }
+    n = static_cast<uint32_t>(count.first);
+    decodeValues(); // Validates the bit stream
+}
+
+uint64_t GCSFilter::hashToRange(const std::string& element) const {
+    // Map the 64-bit hash onto [0, N * M) without a modulo bias
+    uint64_t hash = SipHash::hash(k0, k1, element);
+    unsigned __int128 product = static_cast<unsigned __int128>(hash) * (static_cast<uint64_t>(n) * M);
+    return static_cast<uint64_t>(product >> 64);
+}
+
+std::vector<uint64_t> GCSFilter::decodeValues() const {
+    auto count = Serialize::decodeVarInt(ByteSpan(encoded), 0);
+    BitReader reader(encoded, count.second);
+
+    std::vector<uint64_t> values;
+    values.reserve(n);
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t quotient = 0;
+        while (reader.readBit()) {
+            quotient++;
+        }
+        value += (quotient << P) | reader.read(P);
+        values.push_back(value);
+    }
+    return values;
+}
+
+bool GCSFilter::match(const std::string& element) const {
+    return matchAny({element});
+}
+
+bool GCSFilter::matchAny(const std::vector<std::string>& elements) const {
+    if (n == 0 || elements.empty()) {
+        return false;
+    }
+
+    std::vector<uint64_t> queries;
+    queries.reserve(elements.size());
+    for (const auto& element : elements) {
+        queries.push_back(hashToRange(element));
+    }
+    std::sort(queries.begin(), queries.end());
+
+    // Both sides are sorted, so one merge pass answers every query
+    auto values = decodeValues();
+    size_t i = 0, j = 0;
+    while (i < values.size() && j < queries.size()) {
+        if (values[i] == queries[j]) {
+            return true;
+        }
+        if (values[i] < queries[j]) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return false;
+}
+
+// BlockFilter implementation
+BlockFilter::BlockFilter() : type(BlockFilterType::BASIC) {}
+
+BlockFilter::BlockFilter(const Block& block) : type(BlockFilterType::BASIC), blockHash(block.hash) {
+    uint64_t k0, k1;
+    keyFromBlockHash(blockHash, k0, k1);
+    filter = GCSFilter(k0, k1, basicElements(block));
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterType, const std::string& hash, std::vector<uint8_t> encodedFilter)
+    : type(filterType), blockHash(hash) {
+    uint64_t k0, k1;
+    keyFromBlockHash(blockHash, k0, k1);
+    filter = GCSFilter(k0, k1, std::move(encodedFilter));
+}
+
+void BlockFilter::keyFromBlockHash(const std::string& hash, uint64_t& k0, uint64_t& k1) {
+    // The key is the first 16 bytes of the block hash
+    std::vector<uint8_t> bytes = (hash.size() >= 32 && Utils::isValidHex(hash))
+        ? Hash::fromHex(hash) : Hash::fromHex(Hash::sha256(hash));
+    k0 = readKeyWord(bytes, 0);
+    k1 = readKeyWord(bytes, 8);
+}
+
+std::vector<std::string> BlockFilter::basicElements(const Block& block) {
+    std::vector<std::string> elements;
+    for (const auto& tx : block.transactions) {
+        for (const auto& output : tx.vout) {
+            if (!output.pubKeyHash.empty()) {
+                elements.push_back(output.pubKeyHash);
+            }
+        }
+        if (tx.isCoinbase) {
+            continue;
+        }
+        for (const auto& input : tx.vin) {
+            elements.push_back(outpointElement(input.prevout));
+        }
+    }
+    return elements;
+}
+
+std::string BlockFilter::outpointElement(const OutPoint& outpoint) {
+    auto bytes = outpoint.serialize();
+    return std::string(bytes.begin(), bytes.end());
+}
+
+std::string BlockFilter::getHash() const {
+    return Hash::dbl_sha256(getEncoded());
+}
+
+std::string BlockFilter::computeHeader(const std::string& prevHeader) const {
+    std::vector<uint8_t> data = Hash::fromHex(getHash());
+    std::vector<uint8_t> prev = Hash::fromHex(prevHeader);
+    data.insert(data.end(), prev.begin(), prev.end());
+    return Hash::dbl_sha256(data);
+}
+
+const std::string& BlockFilter::genesisPrevHeader() {
+    static const std::string zero(64, '0');
+    return zero;
+}
+
+std::string BlockFilter::typeName(BlockFilterType filterType) {
+    switch (filterType) {
+        case BlockFilterType::BASIC: return "basic";
+        default: return "unknown";
+    }
+}
+
+} // namespace pragma
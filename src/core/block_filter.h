@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "block.h"
+
+namespace pragma {
+
+/**
+ * Golomb-coded set (BIP158).
+ * Elements are hashed with a keyed SipHash into [0, N * M), sorted, and
+ * stored as Golomb-Rice coded deltas with P remainder bits. Membership
+ * queries have no false negatives and a false-positive rate of about 1/M.
+ * The encoding is varint N followed by the bit stream.
+ */
+class GCSFilter {
+public:
+    static constexpr uint8_t P = 19;
+    static constexpr uint64_t M = 784931;
+
+private:
+    uint64_t k0, k1;
+    uint32_t n;
+    std::vector<uint8_t> encoded;
+
+    uint64_t hashToRange(const std::string& element) const;
+    std::vector<uint64_t> decodeValues() const;
+
+public:
+    GCSFilter();
+    GCSFilter(uint64_t key0, uint64_t key1, const std::vector<std::string>& elements);
+    // Throws std::runtime_error if the encoding is malformed
+    GCSFilter(uint64_t key0, uint64_t key1, std::vector<uint8_t> encodedFilter);
+
+    bool match(const std::string& element) const;
+    bool matchAny(const std::vector<std::string>& elements) const;
+
+    uint32_t getN() const { return n; }
+    const std::vector<uint8_t>& getEncoded() const { return encoded; }
+};
+
+enum class BlockFilterType : uint8_t {
+    BASIC = 0
+};
+
+/**
+ * Compact block filter for light clients.
+ * The basic filter covers every output address in the block and every
+ * outpoint spent by it, keyed by the block hash. Filter headers chain
+ * each filter's hash to the previous block's header, so a client can check
+ * filters from one peer against headers from another.
+ */
+class BlockFilter {
+private:
+    BlockFilterType type;
+    std::string blockHash;
+    GCSFilter filter;
+
+    static void keyFromBlockHash(const std::string& hash, uint64_t& k0, uint64_t& k1);
+
+public:
+    BlockFilter();
+    explicit BlockFilter(const Block& block);
+    BlockFilter(BlockFilterType filterType, const std::string& hash, std::vector<uint8_t> encodedFilter);
+
+    // Elements a wallet queries with
+    static std::vector<std::string> basicElements(const Block& block);
+    static std::string outpointElement(const OutPoint& outpoint);
+
+    BlockFilterType getType() const { return type; }
+    const std::string& getBlockHash() const { return blockHash; }
+    const GCSFilter& getFilter() const { return filter; }
+    const std::vector<uint8_t>& getEncoded() const { return filter.getEncoded(); }
+
+    std::string getHash() const;
+    std::string computeHeader(const std::string& prevHeader) const;
+
+    static const std::string& genesisPrevHeader();
+    static std::string typeName(BlockFilterType filterType);
+};
+
+} // namespace pragma
@@ -9,7 +9,7 @@
 namespace pragma {
 
 ChainState::ChainState() 
-    : bestChainTip(nullptr), totalBlocks(0) {
+    : bestChainTip(nullptr), totalBlocks(0), checkProofOfWork(true) {
 }
 
 bool ChainState::setGenesis(const Block& genesisBlock) {
@@ -33,6 +33,9 @@ bool ChainState::setGenesis(const Block& genesisBlock) {
     std::string cumulativeWork = std::to_string(work);
     
     auto genesisEntry = std::make_shared<ChainEntry>(genesisBlock, 0, cumulativeWork, work);
+    indexFilter(*genesisEntry, nullptr);
+    storeSerialized(*genesisEntry);
+    indexTransactions(*genesisEntry);
     
     blocks[genesisBlock.hash] = genesisEntry;
     bestChainTip = genesisEntry;
@@ -83,6 +86,9 @@ bool ChainState::addBlock(const Block& block) {
     
     // Create new chain entry
     auto newEntry = std::make_shared<ChainEntry>(block, newHeight, cumulativeWork, totalWork);
+    indexFilter(*newEntry, prevEntry.get());
+    storeSerialized(*newEntry);
+    indexTransactions(*newEntry);
     blocks[block.hash] = newEntry;
     totalBlocks++;
     
@@ -174,7 +180,7 @@ bool ChainState::isValidBlock(const Block& block) const {
     }
     
     // Validate proof of work
-    if (!block.meetsTarget()) {
+    if (checkProofOfWork && !block.meetsTarget()) {
         Utils::logError("Block does not meet difficulty target");
         return false;
     }
@@ -463,11 +469,12 @@ bool ChainState::saveToFile(const std::string& filename) const {
         for (const auto& pair : blocks) {
             const auto& entry = pair.second;
             
-            // Serialize block
-            auto blockData = entry->block.serialize();
-            size_t blockSize = blockData.size();
+            // Write the stored encoding; entries always carry one once added
+            auto blockData = entry->serialized ? entry->serialized
+                                               : std::make_shared<const std::vector<uint8_t>>(entry->block.serialize());
+            size_t blockSize = blockData->size();
             file.write(reinterpret_cast<const char*>(&blockSize), sizeof(blockSize));
-            file.write(reinterpret_cast<const char*>(blockData.data()), blockSize);
+            file.write(reinterpret_cast<const char*>(blockData->data()), blockSize);
             
             // Save metadata
             file.write(reinterpret_cast<const char*>(&entry->height), sizeof(entry->height));
@@ -498,6 +505,7 @@ bool ChainState::loadFromFile(const std::string& filename) {
         
         // Clear current state
         blocks.clear();
+        txIndex.clear();
         bestChainTip = nullptr;
         genesisHash.clear();
         totalBlocks = 0;
@@ -544,6 +552,8 @@ bool ChainState::loadFromFile(const std::string& filename) {
             
             // Create entry
             auto entry = std::make_shared<ChainEntry>(block, height, cumulativeWork, totalWork);
+            storeSerialized(*entry, std::move(blockData));
+            indexTransactions(*entry);
             blocks[block.hash] = entry;
             
             // Set best tip if this is it
@@ -553,6 +563,22 @@ bool ChainState::loadFromFile(const std::string& filename) {
         }
         
         file.close();
+        
+        // Filters are not persisted; rebuild them parents-first so each
+        // header can chain to its predecessor's
+        std::vector<std::shared_ptr<ChainEntry>> ordered;
+        ordered.reserve(blocks.size());
+        for (const auto& pair : blocks) {
+            ordered.push_back(pair.second);
+        }
+        std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+            return a->height < b->height;
+        });
+        for (const auto& entry : ordered) {
+            auto prevIt = blocks.find(entry->block.header.prevHash);
+            indexFilter(*entry, prevIt != blocks.end() ? prevIt->second.get() : nullptr);
+        }
+        
         Utils::logInfo("Chain state loaded from: " + filename);
         Utils::logInfo("Loaded " + std::to_string(blockCount) + " blocks");
         return true;
@@ -585,6 +611,83 @@ const Block* ChainState::getBlockByHeight(uint32_t height) const {
     return nullptr;
 }
 
+void ChainState::indexFilter(ChainEntry& entry, const ChainEntry* prevEntry) const {
+    auto filter = std::make_shared<const BlockFilter>(entry.block);
+    entry.filterHeader = filter->computeHeader(prevEntry ? prevEntry->filterHeader : BlockFilter::genesisPrevHeader());
+    entry.filter = std::move(filter);
+}
+
+void ChainState::storeSerialized(ChainEntry& entry, std::vector<uint8_t> data) const {
+    // Encoded once when the block is stored; the bytes are immutable from then on
+    if (data.empty()) {
+        entry.block.serializeInto(data);
+    }
+    entry.serialized = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+}
+
+std::shared_ptr<const std::vector<uint8_t>> ChainState::getSerializedBlock(const std::string& hash) const {
+    auto it = blocks.find(hash);
+    return it != blocks.end() ? it->second->serialized : nullptr;
+}
+
+void ChainState::indexTransactions(const ChainEntry& entry) {
+    for (const auto& tx : entry.block.transactions) {
+        txIndex[tx.txid].push_back(entry.block.hash);
+    }
+}
+
+std::shared_ptr<ChainEntry> ChainState::getTransactionBlock(const std::string& txid) const {
+    auto it = txIndex.find(txid);
+    if (it == txIndex.end()) {
+        return nullptr;
+    }
+    
+    // Every branch stays indexed, so a reorg needs no rewriting; only the
+    // block the best chain holds at that height counts
+    for (const auto& hash : it->second) {
+        auto entry = getBlock(hash);
+        if (entry && getBlockByHeight(entry->height) == &entry->block) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::shared_ptr<ChainEntry>> ChainState::getChainFrom(const std::string& hash, size_t count) const {
+    std::vector<std::shared_ptr<ChainEntry>> chain;
+    auto start = getBlock(hash);
+    if (!start || !bestChainTip || count == 0 || start->height > bestChainTip->height) {
+        return chain;
+    }
+    
+    // Walk back from the tip; only the requested window is kept
+    uint64_t last = static_cast<uint64_t>(start->height) + count - 1;
+    auto current = bestChainTip;
+    while (current && current->height > start->height) {
+        if (current->height <= last) {
+            chain.push_back(current);
+        }
+        auto it = blocks.find(current->block.header.prevHash);
+        current = it != blocks.end() ? it->second : nullptr;
+    }
+    if (current != start) {
+        return {};
+    }
+    chain.push_back(start);
+    std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
+std::shared_ptr<const BlockFilter> ChainState::getBlockFilter(const std::string& hash) const {
+    auto it = blocks.find(hash);
+    return it != blocks.end() ? it->second->filter : nullptr;
+}
+
+std::string ChainState::getFilterHeader(const std::string& hash) const {
+    auto it = blocks.find(hash);
+    return it != blocks.end() ? it->second->filterHeader : "";
+}
+
 const Block* ChainState::getBlockByHash(const std::string& hash) const {
     auto it = blocks.find(hash);
     if (it != blocks.end()) {
@@ -6,6 +6,7 @@
 #include <vector>
 #include <optional>
 #include "block.h"
+#include "block_filter.h"
 
 namespace pragma {
 
@@ -17,6 +18,9 @@ struct ChainEntry {
     uint32_t height;
     std::string cumulativeWork; // Hex string representing cumulative work
     uint64_t totalWork;         // Simplified work counter for now
+    std::shared_ptr<const BlockFilter> filter;  // Basic compact filter, built when the block is added
+    std::string filterHeader;                   // Commits to this filter and every ancestor's
+    std::shared_ptr<const std::vector<uint8_t>> serialized; // Stored block encoding, also its wire payload
     
     ChainEntry() = default;
     ChainEntry(const Block& b, uint32_t h, const std::string& work, uint64_t total)
@@ -29,14 +33,19 @@ struct ChainEntry {
 class ChainState {
 private:
     std::unordered_map<std::string, std::shared_ptr<ChainEntry>> blocks; // hash -> entry
+    std::unordered_map<std::string, std::vector<std::string>> txIndex;   // txid -> hashes of stored blocks holding it, on any branch
     std::shared_ptr<ChainEntry> bestChainTip;
     std::string genesisHash;
     uint64_t totalBlocks;
+    bool checkProofOfWork;      // Off only in simulations, whose blocks are not mined
     
     // Chain validation helpers
     bool isValidChain(const std::vector<std::string>& hashes) const;
     uint64_t calculateBlockWork(uint32_t bits) const;
     std::string calculateCumulativeWork(const std::string& prevWork, uint32_t bits) const;
+    void indexFilter(ChainEntry& entry, const ChainEntry* prevEntry) const;
+    void storeSerialized(ChainEntry& entry, std::vector<uint8_t> data = {}) const;
+    void indexTransactions(const ChainEntry& entry);
     
 public:
     ChainState();
@@ -57,6 +66,7 @@ public:
     // Chain validation
     bool isValidBlock(const Block& block) const;
     bool isValidConnection(const Block& block, const ChainEntry& prevEntry) const;
+    void setCheckProofOfWork(bool enabled) { checkProofOfWork = enabled; }
     
     // Chain reorganization
     bool reorganizeChain(const std::string& newTipHash);
@@ -68,6 +78,19 @@ public:
     const Block* getBlockByHeight(uint32_t height) const;
     const Block* getBlockByHash(const std::string& hash) const;
     
+    // Stored serialized block, served to peers without re-encoding (nullptr if unknown)
+    std::shared_ptr<const std::vector<uint8_t>> getSerializedBlock(const std::string& hash) const;
+    
+    // Best-chain block containing a transaction (nullptr if unknown or only on a stale branch)
+    std::shared_ptr<ChainEntry> getTransactionBlock(const std::string& txid) const;
+    
+    // Up to count best-chain entries starting at hash (empty if hash is not on the best chain)
+    std::vector<std::shared_ptr<ChainEntry>> getChainFrom(const std::string& hash, size_t count) const;
+    
+    // Compact block filters (nullptr / empty if the block is unknown)
+    std::shared_ptr<const BlockFilter> getBlockFilter(const std::string& hash) const;
+    std::string getFilterHeader(const std::string& hash) const;
+    
     // Genesis and initialization
     bool setGenesis(const Block& genesisBlock);
     bool hasGenesis() const;
@@ -158,11 +158,21 @@ bool Mempool::hasTransaction(const std::string& txid) const {
     return transactions.find(txid) != transactions.end();
 }
 
+bool Mempool::isSpent(const OutPoint& outpoint) const {
+    return spentOutputs.find(outpointToString(outpoint)) != spentOutputs.end();
+}
+
 std::shared_ptr<MempoolEntry> Mempool::getTransaction(const std::string& txid) const {
     auto it = transactions.find(txid);
     return it != transactions.end() ? it->second : nullptr;
 }
 
+void Mempool::forEachTransaction(const std::function<void(const Transaction&)>& visitor) const {
+    for (const auto& pair : transactions) {
+        visitor(pair.second->transaction);
+    }
+}
+
 std::vector<Transaction> Mempool::selectTransactions(uint64_t maxBlockSize, uint32_t currentHeight) const {
     std::vector<Transaction> selected;
     std::unordered_set<std::string> included;
@@ -10,6 +10,7 @@
 #include <queue>
 #include <memory>
 #include <functional>
+#include <ctime>
 
 namespace pragma {
 
@@ -99,6 +100,8 @@ public:
     void removeTransactions(const std::vector<std::string>& txids);
     bool hasTransaction(const std::string& txid) const;
     std::shared_ptr<MempoolEntry> getTransaction(const std::string& txid) const;
+    bool isSpent(const OutPoint& outpoint) const;   // Spent by a transaction in the pool
+    void forEachTransaction(const std::function<void(const Transaction&)>& visitor) const;
     
     // Transaction selection for mining
     std::vector<Transaction> selectTransactions(uint64_t maxBlockSize, uint32_t currentHeight) const;
@@ -1,3 +1,4 @@
+#include <stdexcept>
 #include "merkle.h"
 #include "../primitives/hash.h"
 #include "../primitives/utils.h"
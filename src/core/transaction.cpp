@@ -1,3 +1,4 @@
+#include <stdexcept>
 #include "transaction.h"
 #include "../primitives/serialize.h"
 #include "../primitives/hash.h"
@@ -8,18 +9,20 @@ namespace pragma {
 
 // TxOut implementation
 std::vector<uint8_t> TxOut::serialize() const {
-    std::vector<std::vector<uint8_t>> parts;
-    
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void TxOut::serializeInto(std::vector<uint8_t>& out) const {
     // Serialize value (8 bytes, little-endian)
-    parts.push_back(Serialize::encodeUint64LE(value));
+    Serialize::appendUint64LE(out, value);
     
     // Serialize pubKeyHash (length-prefixed string)
-    parts.push_back(Serialize::encodeString(pubKeyHash));
-    
-    return Serialize::combine(parts);
+    Serialize::appendString(out, pubKeyHash);
 }
 
-TxOut TxOut::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+TxOut TxOut::deserialize(ByteSpan data, size_t& offset) {
     TxOut txout;
     
     // Deserialize value
@@ -40,18 +43,20 @@ bool TxOut::operator==(const TxOut& other) const {
 
 // OutPoint implementation
 std::vector<uint8_t> OutPoint::serialize() const {
-    std::vector<std::vector<uint8_t>> parts;
-    
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void OutPoint::serializeInto(std::vector<uint8_t>& out) const {
     // Serialize txid (length-prefixed string)
-    parts.push_back(Serialize::encodeString(txid));
+    Serialize::appendString(out, txid);
     
     // Serialize index (4 bytes, little-endian)
-    parts.push_back(Serialize::encodeUint32LE(index));
-    
-    return Serialize::combine(parts);
+    Serialize::appendUint32LE(out, index);
 }
 
-OutPoint OutPoint::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+OutPoint OutPoint::deserialize(ByteSpan data, size_t& offset) {
     OutPoint outpoint;
     
     // Deserialize txid
@@ -79,21 +84,23 @@ bool OutPoint::operator<(const OutPoint& other) const {
 
 // TxIn implementation
 std::vector<uint8_t> TxIn::serialize() const {
-    std::vector<std::vector<uint8_t>> parts;
-    
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void TxIn::serializeInto(std::vector<uint8_t>& out) const {
     // Serialize prevout
-    parts.push_back(prevout.serialize());
+    prevout.serializeInto(out);
     
     // Serialize signature (length-prefixed string)
-    parts.push_back(Serialize::encodeString(sig));
+    Serialize::appendString(out, sig);
     
     // Serialize pubKey (length-prefixed string)
-    parts.push_back(Serialize::encodeString(pubKey));
-    
-    return Serialize::combine(parts);
+    Serialize::appendString(out, pubKey);
 }
 
-TxIn TxIn::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+TxIn TxIn::deserialize(ByteSpan data, size_t& offset) {
     TxIn txin;
     
     // Deserialize prevout
@@ -147,33 +154,39 @@ Transaction Transaction::create(const std::vector<TxIn>& inputs, const std::vect
 }
 
 std::vector<uint8_t> Transaction::serialize() const {
-    std::vector<std::vector<uint8_t>> parts;
-    
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void Transaction::serializeInto(std::vector<uint8_t>& out) const {
     // Serialize coinbase flag (1 byte)
-    parts.push_back({static_cast<uint8_t>(isCoinbase ? 1 : 0)});
+    Serialize::appendUint8LE(out, static_cast<uint8_t>(isCoinbase ? 1 : 0));
     
     // Serialize number of inputs
-    parts.push_back(Serialize::encodeVarInt(vin.size()));
+    Serialize::appendVarInt(out, vin.size());
     
     // Serialize each input
     for (const auto& input : vin) {
-        parts.push_back(input.serialize());
+        input.serializeInto(out);
     }
     
     // Serialize number of outputs
-    parts.push_back(Serialize::encodeVarInt(vout.size()));
+    Serialize::appendVarInt(out, vout.size());
     
     // Serialize each output
     for (const auto& output : vout) {
-        parts.push_back(output.serialize());
+        output.serializeInto(out);
     }
-    
-    return Serialize::combine(parts);
 }
 
 Transaction Transaction::deserialize(const std::vector<uint8_t>& data) {
-    Transaction tx;
     size_t offset = 0;
+    return deserialize(ByteSpan(data), offset);
+}
+
+Transaction Transaction::deserialize(ByteSpan data, size_t& offset) {
+    Transaction tx;
     
     // Deserialize coinbase flag
     if (offset >= data.size()) {
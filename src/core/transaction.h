@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include "../primitives/serialize.h"
 
 namespace pragma {
 
@@ -18,7 +19,8 @@ struct TxOut {
     
     // Serialization
     std::vector<uint8_t> serialize() const;
-    static TxOut deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static TxOut deserialize(ByteSpan data, size_t& offset);
     
     bool operator==(const TxOut& other) const;
 };
@@ -35,7 +37,8 @@ struct OutPoint {
     
     // Serialization
     std::vector<uint8_t> serialize() const;
-    static OutPoint deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static OutPoint deserialize(ByteSpan data, size_t& offset);
     
     bool operator==(const OutPoint& other) const;
     bool operator<(const OutPoint& other) const; // For use in maps
@@ -55,7 +58,8 @@ struct TxIn {
     
     // Serialization
     std::vector<uint8_t> serialize() const;
-    static TxIn deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static TxIn deserialize(ByteSpan data, size_t& offset);
     
     bool operator==(const TxIn& other) const;
 };
@@ -79,7 +83,9 @@ struct Transaction {
     
     // Serialization
     std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
     static Transaction deserialize(const std::vector<uint8_t>& data);
+    static Transaction deserialize(ByteSpan data, size_t& offset);
     
     // Compute transaction ID from serialized data
     void computeTxid();
@@ -0,0 +1,463 @@
+#include "address_manager.h"
+#include "../primitives/siphash.h"
+#include "../primitives/utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+namespace pragma {
+
+namespace {
+
+constexpr uint32_t FILE_MAGIC = 0x52444150;    // "PADR"
+constexpr uint8_t FILE_VERSION = 1;
+constexpr int64_t FUTURE_SLACK_SECONDS = 10 * 60;
+constexpr int64_t WEEK_SECONDS = 7 * 24 * 60 * 60;
+
+int64_t resolveTime(int64_t now) {
+    return now != 0 ? now : static_cast<int64_t>(Utils::getCurrentTimestamp());
+}
+
+// Integers are stored little-endian whatever the host order, like the rest
+// of the serializer, so peers.dat moves between machines
+template <typename T>
+void put(std::vector<uint8_t>& out, T value) {
+    auto bits = static_cast<std::make_unsigned_t<T>>(value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+}
+
+void putString(std::vector<uint8_t>& out, const std::string& value) {
+    out.push_back(static_cast<uint8_t>(std::min<size_t>(value.size(), 255)));
+    out.insert(out.end(), value.begin(), value.begin() + std::min<size_t>(value.size(), 255));
+}
+
+template <typename T>
+bool get(const std::vector<uint8_t>& in, size_t& offset, T& value) {
+    using Bits = std::make_unsigned_t<T>;
+    if (in.size() - offset < sizeof(T)) return false;
+    Bits bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bits |= static_cast<Bits>(static_cast<Bits>(in[offset + i]) << (8 * i));
+    }
+    value = static_cast<T>(bits);
+    offset += sizeof(T);
+    return true;
+}
+
+bool getString(const std::vector<uint8_t>& in, size_t& offset, std::string& value) {
+    uint8_t length;
+    if (!get(in, offset, length) || in.size() - offset < length) return false;
+    value.assign(reinterpret_cast<const char*>(in.data() + offset), length);
+    offset += length;
+    return true;
+}
+
+} // namespace
+
+AddressManager::AddressManager()
+    : newTable(NEW_BUCKET_COUNT * BUCKET_SIZE, -1), triedTable(TRIED_BUCKET_COUNT * BUCKET_SIZE, -1),
+      newCount(0), triedCount(0), nextId(0), rng(std::random_device{}()) {
+    k0 = Utils::randomUint64();
+    k1 = Utils::randomUint64();
+}
+
+std::string AddressManager::groupOf(const std::string& ip) {
+    // IPv4 addresses group by /16; anything else is its own group
+    size_t first = ip.find('.');
+    size_t second = first == std::string::npos ? std::string::npos : ip.find('.', first + 1);
+    return second == std::string::npos ? ip : ip.substr(0, second);
+}
+
+uint64_t AddressManager::keyedHash(const std::string& data) const {
+    return SipHash::hash(k0, k1, data);
+}
+
+size_t AddressManager::newSlot(const Info& info) const {
+    std::string group = groupOf(info.address.ip);
+    uint64_t spread = keyedHash(group + "|" + info.sourceGroup) % NEW_BUCKETS_PER_SOURCE_GROUP;
+    size_t bucket = keyedHash(info.sourceGroup + "|" + std::to_string(spread)) % NEW_BUCKET_COUNT;
+    size_t position = keyedHash("N" + std::to_string(bucket) + "|" + info.address.toString()) % BUCKET_SIZE;
+    return bucket * BUCKET_SIZE + position;
+}
+
+size_t AddressManager::triedSlot(const Info& info) const {
+    std::string key = info.address.toString();
+    uint64_t spread = keyedHash(key) % TRIED_BUCKETS_PER_GROUP;
+    size_t bucket = keyedHash(groupOf(info.address.ip) + "|" + std::to_string(spread)) % TRIED_BUCKET_COUNT;
+    size_t position = keyedHash("T" + std::to_string(bucket) + "|" + key) % BUCKET_SIZE;
+    return bucket * BUCKET_SIZE + position;
+}
+
+bool AddressManager::isTerrible(const Info& info, int64_t now) {
+    if (info.lastAttempt != 0 && now - info.lastAttempt < 60) {
+        return false; // Just tried; give it a chance to finish
+    }
+    if (info.lastSeen > now + FUTURE_SLACK_SECONDS) {
+        return true;
+    }
+    if (info.lastSeen == 0 || now - info.lastSeen > HORIZON_SECONDS) {
+        return true;
+    }
+    if (info.lastSuccess == 0 && info.attempts >= MAX_RETRIES) {
+        return true;
+    }
+    return now - info.lastSuccess > WEEK_SECONDS && info.attempts >= MAX_FAILURES;
+}
+
+double AddressManager::selectionChance(const Info& info, int64_t now) {
+    double chance = 1.0;
+    if (now - info.lastAttempt < RECENT_TRY_SECONDS) {
+        chance *= 0.01;
+    }
+    return chance * std::pow(0.66, std::min<uint32_t>(info.attempts, 8));
+}
+
+int AddressManager::insertNew(const NetworkAddress& address, const std::string& sourceGroup, int64_t now,
+                              bool displace) {
+    std::string key = address.toString();
+    int64_t advertised = address.timestamp != 0 ? static_cast<int64_t>(address.timestamp) : now;
+
+    auto existing = index.find(key);
+    if (existing != index.end()) {
+        Info& info = entries[existing->second].info;
+        info.lastSeen = std::max(info.lastSeen, std::min(advertised, now));
+        info.address.services |= address.services;
+        return -1;
+    }
+
+    Info info;
+    info.address = address;
+    info.sourceGroup = sourceGroup;
+    info.lastSeen = std::min(advertised, now);
+
+    // A full slot keeps its occupant unless that one is no longer useful, or
+    // the newcomer is already known to work
+    size_t slot = newSlot(info);
+    if (newTable[slot] != -1) {
+        if (!displace && !isTerrible(entries[newTable[slot]].info, now)) {
+            return -1;
+        }
+        erase(newTable[slot]);
+    }
+
+    int id = nextId++;
+    entries[id] = Entry{info, randomOrder.size()};
+    randomOrder.push_back(id);
+    index[key] = id;
+    newTable[slot] = id;
+    newCount++;
+    return id;
+}
+
+void AddressManager::makeTried(int id) {
+    Info& info = entries[id].info;
+    if (info.tried) {
+        return;
+    }
+
+    size_t oldSlot = newSlot(info);
+    if (newTable[oldSlot] == id) {
+        newTable[oldSlot] = -1;
+    }
+    newCount--;
+
+    // The current occupant of the tried slot moves back to the new table
+    size_t slot = triedSlot(info);
+    int evicted = triedTable[slot];
+    if (evicted != -1) {
+        Info& evictedInfo = entries[evicted].info;
+        evictedInfo.tried = false;
+        triedCount--;
+
+        size_t evictedSlot = newSlot(evictedInfo);
+        if (newTable[evictedSlot] != -1) {
+            erase(newTable[evictedSlot]);
+        }
+        newTable[evictedSlot] = evicted;
+        newCount++;
+    }
+
+    triedTable[slot] = id;
+    info.tried = true;
+    triedCount++;
+}
+
+void AddressManager::erase(int id) {
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        return;
+    }
+    const Info& info = it->second.info;
+
+    if (info.tried) {
+        size_t slot = triedSlot(info);
+        if (triedTable[slot] == id) triedTable[slot] = -1;
+        triedCount--;
+    } else {
+        size_t slot = newSlot(info);
+        if (newTable[slot] == id) newTable[slot] = -1;
+        newCount--;
+    }
+
+    // Swap-remove from the sampling order
+    size_t pos = it->second.randomPos;
+    int last = randomOrder.back();
+    randomOrder[pos] = last;
+    entries[last].randomPos = pos;
+    randomOrder.pop_back();
+
+    index.erase(info.address.toString());
+    entries.erase(it);
+}
+
+void AddressManager::clear() {
+    index.clear();
+    entries.clear();
+    randomOrder.clear();
+    std::fill(newTable.begin(), newTable.end(), -1);
+    std::fill(triedTable.begin(), triedTable.end(), -1);
+    newCount = 0;
+    triedCount = 0;
+}
+
+bool AddressManager::add(const NetworkAddress& address, const NetworkAddress& source, int64_t now) {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    return insertNew(address, groupOf(source.ip), resolveTime(now)) != -1;
+}
+
+bool AddressManager::add(const std::vector<NetworkAddress>& addresses, const NetworkAddress& source, int64_t now) {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    now = resolveTime(now);
+    std::string sourceGroup = groupOf(source.ip);
+
+    bool added = false;
+    for (const auto& address : addresses) {
+        added |= insertNew(address, sourceGroup, now) != -1;
+    }
+    return added;
+}
+
+void AddressManager::attempt(const NetworkAddress& address, int64_t now) {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    auto it = index.find(address.toString());
+    if (it == index.end()) {
+        return;
+    }
+    Info& info = entries[it->second].info;
+    info.lastAttempt = resolveTime(now);
+    info.attempts++;
+}
+
+void AddressManager::good(const NetworkAddress& address, int64_t now) {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    now = resolveTime(now);
+
+    // Peers from configuration or seeds are learned on first success, even
+    // over a useful occupant; makeTried then pushes any tried one back to new
+    auto it = index.find(address.toString());
+    int id = it != index.end() ? it->second : insertNew(address, groupOf(address.ip), now, true);
+    if (id == -1) {
+        return;
+    }
+
+    Info& info = entries[id].info;
+    info.lastSuccess = now;
+    info.lastAttempt = now;
+    info.lastSeen = now;
+    info.attempts = 0;
+    makeTried(id);
+}
+
+bool AddressManager::select(NetworkAddress& address, bool newOnly, int64_t now) {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    now = resolveTime(now);
+
+    if (newOnly ? newCount == 0 : randomOrder.empty()) {
+        return false;
+    }
+
+    // Half the picks come from tried addresses when there are any, then
+    // entries are sampled until one passes its (slowly relaxed) chance
+    bool useTried = !newOnly && triedCount > 0 && (newCount == 0 || (rng() & 1));
+    std::uniform_int_distribution<size_t> pick(0, randomOrder.size() - 1);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    double factor = 1.0;
+    for (size_t i = 0; i < 100000; ++i) {
+        const Info& info = entries[randomOrder[pick(rng)]].info;
+        if (info.tried != useTried) {
+            continue;
+        }
+        if (coin(rng) < factor * selectionChance(info, now)) {
+            address = info.address;
+            return true;
+        }
+        factor *= 1.2;
+    }
+    return false;
+}
+
+std::vector<NetworkAddress> AddressManager::getAddresses(size_t maxCount, int64_t now) {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    now = resolveTime(now);
+
+    std::vector<int> order = randomOrder;
+    std::vector<NetworkAddress> result;
+    for (size_t i = 0; i < order.size() && result.size() < maxCount; ++i) {
+        std::uniform_int_distribution<size_t> pick(i, order.size() - 1);
+        std::swap(order[i], order[pick(rng)]);
+
+        const Info& info = entries[order[i]].info;
+        if (isTerrible(info, now)) {
+            continue;
+        }
+        NetworkAddress address = info.address;
+        address.timestamp = static_cast<uint64_t>(info.lastSeen);
+        result.push_back(address);
+    }
+    return result;
+}
+
+bool AddressManager::saveToFile(const std::string& filename) const {
+    std::vector<uint8_t> data;
+    {
+        std::lock_guard<std::mutex> lock(addrMutex);
+        data.reserve(32 + entries.size() * 64);
+        put(data, FILE_MAGIC);
+        put(data, FILE_VERSION);
+        put(data, k0);
+        put(data, k1);
+        put(data, static_cast<uint32_t>(entries.size()));
+
+        // Tried entries first so they reclaim their slots before new ones load
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int id : randomOrder) {
+                const Info& info = entries.at(id).info;
+                if (info.tried != (pass == 0)) continue;
+                putString(data, info.address.ip);
+                put(data, info.address.port);
+                put(data, info.address.services);
+                put(data, info.lastSeen);
+                put(data, info.lastSuccess);
+                put(data, info.lastAttempt);
+                put(data, info.attempts);
+                put(data, static_cast<uint8_t>(info.tried ? 1 : 0));
+                putString(data, info.sourceGroup);
+            }
+        }
+    }
+
+    // Write to a temporary file and rename so a crash never leaves a torn table
+    std::string tempName = filename + ".tmp";
+    {
+        std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            Utils::logError("Cannot open file for writing: " + tempName);
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file.good()) {
+            Utils::logError("Error writing address table: " + tempName);
+            return false;
+        }
+    }
+    if (std::rename(tempName.c_str(), filename.c_str()) != 0) {
+        Utils::logError("Cannot replace address table: " + filename);
+        return false;
+    }
+    return true;
+}
+
+bool AddressManager::loadFromFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t offset = 0;
+    uint32_t magic = 0, count = 0;
+    uint8_t version = 0;
+    uint64_t key0 = 0, key1 = 0;
+    if (!get(data, offset, magic) || magic != FILE_MAGIC || !get(data, offset, version) ||
+        version != FILE_VERSION || !get(data, offset, key0) || !get(data, offset, key1) ||
+        !get(data, offset, count)) {
+        Utils::logWarning("Ignoring invalid address table: " + filename);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(addrMutex);
+    clear();
+    k0 = key0;
+    k1 = key1;
+
+    int64_t now = resolveTime(0);
+    for (uint32_t i = 0; i < count; ++i) {
+        NetworkAddress address;
+        Info loaded;
+        uint8_t tried = 0;
+        if (!getString(data, offset, address.ip) || !get(data, offset, address.port) ||
+            !get(data, offset, address.services) || !get(data, offset, loaded.lastSeen) ||
+            !get(data, offset, loaded.lastSuccess) || !get(data, offset, loaded.lastAttempt) ||
+            !get(data, offset, loaded.attempts) || !get(data, offset, tried) ||
+            !getString(data, offset, loaded.sourceGroup)) {
+            Utils::logWarning("Address table truncated: " + filename);
+            break;
+        }
+
+        address.timestamp = static_cast<uint64_t>(loaded.lastSeen);
+        int id = insertNew(address, loaded.sourceGroup, std::max(now, loaded.lastSeen));
+        if (id == -1) {
+            continue;
+        }
+        Info& info = entries[id].info;
+        info.lastSeen = loaded.lastSeen;
+        info.lastSuccess = loaded.lastSuccess;
+        info.lastAttempt = loaded.lastAttempt;
+        info.attempts = loaded.attempts;
+
+        // Tried entries load first; one whose tried slot is already taken stays new
+        if (tried && triedTable[triedSlot(info)] == -1) {
+            makeTried(id);
+        }
+    }
+    return true;
+}
+
+size_t AddressManager::size() const {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    return entries.size();
+}
+
+size_t AddressManager::getNewCount() const {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    return newCount;
+}
+
+size_t AddressManager::getTriedCount() const {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    return triedCount;
+}
+
+bool AddressManager::contains(const NetworkAddress& address) const {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    return index.count(address.toString()) != 0;
+}
+
+bool AddressManager::getInfo(const NetworkAddress& address, Info& info) const {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    auto it = index.find(address.toString());
+    if (it == index.end()) {
+        return false;
+    }
+    info = entries.at(it->second).info;
+    return true;
+}
+
+} // namespace pragma
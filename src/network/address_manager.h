@@ -0,0 +1,106 @@
+#pragma once
+
+#include "protocol.h"
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Address book for outbound peer selection.
+ * Addresses we have only heard about live in "new" buckets, addresses we
+ * have connected to in "tried" buckets. Bucket positions come from a keyed
+ * hash of the address group (/16) and, for new entries, the group of the
+ * peer that told us, so one source cannot fill the table. Selection favours
+ * tried addresses that connected recently and backs off from ones that
+ * keep failing. The table persists to a compact file so a restarted node
+ * reconnects to known peers without falling back to the seed nodes.
+ */
+class AddressManager {
+public:
+    static constexpr size_t NEW_BUCKET_COUNT = 1024;
+    static constexpr size_t TRIED_BUCKET_COUNT = 256;
+    static constexpr size_t BUCKET_SIZE = 64;
+    static constexpr size_t NEW_BUCKETS_PER_SOURCE_GROUP = 64;
+    static constexpr size_t TRIED_BUCKETS_PER_GROUP = 8;
+
+    static constexpr int64_t HORIZON_SECONDS = 30 * 24 * 60 * 60;    // Unseen for longer is terrible
+    static constexpr uint32_t MAX_RETRIES = 3;                      // Failures before a never-good address is dropped
+    static constexpr uint32_t MAX_FAILURES = 10;                    // Failures in a week that make any address terrible
+    static constexpr int64_t RECENT_TRY_SECONDS = 10 * 60;          // Recently tried addresses are deprioritized
+
+    struct Info {
+        NetworkAddress address;
+        std::string sourceGroup;
+        int64_t lastSeen = 0;       // Timestamp advertised by peers
+        int64_t lastSuccess = 0;    // Last completed handshake
+        int64_t lastAttempt = 0;    // Last connection attempt
+        uint32_t attempts = 0;      // Failed attempts since the last success
+        bool tried = false;
+    };
+
+private:
+    struct Entry {
+        Info info;
+        size_t randomPos;       // Position in randomOrder
+    };
+
+    uint64_t k0, k1;                                    // Bucket hash key, persisted with the table
+    std::unordered_map<std::string, int> index;         // "ip:port" -> id
+    std::unordered_map<int, Entry> entries;
+    std::vector<int> randomOrder;                       // All ids, for uniform sampling
+    std::vector<int> newTable;                          // NEW_BUCKET_COUNT * BUCKET_SIZE, -1 if empty
+    std::vector<int> triedTable;                        // TRIED_BUCKET_COUNT * BUCKET_SIZE, -1 if empty
+    size_t newCount;
+    size_t triedCount;
+    int nextId;
+    std::mt19937_64 rng;
+    mutable std::mutex addrMutex;
+
+    static std::string groupOf(const std::string& ip);
+    uint64_t keyedHash(const std::string& data) const;
+    size_t newSlot(const Info& info) const;
+    size_t triedSlot(const Info& info) const;
+    static bool isTerrible(const Info& info, int64_t now);
+    static double selectionChance(const Info& info, int64_t now);
+
+    int insertNew(const NetworkAddress& address, const std::string& sourceGroup, int64_t now,
+                  bool displace = false);
+    void makeTried(int id);
+    void erase(int id);
+    void clear();
+
+public:
+    AddressManager();
+
+    // Learning addresses; false if already known or rejected by a full bucket
+    bool add(const NetworkAddress& address, const NetworkAddress& source, int64_t now = 0);
+    bool add(const std::vector<NetworkAddress>& addresses, const NetworkAddress& source, int64_t now = 0);
+
+    // Connection feedback
+    void attempt(const NetworkAddress& address, int64_t now = 0);
+    void good(const NetworkAddress& address, int64_t now = 0);
+
+    // Picks an address to connect to, or false if the table is empty
+    bool select(NetworkAddress& address, bool newOnly = false, int64_t now = 0);
+
+    // Random sample of usable addresses for getaddr responses
+    std::vector<NetworkAddress> getAddresses(size_t maxCount, int64_t now = 0);
+
+    // Persistence
+    bool saveToFile(const std::string& filename) const;
+    bool loadFromFile(const std::string& filename);
+
+    // Status
+    size_t size() const;
+    size_t getNewCount() const;
+    size_t getTriedCount() const;
+    bool contains(const NetworkAddress& address) const;
+    bool getInfo(const NetworkAddress& address, Info& info) const;
+};
+
+} // namespace pragma
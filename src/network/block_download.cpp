@@ -0,0 +1,246 @@
+#include "block_download.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pragma {
+
+// BlockDownloadScheduler implementation
+BlockDownloadScheduler::BlockDownloadScheduler() : BlockDownloadScheduler(Config()) {}
+
+BlockDownloadScheduler::BlockDownloadScheduler(const Config& cfg)
+    : config(cfg), base(0), bufferedBytes(0) {}
+
+void BlockDownloadScheduler::addBlocks(const std::vector<std::string>& hashes) {
+    for (const auto& hash : hashes) {
+        if (positions.count(hash)) continue;
+
+        uint64_t position = base + order.size();
+        order.push_back(hash);
+        positions[hash] = position;
+        entries[hash] = BlockEntry();
+        queued.insert(position);
+    }
+}
+
+std::vector<std::string> BlockDownloadScheduler::assignBlocks(const std::string& peerId, Clock::time_point now) {
+    std::vector<std::string> assigned;
+    PeerState& peer = getPeerState(peerId);
+    uint64_t windowEnd = base + config.windowSize;
+
+    while (peer.inFlight < peer.limit && !queued.empty()) {
+        uint64_t position = *queued.begin();
+        if (position >= windowEnd) {
+            break; // Wait for the connected tip to advance
+        }
+        // Over the memory budget only the block everyone is waiting on may be fetched
+        if (bufferedBytes >= config.maxBufferedBytes && position != base) {
+            break;
+        }
+
+        const std::string& hash = order[position - base];
+        BlockEntry& entry = entries[hash];
+        entry.status = BlockStatus::IN_FLIGHT;
+        entry.peerId = peerId;
+        entry.requestTime = now;
+
+        queued.erase(queued.begin());
+        inFlight[position] = hash;
+        if (peer.inFlight == 0 && peer.windowCount == 0) {
+            peer.windowStart = now; // Peer goes from idle to busy
+        }
+        peer.inFlight++;
+        assigned.push_back(hash);
+    }
+    return assigned;
+}
+
+BlockDownloadScheduler::ReceiveResult BlockDownloadScheduler::blockReceived(const std::string& peerId,
+                                                                            std::shared_ptr<Block> block,
+                                                                            size_t bytes,
+                                                                            Clock::time_point now) {
+    if (!block) return ReceiveResult::UNSOLICITED;
+
+    auto positionIt = positions.find(block->hash);
+    if (positionIt == positions.end()) {
+        return ReceiveResult::UNSOLICITED;
+    }
+    uint64_t position = positionIt->second;
+    BlockEntry& entry = entries[block->hash];
+
+    if (entry.status == BlockStatus::RECEIVED) {
+        return ReceiveResult::DUPLICATE;
+    }
+
+    if (entry.status == BlockStatus::IN_FLIGHT) {
+        auto ownerIt = peers.find(entry.peerId);
+        if (ownerIt != peers.end()) {
+            PeerState& owner = ownerIt->second;
+            owner.inFlight--;
+            // Only the assigned peer's deliveries count towards its rate
+            if (entry.peerId == peerId) {
+                updatePeerRate(owner, entry.requestTime, now);
+            }
+        }
+        inFlight.erase(position);
+    } else if (position == base) {
+        // Connectable at once, so it never sits in the buffer
+        queued.erase(position);
+    } else {
+        // Nobody was asked for it; buffering it would bypass the memory budget
+        return ReceiveResult::UNSOLICITED;
+    }
+
+    entry.status = BlockStatus::RECEIVED;
+    entry.peerId.clear();
+    entry.block = std::move(block);
+    entry.bytes = bytes;
+    bufferedBytes += bytes;
+    return ReceiveResult::ACCEPTED;
+}
+
+std::vector<std::shared_ptr<Block>> BlockDownloadScheduler::takeConnectable() {
+    std::vector<std::shared_ptr<Block>> ready;
+
+    while (!order.empty()) {
+        auto entryIt = entries.find(order.front());
+        if (entryIt == entries.end() || entryIt->second.status != BlockStatus::RECEIVED) {
+            break;
+        }
+
+        ready.push_back(std::move(entryIt->second.block));
+        bufferedBytes -= entryIt->second.bytes;
+        positions.erase(order.front());
+        entries.erase(entryIt);
+        order.pop_front();
+        base++;
+    }
+    return ready;
+}
+
+std::vector<std::string> BlockDownloadScheduler::expireStalled(Clock::time_point now) {
+    std::vector<std::string> stalledPeers;
+    std::vector<uint64_t> expired;
+
+    for (const auto& [position, hash] : inFlight) {
+        const BlockEntry& entry = entries[hash];
+        auto peerIt = peers.find(entry.peerId);
+        if (peerIt == peers.end() || now - entry.requestTime > timeoutFor(peerIt->second)) {
+            expired.push_back(position);
+        }
+    }
+
+    for (uint64_t position : expired) {
+        const std::string& peerId = entries[inFlight[position]].peerId;
+        auto peerIt = peers.find(peerId);
+        if (peerIt != peers.end()) {
+            PeerState& peer = peerIt->second;
+            peer.stalls++;
+            // Halve the pipeline once per stalled peer, not once per block
+            if (std::find(stalledPeers.begin(), stalledPeers.end(), peerId) == stalledPeers.end()) {
+                peer.limit = std::max(config.minPerPeer, peer.limit / 2);
+                stalledPeers.push_back(peerId);
+            }
+        }
+        requeue(position);
+    }
+    return stalledPeers;
+}
+
+void BlockDownloadScheduler::removePeer(const std::string& peerId) {
+    std::vector<uint64_t> owned;
+    for (const auto& [position, hash] : inFlight) {
+        if (entries[hash].peerId == peerId) {
+            owned.push_back(position);
+        }
+    }
+    for (uint64_t position : owned) {
+        requeue(position);
+    }
+    peers.erase(peerId);
+}
+
+void BlockDownloadScheduler::reset() {
+    order.clear();
+    base = 0;
+    positions.clear();
+    entries.clear();
+    queued.clear();
+    inFlight.clear();
+    bufferedBytes = 0;
+    peers.clear();
+}
+
+size_t BlockDownloadScheduler::getPeerInFlight(const std::string& peerId) const {
+    auto it = peers.find(peerId);
+    return it != peers.end() ? it->second.inFlight : 0;
+}
+
+size_t BlockDownloadScheduler::getPeerLimit(const std::string& peerId) const {
+    auto it = peers.find(peerId);
+    return it != peers.end() ? it->second.limit : config.initialPerPeer;
+}
+
+double BlockDownloadScheduler::getPeerRate(const std::string& peerId) const {
+    auto it = peers.find(peerId);
+    return it != peers.end() ? it->second.blocksPerSecond : 0.0;
+}
+
+BlockDownloadScheduler::PeerState& BlockDownloadScheduler::getPeerState(const std::string& peerId) {
+    auto it = peers.find(peerId);
+    if (it == peers.end()) {
+        PeerState peer;
+        peer.limit = std::clamp(config.initialPerPeer, config.minPerPeer, config.maxPerPeer);
+        it = peers.emplace(peerId, peer).first;
+    }
+    return it->second;
+}
+
+void BlockDownloadScheduler::updatePeerRate(PeerState& peer, Clock::time_point requestTime, Clock::time_point now) {
+    peer.delivered++;
+    if (peer.windowCount == 0 && peer.windowStart < requestTime) {
+        peer.windowStart = requestTime;
+    }
+    peer.windowCount++;
+
+    // Sample throughput over windows of at least a second of busy time
+    double elapsed = std::chrono::duration<double>(now - peer.windowStart).count();
+    if (elapsed < 1.0) {
+        return;
+    }
+
+    double sample = peer.windowCount / elapsed;
+    peer.blocksPerSecond = peer.blocksPerSecond == 0.0 ? sample : 0.7 * peer.blocksPerSecond + 0.3 * sample;
+    peer.windowStart = now;
+    peer.windowCount = 0;
+
+    // Keep roughly pipelineSeconds of work queued at the peer's measured rate
+    size_t target = static_cast<size_t>(std::ceil(peer.blocksPerSecond * config.pipelineSeconds));
+    peer.limit = std::clamp(target, config.minPerPeer, config.maxPerPeer);
+}
+
+std::chrono::milliseconds BlockDownloadScheduler::timeoutFor(const PeerState& peer) const {
+    // Allow for the blocks queued ahead of this one at the peer's known rate
+    auto timeout = config.stallTimeout;
+    if (peer.blocksPerSecond > 0.0) {
+        auto queueDelay = std::chrono::milliseconds(static_cast<int64_t>(1000.0 * peer.inFlight / peer.blocksPerSecond));
+        timeout += std::min(queueDelay, config.stallTimeout * 3);
+    }
+    return timeout;
+}
+
+void BlockDownloadScheduler::requeue(uint64_t position) {
+    auto it = inFlight.find(position);
+    if (it == inFlight.end()) return;
+
+    BlockEntry& entry = entries[it->second];
+    auto peerIt = peers.find(entry.peerId);
+    if (peerIt != peers.end() && peerIt->second.inFlight > 0) {
+        peerIt->second.inFlight--;
+    }
+    entry.status = BlockStatus::QUEUED;
+    entry.peerId.clear();
+    inFlight.erase(it);
+    queued.insert(position);
+}
+
+} // namespace pragma
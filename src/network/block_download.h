@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../core/block.h"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Block download scheduler for initial sync.
+ * Keeps a sliding window of blocks in flight across all ready peers, sizes
+ * each peer's share by its measured delivery rate, re-assigns blocks from
+ * stalled peers and buffers out-of-order arrivals until they can be
+ * connected in chain order. Not thread-safe; SyncManager serializes access.
+ */
+class BlockDownloadScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        size_t windowSize = 1024;                       // Max blocks ahead of the next block to connect
+        size_t maxBufferedBytes = 256 * 1024 * 1024;    // Out-of-order blocks held in memory
+        size_t minPerPeer = 2;                          // In-flight bounds per peer
+        size_t maxPerPeer = 64;
+        size_t initialPerPeer = 4;
+        double pipelineSeconds = 2.0;                   // Keep about this much work queued per peer
+        std::chrono::milliseconds stallTimeout{10000};  // Base request timeout
+    };
+
+    enum class ReceiveResult {
+        ACCEPTED,
+        DUPLICATE,      // Already received or connected
+        UNSOLICITED     // Not scheduled by us, or not requested and not yet connectable
+    };
+
+private:
+    enum class BlockStatus { QUEUED, IN_FLIGHT, RECEIVED };
+
+    struct BlockEntry {
+        BlockStatus status = BlockStatus::QUEUED;
+        std::string peerId;
+        Clock::time_point requestTime;
+        std::shared_ptr<Block> block;
+        size_t bytes = 0;
+    };
+
+    struct PeerState {
+        size_t inFlight = 0;
+        size_t limit = 0;
+        double blocksPerSecond = 0.0;     // EWMA of delivered blocks per second
+        Clock::time_point windowStart;    // Start of the current rate sampling window
+        size_t windowCount = 0;           // Blocks delivered in the current window
+        uint64_t delivered = 0;
+        uint64_t stalls = 0;
+    };
+
+    Config config;
+
+    // Chain-ordered hashes; positions are absolute, base is the next block to connect
+    std::deque<std::string> order;
+    uint64_t base;
+    std::unordered_map<std::string, uint64_t> positions;
+    std::unordered_map<std::string, BlockEntry> entries;
+
+    std::set<uint64_t> queued;        // Positions waiting for a peer, lowest first
+    std::map<uint64_t, std::string> inFlight;
+    size_t bufferedBytes;
+
+    std::unordered_map<std::string, PeerState> peers;
+
+    PeerState& getPeerState(const std::string& peerId);
+    void updatePeerRate(PeerState& peer, Clock::time_point requestTime, Clock::time_point now);
+    std::chrono::milliseconds timeoutFor(const PeerState& peer) const;
+    void requeue(uint64_t position);
+
+public:
+    BlockDownloadScheduler();
+    explicit BlockDownloadScheduler(const Config& cfg);
+
+    // Scheduling. Times come from the caller's clock, which may be virtual,
+    // so every timestamp and timeout is measured on the same one
+    void addBlocks(const std::vector<std::string>& hashes);
+    std::vector<std::string> assignBlocks(const std::string& peerId, Clock::time_point now);
+    ReceiveResult blockReceived(const std::string& peerId, std::shared_ptr<Block> block, size_t bytes,
+                                Clock::time_point now);
+    std::vector<std::shared_ptr<Block>> takeConnectable();
+
+    // Failure handling; returns peers that stalled so the caller can penalize them
+    std::vector<std::string> expireStalled(Clock::time_point now);
+    void removePeer(const std::string& peerId);
+    void reset();
+
+    // Status
+    bool isScheduled(const std::string& hash) const { return entries.count(hash) != 0; }
+    bool isComplete() const { return order.empty(); }
+    size_t getPendingCount() const { return order.size(); }
+    size_t getQueuedCount() const { return queued.size(); }
+    size_t getInFlightCount() const { return inFlight.size(); }
+    size_t getBufferedBytes() const { return bufferedBytes; }
+    size_t getPeerInFlight(const std::string& peerId) const;
+    size_t getPeerLimit(const std::string& peerId) const;
+    double getPeerRate(const std::string& peerId) const;
+    std::string getLastHash() const { return order.empty() ? "" : order.back(); }
+};
+
+} // namespace pragma
@@ -0,0 +1,154 @@
+#include "compact_block.h"
+#include "../primitives/siphash.h"
+#include <openssl/sha.h>
+#include <cstring>
+#include <unordered_set>
+
+namespace pragma {
+
+// CompactBlocks implementation
+CompactBlockMessage CompactBlocks::build(const Block& block, uint64_t nonce) {
+    CompactBlockMessage compact;
+    compact.header = block.header;
+    compact.nonce = nonce;
+
+    uint64_t k0, k1;
+    getShortIdKeys(block.header, nonce, k0, k1);
+
+    compact.shortIds.reserve(block.transactions.size());
+    for (size_t i = 0; i < block.transactions.size(); ++i) {
+        const Transaction& tx = block.transactions[i];
+        if (i == 0 || tx.isCoinbase) {
+            // The coinbase is never in anyone's mempool
+            compact.prefilled.push_back({static_cast<uint32_t>(i), tx});
+        } else {
+            compact.shortIds.push_back(getShortId(k0, k1, tx.txid));
+        }
+    }
+    return compact;
+}
+
+void CompactBlocks::getShortIdKeys(const BlockHeader& header, uint64_t nonce, uint64_t& k0, uint64_t& k1) {
+    std::vector<uint8_t> preimage;
+    header.serializeInto(preimage);
+    Serialize::appendUint64LE(preimage, nonce);
+
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(preimage.data(), preimage.size(), digest);
+    std::memcpy(&k0, digest, 8);
+    std::memcpy(&k1, digest + 8, 8);
+}
+
+uint64_t CompactBlocks::getShortId(uint64_t k0, uint64_t k1, const std::string& txid) {
+    return SipHash::hash(k0, k1, txid) & SHORT_ID_MASK;
+}
+
+// PartiallyDownloadedBlock implementation
+PartiallyDownloadedBlock::PartiallyDownloadedBlock() : prefilledCount(0), mempoolCount(0) {}
+
+PartiallyDownloadedBlock::Status PartiallyDownloadedBlock::initialize(const CompactBlockMessage& compactBlock,
+                                                                      const Mempool* mempool) {
+    size_t txCount = compactBlock.getTransactionCount();
+    if (txCount == 0 || compactBlock.shortIds.size() > txCount) {
+        return Status::INVALID;
+    }
+
+    header = compactBlock.header;
+    blockHash = header.computeHash();
+    slots.assign(txCount, nullptr);
+    prefilledCount = 0;
+    mempoolCount = 0;
+
+    // Place prefilled transactions; indexes arrive strictly ascending
+    for (const auto& entry : compactBlock.prefilled) {
+        if (entry.index >= txCount || slots[entry.index]) {
+            return Status::INVALID;
+        }
+        slots[entry.index] = std::make_shared<const Transaction>(entry.tx);
+        prefilledCount++;
+    }
+
+    // Map each short ID to the slot it fills
+    std::unordered_map<uint64_t, size_t> shortIdSlots;
+    shortIdSlots.reserve(compactBlock.shortIds.size());
+    size_t shortIdIndex = 0;
+    for (size_t i = 0; i < txCount; ++i) {
+        if (slots[i]) continue;
+        if (!shortIdSlots.emplace(compactBlock.shortIds[shortIdIndex++] & CompactBlocks::SHORT_ID_MASK, i).second) {
+            return Status::FAILED; // Duplicate short IDs in one block
+        }
+    }
+
+    if (!mempool || shortIdSlots.empty()) {
+        return Status::OK;
+    }
+
+    // Scan the mempool once, hashing each txid with this block's salt
+    uint64_t k0, k1;
+    CompactBlocks::getShortIdKeys(header, compactBlock.nonce, k0, k1);
+    std::unordered_set<size_t> collided;
+    mempool->forEachTransaction([&](const Transaction& tx) {
+        auto it = shortIdSlots.find(CompactBlocks::getShortId(k0, k1, tx.txid));
+        if (it == shortIdSlots.end()) return;
+
+        size_t slot = it->second;
+        if (slots[slot]) {
+            // Two mempool transactions share the short ID; let getblocktxn decide
+            if (!collided.count(slot)) {
+                collided.insert(slot);
+                slots[slot].reset();
+                mempoolCount--;
+            }
+            return;
+        }
+        if (collided.count(slot)) return;
+        slots[slot] = std::make_shared<const Transaction>(tx);
+        mempoolCount++;
+    });
+
+    return Status::OK;
+}
+
+bool PartiallyDownloadedBlock::isTxAvailable(size_t index) const {
+    return index < slots.size() && slots[index] != nullptr;
+}
+
+std::vector<uint32_t> PartiallyDownloadedBlock::getMissingIndexes() const {
+    std::vector<uint32_t> missing;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (!slots[i]) {
+            missing.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return missing;
+}
+
+PartiallyDownloadedBlock::Status PartiallyDownloadedBlock::fillBlock(Block& block,
+                                                                    const std::vector<Transaction>& missing) const {
+    std::vector<Transaction> transactions;
+    transactions.reserve(slots.size());
+
+    size_t missingIndex = 0;
+    for (const auto& slot : slots) {
+        if (slot) {
+            transactions.push_back(*slot);
+        } else if (missingIndex < missing.size()) {
+            transactions.push_back(missing[missingIndex++]);
+        } else {
+            return Status::INVALID; // Peer answered with too few transactions
+        }
+    }
+    if (missingIndex != missing.size()) {
+        return Status::INVALID;
+    }
+
+    block = Block(header, transactions);
+
+    // A short ID collision shows up as a merkle root mismatch
+    if (!block.isValidMerkleRoot()) {
+        return Status::FAILED;
+    }
+    return Status::OK;
+}
+
+} // namespace pragma
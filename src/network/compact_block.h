@@ -0,0 +1,63 @@
+#pragma once
+
+#include "protocol.h"
+#include "../core/block.h"
+#include "../core/mempool.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Compact block construction and short transaction ID computation.
+ * Short IDs are SipHash-2-4 of the txid keyed by SHA256(header || nonce),
+ * truncated to 48 bits, so a peer cannot grind collisions in advance.
+ */
+class CompactBlocks {
+public:
+    static constexpr uint64_t SHORT_ID_MASK = 0xFFFFFFFFFFFFULL;
+
+    // Build a compact block; the coinbase is always prefilled
+    static CompactBlockMessage build(const Block& block, uint64_t nonce);
+
+    // Short ID helpers
+    static void getShortIdKeys(const BlockHeader& header, uint64_t nonce, uint64_t& k0, uint64_t& k1);
+    static uint64_t getShortId(uint64_t k0, uint64_t k1, const std::string& txid);
+};
+
+/**
+ * Block being rebuilt from a compact block plus the local mempool.
+ * Transactions that could not be matched are fetched with getblocktxn.
+ */
+class PartiallyDownloadedBlock {
+public:
+    enum class Status {
+        OK,
+        INVALID,            // Malformed compact block, the peer misbehaved
+        FAILED              // Short ID collision or bad reconstruction, fall back to the full block
+    };
+
+private:
+    BlockHeader header;
+    std::string blockHash;
+    std::vector<std::shared_ptr<const Transaction>> slots;  // Null until the transaction is known
+    size_t prefilledCount;
+    size_t mempoolCount;
+
+public:
+    PartiallyDownloadedBlock();
+
+    Status initialize(const CompactBlockMessage& compactBlock, const Mempool* mempool);
+    Status fillBlock(Block& block, const std::vector<Transaction>& missing) const;
+
+    bool isTxAvailable(size_t index) const;
+    std::vector<uint32_t> getMissingIndexes() const;
+
+    const std::string& getBlockHash() const { return blockHash; }
+    size_t getTransactionCount() const { return slots.size(); }
+    size_t getPrefilledCount() const { return prefilledCount; }
+    size_t getMempoolCount() const { return mempoolCount; }
+};
+
+} // namespace pragma
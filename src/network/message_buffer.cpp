@@ -0,0 +1,116 @@
+#include "message_buffer.h"
+
+namespace pragma {
+
+// BufferPool implementation
+BufferPool::BufferPool() : hits(0), misses(0) {}
+
+BufferPool& BufferPool::instance() {
+    // Intentionally leaked so buffers released during static destruction stay valid
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+size_t BufferPool::classIndex(size_t capacity) {
+    size_t shift = MIN_CLASS_SHIFT;
+    while (shift < MAX_CLASS_SHIFT && (static_cast<size_t>(1) << shift) < capacity) {
+        shift++;
+    }
+    return shift - MIN_CLASS_SHIFT;
+}
+
+std::shared_ptr<MessageBuffer> BufferPool::acquire(size_t capacity) {
+    std::unique_ptr<MessageBuffer> buffer;
+
+    if (capacity <= (static_cast<size_t>(1) << MAX_CLASS_SHIFT)) {
+        size_t index = classIndex(capacity);
+        std::lock_guard<std::mutex> lock(poolMutex);
+        SizeClass& sizeClass = classes[index];
+        if (!sizeClass.freeList.empty()) {
+            buffer = std::move(sizeClass.freeList.back());
+            sizeClass.freeList.pop_back();
+            sizeClass.pooledBytes -= buffer->bytes.capacity();
+            hits++;
+        } else {
+            misses++;
+        }
+        if (!buffer) {
+            capacity = static_cast<size_t>(1) << (index + MIN_CLASS_SHIFT);
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        misses++;
+    }
+
+    if (!buffer) {
+        buffer = std::make_unique<MessageBuffer>();
+        buffer->bytes.reserve(capacity);
+    }
+
+    return std::shared_ptr<MessageBuffer>(buffer.release(), [this](MessageBuffer* b) { release(b); });
+}
+
+void BufferPool::release(MessageBuffer* buffer) {
+    std::unique_ptr<MessageBuffer> owned(buffer);
+    size_t capacity = owned->bytes.capacity();
+
+    // Oversized and undersized buffers are simply freed
+    if (capacity < (static_cast<size_t>(1) << MIN_CLASS_SHIFT) ||
+        capacity > (static_cast<size_t>(1) << MAX_CLASS_SHIFT)) {
+        return;
+    }
+
+    // File under the largest class the capacity fully covers
+    size_t index = classIndex(capacity);
+    if ((static_cast<size_t>(1) << (index + MIN_CLASS_SHIFT)) > capacity) {
+        index--;
+    }
+
+    owned->bytes.clear();
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    SizeClass& sizeClass = classes[index];
+    if (sizeClass.pooledBytes + capacity > MAX_BYTES_PER_CLASS) {
+        return;
+    }
+    sizeClass.pooledBytes += capacity;
+    sizeClass.freeList.push_back(std::move(owned));
+}
+
+size_t BufferPool::getPooledBuffers() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    size_t count = 0;
+    for (const auto& sizeClass : classes) {
+        count += sizeClass.freeList.size();
+    }
+    return count;
+}
+
+size_t BufferPool::getPooledBytes() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    size_t total = 0;
+    for (const auto& sizeClass : classes) {
+        total += sizeClass.pooledBytes;
+    }
+    return total;
+}
+
+uint64_t BufferPool::getHits() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return hits;
+}
+
+uint64_t BufferPool::getMisses() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return misses;
+}
+
+void BufferPool::clear() {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    for (auto& sizeClass : classes) {
+        sizeClass.freeList.clear();
+        sizeClass.pooledBytes = 0;
+    }
+}
+
+} // namespace pragma
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Serialized bytes of one or more wire frames.
+ * Instances come from BufferPool and return to it when the last reference drops.
+ */
+struct MessageBuffer {
+    std::vector<uint8_t> bytes;
+
+    const uint8_t* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+};
+
+/**
+ * Size-classed free lists of message buffers.
+ * Recycling buffers keeps steady-state framing and receiving free of heap
+ * allocation: a buffer is acquired once, filled in place, shared by every
+ * peer it is sent to and handed back when the last peer has written it.
+ */
+class BufferPool {
+private:
+    static constexpr size_t MIN_CLASS_SHIFT = 8;     // 256 bytes
+    static constexpr size_t MAX_CLASS_SHIFT = 22;    // 4 MB
+    static constexpr size_t NUM_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+    static constexpr size_t MAX_BYTES_PER_CLASS = 16 * 1024 * 1024;
+
+    struct SizeClass {
+        std::vector<std::unique_ptr<MessageBuffer>> freeList;
+        size_t pooledBytes = 0;
+    };
+
+    std::array<SizeClass, NUM_CLASSES> classes;
+    mutable std::mutex poolMutex;
+
+    // Statistics
+    uint64_t hits;
+    uint64_t misses;
+
+    static size_t classIndex(size_t capacity);
+    void release(MessageBuffer* buffer);
+
+public:
+    BufferPool();
+
+    // Process-wide pool shared by the transport and message framing
+    static BufferPool& instance();
+
+    // Returns an empty buffer with at least the given capacity
+    std::shared_ptr<MessageBuffer> acquire(size_t capacity);
+
+    // Statistics
+    size_t getPooledBuffers() const;
+    size_t getPooledBytes() const;
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+    void clear();
+};
+
+} // namespace pragma
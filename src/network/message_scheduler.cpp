@@ -0,0 +1,214 @@
+#include "message_scheduler.h"
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+
+namespace pragma {
+
+namespace {
+
+// One shard's pending messages grouped by peer; only the shard's own thread
+// touches it. Every peer with an entry is in the rotation exactly once, and
+// entries are dropped when the rotation finds them empty
+class PeerBacklogs {
+private:
+    struct Backlog {
+        std::deque<std::pair<std::shared_ptr<P2PMessage>, bool>> messages;   // Message, priority
+        size_t priorityCount = 0;
+    };
+
+    std::unordered_map<std::string, Backlog> peers;
+    std::deque<std::string> rotation;
+    std::deque<std::string> urgent;     // Peers that had a priority message waiting; may be stale
+    size_t count = 0;
+
+public:
+    void push(const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+        auto [it, inserted] = peers.try_emplace(peerId);
+        if (inserted) {
+            rotation.push_back(peerId);
+        }
+        bool priority = MessageScheduler::isPriorityMessage(message->header.command);
+        if (priority && it->second.priorityCount++ == 0) {
+            urgent.push_back(peerId);
+        }
+        it->second.messages.emplace_back(std::move(message), priority);
+        count++;
+    }
+
+    // Next message in its peer's arrival order; callers check empty() first
+    std::pair<std::string, std::shared_ptr<P2PMessage>> pop() {
+        auto it = peers.end();
+        while (!urgent.empty()) {
+            it = peers.find(urgent.front());
+            if (it != peers.end() && it->second.priorityCount > 0) break;
+            it = peers.end();
+            urgent.pop_front();
+        }
+        while (it == peers.end()) {
+            auto candidate = peers.find(rotation.front());
+            rotation.pop_front();
+            if (candidate->second.messages.empty()) {
+                peers.erase(candidate);
+            } else {
+                rotation.push_back(candidate->first);
+                it = candidate;
+            }
+        }
+
+        Backlog& backlog = it->second;
+        auto [message, priority] = std::move(backlog.messages.front());
+        backlog.messages.pop_front();
+        if (priority) {
+            backlog.priorityCount--;
+        }
+        count--;
+        return {it->first, std::move(message)};
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+};
+
+} // namespace
+
+// MessageScheduler implementation
+MessageScheduler::MessageScheduler(size_t workerShards, Handler messageHandler)
+    : handler(std::move(messageHandler)), shardCount(std::max<size_t>(1, workerShards)) {}
+
+MessageScheduler::~MessageScheduler() {
+    stop();
+}
+
+void MessageScheduler::start() {
+    if (running.load()) {
+        return;
+    }
+
+    // Rings are only allocated for nodes that actually run; lanes are kept
+    // across restarts so a late submit never sees them disappear
+    if (shards.empty()) {
+        for (size_t i = 0; i < shardCount; ++i) {
+            shards.push_back(std::make_unique<Lane>());
+        }
+    }
+    running = true;
+    for (auto& shard : shards) {
+        Lane* lane = shard.get();
+        lane->thread = std::thread([this, lane] { run(*lane); });
+    }
+}
+
+void MessageScheduler::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    for (auto& shard : shards) {
+        {
+            // Taken so the stop cannot slip in between the lane's check and its wait
+            std::lock_guard<std::mutex> lock(shard->mutex);
+        }
+        shard->cv.notify_all();
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+
+    // Drop what was left so a restart does not replay stale messages; the
+    // backlogs went with the worker threads
+    std::vector<std::pair<std::string, std::shared_ptr<P2PMessage>>> discarded;
+    for (auto& shard : shards) {
+        while (shard->queue.popBatch(discarded, BATCH_SIZE) > 0) discarded.clear();
+        shard->backlogged.store(0, std::memory_order_relaxed);
+    }
+}
+
+void MessageScheduler::run(Lane& lane) {
+    std::vector<std::pair<std::string, std::shared_ptr<P2PMessage>>> batch;
+    batch.reserve(BATCH_SIZE);
+    PeerBacklogs backlogs;
+
+    while (running.load()) {
+        // The ring is checked before every message so a block that arrives
+        // behind a long backlog is seen at once. Intake stops at the ring's
+        // size, so a slow shard still fills its ring and refuses further
+        // submits, which pauses reading from its peers
+        batch.clear();
+        if (backlogs.size() < LANE_CAPACITY) {
+            lane.queue.popBatch(batch, BATCH_SIZE);
+        }
+        for (auto& item : batch) {
+            backlogs.push(item.first, std::move(item.second));
+        }
+
+        if (backlogs.empty()) {
+            lane.backlogged.store(0, std::memory_order_relaxed);
+            std::unique_lock<std::mutex> lock(lane.mutex);
+            lane.idle.store(true);
+            // Pairs with the fence in submit: either the producer sees the
+            // lane idle and wakes it, or the lane sees its message here
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            lane.cv.wait(lock, [this, &lane] { return !lane.queue.empty() || !running.load(); });
+            lane.idle.store(false);
+            continue;
+        }
+
+        auto next = backlogs.pop();
+        lane.backlogged.store(backlogs.size(), std::memory_order_relaxed);
+        handler(next.first, std::move(next.second));
+        lane.processed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MessageScheduler::wake(Lane& lane) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (lane.idle.load()) {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        lane.cv.notify_one();
+    }
+}
+
+bool MessageScheduler::submit(const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+    if (!message || !running.load()) return true;
+
+    Lane& lane = *shards[shardFor(peerId)];
+
+    // A full lane is refused rather than waited on: the reading thread serves
+    // every connection on its loop, so only the sending peer may be held up
+    if (!lane.queue.tryPush(std::make_pair(peerId, std::move(message)))) {
+        return false;
+    }
+    wake(lane);
+    return true;
+}
+
+bool MessageScheduler::isPriorityMessage(MessageType type) {
+    switch (type) {
+        case MessageType::BLOCK:
+        case MessageType::CMPCTBLOCK:
+        case MessageType::BLOCKTXN:
+        case MessageType::HEADERS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t MessageScheduler::shardFor(const std::string& peerId) const {
+    return std::hash<std::string>{}(peerId) % shardCount;
+}
+
+std::vector<MessageScheduler::LaneStats> MessageScheduler::getShardStats() const {
+    std::vector<LaneStats> stats;
+    if (shards.empty()) {
+        return std::vector<LaneStats>(shardCount, LaneStats{0, 0});
+    }
+    for (const auto& shard : shards) {
+        stats.push_back({shard->processed.load(std::memory_order_relaxed),
+                         shard->queue.size() + shard->backlogged.load(std::memory_order_relaxed)});
+    }
+    return stats;
+}
+
+} // namespace pragma
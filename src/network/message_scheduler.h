@@ -0,0 +1,77 @@
+#pragma once
+
+#include "protocol.h"
+#include "ring_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Multi-threaded inbound message scheduler.
+ * Peers are hashed onto worker shards, so one peer's messages are always
+ * handled in arrival order by the same thread while different peers run
+ * in parallel. Each shard moves messages off a lock-free MPSC ring into
+ * per-peer backlogs and serves its peers in turn, except that a peer with
+ * a block or headers message waiting goes first. Its backlog is handled up
+ * to that message, so blocks overtake other peers' transactions but never
+ * the sending peer's own earlier messages. A full shard refuses new
+ * messages instead of blocking, so only the peers sending to it are paused.
+ * A shard's mutex is only used to wake it from idle.
+ */
+class MessageScheduler {
+public:
+    using Handler = std::function<void(const std::string&, std::shared_ptr<P2PMessage>)>;
+
+    static constexpr size_t LANE_CAPACITY = 4096;
+    static constexpr size_t BATCH_SIZE = 64;
+
+    struct LaneStats {
+        uint64_t processed;
+        size_t queued;
+    };
+
+private:
+    struct Lane {
+        MpscRingQueue<std::pair<std::string, std::shared_ptr<P2PMessage>>> queue{LANE_CAPACITY};
+        std::atomic<bool> idle{false};
+        std::atomic<uint64_t> processed{0};
+        std::atomic<size_t> backlogged{0};          // Off the ring, not yet handled
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread thread;
+    };
+
+    Handler handler;
+    size_t shardCount;
+    std::vector<std::unique_ptr<Lane>> shards;      // Allocated on the first start()
+    std::atomic<bool> running{false};
+
+    void run(Lane& lane);
+    void wake(Lane& lane);
+
+public:
+    MessageScheduler(size_t workerShards, Handler messageHandler);
+    ~MessageScheduler();
+
+    void start();
+    void stop();    // Queued messages not yet handled are discarded
+
+    // Called from the transport threads. Returns false without taking the
+    // message when the lane is full; the caller keeps it and retries later.
+    // Messages submitted while stopped are dropped
+    bool submit(const std::string& peerId, std::shared_ptr<P2PMessage> message);
+
+    static bool isPriorityMessage(MessageType type);
+    size_t getShardCount() const { return shardCount; }
+    size_t shardFor(const std::string& peerId) const;
+    std::vector<LaneStats> getShardStats() const;
+};
+
+} // namespace pragma
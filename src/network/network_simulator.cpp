@@ -0,0 +1,358 @@
+#include "network_simulator.h"
+#include "../core/utxo.h"
+#include "../core/validator.h"
+#include "../primitives/hash.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+namespace pragma {
+
+namespace {
+
+// Records first arrivals instead of logging every relayed item
+class SimulatedNetwork : public P2PNetwork {
+private:
+    std::function<void(const std::string&)> arrival;
+
+public:
+    SimulatedNetwork(const NetworkConfig& cfg, ChainState* chain, Mempool* mp,
+                     std::function<void(const std::string&)> onArrival)
+        : P2PNetwork(cfg, chain, mp), arrival(std::move(onArrival)) {}
+
+    void onTransactionReceived(const std::string&, const Transaction& tx) override { arrival(tx.txid); }
+    void onBlockReceived(const std::string&, const Block& block) override { arrival(block.hash); }
+    void onInventoryReceived(const std::string&, const std::vector<InventoryVector>&) override {}
+    void onPeerHandshakeComplete(const std::string&) override {}
+};
+
+NetworkAddress simulatedAddress(size_t nodeIndex) {
+    std::string ip = "10." + std::to_string((nodeIndex >> 16) & 0xFF) + "." +
+                     std::to_string((nodeIndex >> 8) & 0xFF) + "." + std::to_string(nodeIndex & 0xFF);
+    return NetworkAddress(ip, 18445);
+}
+
+double toMilliseconds(NetworkSimulator::Duration duration) {
+    return duration.count() / 1000.0;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0.0;
+    // Nearest rank
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+constexpr uint64_t COIN_VALUE = 100000;
+constexpr uint64_t TX_FEE = 10000;
+constexpr uint64_t BLOCK_REWARD = 5000000000ULL;
+
+} // namespace
+
+struct NetworkSimulator::Node {
+    std::unique_ptr<ChainState> chainState;
+    std::unique_ptr<UTXOSet> utxoSet;
+    std::unique_ptr<BlockValidator> validator;
+    std::unique_ptr<Mempool> mempool;
+    std::unique_ptr<P2PNetwork> network;
+    std::vector<std::pair<std::shared_ptr<Peer>, Pipe*>> links;   // In connection order
+};
+
+// NetworkSimulator implementation
+NetworkSimulator::NetworkSimulator(const SimulationConfig& cfg)
+    : config(cfg), rng(cfg.seed), epoch(Clock::now()) {
+    NetworkConfig nodeConfig = config.nodeConfig;
+    nodeConfig.listen = false;
+    nodeConfig.networkThreads = 1;
+    nodeConfig.addressFile.clear();
+
+    Block genesis = Block::createGenesis("simulation", BLOCK_REWARD);
+    for (size_t i = 0; i < config.nodeCount; ++i) {
+        auto node = std::make_unique<Node>();
+        node->chainState = std::make_unique<ChainState>();
+        node->chainState->setCheckProofOfWork(false);
+        node->chainState->setGenesis(genesis);
+        node->utxoSet = std::make_unique<UTXOSet>();
+        node->validator = std::make_unique<BlockValidator>(node->utxoSet.get(), node->chainState.get());
+        node->mempool = std::make_unique<Mempool>(node->utxoSet.get(), node->validator.get());
+
+        // Each node gets its own timer stream, all derived from the seed
+        nodeConfig.randomSeed = config.seed * 1000003 + i + 1;
+        node->network = std::make_unique<SimulatedNetwork>(
+            nodeConfig, node->chainState.get(), node->mempool.get(),
+            [this, i](const std::string& hash) { recordArrival(i, hash); });
+        node->network->setSimulatedTime(epoch);
+        nodes.push_back(std::move(node));
+    }
+
+    if (nodes.size() > 1) {
+        std::uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+        size_t outbound = std::min(config.outboundPeers, nodes.size() - 1);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            // Bounded so a saturated topology cannot spin forever
+            size_t made = 0;
+            for (size_t attempt = 0; made < outbound && attempt < outbound * 20; ++attempt) {
+                size_t target = pick(rng);
+                if (target != i && !isConnected(i, target) && connect(i, target)) {
+                    made++;
+                }
+            }
+        }
+    }
+    scheduleTick();
+}
+
+NetworkSimulator::~NetworkSimulator() = default;
+
+bool NetworkSimulator::connect(size_t from, size_t to) {
+    return connect(from, to, config.link);
+}
+
+bool NetworkSimulator::connect(size_t from, size_t to, const LinkConfig& link) {
+    if (from >= nodes.size() || to >= nodes.size() || from == to) return false;
+
+    auto outboundPeer = nodes[from]->network->getPeerManager()->addPeer(simulatedAddress(to), false);
+    if (!outboundPeer) return false;
+    auto inboundPeer = nodes[to]->network->getPeerManager()->addPeer(simulatedAddress(from), true);
+    if (!inboundPeer) {
+        nodes[from]->network->getPeerManager()->removePeer(outboundPeer->getId());
+        return false;
+    }
+
+    std::uniform_int_distribution<int64_t> latency(link.minLatency.count(),
+                                                   std::max(link.minLatency, link.maxLatency).count());
+    Duration linkLatency(latency(rng));
+    pipes.push_back(Pipe{to, inboundPeer->getId(), link, linkLatency});
+    nodes[from]->links.emplace_back(outboundPeer, &pipes.back());
+    pipes.push_back(Pipe{from, outboundPeer->getId(), link, linkLatency});
+    nodes[to]->links.emplace_back(inboundPeer, &pipes.back());
+
+    // The connection is up; the outbound side sends its version first
+    nodes[to]->network->setSimulatedTime(epoch + now);
+    nodes[from]->network->setSimulatedTime(epoch + now);
+    nodes[to]->network->onPeerConnected(inboundPeer->getId());
+    nodes[from]->network->onPeerConnected(outboundPeer->getId());
+    pump(from);
+    return true;
+}
+
+bool NetworkSimulator::isConnected(size_t a, size_t b) const {
+    for (const auto& link : nodes[a]->links) {
+        if (link.second->to == b) return true;
+    }
+    return false;
+}
+
+void NetworkSimulator::schedule(Duration when, std::function<void()> action) {
+    events.push(Event{when, nextSequence++, std::move(action)});
+}
+
+void NetworkSimulator::scheduleTick() {
+    schedule(now + config.tickInterval, [this]() {
+        auto clockTime = epoch + now;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            nodes[i]->network->simulateAnnouncements(clockTime);
+            pump(i);
+        }
+        scheduleTick();
+    });
+}
+
+void NetworkSimulator::pump(size_t nodeIndex) {
+    for (auto& [peer, pipe] : nodes[nodeIndex]->links) {
+        while (auto message = peer->getNextOutboundMessage()) {
+            size_t bytes = message->getWireBuffer(peer->getFrameChecksum(), peer->getFrameCompression())->size();
+            peer->updateStats(0, bytes);
+            peer->incrementMessageCount(false);
+            send(*pipe, std::move(message), bytes);
+        }
+    }
+}
+
+void NetworkSimulator::send(Pipe& pipe, std::shared_ptr<P2PMessage> message, size_t bytes) {
+    Duration transmit(static_cast<int64_t>(bytes * 1000000.0 / std::max<uint64_t>(pipe.link.bandwidth, 1)));
+    pipe.busyUntil = std::max(now, pipe.busyUntil) + transmit;
+
+    Duration arrival = pipe.busyUntil + pipe.latency;
+    if (pipe.link.lossRate > 0.0) {
+        std::bernoulli_distribution lost(std::min(pipe.link.lossRate, 0.99));
+        while (lost(rng)) {
+            arrival += pipe.link.retransmitTimeout;
+            framesLost++;
+        }
+    }
+    // Frames on one connection arrive in order
+    arrival = std::max(arrival, pipe.lastArrival);
+    pipe.lastArrival = arrival;
+
+    Pipe* target = &pipe;
+    schedule(arrival, [this, target, message = std::move(message), bytes]() {
+        framesDelivered++;
+        bytesDelivered += bytes;
+        auto& network = *nodes[target->to]->network;
+        network.setSimulatedTime(epoch + now);
+        if (auto peer = network.getPeerManager()->getPeer(target->toPeerId)) {
+            peer->updateStats(bytes, 0);
+            peer->incrementMessageCount(true);
+        }
+        try {
+            network.simulateMessage(target->toPeerId, message);
+        } catch (const std::exception& e) {
+            network.onInvalidMessage(target->toPeerId, e.what());
+        }
+        pump(target->to);
+    });
+}
+
+void NetworkSimulator::recordArrival(size_t nodeIndex, const std::string& hash) {
+    auto it = items.find(hash);
+    if (it != items.end() && it->second.arrivals[nodeIndex] < Duration(0)) {
+        it->second.arrivals[nodeIndex] = now;
+    }
+}
+
+void NetworkSimulator::step() {
+    Event event = events.top();
+    events.pop();
+    now = event.time;
+    event.action();
+}
+
+void NetworkSimulator::runFor(Duration duration) {
+    Duration end = now + duration;
+    while (!events.empty() && events.top().time <= end) {
+        step();
+    }
+    now = end;
+}
+
+bool NetworkSimulator::runUntil(const std::function<bool()>& done, Duration limit) {
+    Duration end = now + limit;
+    while (!done()) {
+        if (events.empty() || events.top().time > end) {
+            now = end;
+            return false;
+        }
+        step();
+    }
+    return true;
+}
+
+std::string NetworkSimulator::submitTransaction(size_t nodeIndex) {
+    // A fresh coin, confirmed at every node, keeps submissions independent
+    OutPoint coin(Hash::sha256("simulation-coin-" + std::to_string(config.seed) + "-" + std::to_string(nextCoin++)), 0);
+    for (auto& node : nodes) {
+        node->utxoSet->addUTXO(coin, TxOut(COIN_VALUE, "simulation"), 0);
+    }
+
+    Transaction tx = Transaction::create({ TxIn(coin, "sig", "pubkey") },
+                                         { TxOut(COIN_VALUE - TX_FEE, "recipient" + std::to_string(nodeIndex)) });
+    auto& origin = *nodes.at(nodeIndex);
+    if (!origin.mempool->addTransaction(tx, origin.chainState->getBestHeight())) {
+        return "";
+    }
+
+    Item item{false, nodeIndex, now, std::vector<Duration>(nodes.size(), Duration(-1))};
+    item.arrivals[nodeIndex] = now;
+    items.emplace(tx.txid, std::move(item));
+
+    origin.network->setSimulatedTime(epoch + now);
+    origin.network->broadcastTransaction(tx);
+    pump(nodeIndex);
+    return tx.txid;
+}
+
+std::string NetworkSimulator::submitBlock(size_t nodeIndex) {
+    auto& origin = *nodes.at(nodeIndex);
+    auto tip = origin.chainState->getBestTip();
+    if (!tip) return "";
+
+    // Mine the origin's mempool, so peers rebuild compact blocks from theirs
+    uint32_t height = tip->height + 1;
+    Block block = Block::create(tip->block, origin.mempool->selectTransactions(1000000, height),
+                                "miner" + std::to_string(nodeIndex) + "-" + std::to_string(height), BLOCK_REWARD);
+    block.header.timestamp = std::max(block.header.timestamp, tip->block.header.timestamp + 1);
+    block.computeHash();
+    if (!origin.chainState->addBlock(block)) {
+        return "";
+    }
+    origin.mempool->updateForNewBlock(block.transactions, origin.chainState->getBestHeight());
+
+    Item item{true, nodeIndex, now, std::vector<Duration>(nodes.size(), Duration(-1))};
+    item.arrivals[nodeIndex] = now;
+    items.emplace(block.hash, std::move(item));
+
+    origin.network->setSimulatedTime(epoch + now);
+    origin.network->broadcastBlock(block);
+    pump(nodeIndex);
+    return block.hash;
+}
+
+bool NetworkSimulator::hasReachedAll(const std::string& hash) const {
+    auto it = items.find(hash);
+    if (it == items.end()) return false;
+    return std::none_of(it->second.arrivals.begin(), it->second.arrivals.end(),
+                        [](Duration arrival) { return arrival < Duration(0); });
+}
+
+PropagationStats NetworkSimulator::computeStats(bool blocks) const {
+    PropagationStats stats;
+    std::vector<double> delays;
+    for (const auto& [hash, item] : items) {
+        if (item.isBlock != blocks) continue;
+        stats.items++;
+        stats.expected += nodes.size() - 1;
+        for (size_t i = 0; i < item.arrivals.size(); ++i) {
+            if (i == item.origin || item.arrivals[i] < Duration(0)) continue;
+            delays.push_back(toMilliseconds(item.arrivals[i] - item.submitted));
+        }
+    }
+
+    std::sort(delays.begin(), delays.end());
+    stats.arrivals = delays.size();
+    stats.p50 = percentile(delays, 0.50);
+    stats.p90 = percentile(delays, 0.90);
+    stats.p99 = percentile(delays, 0.99);
+    stats.max = delays.empty() ? 0.0 : delays.back();
+    return stats;
+}
+
+size_t NetworkSimulator::getReadyConnectionCount() const {
+    size_t count = 0;
+    for (const auto& node : nodes) {
+        count += node->network->getPeerManager()->getReadyPeers().size();
+    }
+    return count;
+}
+
+std::string NetworkSimulator::getReport() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << nodes.size() << " nodes, " << pipes.size() / 2 << " links, "
+        << toMilliseconds(now) / 1000.0 << "s virtual time\n";
+    out << framesDelivered << " frames, " << bytesDelivered << " bytes delivered, "
+        << framesLost << " frames lost\n";
+
+    auto line = [&out](const char* name, const PropagationStats& stats) {
+        out << name << ": " << stats.items << " items, " << (stats.coverage() * 100.0) << "% coverage, "
+            << "p50 " << stats.p50 << "ms, p90 " << stats.p90 << "ms, p99 " << stats.p99
+            << "ms, max " << stats.max << "ms\n";
+    };
+    line("Transactions", getTransactionStats());
+    line("Blocks", getBlockStats());
+    return out.str();
+}
+
+P2PNetwork& NetworkSimulator::getNetwork(size_t nodeIndex) {
+    return *nodes.at(nodeIndex)->network;
+}
+
+ChainState& NetworkSimulator::getChainState(size_t nodeIndex) {
+    return *nodes.at(nodeIndex)->chainState;
+}
+
+Mempool& NetworkSimulator::getMempool(size_t nodeIndex) {
+    return *nodes.at(nodeIndex)->mempool;
+}
+
+} // namespace pragma
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "p2p.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Link model for simulated connections.
+ * Each direction is an in-order pipe: a frame waits for the frames ahead of
+ * it, takes size / bandwidth to send, then the link latency to arrive. A
+ * lost frame is resent after the retransmit timeout, holding up everything
+ * behind it as TCP would.
+ */
+struct LinkConfig {
+    std::chrono::microseconds minLatency{20000};
+    std::chrono::microseconds maxLatency{150000};   // Each link draws its one-way latency from this range
+    uint64_t bandwidth = 1250000;                   // Bytes per second in each direction (10 Mbit/s)
+    double lossRate = 0.0;                          // Per frame
+    std::chrono::microseconds retransmitTimeout{200000};
+};
+
+struct SimulationConfig {
+    size_t nodeCount = 100;
+    size_t outboundPeers = 8;           // Random outbound connections made by each node
+    uint64_t seed = 1;                  // Topology, link parameters, losses and trickle timers
+    LinkConfig link;                    // For the links the simulator makes itself
+    std::chrono::milliseconds tickInterval{100};    // Announcement timer resolution, as in announceLoop
+    NetworkConfig nodeConfig = P2PNetworkFactory::getSimulationConfig();
+};
+
+/**
+ * Propagation delays of submitted items, measured from submission to the
+ * first arrival at each other node (milliseconds of virtual time).
+ */
+struct PropagationStats {
+    size_t items = 0;
+    size_t arrivals = 0;
+    size_t expected = 0;                // Items times nodes other than the origin
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+
+    double coverage() const { return expected ? static_cast<double>(arrivals) / expected : 0.0; }
+};
+
+/**
+ * Discrete-event simulator running many P2PNetwork instances in one thread.
+ * Nodes are never started: the simulator hands each queued message to the
+ * receiving node at its virtual arrival time and runs the announcement
+ * timers on virtual time, so hundreds of nodes relay minutes of traffic in
+ * seconds, and a given seed always produces the same run. Proof of work is
+ * not checked, so submitted blocks need no mining.
+ */
+class NetworkSimulator {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = std::chrono::microseconds;
+
+private:
+    struct Node;
+
+    // One direction of a connection
+    struct Pipe {
+        size_t to;
+        std::string toPeerId;           // The sender's peer entry at the receiving node
+        LinkConfig link;
+        Duration latency;               // Drawn from the link's range
+        Duration busyUntil{0};          // End of the last frame's transmission
+        Duration lastArrival{0};
+    };
+
+    struct Event {
+        Duration time;
+        uint64_t sequence;              // Ties run in scheduling order
+        std::function<void()> action;
+
+        bool operator>(const Event& other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    struct Item {
+        bool isBlock;
+        size_t origin;
+        Duration submitted;
+        std::vector<Duration> arrivals; // Per node; negative until it arrives
+    };
+
+    SimulationConfig config;
+    std::mt19937_64 rng;
+    Clock::time_point epoch;            // Virtual time zero on the nodes' clocks
+    Duration now{0};
+    uint64_t nextSequence = 0;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::deque<Pipe> pipes;
+    std::unordered_map<std::string, Item> items;
+    uint64_t nextCoin = 0;
+
+    // Traffic counters
+    uint64_t framesDelivered = 0;
+    uint64_t bytesDelivered = 0;
+    uint64_t framesLost = 0;
+
+    void schedule(Duration when, std::function<void()> action);
+    void scheduleTick();
+    void pump(size_t nodeIndex);        // Puts the node's queued messages on the wire
+    void send(Pipe& pipe, std::shared_ptr<P2PMessage> message, size_t bytes);
+    void recordArrival(size_t nodeIndex, const std::string& hash);
+    void step();
+    PropagationStats computeStats(bool blocks) const;
+
+public:
+    explicit NetworkSimulator(const SimulationConfig& cfg = SimulationConfig());
+    ~NetworkSimulator();
+
+    // Topology; the constructor already connects each node to config.outboundPeers
+    // others. A link made here uses config.link unless given its own model.
+    bool connect(size_t from, size_t to);
+    bool connect(size_t from, size_t to, const LinkConfig& link);
+    bool isConnected(size_t a, size_t b) const;
+
+    // Execution
+    void runFor(Duration duration);
+    bool runUntil(const std::function<bool()>& done, Duration limit);   // False on timeout
+    Duration getTime() const { return now; }
+
+    // Workload; each returns the submitted hash
+    std::string submitTransaction(size_t nodeIndex);
+    std::string submitBlock(size_t nodeIndex);
+    bool hasReachedAll(const std::string& hash) const;
+
+    // Results
+    PropagationStats getTransactionStats() const { return computeStats(false); }
+    PropagationStats getBlockStats() const { return computeStats(true); }
+    size_t getReadyConnectionCount() const;     // Ready peer entries over all nodes
+    uint64_t getFramesDelivered() const { return framesDelivered; }
+    uint64_t getBytesDelivered() const { return bytesDelivered; }
+    uint64_t getFramesLost() const { return framesLost; }
+    std::string getReport() const;
+
+    // Node access
+    size_t getNodeCount() const { return nodes.size(); }
+    P2PNetwork& getNetwork(size_t nodeIndex);
+    ChainState& getChainState(size_t nodeIndex);
+    Mempool& getMempool(size_t nodeIndex);
+};
+
+} // namespace pragma
@@ -0,0 +1,116 @@
+#include "outbound_queue.h"
+#include <algorithm>
+
+namespace pragma {
+
+namespace {
+
+constexpr size_t CONTROL_CLASS = static_cast<size_t>(TrafficClass::CONTROL);
+constexpr size_t BLOCK_CLASS = static_cast<size_t>(TrafficClass::BLOCK);
+constexpr size_t TX_CLASS = static_cast<size_t>(TrafficClass::TX);
+
+} // namespace
+
+OutboundQueue::OutboundQueue() : OutboundQueue(Config()) {}
+
+OutboundQueue::OutboundQueue(const Config& cfg)
+    : config(cfg), queuedBytes{}, deficits{}, current(BLOCK_CLASS), credited(false), dropped(0) {}
+
+bool OutboundQueue::push(std::shared_ptr<P2PMessage> message, size_t bytes, Clock::time_point now) {
+    size_t index = static_cast<size_t>(trafficClassOf(*message));
+    auto& queue = queues[index];
+
+    if (index == TX_CLASS) {
+        dropStale(now);
+        while (!queue.empty() && queuedBytes[index] + bytes > config.maxBytes[index]) {
+            dropFront(index);
+        }
+    } else if (!queue.empty() && queuedBytes[index] + bytes > config.maxBytes[index]) {
+        dropped++;
+        return false;
+    }
+
+    queue.push_back(Entry{std::move(message), bytes, now});
+    queuedBytes[index] += bytes;
+    return true;
+}
+
+std::shared_ptr<P2PMessage> OutboundQueue::pop(uint32_t excludedClasses, Clock::time_point now) {
+    dropStale(now);
+
+    auto eligible = [this, excludedClasses](size_t index) {
+        return (excludedClasses & (1u << index)) == 0 && !queues[index].empty();
+    };
+
+    if (eligible(CONTROL_CLASS)) {
+        return take(CONTROL_CLASS);
+    }
+    if (!eligible(BLOCK_CLASS) && !eligible(TX_CLASS)) {
+        return nullptr;
+    }
+
+    // Deficit round robin: each turn credits a class its quantum, and it sends
+    // while its head fits; a large block just takes a few turns to go out
+    while (true) {
+        if (!eligible(current)) {
+            if (queues[current].empty()) {
+                deficits[current] = 0;
+            }
+            advance();
+            continue;
+        }
+        if (!credited) {
+            deficits[current] += std::max<size_t>(config.quantum[current], 1);
+            credited = true;
+        }
+        if (queues[current].front().bytes <= deficits[current]) {
+            deficits[current] -= queues[current].front().bytes;
+            return take(current);
+        }
+        advance();
+    }
+}
+
+bool OutboundQueue::empty() const {
+    for (const auto& queue : queues) {
+        if (!queue.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t OutboundQueue::size() const {
+    size_t total = 0;
+    for (const auto& queue : queues) {
+        total += queue.size();
+    }
+    return total;
+}
+
+std::shared_ptr<P2PMessage> OutboundQueue::take(size_t index) {
+    auto& queue = queues[index];
+    auto message = std::move(queue.front().message);
+    queuedBytes[index] -= queue.front().bytes;
+    queue.pop_front();
+    return message;
+}
+
+void OutboundQueue::dropFront(size_t index) {
+    take(index);
+    dropped++;
+}
+
+void OutboundQueue::dropStale(Clock::time_point now) {
+    auto& queue = queues[TX_CLASS];
+    while (!queue.empty() && now - queue.front().queued > config.maxTxAge) {
+        dropFront(TX_CLASS);
+    }
+}
+
+void OutboundQueue::advance() {
+    current = (current == BLOCK_CLASS) ? TX_CLASS : BLOCK_CLASS;
+    credited = false;
+}
+
+} // namespace pragma
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "protocol.h"
+#include "rate_limiter.h"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+
+namespace pragma {
+
+/**
+ * Per-peer outbound message queue with priority classes.
+ * Control messages always go first. Block and transaction traffic share
+ * the rest by deficit round robin, weighted so a new block overtakes a
+ * backlog of transaction invs but relay is never starved outright. Each
+ * class has a byte limit; transaction traffic is best effort, so its
+ * oldest entries are dropped when it overflows or goes stale, while
+ * control and block messages over the limit are refused.
+ * Not thread-safe; the owning Peer serializes access.
+ */
+class OutboundQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        std::array<size_t, TRAFFIC_CLASS_COUNT> maxBytes{{1024 * 1024, 64 * 1024 * 1024, 8 * 1024 * 1024}};
+        std::array<size_t, TRAFFIC_CLASS_COUNT> quantum{{0, 512 * 1024, 32 * 1024}}; // Bytes per round
+        std::chrono::milliseconds maxTxAge{30000};     // Older tx-class entries are dropped
+    };
+
+private:
+    struct Entry {
+        std::shared_ptr<P2PMessage> message;
+        size_t bytes;
+        Clock::time_point queued;
+    };
+
+    Config config;
+    std::array<std::deque<Entry>, TRAFFIC_CLASS_COUNT> queues;
+    std::array<size_t, TRAFFIC_CLASS_COUNT> queuedBytes;
+    std::array<size_t, TRAFFIC_CLASS_COUNT> deficits;
+    size_t current;         // Class whose round-robin turn it is
+    bool credited;          // Whether current already got its quantum this turn
+    uint64_t dropped;
+
+    std::shared_ptr<P2PMessage> take(size_t index);
+    void dropFront(size_t index);
+    void dropStale(Clock::time_point now);
+    void advance();
+
+public:
+    OutboundQueue();
+    explicit OutboundQueue(const Config& cfg);
+
+    void setConfig(const Config& cfg) { config = cfg; }
+    const Config& getConfig() const { return config; }
+
+    // False if the message was refused because its class is full
+    bool push(std::shared_ptr<P2PMessage> message, size_t bytes, Clock::time_point now = Clock::now());
+
+    // Next message to send, skipping classes whose bit is set in excludedClasses
+    std::shared_ptr<P2PMessage> pop(uint32_t excludedClasses = 0, Clock::time_point now = Clock::now());
+
+    bool empty() const;
+    size_t size() const;
+    size_t getQueuedCount(TrafficClass trafficClass) const { return queues[static_cast<size_t>(trafficClass)].size(); }
+    size_t getQueuedBytes(TrafficClass trafficClass) const { return queuedBytes[static_cast<size_t>(trafficClass)]; }
+    uint64_t getDroppedCount() const { return dropped; }
+
+    static uint32_t classBit(TrafficClass trafficClass) { return 1u << static_cast<size_t>(trafficClass); }
+};
+
+} // namespace pragma
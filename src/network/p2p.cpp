@@ -11,6 +11,7 @@
 #include <iomanip>
 #include <sstream>
 #include <random>
+#include <ctime>
 
 namespace pragma {
 
@@ -18,14 +19,29 @@ std::string messageTypeToString(MessageType type) {
     switch(type) {
         case MessageType::VERSION: return "VERSION";
         case MessageType::VERACK: return "VERACK";
+        case MessageType::GETHEADERS: return "GETHEADERS";
+        case MessageType::HEADERS: return "HEADERS";
         case MessageType::INV: return "INV";
         case MessageType::GETDATA: return "GETDATA";
+        case MessageType::NOTFOUND: return "NOTFOUND";
         case MessageType::TX: return "TX";
         case MessageType::BLOCK: return "BLOCK";
         case MessageType::PING: return "PING";
         case MessageType::PONG: return "PONG";
         case MessageType::ADDR: return "ADDR";
         case MessageType::REJECT: return "REJECT";
+        case MessageType::SENDCMPCT: return "SENDCMPCT";
+        case MessageType::CMPCTBLOCK: return "CMPCTBLOCK";
+        case MessageType::GETBLOCKTXN: return "GETBLOCKTXN";
+        case MessageType::BLOCKTXN: return "BLOCKTXN";
+        case MessageType::SENDTXRCNCL: return "SENDTXRCNCL";
+        case MessageType::REQRECON: return "REQRECON";
+        case MessageType::SKETCH: return "SKETCH";
+        case MessageType::RECONCILDIFF: return "RECONCILDIFF";
+        case MessageType::GETCFILTERS: return "GETCFILTERS";
+        case MessageType::CFILTER: return "CFILTER";
+        case MessageType::GETCFHEADERS: return "GETCFHEADERS";
+        case MessageType::CFHEADERS: return "CFHEADERS";
         default: return "UNKNOWN";
     }
 }
@@ -46,20 +62,44 @@ bool isValidIP(const std::string& ip) {
     return !ip.empty() && ip != "0.0.0.0";
 }
 
+// Next event of a Poisson process with the given mean interval
+std::chrono::steady_clock::time_point poissonNextSend(std::mt19937_64& gen, std::chrono::steady_clock::time_point now,
+                                                      std::chrono::milliseconds meanInterval) {
+    std::exponential_distribution<double> delay(1.0);
+    auto micros = static_cast<int64_t>(delay(gen) * meanInterval.count() * 1000.0);
+    return now + std::chrono::microseconds(micros);
+}
+
 SyncManager::SyncManager(ChainState* chain, PeerManager* peers)
-    : chainState(chain), peerManager(peers), state(SyncState::IDLE), targetHeight(0), currentHeight(0) {}
+    : SyncManager(chain, peers, BlockDownloadScheduler::Config()) {}
+
+SyncManager::SyncManager(ChainState* chain, PeerManager* peers, const BlockDownloadScheduler::Config& downloadConfig)
+    : chainState(chain), peerManager(peers), state(SyncState::IDLE), targetHeight(0), currentHeight(0),
+      downloader(downloadConfig), headersComplete(false), rng(std::random_device{}()) {}
 
 void SyncManager::startSync() {
     std::lock_guard<std::mutex> lock(syncMutex);
     state = SyncState::HEADERS_SYNC;
-    syncStartTime = std::chrono::steady_clock::now();
+    syncStartTime = now();
+    currentHeight = chainState ? chainState->getBestHeight() : 0;
+    targetHeight = currentHeight;
+    headersComplete = false;
+    downloader.reset();
+    
     updateSyncPeer();
+    if (!syncPeer.empty()) {
+        if (auto peer = peerManager->getPeer(syncPeer)) {
+            targetHeight = std::max(targetHeight, peer->getStartHeight());
+        }
+        sendGetHeaders(syncPeer);
+    }
 }
 
 void SyncManager::stopSync() {
     std::lock_guard<std::mutex> lock(syncMutex);
     state = SyncState::IDLE;
     syncPeer.clear();
+    downloader.reset();
 }
 
 bool SyncManager::isSyncing() const {
@@ -75,23 +115,160 @@ SyncState SyncManager::getState() const {
 }
 
 void SyncManager::requestHeaders(const std::string& peerId) {
-    // Send getheaders message to peer
-    // ...
+    std::lock_guard<std::mutex> lock(syncMutex);
+    sendGetHeaders(peerId);
 }
 
 void SyncManager::requestBlocks(const std::string& peerId, const std::vector<std::string>& hashes) {
-    // Send getdata message for blocks
-    // ...
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || hashes.empty()) return;
+    
+    std::vector<InventoryVector> inventory;
+    inventory.reserve(hashes.size());
+    for (const auto& hash : hashes) {
+        inventory.emplace_back(InventoryType::BLOCK, hash);
+    }
+    peer->queueOutboundMessage(P2PMessage::createGetData(inventory));
 }
 
-void SyncManager::handleHeaders(const std::string& peerId, const std::vector<std::string>& headers) {
-    // Process received headers
-    // ...
+void SyncManager::handleHeaders(const std::string& peerId, const std::vector<std::shared_ptr<Block>>& headers) {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    if (!isSyncing() || peerId != syncPeer || !chainState) return;
+    
+    // A full batch means the peer has more: ask for the next one before
+    // validating this one, so the round trip overlaps with our work here
+    headersComplete = headers.size() < Protocol::MAX_HEADERS;
+    if (!headersComplete) {
+        sendGetHeaders(peerId, headers.back()->hash);
+    }
+    
+    // Headers must extend the last one we queued, or a block we already have
+    std::string lastHash = downloader.getLastHash();
+    if (lastHash.empty()) {
+        lastHash = chainState->getBestHash();
+    }
+    uint64_t maxTimestamp = static_cast<uint64_t>(std::time(nullptr)) + MAX_HEADER_TIME_DRIFT;
+    
+    std::vector<std::string> hashes;
+    hashes.reserve(headers.size());
+    for (const auto& header : headers) {
+        bool connected = header->header.prevHash == lastHash || chainState->getBlock(header->header.prevHash);
+        if (!connected || header->header.timestamp > maxTimestamp) {
+            if (auto peer = peerManager->getPeer(peerId)) {
+                peer->increaseBanScore(20); // Unconnected or far-future headers
+            }
+            // Drop the peer as sync source so the pipelined batch is ignored
+            syncPeer.clear();
+            headersComplete = false;
+            return;
+        }
+        lastHash = header->hash;
+        if (!chainState->getBlock(header->hash)) {
+            hashes.push_back(header->hash);
+        }
+    }
+    
+    downloader.addBlocks(hashes);
+    targetHeight = std::max<uint32_t>(targetHeight, currentHeight + downloader.getPendingCount());
+    
+    if (headersComplete && downloader.isComplete()) {
+        state = SyncState::SYNCED;
+        return;
+    }
+    state = SyncState::BLOCKS_SYNC;
+    scheduleDownloads();
 }
 
-void SyncManager::handleBlock(const std::string& peerId, const Block& block) {
-    // Process received block
-    // ...
+bool SyncManager::handleBlock(const std::string& peerId, std::shared_ptr<Block> block, size_t bytes,
+                              std::vector<std::shared_ptr<Block>>& connectable) {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    if (!block || state != SyncState::BLOCKS_SYNC || !downloader.isScheduled(block->hash)) {
+        return false;
+    }
+    
+    // Duplicates and blocks nobody asked for are dropped without counting as
+    // progress or refilling anyone's pipeline
+    auto received = downloader.blockReceived(peerId, std::move(block), bytes, now());
+    if (received != BlockDownloadScheduler::ReceiveResult::ACCEPTED) {
+        connectable.clear();
+        return true;
+    }
+    connectable = downloader.takeConnectable();
+    currentHeight += connectable.size();
+    
+    if (headersComplete && downloader.isComplete()) {
+        state = SyncState::SYNCED;
+    } else {
+        scheduleDownloads();
+    }
+    return true;
+}
+
+void SyncManager::removePeer(const std::string& peerId) {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    downloader.removePeer(peerId);
+    if (peerId == syncPeer) {
+        syncPeer.clear();
+    }
+}
+
+void SyncManager::tick() {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    if (!isSyncing()) return;
+    
+    // Re-request headers from another peer if the sync peer left or went quiet
+    auto current = now();
+    if (!headersComplete && (syncPeer.empty() || current - lastHeadersRequest > std::chrono::seconds(30))) {
+        if (auto peer = syncPeer.empty() ? nullptr : peerManager->getPeer(syncPeer)) {
+            peer->getTelemetry().recordStall();
+        }
+        updateSyncPeer();
+        if (!syncPeer.empty()) {
+            sendGetHeaders(syncPeer);
+        }
+    }
+    
+    for (const auto& peerId : downloader.expireStalled(current)) {
+        Utils::logWarning("Block download stalled on peer " + peerId);
+        if (auto peer = peerManager->getPeer(peerId)) {
+            peer->getTelemetry().recordStall();
+        }
+    }
+    scheduleDownloads();
+}
+
+void SyncManager::sendGetHeaders(const std::string& peerId, const std::string& fromHash) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !chainState) return;
+    
+    // Locator: the given hash, else the last header we queued (or our tip),
+    // then genesis
+    GetHeadersMessage getHeaders;
+    getHeaders.version = Protocol::PROTOCOL_VERSION;
+    std::string lastHash = fromHash.empty() ? downloader.getLastHash() : fromHash;
+    getHeaders.locatorHashes.push_back(lastHash.empty() ? chainState->getBestHash() : lastHash);
+    if (const Block* genesis = chainState->getBlockByHeight(0)) {
+        if (genesis->hash != getHeaders.locatorHashes.front()) {
+            getHeaders.locatorHashes.push_back(genesis->hash);
+        }
+    }
+    
+    peer->queueOutboundMessage(P2PMessage::createGetHeaders(getHeaders));
+    lastHeadersRequest = now();
+}
+
+void SyncManager::scheduleDownloads() {
+    if (state != SyncState::BLOCKS_SYNC) return;
+    
+    for (const auto& peer : peerManager->getReadyPeers()) {
+        if (peer->getStartHeight() <= currentHeight && peer->getId() != syncPeer) {
+            continue; // Peer cannot have any of the blocks we need
+        }
+        auto hashes = downloader.assignBlocks(peer->getId(), now());
+        if (!hashes.empty()) {
+            requestBlocks(peer->getId(), hashes);
+        }
+    }
 }
 
 double SyncManager::getSyncProgress() const {
@@ -108,18 +285,53 @@ uint32_t SyncManager::getTargetHeight() const {
 }
 
 std::chrono::seconds SyncManager::getSyncDuration() const {
-    auto now = std::chrono::steady_clock::now();
-    return std::chrono::duration_cast<std::chrono::seconds>(now - syncStartTime);
+    return std::chrono::duration_cast<std::chrono::seconds>(now() - syncStartTime);
+}
+
+std::chrono::steady_clock::time_point SyncManager::now() const {
+    return clock ? clock() : std::chrono::steady_clock::now();
+}
+
+size_t SyncManager::getBlocksInFlight() const {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    return downloader.getInFlightCount();
+}
+
+bool SyncManager::isBlockInFlight(const std::string& hash) const {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    return downloader.isScheduled(hash);
 }
 
 std::string SyncManager::selectSyncPeer() {
-    // Select a random ready peer for sync
     auto readyPeers = peerManager->getReadyPeers();
     if (readyPeers.empty()) return "";
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, readyPeers.size() - 1);
-    return readyPeers[dis(gen)]->getId();
+    
+    // Only peers that advertised a longer chain can serve headers, if any did
+    uint32_t ourHeight = chainState ? chainState->getBestHeight() : 0;
+    std::vector<std::shared_ptr<Peer>> candidates;
+    for (const auto& peer : readyPeers) {
+        if (peer->getStartHeight() > ourHeight) {
+            candidates.push_back(peer);
+        }
+    }
+    if (candidates.empty()) {
+        candidates = std::move(readyPeers);
+    }
+    
+    // Prefer the peer expected to deliver blocks fastest; unmeasured peers
+    // rank on default estimates, and ties are broken at random (seeded, so a
+    // simulation with a fixed seed picks the same peers every run)
+    std::shuffle(candidates.begin(), candidates.end(), rng);
+    std::shared_ptr<Peer> best;
+    double bestSeconds = 0.0;
+    for (const auto& peer : candidates) {
+        double seconds = peer->getTelemetry().getSnapshot().estimatedBlockSeconds();
+        if (!best || seconds < bestSeconds) {
+            best = peer;
+            bestSeconds = seconds;
+        }
+    }
+    return best->getId();
 }
 
 void SyncManager::updateSyncPeer() {
@@ -127,9 +339,39 @@ void SyncManager::updateSyncPeer() {
 }
 
 P2PNetwork::P2PNetwork(const NetworkConfig& cfg, ChainState* chain, Mempool* mp)
-    : config(cfg), chainState(chain), mempool(mp) {
+    : config(cfg), chainState(chain), mempool(mp), localNonce(Utils::randomUint64()), relayCacheBytes(0),
+      announceRng(cfg.randomSeed ? cfg.randomSeed : std::random_device{}()),
+      recentRejects(cfg.recentRejectsSize, 0.000001) {
     peerManager = std::make_unique<PeerManager>(cfg.maxConnections, cfg.maxInbound, cfg.maxOutbound);
+    peerManager->setOutboundQueueConfig(cfg.outboundQueue);
+    addressManager = std::make_unique<AddressManager>();
     syncManager = std::make_unique<SyncManager>(chain, peerManager.get());
+    syncManager->setClock([this]() { return currentTime(); });
+    // Seeded from the config rather than announceRng, so the announcement
+    // timers draw the same sequence whether or not sync ties are broken
+    if (cfg.randomSeed) {
+        syncManager->setRandomSeed(cfg.randomSeed);
+    }
+    transport = std::make_unique<Transport>(peerManager.get(), this, cfg.networkThreads);
+    transport->setAcceptCrc32c(cfg.crc32cChecksums);
+    transport->setAcceptCompression(cfg.compression);
+    transport->setRateLimits(cfg.rateLimits);
+    messageScheduler = std::make_unique<MessageScheduler>(cfg.messageThreads,
+        [this](const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+            try {
+                processMessage(peerId, std::move(message));
+            } catch (const std::exception& e) {
+                onInvalidMessage(peerId, e.what());
+            }
+        });
+    TxRequestTracker::Config requestConfig;
+    requestConfig.requestTimeout = cfg.txRequestTimeout;
+    txRequests = std::make_unique<TxRequestTracker>(requestConfig);
+    if (cfg.txReconciliation) {
+        TxReconciliationTracker::Config reconciliationConfig;
+        reconciliationConfig.floodOutboundPeers = cfg.txFloodOutboundPeers;
+        txReconciliation = std::make_unique<TxReconciliationTracker>(reconciliationConfig);
+    }
 }
 
 P2PNetwork::~P2PNetwork() {
@@ -138,51 +380,1249 @@ P2PNetwork::~P2PNetwork() {
 }
 
 bool P2PNetwork::start() {
+    if (running.load()) {
+        return true;
+    }
+    
+    if (config.listen && !transport->listen(config.bindAddress, config.port)) {
+        return false;
+    }
+    
+    // A saved table lets a restart reconnect to known peers right away
+    if (!config.addressFile.empty() && addressManager->loadFromFile(config.addressFile)) {
+        Utils::logInfo("Loaded " + std::to_string(addressManager->size()) + " addresses from " + config.addressFile);
+    }
+    
     running = true;
     listening = config.listen;
-    // Start network, sync, and message threads (stubbed)
-    // ...
+    lastPingTime = currentTime();
+    startTime = lastPingTime;
+    lastAddressSave = lastPingTime;
+    lastSlowPeerEviction = lastPingTime;
+    
+    transport->start();
+    messageScheduler->start();
+    networkThread = std::thread(&P2PNetwork::networkLoop, this);
+    syncThread = std::thread(&P2PNetwork::syncLoop, this);
+    announceThread = std::thread(&P2PNetwork::announceLoop, this);
     return true;
 }
 
 void P2PNetwork::stop() {
-    running = false;
+    bool wasRunning = running.exchange(false);
     listening = false;
-    // Stop threads and cleanup
-    // ...
+    if (!wasRunning) {
+        return;
+    }
+    
+    networkCV.notify_all();
+    
+    if (networkThread.joinable()) networkThread.join();
+    if (syncThread.joinable()) syncThread.join();
+    messageScheduler->stop();
+    if (announceThread.joinable()) announceThread.join();
+    
+    transport->stop();
+    saveAddresses();
+}
+
+uint16_t P2PNetwork::getListenPort() const {
+    return listening.load() ? transport->getListenPort() : config.port;
+}
+
+void P2PNetwork::networkLoop() {
+    while (running.load()) {
+        peerManager->updatePeerStates();
+        maintainConnections();
+        connectToPeers();
+        sendPings();
+        expirePendingCompactBlocks();
+        peerManager->cleanupPeers();
+        
+        if (std::chrono::steady_clock::now() - lastAddressSave > config.addressSaveInterval) {
+            saveAddresses();
+        }
+        
+        std::unique_lock<std::mutex> lock(networkMutex);
+        networkCV.wait_for(lock, std::chrono::seconds(1), [this] { return !running.load(); });
+    }
+}
+
+void P2PNetwork::syncLoop() {
+    while (running.load()) {
+        // Start syncing once a ready peer advertises a longer chain than ours
+        if (chainState && !syncManager->isSyncing()) {
+            uint32_t ourHeight = chainState->getBestHeight();
+            for (const auto& peer : peerManager->getReadyPeers()) {
+                if (peer->getStartHeight() > ourHeight) {
+                    syncManager->startSync();
+                    onSyncStarted(syncManager->getSyncPeer());
+                    break;
+                }
+            }
+        }
+        
+        // Re-assign stalled block requests and keep every peer's pipeline full
+        syncManager->tick();
+        
+        std::unique_lock<std::mutex> lock(networkMutex);
+        networkCV.wait_for(lock, std::chrono::seconds(1), [this] { return !running.load(); });
+    }
+}
+
+void P2PNetwork::announceLoop() {
+    while (running.load()) {
+        auto now = std::chrono::steady_clock::now();
+        flushAnnouncements(now);
+        reconcileTransactions(now);
+        retryTxRequests(now);
+        
+        std::unique_lock<std::mutex> lock(networkMutex);
+        networkCV.wait_for(lock, std::chrono::milliseconds(100), [this] { return !running.load(); });
+    }
+}
+
+void P2PNetwork::flushAnnouncements(std::chrono::steady_clock::time_point now) {
+    bool inboundDue = now >= nextInboundAnnouncement;
+    if (inboundDue) {
+        nextInboundAnnouncement = poissonNextSend(announceRng, now, config.inboundInvInterval);
+    }
+    
+    auto peers = peerManager->getReadyPeers();
+    if (config.randomSeed) {
+        // Seeded runs visit peers in a fixed order so the timer draws repeat
+        std::sort(peers.begin(), peers.end(), [](const auto& a, const auto& b) {
+            return a->getAddress().toString() < b->getAddress().toString();
+        });
+    }
+    for (const auto& peer : peers) {
+        if (peer->isInbound()) {
+            if (!inboundDue) continue;
+        } else {
+            if (now < peer->getNextAnnouncementTime()) continue;
+            peer->setNextAnnouncementTime(poissonNextSend(announceRng, now, config.outboundInvInterval));
+        }
+        
+        // Skip transactions that left the mempool while waiting
+        std::vector<InventoryVector> batch;
+        {
+            std::shared_lock<std::shared_mutex> lock(validationMutex);
+            for (auto& item : peer->takeAnnouncements(config.maxInvPerMessage)) {
+                if (item.type != InventoryType::TX || !mempool || mempool->hasTransaction(item.hash)) {
+                    batch.push_back(std::move(item));
+                }
+            }
+        }
+        if (!batch.empty()) {
+            peer->queueOutboundMessage(P2PMessage::createInv(batch));
+        }
+    }
+}
+
+void P2PNetwork::reconcileTransactions(std::chrono::steady_clock::time_point now) {
+    if (!txReconciliation) return;
+    
+    std::string peerId = txReconciliation->nextPeerToReconcile(now);
+    if (peerId.empty()) return;
+    
+    auto peer = peerManager->getPeer(peerId);
+    ReqReconMessage request;
+    if (peer && txReconciliation->initiateReconciliation(peerId, request, now)) {
+        peer->queueOutboundMessage(P2PMessage::createReqRecon(request));
+    }
+}
+
+void P2PNetwork::sendTxAnnouncements(const std::shared_ptr<Peer>& peer, const std::vector<std::string>& txids) {
+    std::vector<InventoryVector> batch;
+    for (const auto& txid : txids) {
+        if (mempool && !mempool->hasTransaction(txid)) continue;
+        if (!peer->markInventoryKnown(txid)) continue;
+        
+        batch.emplace_back(InventoryType::TX, txid);
+        if (batch.size() == config.maxInvPerMessage) {
+            peer->queueOutboundMessage(P2PMessage::createInv(batch));
+            batch.clear();
+        }
+    }
+    if (!batch.empty()) {
+        peer->queueOutboundMessage(P2PMessage::createInv(batch));
+    }
+}
+
+void P2PNetwork::connectToPeers() {
+    auto now = currentTime();
+    
+    for (const auto& node : config.addNodes) {
+        if (!peerManager->canMakeOutbound()) return;
+        tryConnect(stringToAddress(node), now);
+    }
+    
+    // The address table is biased toward peers that answered recently
+    for (size_t i = 0; i < MAX_ADDRESS_SELECTIONS && peerManager->canMakeOutbound(); ++i) {
+        NetworkAddress addr;
+        if (!addressManager->select(addr)) break;
+        tryConnect(addr, now);
+    }
+    
+    // Seeds are only for bootstrapping, or when the table has produced no peer in time
+    bool needSeeds = addressManager->size() == 0 ||
+                     (peerManager->getReadyPeers().empty() && now - startTime > config.seedFallbackDelay);
+    if (!needSeeds) return;
+    for (const auto& seed : config.seedNodes) {
+        if (!peerManager->canMakeOutbound()) return;
+        tryConnect(stringToAddress(seed), now);
+    }
+}
+
+bool P2PNetwork::tryConnect(const NetworkAddress& addr, std::chrono::steady_clock::time_point now) {
+    if (!isValidPeerAddress(addr) || peerManager->getPeerByAddress(addr)) {
+        return false;
+    }
+    
+    std::string key = addr.toString();
+    auto it = lastConnectAttempt.find(key);
+    if (it != lastConnectAttempt.end() && now - it->second < config.connectTimeout) {
+        return false;
+    }
+    lastConnectAttempt[key] = now;
+    addressManager->attempt(addr);
+    return transport->connect(addr) != nullptr;
+}
+
+void P2PNetwork::saveAddresses() {
+    lastAddressSave = std::chrono::steady_clock::now();
+    if (!config.addressFile.empty()) {
+        addressManager->saveToFile(config.addressFile);
+    }
+}
+
+void P2PNetwork::maintainConnections() {
+    for (const auto& peer : peerManager->getAllPeers()) {
+        if (peer->isBanned() || peer->getState() == PeerState::DISCONNECTING) {
+            transport->disconnect(peer->getId());
+            continue;
+        }
+        
+        // Drop peers that never finish the version handshake
+        if (peer->isConnected() && !peer->isHandshakeComplete() &&
+            peer->getConnectionDuration() > static_cast<double>(config.handshakeTimeout.count())) {
+            disconnectPeer(peer->getId());
+        }
+    }
+    
+    evictSlowOutboundPeer();
+}
+
+void P2PNetwork::evictSlowOutboundPeer() {
+    auto now = currentTime();
+    if (config.slowPeerEvictionInterval.count() == 0 || now - lastSlowPeerEviction < config.slowPeerEvictionInterval) {
+        return;
+    }
+    lastSlowPeerEviction = now;
+    
+    // Only worth it when every slot is taken; the freed one goes to a new address
+    if (peerManager->canMakeOutbound()) {
+        return;
+    }
+    
+    // Unmeasured peers, the sync peer and manually added peers are kept
+    std::string syncPeer = syncManager->getSyncPeer();
+    std::vector<std::pair<double, std::shared_ptr<Peer>>> measured;
+    for (const auto& peer : peerManager->getReadyPeers()) {
+        if (peer->isInbound() || peer->getId() == syncPeer || isManualPeer(peer->getAddress())) {
+            continue;
+        }
+        auto telemetry = peer->getTelemetry().getSnapshot();
+        if (telemetry.hasMeasurements()) {
+            measured.emplace_back(telemetry.estimatedBlockSeconds(), peer);
+        }
+    }
+    if (measured.size() < MIN_MEASURED_FOR_EVICTION) {
+        return;
+    }
+    
+    std::sort(measured.begin(), measured.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    double median = measured[measured.size() / 2].first;
+    const auto& slowest = measured.back();
+    if (slowest.first > SLOW_PEER_FACTOR * median) {
+        Utils::logInfo("Evicting slow outbound peer " + slowest.second->getId());
+        disconnectPeer(slowest.second->getId());
+    }
+}
+
+bool P2PNetwork::isManualPeer(const NetworkAddress& address) {
+    std::string key = address.toString();
+    for (const auto* nodes : { &config.addNodes, &config.trustedNodes }) {
+        for (const auto& node : *nodes) {
+            if (stringToAddress(node).toString() == key) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void P2PNetwork::sendPings() {
+    auto now = currentTime();
+    if (now - lastPingTime < config.pingInterval) {
+        return;
+    }
+    lastPingTime = now;
+    
+    for (const auto& peer : peerManager->getReadyPeers()) {
+        uint64_t nonce = Utils::randomUint64();
+        peer->addPendingPing(nonce);
+        peer->queueOutboundMessage(P2PMessage::createPing(nonce));
+    }
+}
+
+void P2PNetwork::processMessage(const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !message) {
+        return;
+    }
+    
+    // Only the handshake may run before version/verack have been exchanged
+    bool handshakeMessage = message->isVersion() || message->isVerack();
+    if (!handshakeMessage && !peer->isHandshakeComplete()) {
+        peer->increaseBanScore(1);
+        return;
+    }
+    
+    // Lookups of stored blocks, headers and filters share the validation
+    // lock; anything that may change the chain or mempool holds it alone
+    std::unique_lock<std::shared_mutex> validationLock(validationMutex, std::defer_lock);
+    std::shared_lock<std::shared_mutex> readLock(validationMutex, std::defer_lock);
+    if (readsChainState(message->header.command)) {
+        readLock.lock();
+    } else if (usesChainState(message->header.command)) {
+        validationLock.lock();
+    }
+    
+    switch (message->header.command) {
+        case MessageType::VERSION:
+            if (auto* version = message->getVersion()) handleVersionMessage(peerId, *version);
+            break;
+        case MessageType::VERACK:
+            handleVerackMessage(peerId);
+            break;
+        case MessageType::PING:
+            if (auto* ping = message->getPing()) handlePingMessage(peerId, *ping);
+            break;
+        case MessageType::PONG:
+            if (auto* pong = message->getPong()) handlePongMessage(peerId, *pong);
+            break;
+        case MessageType::INV:
+            if (auto* inv = message->getInv()) handleInvMessage(peerId, *inv);
+            break;
+        case MessageType::GETDATA:
+            if (auto* getData = message->getGetData()) handleGetDataMessage(peerId, *getData);
+            break;
+        case MessageType::NOTFOUND:
+            if (auto* notFound = message->getNotFound()) handleNotFoundMessage(peerId, *notFound);
+            break;
+        case MessageType::TX:
+            if (auto* tx = message->getTx()) handleTxMessage(peerId, *tx);
+            break;
+        case MessageType::BLOCK:
+            if (auto* block = message->getBlock()) handleBlockMessage(peerId, *block, message->header.length);
+            break;
+        case MessageType::GETHEADERS:
+            if (auto* getHeaders = message->getGetHeaders()) handleGetHeadersMessage(peerId, *getHeaders);
+            break;
+        case MessageType::HEADERS:
+            if (auto* headers = message->getHeaders()) handleHeadersMessage(peerId, *headers);
+            break;
+        case MessageType::ADDR:
+            if (auto* addr = message->getAddr()) handleAddrMessage(peerId, *addr);
+            break;
+        case MessageType::GETADDR:
+            shareAddresses(peerId);
+            break;
+        case MessageType::REJECT:
+            if (auto* reject = message->getReject()) handleRejectMessage(peerId, *reject);
+            break;
+        case MessageType::SENDCMPCT:
+            if (auto* sendCmpct = message->getSendCmpct()) handleSendCmpctMessage(peerId, *sendCmpct);
+            break;
+        case MessageType::CMPCTBLOCK:
+            if (auto* compactBlock = message->getCompactBlock()) handleCompactBlockMessage(peerId, *compactBlock);
+            break;
+        case MessageType::GETBLOCKTXN:
+            if (auto* getBlockTxn = message->getGetBlockTxn()) handleGetBlockTxnMessage(peerId, *getBlockTxn);
+            break;
+        case MessageType::BLOCKTXN:
+            if (auto* blockTxn = message->getBlockTxn()) handleBlockTxnMessage(peerId, *blockTxn);
+            break;
+        case MessageType::SENDTXRCNCL:
+            if (auto* sendTxRcncl = message->getSendTxRcncl()) handleSendTxRcnclMessage(peerId, *sendTxRcncl);
+            break;
+        case MessageType::REQRECON:
+            if (auto* reqRecon = message->getReqRecon()) handleReqReconMessage(peerId, *reqRecon);
+            break;
+        case MessageType::SKETCH:
+            if (auto* sketch = message->getSketch()) handleSketchMessage(peerId, *sketch);
+            break;
+        case MessageType::RECONCILDIFF:
+            if (auto* reconcilDiff = message->getReconcilDiff()) handleReconcilDiffMessage(peerId, *reconcilDiff);
+            break;
+        case MessageType::GETCFILTERS:
+            if (auto* getCFilters = message->getGetCFilters()) handleGetCFiltersMessage(peerId, *getCFilters);
+            break;
+        case MessageType::GETCFHEADERS:
+            if (auto* getCFHeaders = message->getGetCFHeaders()) handleGetCFHeadersMessage(peerId, *getCFHeaders);
+            break;
+        default:
+            break;
+    }
+}
+
+bool P2PNetwork::usesChainState(MessageType type) {
+    // Everything else runs on its shard without waiting for validation
+    switch (type) {
+        case MessageType::VERACK:
+        case MessageType::PING:
+        case MessageType::PONG:
+        case MessageType::ADDR:
+        case MessageType::GETADDR:
+        case MessageType::REJECT:
+        case MessageType::SENDCMPCT:
+        case MessageType::SENDTXRCNCL:
+        case MessageType::REQRECON:
+            return false;
+        default:
+            return true;
+    }
+}
+
+bool P2PNetwork::readsChainState(MessageType type) {
+    // Served from stored blocks, filters and the mempool without changing them
+    switch (type) {
+        case MessageType::GETDATA:
+        case MessageType::GETHEADERS:
+        case MessageType::GETBLOCKTXN:
+        case MessageType::GETCFILTERS:
+        case MessageType::GETCFHEADERS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void P2PNetwork::handleVersionMessage(const std::string& peerId, const VersionMessage& version) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    if (version.nonce == localNonce) {
+        disconnectPeer(peerId); // Connected to ourselves
+        return;
+    }
+    
+    peer->setVersionInfo(version);
+    peer->markVersionReceived();
+    
+    // Both sides offered CRC32C, so frames we send from now on use it; the
+    // peer accepts CRC32C frames as soon as it has advertised the service
+    if (config.crc32cChecksums && (version.services & Protocol::NODE_CRC32C)) {
+        peer->setFrameChecksum(ChecksumType::CRC32C);
+    }
+    if (config.compression && (version.services & Protocol::NODE_COMPRESSION)) {
+        peer->setFrameCompression(true);
+    }
+    
+    if (peer->needsVersionSent()) {
+        initiateHandshake(peerId);
+    }
+    if (peer->needsVerackSent()) {
+        peer->queueOutboundMessage(P2PMessage::createVerack());
+        peer->markVerackSent();
+    }
+    if (peer->isHandshakeReady()) {
+        completeHandshake(peerId);
+    }
+}
+
+void P2PNetwork::handleVerackMessage(const std::string& peerId) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    peer->markVerackReceived();
+    if (peer->isHandshakeReady()) {
+        completeHandshake(peerId);
+    }
+}
+
+void P2PNetwork::handlePingMessage(const std::string& peerId, const PingMessage& ping) {
+    auto peer = peerManager->getPeer(peerId);
+    if (peer) {
+        peer->queueOutboundMessage(P2PMessage::createPong(ping.nonce));
+    }
+}
+
+void P2PNetwork::handlePongMessage(const std::string& peerId, const PongMessage& pong) {
+    auto peer = peerManager->getPeer(peerId);
+    if (peer && !peer->handlePong(pong.nonce)) {
+        peer->increaseBanScore(1); // Unsolicited pong
+    }
+}
+
+void P2PNetwork::handleInvMessage(const std::string& peerId, const InvMessage& inv) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    if (inv.inventory.size() > Protocol::MAX_INV_SIZE) {
+        peer->increaseBanScore(20);
+        return;
+    }
+    
+    // Request only what we do not already have; a transaction or block
+    // already being fetched from another peer is left to that request
+    auto now = currentTime();
+    std::vector<InventoryVector> wanted;
+    for (const auto& item : inv.inventory) {
+        peer->addKnownInventory(item.hash); // Never announce it back
+        if (item.type == InventoryType::TX) {
+            if (txReconciliation) {
+                txReconciliation->removeFromSet(peerId, item.hash);
+            }
+            if (mempool && !mempool->hasTransaction(item.hash) && !isRecentlyRejected(item.hash) &&
+                txRequests->onAnnounced(peerId, item.hash, now)) {
+                wanted.push_back(item);
+            }
+        } else if (item.type == InventoryType::BLOCK) {
+            if (chainState && !chainState->getBlock(item.hash) && claimBlockRequest(item.hash, now)) {
+                // Ask for the compact form when the peer can serve it
+                bool compact = config.compactBlocks && peer->supportsCompactBlocks();
+                wanted.emplace_back(compact ? InventoryType::COMPACT_BLOCK : InventoryType::BLOCK, item.hash);
+            }
+        }
+    }
+    
+    if (!wanted.empty()) {
+        peer->queueOutboundMessage(P2PMessage::createGetData(wanted));
+    }
+    onInventoryReceived(peerId, inv.inventory);
+}
+
+void P2PNetwork::handleGetDataMessage(const std::string& peerId, const GetDataMessage& getData) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    if (getData.inventory.size() > Protocol::MAX_INV_SIZE) {
+        peer->increaseBanScore(20);
+        return;
+    }
+    
+    peer->getTelemetry().recordGetData(getData.inventory);
+    std::vector<InventoryVector> missing;
+    for (const auto& item : getData.inventory) {
+        if (auto message = getRelayMessage(item)) {
+            peer->queueOutboundMessage(message);
+        } else {
+            missing.push_back(item);
+        }
+    }
+    
+    // Lets the peer ask another announcer instead of waiting out its timeout
+    if (!missing.empty()) {
+        peer->queueOutboundMessage(P2PMessage::createNotFound(missing));
+    }
+}
+
+void P2PNetwork::handleNotFoundMessage(const std::string& peerId, const NotFoundMessage& notFound) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    if (notFound.inventory.size() > Protocol::MAX_INV_SIZE) {
+        peer->increaseBanScore(20);
+        return;
+    }
+    
+    // Transactions this peer was asked for go straight to their next announcer
+    auto now = currentTime();
+    std::unordered_map<std::string, std::vector<InventoryVector>> retries;
+    for (const auto& item : notFound.inventory) {
+        if (item.type != InventoryType::TX) continue;
+        std::string next = txRequests->onNotFound(peerId, item.hash, now);
+        if (!next.empty() && mempool && !mempool->hasTransaction(item.hash) && !isRecentlyRejected(item.hash)) {
+            retries[next].emplace_back(InventoryType::TX, item.hash);
+        }
+    }
+    for (const auto& [nextPeerId, wanted] : retries) {
+        if (auto nextPeer = peerManager->getPeer(nextPeerId)) {
+            nextPeer->queueOutboundMessage(P2PMessage::createGetData(wanted));
+        }
+    }
+}
+
+void P2PNetwork::handleTxMessage(const std::string& peerId, const TxMessage& txMsg) {
+    if (!txMsg.transaction || !mempool) return;
+    const Transaction& tx = *txMsg.transaction;
+    
+    onTransactionReceived(peerId, tx);
+    if (auto peer = peerManager->getPeer(peerId)) {
+        peer->addKnownInventory(tx.txid);
+        peer->getTelemetry().recordReceived(tx.txid, 0, false);
+    }
+    if (txReconciliation) {
+        txReconciliation->removeFromSet(peerId, tx.txid);
+    }
+    txRequests->onReceived(tx.txid);
+    
+    // Duplicates and recent failures are not validated again
+    if (mempool->hasTransaction(tx.txid) || isRecentlyRejected(tx.txid)) {
+        return;
+    }
+    uint32_t height = chainState ? chainState->getBestHeight() : 0;
+    if (!mempool->addTransaction(tx, height)) {
+        recentRejects.insert(tx.txid);
+        return;
+    }
+    
+    cacheRelayMessage(tx.txid, P2PMessage::createTx(txMsg.transaction));
+    relayInventory({ InventoryVector(InventoryType::TX, tx.txid) }, peerId);
+}
+
+bool P2PNetwork::isRecentlyRejected(const std::string& txid) {
+    // A new tip can make a rejected transaction valid, e.g. by confirming its parent
+    std::string tip = chainState ? chainState->getBestHash() : "";
+    if (tip != recentRejectsTip) {
+        recentRejects.reset();
+        recentRejectsTip = tip;
+    }
+    return recentRejects.contains(txid);
+}
+
+void P2PNetwork::retryTxRequests(std::chrono::steady_clock::time_point now) {
+    auto reassigned = txRequests->expire(now);
+    if (reassigned.empty()) return;
+    
+    for (const auto& [peerId, txids] : reassigned) {
+        auto peer = peerManager->getPeer(peerId);
+        if (!peer) {
+            continue; // Left since; the next announcer is asked after another timeout
+        }
+        std::vector<InventoryVector> wanted;
+        {
+            std::lock_guard<std::shared_mutex> lock(validationMutex);
+            for (const auto& txid : txids) {
+                if (mempool && !mempool->hasTransaction(txid) && !isRecentlyRejected(txid)) {
+                    wanted.emplace_back(InventoryType::TX, txid);
+                }
+            }
+        }
+        if (!wanted.empty()) {
+            peer->queueOutboundMessage(P2PMessage::createGetData(wanted));
+        }
+    }
+}
+
+void P2PNetwork::handleBlockMessage(const std::string& peerId, const BlockMessage& blockMsg, size_t payloadSize) {
+    if (!blockMsg.block) return;
+    
+    if (auto peer = peerManager->getPeer(peerId)) {
+        peer->getTelemetry().recordReceived(blockMsg.block->hash, payloadSize, true);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(compactBlockMutex);
+        pendingCompactBlocks.erase(blockMsg.block->hash);
+    }
+    
+    // Blocks fetched by the initial sync are connected in chain order and not relayed
+    std::vector<std::shared_ptr<Block>> connectable;
+    if (syncManager->handleBlock(peerId, blockMsg.block, payloadSize, connectable)) {
+        for (const auto& block : connectable) {
+            if (!acceptBlock(peerId, block, false)) {
+                syncManager->stopSync(); // Restarted from our new tip by the sync loop
+                return;
+            }
+        }
+        if (syncManager->isSynced()) {
+            onSyncCompleted(peerId);
+        }
+        return;
+    }
+    acceptBlock(peerId, blockMsg.block);
+}
+
+void P2PNetwork::handleGetHeadersMessage(const std::string& peerId, const GetHeadersMessage& getHeaders) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !chainState) return;
+    
+    if (getHeaders.locatorHashes.size() > Protocol::MAX_HEADERS) {
+        peer->increaseBanScore(20);
+        return;
+    }
+    
+    // Start after the first locator entry that is on our best chain
+    uint32_t height = 0;
+    for (const auto& hash : getHeaders.locatorHashes) {
+        auto entry = chainState->getBlock(hash);
+        const Block* active = entry ? chainState->getBlockByHeight(entry->height) : nullptr;
+        if (active && active->hash == hash) {
+            height = entry->height + 1;
+            break;
+        }
+    }
+    
+    std::vector<std::shared_ptr<Block>> headers;
+    uint32_t bestHeight = chainState->getBestHeight();
+    while (height <= bestHeight && headers.size() < Protocol::MAX_HEADERS) {
+        const Block* block = chainState->getBlockByHeight(height++);
+        if (!block) break;
+        
+        auto header = std::make_shared<Block>();
+        header->header = block->header;
+        header->hash = block->hash;
+        headers.push_back(header);
+        if (block->hash == getHeaders.stopHash) break;
+    }
+    peer->queueOutboundMessage(P2PMessage::createHeaders(headers));
+}
+
+void P2PNetwork::handleHeadersMessage(const std::string& peerId, const HeadersMessage& headers) {
+    std::vector<std::string> hashes;
+    hashes.reserve(headers.headers.size());
+    for (const auto& header : headers.headers) {
+        hashes.push_back(header->hash);
+    }
+    onHeadersReceived(peerId, hashes);
+    syncManager->handleHeaders(peerId, headers.headers);
+}
+
+void P2PNetwork::handleSendCmpctMessage(const std::string& peerId, const SendCmpctMessage& sendCmpct) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || sendCmpct.version != 1) return;
+    
+    peer->setCompactBlockMode(true, sendCmpct.highBandwidth);
+}
+
+void P2PNetwork::handleCompactBlockMessage(const std::string& peerId, const CompactBlockMessage& compactBlock) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !chainState) return;
+    
+    std::string blockHash = compactBlock.header.computeHash();
+    peer->addKnownInventory(blockHash);
+    peer->getTelemetry().recordReceived(blockHash, 0, false);
+    if (chainState->getBlock(blockHash)) {
+        return; // Already have it, e.g. pushed by several high-bandwidth peers
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(compactBlockMutex);
+        if (pendingCompactBlocks.count(blockHash)) {
+            return; // Reconstruction already in progress with another peer
+        }
+    }
+    
+    PartiallyDownloadedBlock partial;
+    auto status = partial.initialize(compactBlock, mempool);
+    if (status == PartiallyDownloadedBlock::Status::INVALID) {
+        peer->increaseBanScore(20);
+        return;
+    }
+    if (status == PartiallyDownloadedBlock::Status::FAILED) {
+        peer->queueOutboundMessage(P2PMessage::createGetData({ InventoryVector(InventoryType::BLOCK, blockHash) }));
+        return;
+    }
+    
+    auto missing = partial.getMissingIndexes();
+    if (missing.empty()) {
+        auto block = std::make_shared<Block>();
+        if (partial.fillBlock(*block, {}) == PartiallyDownloadedBlock::Status::OK) {
+            acceptBlock(peerId, block);
+        } else {
+            peer->queueOutboundMessage(P2PMessage::createGetData({ InventoryVector(InventoryType::BLOCK, blockHash) }));
+        }
+        return;
+    }
+    
+    // One round trip for whatever the mempool could not supply
+    GetBlockTxnMessage request;
+    request.blockHash = blockHash;
+    request.indexes = std::move(missing);
+    {
+        std::lock_guard<std::mutex> lock(compactBlockMutex);
+        pendingCompactBlocks[blockHash] = PendingCompactBlock{ peerId, std::move(partial), currentTime() };
+    }
+    peer->queueOutboundMessage(P2PMessage::createGetBlockTxn(request));
+}
+
+void P2PNetwork::handleGetBlockTxnMessage(const std::string& peerId, const GetBlockTxnMessage& getBlockTxn) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !chainState) return;
+    
+    auto entry = chainState->getBlock(getBlockTxn.blockHash);
+    if (!entry) return;
+    
+    const auto& transactions = entry->block.transactions;
+    BlockTxnMessage response;
+    response.blockHash = getBlockTxn.blockHash;
+    response.transactions.reserve(getBlockTxn.indexes.size());
+    for (uint32_t index : getBlockTxn.indexes) {
+        if (index >= transactions.size()) {
+            peer->increaseBanScore(100);
+            return;
+        }
+        response.transactions.push_back(transactions[index]);
+    }
+    peer->queueOutboundMessage(P2PMessage::createBlockTxn(response));
+}
+
+void P2PNetwork::handleBlockTxnMessage(const std::string& peerId, const BlockTxnMessage& blockTxn) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    PendingCompactBlock pending;
+    {
+        std::lock_guard<std::mutex> lock(compactBlockMutex);
+        auto it = pendingCompactBlocks.find(blockTxn.blockHash);
+        if (it == pendingCompactBlocks.end() || it->second.peerId != peerId) {
+            return; // Unsolicited or late
+        }
+        pending = std::move(it->second);
+        pendingCompactBlocks.erase(it);
+    }
+    
+    auto block = std::make_shared<Block>();
+    auto status = pending.partial.fillBlock(*block, blockTxn.transactions);
+    if (status == PartiallyDownloadedBlock::Status::INVALID) {
+        peer->increaseBanScore(20);
+        return;
+    }
+    if (status == PartiallyDownloadedBlock::Status::FAILED) {
+        // Short ID collision: fall back to the full block
+        peer->queueOutboundMessage(P2PMessage::createGetData({ InventoryVector(InventoryType::BLOCK, blockTxn.blockHash) }));
+        return;
+    }
+    acceptBlock(peerId, block);
+}
+
+bool P2PNetwork::claimBlockRequest(const std::string& hash, std::chrono::steady_clock::time_point now) {
+    if (syncManager->isBlockInFlight(hash)) {
+        return false; // The sync's download scheduler fetches it
+    }
+    std::lock_guard<std::mutex> lock(compactBlockMutex);
+    if (pendingCompactBlocks.count(hash)) {
+        return false;
+    }
+    // A request older than the expiry is presumed lost and may be repeated
+    auto it = requestedBlocks.find(hash);
+    if (it != requestedBlocks.end() && now - it->second < BLOCK_REQUEST_TIMEOUT) {
+        return false;
+    }
+    requestedBlocks[hash] = now;
+    return true;
+}
+
+bool P2PNetwork::acceptBlock(const std::string& peerId, std::shared_ptr<Block> block, bool relay) {
+    if (!block || !chainState) return false;
+    
+    {
+        std::lock_guard<std::mutex> lock(compactBlockMutex);
+        requestedBlocks.erase(block->hash);
+    }
+    onBlockReceived(peerId, *block);
+    if (!chainState->addBlock(*block)) {
+        if (auto peer = peerManager->getPeer(peerId)) {
+            peer->incrementInvalidMessages();
+        }
+        return false;
+    }
+    
+    if (mempool) {
+        mempool->updateForNewBlock(block->transactions, chainState->getBestHeight());
+    }
+    
+    if (relay) {
+        relayBlock(*block, peerId);
+    }
+    return true;
+}
+
+void P2PNetwork::relayBlock(const Block& block, const std::string& excludePeer) {
+    auto blockMessage = getStoredBlockMessage(block.hash);
+    if (!blockMessage) {
+        blockMessage = P2PMessage::createBlock(std::make_shared<Block>(block));
+    }
+    cacheRelayMessage(block.hash, blockMessage);
+    
+    std::shared_ptr<P2PMessage> compactMessage;
+    if (config.compactBlocks) {
+        compactMessage = P2PMessage::createCompactBlock(CompactBlocks::build(block, Utils::randomUint64()));
+        cacheRelayMessage("cmpct:" + block.hash, compactMessage);
+    }
+    
+    // High-bandwidth peers get the compact block straight away, the rest an inv
+    auto invMessage = P2PMessage::createInv({ InventoryVector(InventoryType::BLOCK, block.hash) });
+    for (const auto& peer : peerManager->getReadyPeers()) {
+        if (peer->getId() == excludePeer || !peer->markInventoryKnown(block.hash)) continue;
+        if (compactMessage && peer->wantsHighBandwidthBlocks()) {
+            peer->queueOutboundMessage(compactMessage);
+        } else {
+            peer->queueOutboundMessage(invMessage);
+        }
+    }
+}
+
+void P2PNetwork::expirePendingCompactBlocks() {
+    auto cutoff = currentTime() - BLOCK_REQUEST_TIMEOUT;
+    std::vector<std::pair<std::string, std::string>> expired; // blockHash, peerId
+    {
+        std::lock_guard<std::mutex> lock(compactBlockMutex);
+        for (auto it = requestedBlocks.begin(); it != requestedBlocks.end();) {
+            it = it->second < cutoff ? requestedBlocks.erase(it) : std::next(it);
+        }
+        for (auto it = pendingCompactBlocks.begin(); it != pendingCompactBlocks.end();) {
+            if (it->second.requestTime < cutoff) {
+                expired.emplace_back(it->first, it->second.peerId);
+                it = pendingCompactBlocks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    // The peer never answered getblocktxn; ask it for the full block instead
+    for (const auto& [blockHash, peerId] : expired) {
+        if (auto peer = peerManager->getPeer(peerId)) {
+            peer->getTelemetry().recordStall();
+            peer->queueOutboundMessage(P2PMessage::createGetData({ InventoryVector(InventoryType::BLOCK, blockHash) }));
+        }
+    }
+}
+
+void P2PNetwork::handleSendTxRcnclMessage(const std::string& peerId, const SendTxRcnclMessage& sendTxRcncl) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !txReconciliation) return;
+    
+    if (!txReconciliation->registerPeer(peerId, peer->isInbound(), sendTxRcncl.version, sendTxRcncl.salt)) {
+        peer->increaseBanScore(1);
+    }
+}
+
+void P2PNetwork::handleReqReconMessage(const std::string& peerId, const ReqReconMessage& reqRecon) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !txReconciliation) return;
+    
+    SketchMessage response;
+    if (!txReconciliation->handleReconciliationRequest(peerId, reqRecon, response)) {
+        peer->increaseBanScore(10); // Only the outbound side may request
+        return;
+    }
+    peer->queueOutboundMessage(P2PMessage::createSketch(response));
+}
+
+void P2PNetwork::handleSketchMessage(const std::string& peerId, const SketchMessage& sketch) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !txReconciliation) return;
+    
+    std::vector<std::string> announce;
+    ReconcilDiffMessage diff;
+    auto result = txReconciliation->handleSketch(peerId, sketch, announce, diff.askShortIds);
+    if (result == TxReconciliationTracker::SketchResult::UNEXPECTED) {
+        peer->increaseBanScore(10);
+        return;
+    }
+    
+    // Announce what the peer is missing, then tell it what we are missing;
+    // on failure it announces its whole set to us in return
+    sendTxAnnouncements(peer, announce);
+    diff.success = (result == TxReconciliationTracker::SketchResult::SUCCESS);
+    peer->queueOutboundMessage(P2PMessage::createReconcilDiff(diff));
+}
+
+void P2PNetwork::handleReconcilDiffMessage(const std::string& peerId, const ReconcilDiffMessage& reconcilDiff) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !txReconciliation) return;
+    
+    sendTxAnnouncements(peer, txReconciliation->handleReconciliationDiff(peerId, reconcilDiff));
+}
+
+bool P2PNetwork::resolveFilterRange(const std::string& peerId, uint8_t filterType, uint32_t startHeight,
+                                    const std::string& stopHash, size_t maxSize,
+                                    std::vector<std::shared_ptr<ChainEntry>>& entries) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || !chainState) return false;
+    if (!config.blockFilters) {
+        disconnectPeer(peerId); // We never advertised NODE_COMPACT_FILTERS
+        return false;
+    }
+    
+    // The stop block must be on our best chain and the range within limits
+    auto stop = chainState->getBlock(stopHash);
+    const Block* active = stop ? chainState->getBlockByHeight(stop->height) : nullptr;
+    if (filterType != static_cast<uint8_t>(BlockFilterType::BASIC) || !active || active->hash != stopHash ||
+        startHeight > stop->height || stop->height - startHeight >= maxSize) {
+        peer->increaseBanScore(20);
+        return false;
+    }
+    
+    // Walk back from the stop block; cheaper than a height lookup per block
+    entries.assign(stop->height - startHeight + 1, nullptr);
+    auto entry = stop;
+    for (size_t i = entries.size(); i-- > 0 && entry;) {
+        entries[i] = entry;
+        entry = chainState->getBlock(entry->block.header.prevHash);
+    }
+    return true;
+}
+
+void P2PNetwork::handleGetCFiltersMessage(const std::string& peerId, const GetCFiltersMessage& getCFilters) {
+    std::vector<std::shared_ptr<ChainEntry>> entries;
+    if (!resolveFilterRange(peerId, getCFilters.filterType, getCFilters.startHeight, getCFilters.stopHash,
+                            Protocol::MAX_GETCFILTERS_SIZE, entries)) {
+        return;
+    }
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    for (const auto& entry : entries) {
+        if (!entry || !entry->filter) continue;
+        CFilterMessage cfilter;
+        cfilter.filterType = getCFilters.filterType;
+        cfilter.blockHash = entry->block.hash;
+        cfilter.filter = entry->filter->getEncoded();
+        peer->queueOutboundMessage(P2PMessage::createCFilter(cfilter));
+    }
+}
+
+void P2PNetwork::handleGetCFHeadersMessage(const std::string& peerId, const GetCFHeadersMessage& getCFHeaders) {
+    std::vector<std::shared_ptr<ChainEntry>> entries;
+    if (!resolveFilterRange(peerId, getCFHeaders.filterType, getCFHeaders.startHeight, getCFHeaders.stopHash,
+                            Protocol::MAX_GETCFHEADERS_SIZE, entries)) {
+        return;
+    }
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || entries.empty() || !entries.front()) return;
+    
+    CFHeadersMessage cfheaders;
+    cfheaders.filterType = getCFHeaders.filterType;
+    cfheaders.stopHash = getCFHeaders.stopHash;
+    cfheaders.prevFilterHeader = getCFHeaders.startHeight == 0
+        ? BlockFilter::genesisPrevHeader()
+        : chainState->getFilterHeader(entries.front()->block.header.prevHash);
+    cfheaders.filterHashes.reserve(entries.size());
+    for (const auto& entry : entries) {
+        if (!entry || !entry->filter) return;
+        cfheaders.filterHashes.push_back(entry->filter->getHash());
+    }
+    peer->queueOutboundMessage(P2PMessage::createCFHeaders(cfheaders));
+}
+
+void P2PNetwork::handleAddrMessage(const std::string& peerId, const AddrMessage& addr) {
+    if (addr.addresses.size() > Protocol::MAX_ADDR_SIZE) {
+        if (auto peer = peerManager->getPeer(peerId)) {
+            peer->increaseBanScore(20);
+        }
+        return;
+    }
+    
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    std::vector<NetworkAddress> valid;
+    for (const auto& address : addr.addresses) {
+        if (isValidPeerAddress(address)) {
+            valid.push_back(address);
+        }
+    }
+    addressManager->add(valid, peer->getAddress());
+}
+
+void P2PNetwork::handleRejectMessage(const std::string& peerId, const RejectMessage& reject) {
+    Utils::logWarning("Peer " + peerId + " rejected " + reject.message + ": " + reject.reason);
+}
+
+void P2PNetwork::initiateHandshake(const std::string& peerId) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    peer->setState(PeerState::HANDSHAKING);
+    peer->queueOutboundMessage(P2PMessage::createVersion(createVersionMessage(peer->getAddress())));
+    peer->markVersionSent();
+}
+
+void P2PNetwork::completeHandshake(const std::string& peerId) {
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer || peer->isReady()) return;
+    
+    peer->setState(PeerState::READY);
+    
+    // Announce compact block support; a few outbound peers are asked to push
+    // new blocks to us immediately, which saves an inv/getdata round trip
+    if (config.compactBlocks) {
+        bool highBandwidth = false;
+        if (!peer->isInbound()) {
+            std::lock_guard<std::mutex> lock(compactBlockMutex);
+            if (highBandwidthPeers.size() < config.highBandwidthPeers) {
+                highBandwidthPeers.insert(peerId);
+                highBandwidth = true;
+            }
+        }
+        peer->queueOutboundMessage(P2PMessage::createSendCmpct(highBandwidth));
+    }
+    
+    // Offer reconciliation; the peer's sendtxrcncl completes registration
+    if (txReconciliation) {
+        peer->queueOutboundMessage(P2PMessage::createSendTxRcncl(txReconciliation->preRegisterPeer(peerId)));
+    }
+    
+    // Outbound peers we reached are worth trying first next time
+    if (!peer->isInbound()) {
+        addressManager->good(peer->getAddress());
+    }
+    
+    onPeerHandshakeComplete(peerId);
+}
+
+VersionMessage P2PNetwork::createVersionMessage(const NetworkAddress& remoteAddr) {
+    VersionMessage version;
+    version.version = config.protocolVersion;
+    version.services = config.services | (config.crc32cChecksums ? Protocol::NODE_CRC32C : 0) |
+                       (config.compression ? Protocol::NODE_COMPRESSION : 0) |
+                       (config.blockFilters ? Protocol::NODE_COMPACT_FILTERS : 0);
+    version.timestamp = Utils::getCurrentTimestamp();
+    version.addrRecv = remoteAddr;
+    version.addrFrom = NetworkAddress(config.bindAddress, getListenPort(), config.services);
+    version.nonce = localNonce;
+    version.userAgent = config.userAgent;
+    version.startHeight = chainState ? chainState->getBestHeight() : 0;
+    version.relay = config.relay;
+    return version;
 }
 
 void P2PNetwork::updateConfig(const NetworkConfig& newConfig) {
     config = newConfig;
+    transport->setAcceptCrc32c(config.crc32cChecksums);
+    transport->setAcceptCompression(config.compression);
+    transport->setRateLimits(config.rateLimits);
+    peerManager->setOutboundQueueConfig(config.outboundQueue);
 }
 
 bool P2PNetwork::connectToPeer(const std::string& address) {
     NetworkAddress addr = stringToAddress(address);
     if (!isValidPeerAddress(addr)) return false;
-    auto peer = peerManager->addPeer(addr, false);
-    return peer != nullptr;
+    
+    // Without a running transport the peer is only tracked (simulation mode)
+    if (!running.load()) {
+        return peerManager->addPeer(addr, false) != nullptr;
+    }
+    return transport->connect(addr) != nullptr;
 }
 
 void P2PNetwork::disconnectPeer(const std::string& peerId) {
     peerManager->disconnectPeer(peerId);
+    transport->disconnect(peerId);
 }
 
 void P2PNetwork::banPeer(const std::string& peerId, const std::string& reason) {
     peerManager->banPeer(peerId, reason);
+    transport->disconnect(peerId);
+    onPeerBanned(peerId, reason);
 }
 
 void P2PNetwork::broadcastTransaction(const Transaction& tx) {
+    cacheRelayMessage(tx.txid, P2PMessage::createTx(std::make_shared<Transaction>(tx)));
     auto inv = std::vector<InventoryVector>{ InventoryVector(InventoryType::TX, tx.txid) };
     relayInventory(inv);
 }
 
 void P2PNetwork::broadcastBlock(const Block& block) {
-    auto inv = std::vector<InventoryVector>{ InventoryVector(InventoryType::BLOCK, block.hash) };
-    relayInventory(inv);
+    relayBlock(block);
 }
 
 void P2PNetwork::relayInventory(const std::vector<InventoryVector>& inventory, const std::string& excludePeer) {
-    peerManager->broadcastInventory(inventory, excludePeer);
+    // Queued per peer and sent in batches by the announcement thread;
+    // transactions for reconciling peers go into their reconciliation set
+    for (const auto& peer : peerManager->getReadyPeers()) {
+        if (peer->getId() == excludePeer) continue;
+        
+        bool reconcile = txReconciliation && !txReconciliation->shouldFlood(peer->getId());
+        for (const auto& item : inventory) {
+            if (reconcile && item.type == InventoryType::TX) {
+                if (!peer->hasInventory(item.hash)) {
+                    txReconciliation->addToSet(peer->getId(), item.hash);
+                }
+            } else {
+                peer->queueAnnouncement(item);
+            }
+        }
+        if (reconcile) {
+            for (const auto& txid : txReconciliation->takeOversizedSet(peer->getId())) {
+                peer->queueAnnouncement(InventoryVector(InventoryType::TX, txid));
+            }
+        }
+    }
+}
+
+void P2PNetwork::cacheRelayMessage(const std::string& hash, std::shared_ptr<P2PMessage> message) {
+    // Encode once up front; every peer served from the cache shares these bytes
+    size_t encodedSize = message->getWireBuffer()->size();
+    
+    std::lock_guard<std::mutex> lock(relayCacheMutex);
+    if (relayCache.count(hash) || encodedSize > MAX_RELAY_CACHE_BYTES) {
+        return;
+    }
+    
+    relayCache[hash] = std::move(message);
+    relayCacheOrder.push_back(hash);
+    relayCacheBytes += encodedSize;
+    
+    // Evict oldest entries until back under budget
+    while (relayCacheBytes > MAX_RELAY_CACHE_BYTES && !relayCacheOrder.empty()) {
+        auto it = relayCache.find(relayCacheOrder.front());
+        if (it != relayCache.end()) {
+            relayCacheBytes -= it->second->getWireBuffer()->size();
+            relayCache.erase(it);
+        }
+        relayCacheOrder.pop_front();
+    }
+}
+
+std::shared_ptr<P2PMessage> P2PNetwork::getStoredBlockMessage(const std::string& hash) const {
+    if (!chainState) {
+        return nullptr;
+    }
+    auto entry = chainState->getBlock(hash);
+    if (!entry || !entry->serialized) {
+        return nullptr;
+    }
+    // The payload is the stored encoding and the block aliases the chain
+    // entry, so serving a block neither copies nor re-serializes it
+    return P2PMessage::createBlock(std::shared_ptr<Block>(entry, &entry->block), entry->serialized);
+}
+
+std::shared_ptr<P2PMessage> P2PNetwork::getRelayMessage(const InventoryVector& item) {
+    // Compact and full encodings of a block are cached separately
+    std::string cacheKey = item.type == InventoryType::COMPACT_BLOCK ? "cmpct:" + item.hash : item.hash;
+    {
+        std::lock_guard<std::mutex> lock(relayCacheMutex);
+        auto it = relayCache.find(cacheKey);
+        if (it != relayCache.end()) {
+            return it->second;
+        }
+    }
+    
+    // Fall back to the mempool / chain and cache the result for the next requester
+    std::shared_ptr<P2PMessage> message;
+    if (item.type == InventoryType::TX && mempool) {
+        if (auto entry = mempool->getTransaction(item.hash)) {
+            message = P2PMessage::createTx(std::make_shared<Transaction>(entry->transaction));
+        }
+    } else if (item.type == InventoryType::BLOCK && chainState) {
+        message = getStoredBlockMessage(item.hash);
+    } else if (item.type == InventoryType::COMPACT_BLOCK && chainState) {
+        if (auto entry = chainState->getBlock(item.hash)) {
+            message = P2PMessage::createCompactBlock(CompactBlocks::build(entry->block, Utils::randomUint64()));
+        }
+    }
+    
+    if (message) {
+        cacheRelayMessage(cacheKey, message);
+    }
+    return message;
 }
 
 P2PNetwork::NetworkInfo P2PNetwork::getNetworkInfo() const {
@@ -205,25 +1645,47 @@ P2PNetwork::NetworkInfo P2PNetwork::getNetworkInfo() const {
 }
 
 void P2PNetwork::addAddress(const NetworkAddress& address) {
-    std::lock_guard<std::mutex> lock(addressMutex);
-    knownAddresses.push_back(address);
+    addressManager->add(address, address);
 }
 
 std::vector<NetworkAddress> P2PNetwork::getKnownAddresses() const {
-    std::lock_guard<std::mutex> lock(addressMutex);
-    return knownAddresses;
+    return addressManager->getAddresses(addressManager->size());
 }
 
 void P2PNetwork::shareAddresses(const std::string& peerId) {
-    // Send addr message to peer
-    // ...
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    
+    auto addresses = addressManager->getAddresses(Protocol::MAX_ADDR_SIZE);
+    if (!addresses.empty()) {
+        peer->queueOutboundMessage(P2PMessage::createAddr(addresses));
+    }
 }
 
 void P2PNetwork::onPeerConnected(const std::string& peerId) {
     std::cout << "Peer connected: " << peerId << std::endl;
+    
+    // We speak first on outbound connections; inbound peers send their version
+    auto peer = peerManager->getPeer(peerId);
+    if (!peer) return;
+    peer->getTelemetry().setClock([this]() { return currentTime(); });
+    if (peer->isInbound()) {
+        peer->setState(PeerState::HANDSHAKING);
+    } else {
+        initiateHandshake(peerId);
+    }
 }
 
 void P2PNetwork::onPeerDisconnected(const std::string& peerId) {
+    {
+        std::lock_guard<std::mutex> lock(compactBlockMutex);
+        highBandwidthPeers.erase(peerId);
+    }
+    syncManager->removePeer(peerId);
+    txRequests->removePeer(peerId);
+    if (txReconciliation) {
+        txReconciliation->forgetPeer(peerId);
+    }
     std::cout << "Peer disconnected: " << peerId << std::endl;
 }
 
@@ -235,8 +1697,11 @@ void P2PNetwork::onPeerBanned(const std::string& peerId, const std::string& reas
     std::cout << "Peer banned: " << peerId << " Reason: " << reason << std::endl;
 }
 
-void P2PNetwork::onMessageReceived(const std::string& peerId, std::shared_ptr<P2PMessage> message) {
-    std::cout << "Message received from " << peerId << " Type: " << messageTypeToString(message->header.command) << std::endl;
+bool P2PNetwork::onMessageReceived(const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+    // Called from the transport threads; processing happens on the scheduler's
+    // workers, in the order each peer sent its messages. A full shard pauses
+    // only this peer's connection until it drains
+    return messageScheduler->submit(peerId, std::move(message));
 }
 
 void P2PNetwork::onInvalidMessage(const std::string& peerId, const std::string& reason) {
@@ -297,13 +1762,33 @@ void P2PNetwork::simulateConnect(const std::string& address) {
 }
 
 void P2PNetwork::simulateMessage(const std::string& peerId, std::shared_ptr<P2PMessage> message) {
-    onMessageReceived(peerId, message);
+    processMessage(peerId, message);
 }
 
 void P2PNetwork::simulateHandshake(const std::string& peerId) {
     onPeerHandshakeComplete(peerId);
 }
 
+void P2PNetwork::setSimulatedTime(std::chrono::steady_clock::time_point now) {
+    simulatedTime.store(now.time_since_epoch().count());
+}
+
+void P2PNetwork::simulateAnnouncements(std::chrono::steady_clock::time_point now) {
+    setSimulatedTime(now);
+    flushAnnouncements(now);
+    reconcileTransactions(now);
+    retryTxRequests(now);
+    expirePendingCompactBlocks();
+}
+
+std::chrono::steady_clock::time_point P2PNetwork::currentTime() const {
+    auto simulated = simulatedTime.load();
+    if (simulated != 0) {
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(simulated));
+    }
+    return std::chrono::steady_clock::now();
+}
+
 NetworkAddress P2PNetwork::stringToAddress(const std::string& addressStr) {
     std::string ip;
     uint16_t port = config.port;
@@ -354,6 +1839,7 @@ NetworkConfig P2PNetworkFactory::getMainnetConfig() {
     cfg.connectTimeout = std::chrono::seconds(30);
     cfg.handshakeTimeout = std::chrono::seconds(60);
     cfg.pingInterval = std::chrono::seconds(60);
+    cfg.addressFile = "peers.dat";
     return cfg;
 }
 
@@ -361,6 +1847,7 @@ NetworkConfig P2PNetworkFactory::getTestnetConfig() {
     NetworkConfig cfg = getMainnetConfig();
     cfg.port = 18333;
     cfg.userAgent = "/Pragma:1.0.0-testnet/";
+    cfg.addressFile = "testnet_peers.dat";
     return cfg;
 }
 
@@ -368,6 +1855,7 @@ NetworkConfig P2PNetworkFactory::getRegtestConfig() {
     NetworkConfig cfg = getMainnetConfig();
     cfg.port = 18444;
     cfg.userAgent = "/Pragma:1.0.0-regtest/";
+    cfg.addressFile.clear();
     return cfg;
 }
 
@@ -375,7 +1863,9 @@ NetworkConfig P2PNetworkFactory::getSimulationConfig() {
     NetworkConfig cfg = getMainnetConfig();
     cfg.port = 18445;
     cfg.userAgent = "/Pragma:1.0.0-sim/";
+    cfg.addressFile.clear();
     cfg.listen = false;
+    cfg.recentRejectsSize = 10000;      // Hundreds of nodes share one process
     return cfg;
 }
 
@@ -2,6 +2,13 @@
 
 #include "peer.h"
 #include "protocol.h"
+#include "transport.h"
+#include "compact_block.h"
+#include "block_download.h"
+#include "tx_reconciliation.h"
+#include "tx_request.h"
+#include "address_manager.h"
+#include "message_scheduler.h"
 #include "../core/block.h"
 #include "../core/transaction.h"
 #include "../core/chainstate.h"
@@ -9,7 +16,10 @@
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <shared_mutex>
 #include <functional>
+#include <deque>
+#include <random>
 
 namespace pragma {
 
@@ -29,24 +39,55 @@ enum class SyncState {
  */
 struct NetworkConfig {
     uint16_t port = 8333;
+    std::string bindAddress = "0.0.0.0";
+    size_t networkThreads = 2;          // epoll event loops shared by all connections
+    size_t messageThreads = 4;          // Message processing shards; blocks and headers go first within each
     std::string userAgent = "/Pragma:1.0.0/";
     uint32_t protocolVersion = 70015;
     uint64_t services = 1; // NODE_NETWORK
     bool listen = true;
     bool relay = true;
+    bool crc32cChecksums = false;       // Offer CRC32C frame checksums (trusted local links only)
+    bool compression = true;            // Offer LZ4 compression of large block/tx/inv/addr payloads
+    bool compactBlocks = true;          // Relay blocks as compact blocks where peers support it
+    size_t highBandwidthPeers = 3;      // Outbound peers asked to push compact blocks without an inv
+    std::chrono::milliseconds inboundInvInterval{5000};   // Mean trickle delay, shared by inbound peers
+    std::chrono::milliseconds outboundInvInterval{2000};  // Mean trickle delay, per outbound peer
+    size_t maxInvPerMessage = 1000;     // Larger backlogs carry over to the next trickle
+    std::chrono::milliseconds txRequestTimeout{30000};    // Before another announcer is asked for a transaction
+    uint32_t recentRejectsSize = 120000;    // Rejected txids not fetched again until the next tip
+    uint64_t randomSeed = 0;            // Seeds the trickle timers; 0 draws from the OS (simulations fix it)
+    bool txReconciliation = false;      // Offer set-reconciliation tx relay (sendtxrcncl)
+    size_t txFloodOutboundPeers = 4;    // Reconciling outbound peers that still get invs
+    bool blockFilters = true;           // Serve compact block filters (getcfilters/getcfheaders)
+    RateLimitConfig rateLimits;         // Per-peer and global bandwidth and message budgets
+    OutboundQueue::Config outboundQueue; // Per-peer send queue class limits and weights
     size_t maxConnections = 125;
     size_t maxInbound = 100;
     size_t maxOutbound = 25;
     std::chrono::seconds connectTimeout{30};
     std::chrono::seconds handshakeTimeout{60};
     std::chrono::seconds pingInterval{60};
+    std::chrono::seconds slowPeerEvictionInterval{600};  // How often the slowest full-slot outbound peer may be dropped (0 disables)
+    std::string addressFile;            // Address table kept across restarts (empty disables)
+    std::chrono::minutes addressSaveInterval{15};
+    std::chrono::seconds seedFallbackDelay{10};   // Seeds are used if the table yields no peer by then
     std::vector<std::string> seedNodes;
     std::vector<std::string> addNodes;
     std::vector<std::string> trustedNodes;
 };
 
+// Next event of a Poisson process with the given mean interval; the trickle
+// timers draw from it
+std::chrono::steady_clock::time_point poissonNextSend(std::mt19937_64& gen, std::chrono::steady_clock::time_point now,
+                                                      std::chrono::milliseconds meanInterval);
+
 /**
- * Sync manager - handles blockchain synchronization
+ * Sync manager - handles blockchain synchronization.
+ * Headers come from a single sync peer in MAX_HEADERS batches, with the
+ * next request pipelined as soon as a full batch arrives; block bodies
+ * are fetched in parallel from every ready peer through the download
+ * scheduler, which starts as soon as the first batch of headers arrives.
  */
 class SyncManager {
 private:
@@ -58,12 +99,33 @@ private:
     uint32_t currentHeight;
     std::chrono::steady_clock::time_point syncStartTime;
     
+    // Parallel block download
+    BlockDownloadScheduler downloader;
+    bool headersComplete;
+    std::chrono::steady_clock::time_point lastHeadersRequest;
+    
+    // Source of the sync timers; P2PNetwork points it at its own clock
+    std::function<std::chrono::steady_clock::time_point()> clock;
+    std::chrono::steady_clock::time_point now() const;
+    
+    std::mt19937_64 rng;                // Breaks ties between equally ranked sync peers
+    
     mutable std::mutex syncMutex;
     
+    static constexpr uint64_t MAX_HEADER_TIME_DRIFT = 2 * 60 * 60;  // Seconds a header may be ahead of us
+    
+    // Callers hold syncMutex
+    void sendGetHeaders(const std::string& peerId, const std::string& fromHash = "");
+    void scheduleDownloads();
+    
 public:
     SyncManager(ChainState* chain, PeerManager* peers);
+    SyncManager(ChainState* chain, PeerManager* peers, const BlockDownloadScheduler::Config& downloadConfig);
     ~SyncManager() = default;
     
+    void setClock(std::function<std::chrono::steady_clock::time_point()> source) { clock = std::move(source); }
+    void setRandomSeed(uint64_t seed) { rng.seed(seed); }
+    
     // Sync control
     void startSync();
     void stopSync();
@@ -74,14 +136,22 @@ public:
     // Sync operations
     void requestHeaders(const std::string& peerId);
     void requestBlocks(const std::string& peerId, const std::vector<std::string>& hashes);
-    void handleHeaders(const std::string& peerId, const std::vector<std::string>& headers);
-    void handleBlock(const std::string& peerId, const Block& block);
+    void handleHeaders(const std::string& peerId, const std::vector<std::shared_ptr<Block>>& headers);
+    // Returns false if the block is not part of the sync; otherwise fills
+    // connectable with the blocks that are now ready, in chain order (none
+    // for a duplicate or unrequested block, which is dropped)
+    bool handleBlock(const std::string& peerId, std::shared_ptr<Block> block, size_t bytes,
+                     std::vector<std::shared_ptr<Block>>& connectable);
+    void removePeer(const std::string& peerId);
+    void tick();
     
     // Sync status
     double getSyncProgress() const;
     std::string getSyncPeer() const;
     uint32_t getTargetHeight() const;
     std::chrono::seconds getSyncDuration() const;
+    size_t getBlocksInFlight() const;
+    bool isBlockInFlight(const std::string& hash) const;    // Queued or requested by the sync
     
     // Peer selection for sync
     std::string selectSyncPeer();
@@ -96,6 +166,7 @@ private:
     NetworkConfig config;
     std::unique_ptr<PeerManager> peerManager;
     std::unique_ptr<SyncManager> syncManager;
+    std::unique_ptr<Transport> transport;
     
     // Core components (external references)
     ChainState* chainState;
@@ -108,40 +179,121 @@ private:
     // Threading
     std::thread networkThread;
     std::thread syncThread;
-    std::thread messageThread;
+    std::thread announceThread;
     std::condition_variable networkCV;
     std::mutex networkMutex;
     
-    // Message handling
-    std::queue<std::pair<std::string, std::shared_ptr<P2PMessage>>> messageQueue;
-    std::mutex messageQueueMutex;
-    std::condition_variable messageCV;
+    // Message handling: peers are sharded over worker threads. Handlers that
+    // change the chain state or mempool (neither is thread-safe) hold
+    // validationMutex exclusively; ones that only look data up share it
+    std::unique_ptr<MessageScheduler> messageScheduler;
+    std::shared_mutex validationMutex;
     
     // Ping management
     std::chrono::steady_clock::time_point lastPingTime;
     
+    // Nonce sent in our version messages, used to detect self-connections
+    uint64_t localNonce;
+    
+    // Outbound connection attempts, throttled per address
+    static constexpr size_t MAX_ADDRESS_SELECTIONS = 16;  // Table picks per connection round
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> lastConnectAttempt;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point lastAddressSave;
+    
+    // Slow outbound peers are swapped out for fresh addresses once all slots
+    // are taken, if they are far behind the typical outbound peer
+    static constexpr size_t MIN_MEASURED_FOR_EVICTION = 4;
+    static constexpr double SLOW_PEER_FACTOR = 4.0;     // Times the median estimated block time
+    std::chrono::steady_clock::time_point lastSlowPeerEviction;
+    
+    // Recently relayed TX/BLOCK messages; every peer that requests one is
+    // sent the same message and therefore the same encoded wire buffer
+    static constexpr size_t MAX_RELAY_CACHE_BYTES = 64 * 1024 * 1024;
+    std::unordered_map<std::string, std::shared_ptr<P2PMessage>> relayCache;
+    std::deque<std::string> relayCacheOrder;
+    size_t relayCacheBytes;
+    mutable std::mutex relayCacheMutex;
+    
+    // Transaction announcements trickle out on Poisson timers; inbound peers
+    // share one timer so they cannot tell our peers apart by timing
+    std::chrono::steady_clock::time_point nextInboundAnnouncement;
+    std::mt19937_64 announceRng;        // Only used by the announcement thread
+    
+    // Transaction download deduplication: each txid is requested from one
+    // peer at a time, and transactions rejected since the current tip are
+    // not fetched or validated again. recentRejects is guarded by validationMutex
+    std::unique_ptr<TxRequestTracker> txRequests;
+    RollingBloomFilter recentRejects;
+    std::string recentRejectsTip;
+    
+    // Virtual time set by the simulator; every protocol timer, including
+    // peer telemetry and the sync manager's, reads it through currentTime()
+    std::atomic<std::chrono::steady_clock::rep> simulatedTime{0};
+    std::chrono::steady_clock::time_point currentTime() const;
+    
+    // Set-reconciliation relay state; null unless enabled in the config
+    std::unique_ptr<TxReconciliationTracker> txReconciliation;
+    
+    // Compact blocks waiting on a getblocktxn round, keyed by block hash
+    struct PendingCompactBlock {
+        std::string peerId;
+        PartiallyDownloadedBlock partial;
+        std::chrono::steady_clock::time_point requestTime;
+    };
+    std::unordered_map<std::string, PendingCompactBlock> pendingCompactBlocks;
+    std::unordered_set<std::string> highBandwidthPeers;    // Peers we asked to push compact blocks
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> requestedBlocks; // Asked for after an inv
+    std::mutex compactBlockMutex;
+    
     // Connection management
     void networkLoop();
     void syncLoop();
-    void messageLoop();
+    void announceLoop();
+    void flushAnnouncements(std::chrono::steady_clock::time_point now);
+    void reconcileTransactions(std::chrono::steady_clock::time_point now);
+    void sendTxAnnouncements(const std::shared_ptr<Peer>& peer, const std::vector<std::string>& txids);
+    void retryTxRequests(std::chrono::steady_clock::time_point now);
+    bool isRecentlyRejected(const std::string& txid);  // Caller holds validationMutex
     void connectToPeers();
+    bool tryConnect(const NetworkAddress& address, std::chrono::steady_clock::time_point now);
+    void saveAddresses();
     void maintainConnections();
+    void evictSlowOutboundPeer();
+    bool isManualPeer(const NetworkAddress& address);  // Listed in addNodes or trustedNodes
     void sendPings();
     
     // Message processing
     void processMessage(const std::string& peerId, std::shared_ptr<P2PMessage> message);
+    static bool usesChainState(MessageType type);
+    static bool readsChainState(MessageType type);     // Shared lock is enough
     void handleVersionMessage(const std::string& peerId, const VersionMessage& version);
     void handleVerackMessage(const std::string& peerId);
     void handlePingMessage(const std::string& peerId, const PingMessage& ping);
     void handlePongMessage(const std::string& peerId, const PongMessage& pong);
     void handleInvMessage(const std::string& peerId, const InvMessage& inv);
     void handleGetDataMessage(const std::string& peerId, const GetDataMessage& getData);
-    void handleTxMessage(const std::string& peerId, const std::string& txData);
-    void handleBlockMessage(const std::string& peerId, const std::string& blockData);
+    void handleNotFoundMessage(const std::string& peerId, const NotFoundMessage& notFound);
+    void handleTxMessage(const std::string& peerId, const TxMessage& txMsg);
+    void handleBlockMessage(const std::string& peerId, const BlockMessage& blockMsg, size_t payloadSize);
     void handleGetHeadersMessage(const std::string& peerId, const GetHeadersMessage& getHeaders);
     void handleHeadersMessage(const std::string& peerId, const HeadersMessage& headers);
     void handleAddrMessage(const std::string& peerId, const AddrMessage& addr);
     void handleRejectMessage(const std::string& peerId, const RejectMessage& reject);
+    void handleSendCmpctMessage(const std::string& peerId, const SendCmpctMessage& sendCmpct);
+    void handleCompactBlockMessage(const std::string& peerId, const CompactBlockMessage& compactBlock);
+    void handleGetBlockTxnMessage(const std::string& peerId, const GetBlockTxnMessage& getBlockTxn);
+    void handleBlockTxnMessage(const std::string& peerId, const BlockTxnMessage& blockTxn);
+    void handleSendTxRcnclMessage(const std::string& peerId, const SendTxRcnclMessage& sendTxRcncl);
+    void handleReqReconMessage(const std::string& peerId, const ReqReconMessage& reqRecon);
+    void handleSketchMessage(const std::string& peerId, const SketchMessage& sketch);
+    void handleReconcilDiffMessage(const std::string& peerId, const ReconcilDiffMessage& reconcilDiff);
+    void handleGetCFiltersMessage(const std::string& peerId, const GetCFiltersMessage& getCFilters);
+    void handleGetCFHeadersMessage(const std::string& peerId, const GetCFHeadersMessage& getCFHeaders);
+    // Best-chain entries from startHeight to stopHash, or false if the request is invalid
+    bool resolveFilterRange(const std::string& peerId, uint8_t filterType, uint32_t startHeight,
+                            const std::string& stopHash, size_t maxSize,
+                            std::vector<std::shared_ptr<ChainEntry>>& entries);
     
     // Handshake management
     void initiateHandshake(const std::string& peerId);
@@ -153,6 +305,19 @@ private:
     void announceBlock(const Block& block);
     void requestInventory(const std::string& peerId, const std::vector<InventoryVector>& inventory);
     
+    // Relay cache
+    void cacheRelayMessage(const std::string& hash, std::shared_ptr<P2PMessage> message);
+    std::shared_ptr<P2PMessage> getRelayMessage(const InventoryVector& item);
+    std::shared_ptr<P2PMessage> getStoredBlockMessage(const std::string& hash) const;  // nullptr if not in the chain
+    
+    // Block acceptance and relay; an announced block is requested from one
+    // peer at a time until it arrives or the request expires
+    static constexpr std::chrono::seconds BLOCK_REQUEST_TIMEOUT{10};
+    bool claimBlockRequest(const std::string& hash, std::chrono::steady_clock::time_point now);
+    bool acceptBlock(const std::string& peerId, std::shared_ptr<Block> block, bool relay = true);
+    void relayBlock(const Block& block, const std::string& excludePeer = "");
+    void expirePendingCompactBlocks();
+    
 public:
     P2PNetwork(const NetworkConfig& cfg, ChainState* chain, Mempool* mp);
     ~P2PNetwork();
@@ -162,6 +327,7 @@ public:
     void stop();
     bool isRunning() const { return running.load(); }
     bool isListening() const { return listening.load(); }
+    uint16_t getListenPort() const;
     
     // Configuration
     const NetworkConfig& getConfig() const { return config; }
@@ -208,13 +374,14 @@ public:
     void addAddress(const NetworkAddress& address);
     std::vector<NetworkAddress> getKnownAddresses() const;
     void shareAddresses(const std::string& peerId);
+    AddressManager& getAddressManager() { return *addressManager; }
     
     // Events (NetworkEventHandler implementation)
     void onPeerConnected(const std::string& peerId) override;
     void onPeerDisconnected(const std::string& peerId) override;
     void onPeerHandshakeComplete(const std::string& peerId) override;
     void onPeerBanned(const std::string& peerId, const std::string& reason) override;
-    void onMessageReceived(const std::string& peerId, std::shared_ptr<P2PMessage> message) override;
+    bool onMessageReceived(const std::string& peerId, std::shared_ptr<P2PMessage> message) override;
     void onInvalidMessage(const std::string& peerId, const std::string& reason) override;
     void onInventoryReceived(const std::string& peerId, const std::vector<InventoryVector>& inventory) override;
     void onTransactionReceived(const std::string& peerId, const Transaction& tx) override;
@@ -232,11 +399,13 @@ public:
     void simulateConnect(const std::string& address);
     void simulateMessage(const std::string& peerId, std::shared_ptr<P2PMessage> message);
     void simulateHandshake(const std::string& peerId);
+    void setSimulatedTime(std::chrono::steady_clock::time_point now);
+    // One announceLoop pass, plus compact block expiry, at a virtual time
+    void simulateAnnouncements(std::chrono::steady_clock::time_point now);
     
 private:
     // Address book for peer discovery
-    std::vector<NetworkAddress> knownAddresses;
-    mutable std::mutex addressMutex;
+    std::unique_ptr<AddressManager> addressManager;
     
     // Utility methods
     NetworkAddress stringToAddress(const std::string& addressStr);
@@ -1,9 +1,10 @@
 #include "p2p_test.h"
 #include <iostream>
 #include <chrono>
+#include <algorithm>
 
 // P2PTestNode implementation
-pragma::P2PTestNode::P2PTestNode(uint16_t port, const std::string& nodeId) 
+pragma::P2PTestNode::P2PTestNode(uint16_t port, const std::string& nodeId, size_t maxConnections) 
     : port(port), nodeId(nodeId), running(false) {
     
     // Initialize core components
@@ -17,10 +18,14 @@ pragma::P2PTestNode::P2PTestNode(uint16_t port, const std::string& nodeId)
     // Initialize P2P network with proper NetworkConfig
     NetworkConfig config;
     config.port = port;
+    config.bindAddress = "127.0.0.1";
     config.listen = true;
-    config.maxConnections = 8;
-    config.maxInbound = 4;
-    config.maxOutbound = 4;
+    config.networkThreads = 1;
+    config.messageThreads = 1;
+    config.crc32cChecksums = (port % 2 == 0); // Mix CRC32C and double SHA-256 links
+    config.maxConnections = maxConnections;
+    config.maxInbound = maxConnections - maxConnections / 2;
+    config.maxOutbound = maxConnections / 2;
     config.connectTimeout = std::chrono::seconds(10);
     config.handshakeTimeout = std::chrono::seconds(15);
     config.userAgent = "/PragmaTest:1.0.0/";
@@ -35,6 +40,10 @@ pragma::P2PTestNode::~P2PTestNode() {
 void pragma::P2PTestNode::start() {
     if (running) return;
     
+    if (!p2pNetwork->start()) {
+        std::cout << "Failed to start P2P node " << nodeId << " on port " << port << std::endl;
+        return;
+    }
     running = true;
     std::cout << "Started P2P node " << nodeId << " on port " << port << std::endl;
 }
@@ -42,12 +51,14 @@ void pragma::P2PTestNode::start() {
 void pragma::P2PTestNode::stop() {
     if (!running) return;
     
+    p2pNetwork->stop();
     running = false;
     std::cout << "Stopped P2P node " << nodeId << std::endl;
 }
 
 void pragma::P2PTestNode::connectToPeer(const std::string& address, uint16_t peerPort) {
     std::cout << "Node " << nodeId << " connecting to " << address << ":" << peerPort << std::endl;
+    p2pNetwork->connectToPeer(address + ":" + std::to_string(peerPort));
 }
 
 void pragma::P2PTestNode::broadcastTransaction(const Transaction& tx) {
@@ -59,17 +70,43 @@ void pragma::P2PTestNode::mineBlock() {
 }
 
 pragma::P2PNetwork::NetworkInfo pragma::P2PTestNode::getNetworkInfo() const {
-    return P2PNetwork::NetworkInfo{};
+    return p2pNetwork->getNetworkInfo();
 }
 
 std::string pragma::P2PTestNode::getStatus() const {
     return "Node " + nodeId + " - Status: OK";
 }
 
-// Test Suite Implementation (Simplified for now)
+// Test Suite Implementation
+bool pragma::P2PTestSuite::waitForConnection(P2PTestNode& node1, P2PTestNode& node2, int timeoutSeconds) {
+    return waitForReadyPeers(node1, 1, timeoutSeconds) && waitForReadyPeers(node2, 1, timeoutSeconds);
+}
+
+bool pragma::P2PTestSuite::waitForReadyPeers(P2PTestNode& node, size_t count, int timeoutSeconds) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSeconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (node.getP2PNetwork()->getPeerManager()->getReadyPeers().size() >= count) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
 void pragma::P2PTestSuite::runBasicConnectivityTest() {
     std::cout << "\n=== Basic Connectivity Test ===" << std::endl;
-    std::cout << "✅ Basic connectivity test completed" << std::endl;
+    
+    P2PTestNode node1(19100, "node1");
+    P2PTestNode node2(19101, "node2");
+    node1.start();
+    node2.start();
+    node2.connectToPeer("127.0.0.1", node1.getPort());
+    
+    if (waitForConnection(node1, node2)) {
+        std::cout << "✅ Basic connectivity test completed" << std::endl;
+    } else {
+        std::cout << "❌ Basic connectivity test failed: handshake did not complete" << std::endl;
+    }
 }
 
 void pragma::P2PTestSuite::runTransactionBroadcastTest() {
@@ -84,7 +121,56 @@ void pragma::P2PTestSuite::runBlockSyncTest() {
 
 void pragma::P2PTestSuite::runStressTest() {
     std::cout << "\n=== Stress Test ===" << std::endl;
-    std::cout << "✅ Stress test completed" << std::endl;
+    
+    // One hub accepting 130 inbound peers, all served by a single event loop
+    const size_t leafCount = 130;
+    P2PTestNode hub(19200, "hub", 2 * (leafCount + 10));
+    hub.start();
+    
+    std::vector<std::unique_ptr<P2PTestNode>> leaves;
+    for (size_t i = 0; i < leafCount; ++i) {
+        auto leaf = std::make_unique<P2PTestNode>(static_cast<uint16_t>(19201 + i), "leaf" + std::to_string(i));
+        leaf->start();
+        leaf->connectToPeer("127.0.0.1", hub.getPort());
+        leaves.push_back(std::move(leaf));
+    }
+    
+    if (waitForReadyPeers(hub, leafCount, 60)) {
+        std::cout << "✅ Stress test completed: hub has " << leafCount << " ready peers" << std::endl;
+    } else {
+        std::cout << "❌ Stress test failed: hub has "
+                  << hub.getP2PNetwork()->getPeerManager()->getReadyPeers().size() << " ready peers" << std::endl;
+    }
+}
+
+void pragma::P2PTestSuite::runSimulationTest() {
+    std::cout << "\n=== Simulation Test ===" << std::endl;
+    
+    // Hundreds of nodes on virtual time; finishes in seconds of real time
+    SimulationConfig config;
+    config.nodeCount = 200;
+    config.link.lossRate = 0.01;
+    NetworkSimulator simulator(config);
+    simulator.runFor(std::chrono::seconds(5));
+    
+    std::vector<std::string> hashes;
+    for (size_t i = 0; i < 20; ++i) {
+        hashes.push_back(simulator.submitTransaction(i * 7 % config.nodeCount));
+        simulator.runFor(std::chrono::milliseconds(250));
+    }
+    hashes.push_back(simulator.submitBlock(0));
+    
+    bool reached = simulator.runUntil([&]() {
+        return std::all_of(hashes.begin(), hashes.end(),
+                           [&](const std::string& hash) { return simulator.hasReachedAll(hash); });
+    }, std::chrono::seconds(120));
+    
+    std::cout << simulator.getReport();
+    if (reached) {
+        std::cout << "✅ Simulation test completed" << std::endl;
+    } else {
+        std::cout << "❌ Simulation test failed: not every item reached every node" << std::endl;
+    }
 }
 
 void pragma::P2PTestSuite::runAllTests() {
@@ -94,6 +180,7 @@ void pragma::P2PTestSuite::runAllTests() {
     runTransactionBroadcastTest();
     runBlockSyncTest();
     runStressTest();
+    runSimulationTest();
     
     std::cout << "\n✅ All P2P tests completed!\n" << std::endl;
 }
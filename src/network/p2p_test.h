@@ -7,6 +7,7 @@
 #include "../core/utxo.h"
 #include "../core/validator.h"
 #include "../network/p2p.h"
+#include "../network/network_simulator.h"
 #include "../primitives/utils.h"
 #include <memory>
 #include <thread>
@@ -34,7 +35,7 @@ private:
     std::thread networkThread;
 
 public:
-    P2PTestNode(uint16_t port, const std::string& nodeId);
+    P2PTestNode(uint16_t port, const std::string& nodeId, size_t maxConnections = 8);
     ~P2PTestNode();
     
     // Node lifecycle
@@ -69,36 +70,17 @@ public:
     static void runTransactionBroadcastTest();
     static void runBlockSyncTest();
     static void runStressTest();
+    static void runSimulationTest();
     
     // Run all tests
     static void runAllTests();
     
 private:
     // Helper methods
-    static void waitForConnection(P2PTestNode& node1, P2PTestNode& node2, int timeoutSeconds = 10);
+    static bool waitForConnection(P2PTestNode& node1, P2PTestNode& node2, int timeoutSeconds = 10);
+    static bool waitForReadyPeers(P2PTestNode& node, size_t count, int timeoutSeconds = 30);
     static void waitForSync(P2PTestNode& node1, P2PTestNode& node2, int timeoutSeconds = 15);
     static bool checkTransactionPropagation(const std::vector<P2PTestNode*>& nodes, const std::string& txid);
 };
 
-/**
- * Network Simulation Helpers
- */
-class NetworkSimulator {
-public:
-    // Simulate network latency
-    static void simulateLatency(int milliseconds);
-    
-    // Simulate packet loss
-    static bool simulatePacketLoss(double lossRate = 0.05);
-    
-    // Create network topologies
-    static void createMeshNetwork(std::vector<P2PTestNode*>& nodes);
-    static void createRingNetwork(std::vector<P2PTestNode*>& nodes);
-    static void createStarNetwork(std::vector<P2PTestNode*>& nodes);
-    
-    // Network partitioning
-    static void partitionNetwork(std::vector<P2PTestNode*>& groupA, std::vector<P2PTestNode*>& groupB);
-    static void reconnectNetwork(std::vector<P2PTestNode*>& groupA, std::vector<P2PTestNode*>& groupB);
-};
-
 } // namespace pragma
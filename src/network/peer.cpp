@@ -1,4 +1,5 @@
 #include "peer.h"
+#include "message_buffer.h"
 #include "../core/transaction.h"
 #include "../core/block.h"
 #include "../primitives/utils.h"
@@ -11,13 +12,27 @@
 namespace pragma {
 
 // Peer implementation
-Peer::Peer(const std::string& peerId, const NetworkAddress& addr)
-    : id(peerId), address(addr), state(PeerState::CONNECTING), version(0), services(0),
+Peer::Peer(const std::string& peerId, const NetworkAddress& addr, bool isInbound)
+    : id(peerId), address(addr), inbound(isInbound), state(PeerState::CONNECTING), version(0), services(0),
       startHeight(0), nonce(0), relay(true), versionSent(false), versionReceived(false),
-      verackSent(false), verackReceived(false), messageRate(0) {
+      verackSent(false), verackReceived(false),
+      knownInventory(KNOWN_INVENTORY_SIZE, KNOWN_INVENTORY_FP_RATE) {
     
-    stats.connectionTime = Utils::getCurrentTimestamp();
-    lastMessageTime = std::chrono::steady_clock::now();
+    counters.connectionTime.store(Utils::getCurrentTimestamp(), std::memory_order_relaxed);
+}
+
+PeerStats Peer::getStats() const {
+    PeerStats snapshot;
+    snapshot.bytesReceived = counters.bytesReceived.load(std::memory_order_relaxed);
+    snapshot.bytesSent = counters.bytesSent.load(std::memory_order_relaxed);
+    snapshot.messagesReceived = counters.messagesReceived.load(std::memory_order_relaxed);
+    snapshot.messagesSent = counters.messagesSent.load(std::memory_order_relaxed);
+    snapshot.invalidMessages = counters.invalidMessages.load(std::memory_order_relaxed);
+    snapshot.lastSeen = counters.lastSeen.load(std::memory_order_relaxed);
+    snapshot.connectionTime = counters.connectionTime.load(std::memory_order_relaxed);
+    snapshot.latency = counters.latency.load(std::memory_order_relaxed);
+    snapshot.banScore = counters.banScore.load(std::memory_order_relaxed);
+    return snapshot;
 }
 
 void Peer::setState(PeerState newState) {
@@ -55,117 +70,113 @@ void Peer::setVersionInfo(const VersionMessage& versionMsg) {
     relay = versionMsg.relay;
 }
 
-void Peer::queueOutboundMessage(std::shared_ptr<P2PMessage> message) {
-    std::lock_guard<std::mutex> lock(peerMutex);
-    outboundQueue.push(message);
+bool Peer::queueOutboundMessage(std::shared_ptr<P2PMessage> message) {
+    // Encode before taking the lock; the size is needed for the class byte limits
+    size_t bytes = message->getWireBuffer(getFrameChecksum(), getFrameCompression())->size();
+    
+    // Requests and announcements are timed from the moment they are queued
+    if (auto* getData = message->getGetData()) {
+        telemetry.recordRequested(getData->inventory);
+    } else if (auto* inv = message->getInv()) {
+        telemetry.recordAnnounced(inv->inventory);
+    }
+    
+    std::function<void()> notifier;
+    {
+        std::lock_guard<std::mutex> lock(peerMutex);
+        if (!outboundQueue.push(std::move(message), bytes)) {
+            return false;
+        }
+        notifier = outboundNotifier;
+    }
+    
+    // Notify outside the lock; the transport may drain the queue immediately
+    if (notifier) {
+        notifier();
+    }
+    return true;
 }
 
-std::shared_ptr<P2PMessage> Peer::getNextOutboundMessage() {
+std::shared_ptr<P2PMessage> Peer::getNextOutboundMessage(uint32_t excludedClasses) {
     std::lock_guard<std::mutex> lock(peerMutex);
-    if (outboundQueue.empty()) {
-        return nullptr;
-    }
-    
-    auto message = outboundQueue.front();
-    outboundQueue.pop();
-    return message;
+    return outboundQueue.pop(excludedClasses);
 }
 
-void Peer::queueInboundMessage(std::shared_ptr<P2PMessage> message) {
+bool Peer::hasOutboundMessages() const {
     std::lock_guard<std::mutex> lock(peerMutex);
-    inboundQueue.push(message);
+    return !outboundQueue.empty();
 }
 
-std::shared_ptr<P2PMessage> Peer::getNextInboundMessage() {
+size_t Peer::getOutboundQueueSize() const {
     std::lock_guard<std::mutex> lock(peerMutex);
-    if (inboundQueue.empty()) {
-        return nullptr;
-    }
-    
-    auto message = inboundQueue.front();
-    inboundQueue.pop();
-    return message;
+    return outboundQueue.size();
 }
 
-bool Peer::hasOutboundMessages() const {
+size_t Peer::getOutboundQueueBytes(TrafficClass trafficClass) const {
     std::lock_guard<std::mutex> lock(peerMutex);
-    return !outboundQueue.empty();
+    return outboundQueue.getQueuedBytes(trafficClass);
 }
 
-bool Peer::hasInboundMessages() const {
+uint64_t Peer::getDroppedOutboundCount() const {
     std::lock_guard<std::mutex> lock(peerMutex);
-    return !inboundQueue.empty();
+    return outboundQueue.getDroppedCount();
 }
 
-size_t Peer::getOutboundQueueSize() const {
+void Peer::setOutboundQueueConfig(const OutboundQueue::Config& config) {
     std::lock_guard<std::mutex> lock(peerMutex);
-    return outboundQueue.size();
+    outboundQueue.setConfig(config);
 }
 
-size_t Peer::getInboundQueueSize() const {
+void Peer::setOutboundNotifier(std::function<void()> notifier) {
     std::lock_guard<std::mutex> lock(peerMutex);
-    return inboundQueue.size();
+    outboundNotifier = std::move(notifier);
 }
 
 void Peer::updateStats(uint64_t bytesReceived, uint64_t bytesSent) {
-    std::lock_guard<std::mutex> lock(peerMutex);
-    stats.bytesReceived += bytesReceived;
-    stats.bytesSent += bytesSent;
+    counters.bytesReceived.fetch_add(bytesReceived, std::memory_order_relaxed);
+    counters.bytesSent.fetch_add(bytesSent, std::memory_order_relaxed);
     updateLastSeen();
 }
 
 void Peer::incrementMessageCount(bool inbound) {
-    std::lock_guard<std::mutex> lock(peerMutex);
     if (inbound) {
-        stats.messagesReceived++;
+        counters.messagesReceived.fetch_add(1, std::memory_order_relaxed);
     } else {
-        stats.messagesSent++;
+        counters.messagesSent.fetch_add(1, std::memory_order_relaxed);
     }
     updateLastSeen();
 }
 
 void Peer::incrementInvalidMessages() {
-    std::lock_guard<std::mutex> lock(peerMutex);
-    stats.invalidMessages++;
+    counters.invalidMessages.fetch_add(1, std::memory_order_relaxed);
     increaseBanScore(10); // Invalid messages increase ban score
 }
 
 void Peer::updateLastSeen() {
-    stats.lastSeen = Utils::getCurrentTimestamp();
+    counters.lastSeen.store(Utils::getCurrentTimestamp(), std::memory_order_relaxed);
 }
 
 void Peer::increaseBanScore(uint32_t points) {
-    stats.banScore += points;
+    counters.banScore.fetch_add(points, std::memory_order_relaxed);
 }
 
 void Peer::resetBanScore() {
-    stats.banScore = 0;
-}
-
-bool Peer::isRateLimited() const {
-    auto now = std::chrono::steady_clock::now();
-    auto timeSinceLastMessage = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastMessageTime).count();
-    
-    // Allow up to 100 messages per second
-    return timeSinceLastMessage < 10;
-}
-
-void Peer::updateMessageRate() {
-    lastMessageTime = std::chrono::steady_clock::now();
+    counters.banScore.store(0, std::memory_order_relaxed);
 }
 
 void Peer::addPendingPing(uint64_t pingNonce) {
     std::lock_guard<std::mutex> lock(peerMutex);
-    pendingPings[pingNonce] = std::chrono::steady_clock::now();
+    pendingPings[pingNonce] = telemetry.now();
 }
 
 bool Peer::handlePong(uint64_t pongNonce) {
     std::lock_guard<std::mutex> lock(peerMutex);
     auto it = pendingPings.find(pongNonce);
     if (it != pendingPings.end()) {
-        auto now = std::chrono::steady_clock::now();
+        auto now = telemetry.now();
         auto latencyMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - it->second).count();
-        stats.latency = static_cast<double>(latencyMs);
+        counters.latency.store(static_cast<double>(latencyMs), std::memory_order_relaxed);
+        telemetry.recordPing(now - it->second);
         pendingPings.erase(it);
         return true;
     }
@@ -173,55 +184,91 @@ bool Peer::handlePong(uint64_t pongNonce) {
 }
 
 bool Peer::hasInventory(const std::string& hash) const {
-    std::lock_guard<std::mutex> lock(peerMutex);
-    return knownInventory.find(hash) != knownInventory.end();
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    return knownInventory.contains(hash);
 }
 
 void Peer::addKnownInventory(const std::string& hash) {
-    std::lock_guard<std::mutex> lock(peerMutex);
+    std::lock_guard<std::mutex> lock(inventoryMutex);
     knownInventory.insert(hash);
-    
-    // Cleanup old inventory if too large
-    if (knownInventory.size() > 10000) {
-        clearOldInventory(8000);
+}
+
+bool Peer::markInventoryKnown(const std::string& hash) {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    if (knownInventory.contains(hash)) {
+        return false;
     }
+    knownInventory.insert(hash);
+    return true;
 }
 
 void Peer::addRequestedInventory(const std::string& hash) {
-    std::lock_guard<std::mutex> lock(peerMutex);
+    std::lock_guard<std::mutex> lock(inventoryMutex);
     requestedInventory.insert(hash);
 }
 
 void Peer::removeRequestedInventory(const std::string& hash) {
-    std::lock_guard<std::mutex> lock(peerMutex);
+    std::lock_guard<std::mutex> lock(inventoryMutex);
     requestedInventory.erase(hash);
 }
 
 bool Peer::isInventoryRequested(const std::string& hash) const {
-    std::lock_guard<std::mutex> lock(peerMutex);
+    std::lock_guard<std::mutex> lock(inventoryMutex);
     return requestedInventory.find(hash) != requestedInventory.end();
 }
 
-size_t Peer::getKnownInventorySize() const {
-    std::lock_guard<std::mutex> lock(peerMutex);
-    return knownInventory.size();
+size_t Peer::getKnownInventoryMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    return knownInventory.getMemoryUsage();
 }
 
 size_t Peer::getRequestedInventorySize() const {
-    std::lock_guard<std::mutex> lock(peerMutex);
+    std::lock_guard<std::mutex> lock(inventoryMutex);
     return requestedInventory.size();
 }
 
-void Peer::clearOldInventory(size_t maxSize) {
-    // Simple implementation: clear half when over limit
-    // In production, would use LRU or time-based cleanup
-    if (knownInventory.size() > maxSize) {
-        auto it = knownInventory.begin();
-        size_t toRemove = knownInventory.size() - maxSize;
-        for (size_t i = 0; i < toRemove && it != knownInventory.end(); ++i) {
-            it = knownInventory.erase(it);
+void Peer::queueAnnouncement(const InventoryVector& item) {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    if (knownInventory.contains(item.hash) || !pendingAnnouncementHashes.insert(item.hash).second) {
+        return;
+    }
+    if (pendingAnnouncements.size() >= MAX_PENDING_ANNOUNCEMENTS) {
+        pendingAnnouncementHashes.erase(pendingAnnouncements.front().hash);
+        pendingAnnouncements.pop_front();
+    }
+    pendingAnnouncements.push_back(item);
+}
+
+std::vector<InventoryVector> Peer::takeAnnouncements(size_t maxCount) {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    std::vector<InventoryVector> result;
+    
+    // Oldest first; items the peer learned about meanwhile are dropped
+    while (!pendingAnnouncements.empty() && result.size() < maxCount) {
+        InventoryVector item = std::move(pendingAnnouncements.front());
+        pendingAnnouncements.pop_front();
+        pendingAnnouncementHashes.erase(item.hash);
+        if (!knownInventory.contains(item.hash)) {
+            knownInventory.insert(item.hash);
+            result.push_back(std::move(item));
         }
     }
+    return result;
+}
+
+size_t Peer::getPendingAnnouncementCount() const {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    return pendingAnnouncements.size();
+}
+
+std::chrono::steady_clock::time_point Peer::getNextAnnouncementTime() const {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    return nextAnnouncementTime;
+}
+
+void Peer::setNextAnnouncementTime(std::chrono::steady_clock::time_point when) {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    nextAnnouncementTime = when;
 }
 
 std::string Peer::toString() const {
@@ -231,18 +278,17 @@ std::string Peer::toString() const {
        << " State: " << static_cast<int>(state.load())
        << " Version: " << version
        << " Height: " << startHeight
-       << " Latency: " << std::fixed << std::setprecision(1) << stats.latency << "ms";
+       << " Latency: " << std::fixed << std::setprecision(1) << getLatency() << "ms";
     return ss.str();
 }
 
 double Peer::getConnectionDuration() const {
     uint64_t now = Utils::getCurrentTimestamp();
-    return static_cast<double>(now - stats.connectionTime);
+    return static_cast<double>(now - counters.connectionTime.load(std::memory_order_relaxed));
 }
 
 bool Peer::shouldBan() const {
-    std::lock_guard<std::mutex> lock(peerMutex);
-    return stats.banScore >= 100; // Ban threshold
+    return counters.banScore.load(std::memory_order_relaxed) >= 100; // Ban threshold
 }
 
 // PeerManager implementation
@@ -281,7 +327,8 @@ std::shared_ptr<Peer> PeerManager::addPeer(const NetworkAddress& address, bool i
     
     // Create new peer
     std::string peerId = generatePeerId(address);
-    auto peer = std::make_shared<Peer>(peerId, address);
+    auto peer = std::make_shared<Peer>(peerId, address, inbound);
+    peer->setOutboundQueueConfig(outboundQueueConfig);
     
     peers[peerId] = peer;
     addressToPeerId[addressStr] = peerId;
@@ -310,10 +357,11 @@ bool PeerManager::removePeer(const std::string& peerId) {
     peers.erase(it);
     addressToPeerId.erase(addressStr);
     
-    if (peer->isConnected()) {
-        connectedPeers--;
-        // Note: We don't track inbound/outbound separately for removal
-        // In a full implementation, this would be tracked per peer
+    connectedPeers--;
+    if (peer->isInbound()) {
+        inboundConnections--;
+    } else {
+        outboundConnections--;
     }
     
     return true;
@@ -329,7 +377,7 @@ void PeerManager::disconnectPeer(const std::string& peerId) {
 void PeerManager::banPeer(const std::string& peerId, const std::string& reason) {
     std::lock_guard<std::mutex> lock(managerMutex);
     
-    auto peer = getPeer(peerId);
+    auto peer = getPeerNoLock(peerId);
     if (peer) {
         peer->setState(PeerState::BANNED);
         bannedPeers[peer->getAddress().toString()] = std::chrono::steady_clock::now();
@@ -456,7 +504,22 @@ void PeerManager::sendToRandomPeers(std::shared_ptr<P2PMessage> message, size_t
 
 void PeerManager::broadcastInventory(const std::vector<InventoryVector>& inventory, const std::string& excludePeer) {
     auto message = P2PMessage::createInv(inventory);
-    broadcastToReady(message, excludePeer);
+    for (auto& peer : getReadyPeers()) {
+        if (peer->getId() == excludePeer) continue;
+        
+        // Only announce what this peer has not announced to us or been sent already
+        std::vector<InventoryVector> unknown;
+        for (const auto& item : inventory) {
+            if (peer->markInventoryKnown(item.hash)) {
+                unknown.push_back(item);
+            }
+        }
+        if (unknown.size() == inventory.size()) {
+            peer->queueOutboundMessage(message); // Shared encoding
+        } else if (!unknown.empty()) {
+            peer->queueOutboundMessage(P2PMessage::createInv(unknown));
+        }
+    }
 }
 
 std::vector<std::shared_ptr<Peer>> PeerManager::getPeersWithoutInventory(const std::string& hash) {
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "protocol.h"
+#include "outbound_queue.h"
+#include "peer_telemetry.h"
+#include "../primitives/rolling_bloom.h"
 #include <memory>
 #include <chrono>
 #include <string>
@@ -8,9 +11,9 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <queue>
+#include <deque>
 #include <atomic>
 #include <functional>
-#include <atomic>
 #include <mutex>
 
 namespace pragma {
@@ -59,8 +62,22 @@ class Peer {
 private:
     std::string id;
     NetworkAddress address;
+    bool inbound;
     std::atomic<PeerState> state;
-    PeerStats stats;
+    
+    // Bumped by the transport and message threads; relaxed atomics keep them
+    // off peerMutex, and getStats() reads a field-by-field snapshot
+    struct Counters {
+        std::atomic<uint64_t> bytesReceived{0};
+        std::atomic<uint64_t> bytesSent{0};
+        std::atomic<uint64_t> messagesReceived{0};
+        std::atomic<uint64_t> messagesSent{0};
+        std::atomic<uint64_t> invalidMessages{0};
+        std::atomic<uint64_t> lastSeen{0};
+        std::atomic<uint64_t> connectionTime{0};
+        std::atomic<double> latency{0.0};
+        std::atomic<uint32_t> banScore{0};
+    } counters;
     
     // Protocol information
     uint32_t version;
@@ -76,36 +93,52 @@ private:
     bool verackSent;
     bool verackReceived;
     
-    // Message queues
-    std::queue<std::shared_ptr<P2PMessage>> outboundQueue;
-    std::queue<std::shared_ptr<P2PMessage>> inboundQueue;
+    // Outbound messages, sent by priority class under peerMutex. Inbound
+    // messages go from the transport straight to the message scheduler
+    OutboundQueue outboundQueue;
+    
+    // Invoked after a message is queued so the transport can flush it
+    std::function<void()> outboundNotifier;
+    
+    // Checksum used for frames we send; switched after the version handshake
+    std::atomic<ChecksumType> frameChecksum{ChecksumType::DOUBLE_SHA256};
+    std::atomic<bool> frameCompression{false};  // Both sides advertised NODE_COMPRESSION
     
-    // Rate limiting
-    std::chrono::steady_clock::time_point lastMessageTime;
-    uint32_t messageRate; // messages per second
+    // Compact block relay mode announced by the peer's sendcmpct
+    std::atomic<bool> compactBlocks{false};
+    std::atomic<bool> compactHighBandwidth{false};
     
     // Ping tracking
     std::unordered_map<uint64_t, std::chrono::steady_clock::time_point> pendingPings;
     
-    // Inventory tracking
-    std::unordered_set<std::string> knownInventory;
+    // Latency and throughput measurements; getdata and inv messages start
+    // their clocks as they are queued
+    PeerTelemetry telemetry;
+    
+    // Inventory tracking; known inventory is what the peer has announced to
+    // us or we to it, kept in a fixed-size filter. Inventory state has its
+    // own short lock, separate from the send queue's
+    RollingBloomFilter knownInventory;
     std::unordered_set<std::string> requestedInventory;
     
+    // Announcements waiting for this peer's next trickle, oldest first
+    std::deque<InventoryVector> pendingAnnouncements;
+    std::unordered_set<std::string> pendingAnnouncementHashes;
+    std::chrono::steady_clock::time_point nextAnnouncementTime;
+    mutable std::mutex inventoryMutex;
+    
     mutable std::mutex peerMutex;
     
 public:
-    Peer(const std::string& peerId, const NetworkAddress& addr);
+    Peer(const std::string& peerId, const NetworkAddress& addr, bool isInbound = false);
     ~Peer() = default;
     
     // Basic getters
     const std::string& getId() const { return id; }
     const NetworkAddress& getAddress() const { return address; }
+    bool isInbound() const { return inbound; }
     PeerState getState() const { return state.load(); }
-    // Get peer statistics (return by value to avoid mutex issues)
-    PeerStats getStats() const { 
-        std::lock_guard<std::mutex> lock(peerMutex); 
-        return stats; 
-    }
+    PeerStats getStats() const;
     
     // Protocol information
     uint32_t getVersion() const { return version; }
@@ -132,14 +165,26 @@ public:
     bool isHandshakeReady() const { return versionSent && versionReceived && verackSent && verackReceived; }
     
     // Message handling
-    void queueOutboundMessage(std::shared_ptr<P2PMessage> message);
-    std::shared_ptr<P2PMessage> getNextOutboundMessage();
-    void queueInboundMessage(std::shared_ptr<P2PMessage> message);
-    std::shared_ptr<P2PMessage> getNextInboundMessage();
+    bool queueOutboundMessage(std::shared_ptr<P2PMessage> message); // False if its class is full
+    std::shared_ptr<P2PMessage> getNextOutboundMessage(uint32_t excludedClasses = 0);
     bool hasOutboundMessages() const;
-    bool hasInboundMessages() const;
     size_t getOutboundQueueSize() const;
-    size_t getInboundQueueSize() const;
+    size_t getOutboundQueueBytes(TrafficClass trafficClass) const;
+    uint64_t getDroppedOutboundCount() const;
+    void setOutboundQueueConfig(const OutboundQueue::Config& config);
+    void setOutboundNotifier(std::function<void()> notifier);
+    ChecksumType getFrameChecksum() const { return frameChecksum.load(); }
+    void setFrameChecksum(ChecksumType type) { frameChecksum.store(type); }
+    bool getFrameCompression() const { return frameCompression.load(); }
+    void setFrameCompression(bool enabled) { frameCompression.store(enabled); }
+    
+    // Compact block relay
+    void setCompactBlockMode(bool supported, bool highBandwidth) {
+        compactBlocks.store(supported);
+        compactHighBandwidth.store(supported && highBandwidth);
+    }
+    bool supportsCompactBlocks() const { return compactBlocks.load(); }
+    bool wantsHighBandwidthBlocks() const { return compactHighBandwidth.load(); }
     
     // Statistics
     void updateStats(uint64_t bytesReceived, uint64_t bytesSent);
@@ -149,24 +194,37 @@ public:
     void increaseBanScore(uint32_t points);
     void resetBanScore();
     
-    // Rate limiting
-    bool isRateLimited() const;
-    void updateMessageRate();
-    
     // Ping management
     void addPendingPing(uint64_t nonce);
     bool handlePong(uint64_t nonce);
-    double getLatency() const { return stats.latency; }
+    double getLatency() const { return counters.latency.load(std::memory_order_relaxed); }
+    
+    // Performance telemetry
+    PeerTelemetry& getTelemetry() { return telemetry; }
+    const PeerTelemetry& getTelemetry() const { return telemetry; }
     
     // Inventory management
+    static constexpr uint32_t KNOWN_INVENTORY_SIZE = 10000;
+    static constexpr double KNOWN_INVENTORY_FP_RATE = 0.000001;
+    
     bool hasInventory(const std::string& hash) const;
     void addKnownInventory(const std::string& hash);
+    bool markInventoryKnown(const std::string& hash); // False if already known
     void addRequestedInventory(const std::string& hash);
     void removeRequestedInventory(const std::string& hash);
     bool isInventoryRequested(const std::string& hash) const;
-    size_t getKnownInventorySize() const;
+    size_t getKnownInventoryMemoryUsage() const;
     size_t getRequestedInventorySize() const;
-    void clearOldInventory(size_t maxSize = 10000);
+    
+    // Trickled announcements; past the cap the oldest are dropped, as a peer
+    // that far behind will fetch them from someone else or not at all
+    static constexpr size_t MAX_PENDING_ANNOUNCEMENTS = Protocol::MAX_INV_SIZE;
+    
+    void queueAnnouncement(const InventoryVector& item);
+    std::vector<InventoryVector> takeAnnouncements(size_t maxCount); // Marks them known
+    size_t getPendingAnnouncementCount() const;
+    std::chrono::steady_clock::time_point getNextAnnouncementTime() const;
+    void setNextAnnouncementTime(std::chrono::steady_clock::time_point when);
     
     // Utility
     std::string toString() const;
@@ -189,6 +247,7 @@ private:
     uint32_t banThreshold;
     std::chrono::seconds banDuration;
     uint32_t maxMessageRate;
+    OutboundQueue::Config outboundQueueConfig;
     
     // Connection tracking
     std::atomic<size_t> connectedPeers{0};
@@ -262,6 +321,10 @@ public:
     void setBanThreshold(uint32_t threshold) { banThreshold = threshold; }
     void setBanDuration(std::chrono::seconds duration) { banDuration = duration; }
     void setMaxMessageRate(uint32_t rate) { maxMessageRate = rate; }
+    void setOutboundQueueConfig(const OutboundQueue::Config& config) {
+        std::lock_guard<std::mutex> lock(managerMutex);
+        outboundQueueConfig = config;
+    }
     
     size_t getMaxPeers() const { return maxPeers; }
     uint32_t getBanThreshold() const { return banThreshold; }
@@ -293,7 +356,9 @@ public:
     virtual void onPeerBanned(const std::string& peerId, const std::string& reason) {}
     
     // Message events
-    virtual void onMessageReceived(const std::string& peerId, std::shared_ptr<P2PMessage> message) {}
+    // False refuses the message for now: the transport holds it, stops reading
+    // from that peer and offers it again shortly
+    virtual bool onMessageReceived(const std::string& peerId, std::shared_ptr<P2PMessage> message) { return true; }
     virtual void onInvalidMessage(const std::string& peerId, const std::string& reason) {}
     
     // Inventory events
@@ -0,0 +1,161 @@
+#include "peer_telemetry.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace pragma {
+
+// LatencyHistogram implementation
+void LatencyHistogram::add(double milliseconds) {
+    size_t bucket = 0;
+    while (bucket + 1 < BUCKETS && milliseconds >= bucketUpperBound(bucket)) {
+        bucket++;
+    }
+    counts[bucket]++;
+}
+
+uint64_t LatencyHistogram::total() const {
+    uint64_t sum = 0;
+    for (uint64_t count : counts) {
+        sum += count;
+    }
+    return sum;
+}
+
+double LatencyHistogram::percentile(double fraction) const {
+    uint64_t samples = total();
+    if (samples == 0) {
+        return 0.0;
+    }
+
+    auto rank = static_cast<uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * samples));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= std::max<uint64_t>(rank, 1)) {
+            return bucketUpperBound(i);
+        }
+    }
+    return bucketUpperBound(BUCKETS - 1);
+}
+
+double LatencyHistogram::bucketUpperBound(size_t bucket) {
+    // The last bucket is open-ended; report its lower bound
+    return std::ldexp(1.0, static_cast<int>(std::min(bucket, BUCKETS - 2)));
+}
+
+// MovingAverage implementation
+void MovingAverage::add(double sample) {
+    value = samples == 0 ? sample : value + WEIGHT * (sample - value);
+    samples++;
+}
+
+// PeerTelemetry implementation
+double PeerTelemetry::Snapshot::estimatedBlockSeconds() const {
+    double responseMs = responseTime.samples ? responseTime.value
+                      : pingTime.samples ? pingTime.value : DEFAULT_RESPONSE_MS;
+    double throughput = blockThroughput.samples ? blockThroughput.value : DEFAULT_THROUGHPUT;
+    double seconds = responseMs / 1000.0 + REFERENCE_BLOCK_BYTES / std::max(throughput, 1.0);
+
+    // A stall means some request had to be sent elsewhere after a timeout;
+    // answered requests wear the penalty off again
+    return seconds * (1.0 + STALL_PENALTY * stallRate.value);
+}
+
+void PeerTelemetry::ItemRing::add(uint64_t key, Clock::time_point time) {
+    items[next] = TrackedItem{key, time};
+    next = (next + 1) % TRACKED_ITEMS;
+}
+
+bool PeerTelemetry::ItemRing::take(uint64_t key, Clock::time_point& time) {
+    for (auto& item : items) {
+        if (item.key == key) {
+            time = item.time;
+            item.key = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t PeerTelemetry::keyFor(const std::string& hash) {
+    // Never 0, which marks a free slot
+    return static_cast<uint64_t>(std::hash<std::string>{}(hash)) | 1;
+}
+
+void PeerTelemetry::setClock(ClockSource source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    clock = std::move(source);
+}
+
+PeerTelemetry::Clock::time_point PeerTelemetry::now() const {
+    ClockSource source;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        source = clock;
+    }
+    return source ? source() : Clock::now();
+}
+
+void PeerTelemetry::recordRequested(const std::vector<InventoryVector>& items, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& item : items) {
+        requests.add(keyFor(item.hash), now);
+    }
+}
+
+void PeerTelemetry::recordAnnounced(const std::vector<InventoryVector>& items, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& item : items) {
+        announcements.add(keyFor(item.hash), now);
+    }
+}
+
+void PeerTelemetry::recordReceived(const std::string& hash, size_t bytes, bool fullBlock, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::time_point requested;
+    if (!requests.take(keyFor(hash), requested)) {
+        return; // Unsolicited, or requested too long ago to still be tracked
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(now - requested).count();
+    data.stallRate.add(0.0);
+    data.responseTime.add(elapsedMs);
+    data.responseHistogram.add(elapsedMs);
+    if (fullBlock && bytes > 0) {
+        data.blockThroughput.add(bytes / (std::max(elapsedMs, 1.0) / 1000.0));
+        data.blockBytes += bytes;
+    }
+}
+
+void PeerTelemetry::recordGetData(const std::vector<InventoryVector>& items, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& item : items) {
+        Clock::time_point announced;
+        if (announcements.take(keyFor(item.hash), announced)) {
+            double delayMs = std::chrono::duration<double, std::milli>(now - announced).count();
+            data.requestDelay.add(delayMs);
+            data.requestDelayHistogram.add(delayMs);
+        }
+    }
+}
+
+void PeerTelemetry::recordPing(Clock::duration roundTrip) {
+    double roundTripMs = std::chrono::duration<double, std::milli>(roundTrip).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    data.pingTime.add(roundTripMs);
+    data.pingHistogram.add(roundTripMs);
+}
+
+void PeerTelemetry::recordStall() {
+    std::lock_guard<std::mutex> lock(mutex);
+    data.stalls++;
+    data.stallRate.add(1.0);
+}
+
+PeerTelemetry::Snapshot PeerTelemetry::getSnapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return data;
+}
+
+} // namespace pragma
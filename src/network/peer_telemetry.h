@@ -0,0 +1,124 @@
+#pragma once
+
+#include "protocol.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Log-scale histogram of durations in milliseconds.
+ * Bucket 0 counts samples under 1 ms, bucket i those in [2^(i-1), 2^i) ms,
+ * and the last bucket everything longer.
+ */
+struct LatencyHistogram {
+    static constexpr size_t BUCKETS = 16;
+    std::array<uint64_t, BUCKETS> counts{};
+
+    void add(double milliseconds);
+    uint64_t total() const;
+    double percentile(double fraction) const;   // Upper bound of the bucket holding it; 0 if empty
+    static double bucketUpperBound(size_t bucket);
+};
+
+/**
+ * Exponentially weighted moving average; the first sample is taken as is.
+ */
+struct MovingAverage {
+    static constexpr double WEIGHT = 0.2;   // Of each new sample
+    double value = 0.0;
+    uint64_t samples = 0;
+
+    void add(double sample);
+};
+
+/**
+ * Per-peer performance measurements used for scheduling decisions.
+ * The outgoing side is recorded as messages are queued to the peer: a
+ * getdata starts the clock for each requested item, an inv for each
+ * announced one. Responses stop it, giving time to first byte for our
+ * requests, block download throughput and how quickly the peer asks for
+ * what we announce. Only the most recent items are tracked, in fixed
+ * rings, so memory stays constant however much the peer ignores.
+ * Calls without a time use the telemetry's clock, which simulations point
+ * at virtual time. Thread-safe.
+ */
+class PeerTelemetry {
+public:
+    using Clock = std::chrono::steady_clock;
+    using ClockSource = std::function<Clock::time_point()>;
+
+    static constexpr size_t TRACKED_ITEMS = 128;                // Per direction
+    static constexpr double REFERENCE_BLOCK_BYTES = 1000000.0;  // Block size peers are ranked by
+    static constexpr double DEFAULT_RESPONSE_MS = 500.0;        // Assumed until measured
+    static constexpr double DEFAULT_THROUGHPUT = 125000.0;      // Bytes per second, assumed until measured
+    static constexpr double STALL_PENALTY = 5.0;                // Estimate multiplier per unit of stall rate
+
+    struct Snapshot {
+        MovingAverage pingTime;             // Milliseconds
+        LatencyHistogram pingHistogram;
+        MovingAverage responseTime;         // Our getdata to the first reply, milliseconds
+        LatencyHistogram responseHistogram;
+        MovingAverage requestDelay;         // Our inv to the peer's getdata, milliseconds
+        LatencyHistogram requestDelayHistogram;
+        MovingAverage blockThroughput;      // Full block bytes per second of request time
+        uint64_t blockBytes = 0;
+        uint64_t stalls = 0;                // Requests the peer failed to answer in time
+        MovingAverage stallRate;            // 1 per stall, 0 per answered request
+
+        bool hasMeasurements() const { return pingTime.samples || responseTime.samples; }
+        // Expected seconds to fetch a reference-sized block; lower is better
+        double estimatedBlockSeconds() const;
+    };
+
+private:
+    struct TrackedItem {
+        uint64_t key = 0;               // 0 marks a free slot
+        Clock::time_point time;
+    };
+
+    struct ItemRing {
+        std::array<TrackedItem, TRACKED_ITEMS> items{};
+        size_t next = 0;
+
+        void add(uint64_t key, Clock::time_point time);
+        bool take(uint64_t key, Clock::time_point& time);   // Removes the item if found
+    };
+
+    Snapshot data;
+    ClockSource clock;
+    ItemRing requests;
+    ItemRing announcements;
+    mutable std::mutex mutex;
+
+    static uint64_t keyFor(const std::string& hash);
+
+public:
+    void setClock(ClockSource source);     // Null restores the steady clock
+    Clock::time_point now() const;
+
+    // Outgoing messages
+    void recordRequested(const std::vector<InventoryVector>& items) { recordRequested(items, now()); }
+    void recordRequested(const std::vector<InventoryVector>& items, Clock::time_point now);
+    void recordAnnounced(const std::vector<InventoryVector>& items) { recordAnnounced(items, now()); }
+    void recordAnnounced(const std::vector<InventoryVector>& items, Clock::time_point now);
+
+    // Incoming messages; bytes is the payload size, used for full blocks only
+    void recordReceived(const std::string& hash, size_t bytes, bool fullBlock) {
+        recordReceived(hash, bytes, fullBlock, now());
+    }
+    void recordReceived(const std::string& hash, size_t bytes, bool fullBlock, Clock::time_point now);
+    void recordGetData(const std::vector<InventoryVector>& items) { recordGetData(items, now()); }
+    void recordGetData(const std::vector<InventoryVector>& items, Clock::time_point now);
+    void recordPing(Clock::duration roundTrip);
+    void recordStall();
+
+    Snapshot getSnapshot() const;
+};
+
+} // namespace pragma
@@ -1,27 +1,34 @@
 #include "protocol.h"
+#include "message_buffer.h"
 #include "../core/transaction.h"
 #include "../core/block.h"
 #include "../primitives/serialize.h"
 #include "../primitives/hash.h"
 #include "../primitives/utils.h"
+#include "../primitives/lz4.h"
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
 #include <variant>
+#include <stdexcept>
+#include <cstring>
+#include <type_traits>
 
 namespace pragma {
 
 // InventoryVector implementation
 std::vector<uint8_t> InventoryVector::serialize() const {
     std::vector<uint8_t> result;
-    auto typeBytes = Serialize::encodeUint32LE(static_cast<uint32_t>(type));
-    auto hashBytes = Serialize::encodeString(hash);
-    result.insert(result.end(), typeBytes.begin(), typeBytes.end());
-    result.insert(result.end(), hashBytes.begin(), hashBytes.end());
+    serializeInto(result);
     return result;
 }
 
-InventoryVector InventoryVector::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void InventoryVector::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint32LE(out, static_cast<uint32_t>(type));
+    Serialize::appendString(out, hash);
+}
+
+InventoryVector InventoryVector::deserialize(ByteSpan data, size_t& offset) {
     InventoryVector inv;
     inv.type = static_cast<InventoryType>(Serialize::decodeUint32LE(data, offset));
     offset += 4;
@@ -34,19 +41,18 @@ InventoryVector InventoryVector::deserialize(const std::vector<uint8_t>& data, s
 // NetworkAddress implementation
 std::vector<uint8_t> NetworkAddress::serialize() const {
     std::vector<uint8_t> result;
-    auto servicesBytes = Serialize::encodeUint64LE(services);
-    auto ipBytes = Serialize::encodeString(ip);
-    auto portBytes = Serialize::encodeUint16LE(port);
-    auto timestampBytes = Serialize::encodeUint64LE(timestamp);
-    
-    result.insert(result.end(), servicesBytes.begin(), servicesBytes.end());
-    result.insert(result.end(), ipBytes.begin(), ipBytes.end());
-    result.insert(result.end(), portBytes.begin(), portBytes.end());
-    result.insert(result.end(), timestampBytes.begin(), timestampBytes.end());
+    serializeInto(result);
     return result;
 }
 
-NetworkAddress NetworkAddress::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void NetworkAddress::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint64LE(out, services);
+    Serialize::appendString(out, ip);
+    Serialize::appendUint16LE(out, port);
+    Serialize::appendUint64LE(out, timestamp);
+}
+
+NetworkAddress NetworkAddress::deserialize(ByteSpan data, size_t& offset) {
     NetworkAddress addr;
     addr.services = Serialize::decodeUint64LE(data, offset);
     offset += 8;
@@ -63,23 +69,33 @@ NetworkAddress NetworkAddress::deserialize(const std::vector<uint8_t>& data, siz
 // MessageHeader implementation
 std::vector<uint8_t> MessageHeader::serialize() const {
     std::vector<uint8_t> result;
-    auto magicBytes = Serialize::encodeUint32LE(magic);
-    auto commandBytes = Serialize::encodeUint32LE(static_cast<uint32_t>(command));
-    auto lengthBytes = Serialize::encodeUint32LE(length);
-    auto checksumBytes = Serialize::encodeUint32LE(checksum);
-    
-    result.insert(result.end(), magicBytes.begin(), magicBytes.end());
-    result.insert(result.end(), commandBytes.begin(), commandBytes.end());
-    result.insert(result.end(), lengthBytes.begin(), lengthBytes.end());
-    result.insert(result.end(), checksumBytes.begin(), checksumBytes.end());
+    serializeInto(result);
     return result;
 }
 
-MessageHeader MessageHeader::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void MessageHeader::serializeInto(std::vector<uint8_t>& out) const {
+    uint32_t commandField = static_cast<uint32_t>(command);
+    if (checksumType == ChecksumType::CRC32C) {
+        commandField |= Protocol::CRC32C_COMMAND_FLAG;
+    }
+    if (compressed) {
+        commandField |= Protocol::COMPRESSED_COMMAND_FLAG;
+    }
+    Serialize::appendUint32LE(out, magic);
+    Serialize::appendUint32LE(out, commandField);
+    Serialize::appendUint32LE(out, length);
+    Serialize::appendUint32LE(out, checksum);
+}
+
+MessageHeader MessageHeader::deserialize(ByteSpan data, size_t& offset) {
     MessageHeader header;
     header.magic = Serialize::decodeUint32LE(data, offset);
     offset += 4;
-    header.command = static_cast<MessageType>(Serialize::decodeUint32LE(data, offset));
+    uint32_t commandField = Serialize::decodeUint32LE(data, offset);
+    header.command = static_cast<MessageType>(commandField & ~Protocol::COMMAND_FLAGS);
+    header.checksumType = (commandField & Protocol::CRC32C_COMMAND_FLAG) ? ChecksumType::CRC32C
+                                                                         : ChecksumType::DOUBLE_SHA256;
+    header.compressed = (commandField & Protocol::COMPRESSED_COMMAND_FLAG) != 0;
     offset += 4;
     header.length = Serialize::decodeUint32LE(data, offset);
     offset += 4;
@@ -91,29 +107,23 @@ MessageHeader MessageHeader::deserialize(const std::vector<uint8_t>& data, size_
 // VersionMessage implementation
 std::vector<uint8_t> VersionMessage::serialize() const {
     std::vector<uint8_t> result;
-    auto versionBytes = Serialize::encodeUint32LE(version);
-    auto servicesBytes = Serialize::encodeUint64LE(services);
-    auto timestampBytes = Serialize::encodeUint64LE(timestamp);
-    auto addrRecvBytes = addrRecv.serialize();
-    auto addrFromBytes = addrFrom.serialize();
-    auto nonceBytes = Serialize::encodeUint64LE(nonce);
-    auto userAgentBytes = Serialize::encodeString(userAgent);
-    auto startHeightBytes = Serialize::encodeUint32LE(startHeight);
-    auto relayBytes = Serialize::encodeUint8LE(relay ? 1 : 0);
-    
-    result.insert(result.end(), versionBytes.begin(), versionBytes.end());
-    result.insert(result.end(), servicesBytes.begin(), servicesBytes.end());
-    result.insert(result.end(), timestampBytes.begin(), timestampBytes.end());
-    result.insert(result.end(), addrRecvBytes.begin(), addrRecvBytes.end());
-    result.insert(result.end(), addrFromBytes.begin(), addrFromBytes.end());
-    result.insert(result.end(), nonceBytes.begin(), nonceBytes.end());
-    result.insert(result.end(), userAgentBytes.begin(), userAgentBytes.end());
-    result.insert(result.end(), startHeightBytes.begin(), startHeightBytes.end());
-    result.insert(result.end(), relayBytes.begin(), relayBytes.end());
+    serializeInto(result);
     return result;
 }
 
-VersionMessage VersionMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void VersionMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint32LE(out, version);
+    Serialize::appendUint64LE(out, services);
+    Serialize::appendUint64LE(out, timestamp);
+    addrRecv.serializeInto(out);
+    addrFrom.serializeInto(out);
+    Serialize::appendUint64LE(out, nonce);
+    Serialize::appendString(out, userAgent);
+    Serialize::appendUint32LE(out, startHeight);
+    Serialize::appendUint8LE(out, relay ? 1 : 0);
+}
+
+VersionMessage VersionMessage::deserialize(ByteSpan data, size_t& offset) {
     VersionMessage msg;
     msg.version = Serialize::decodeUint32LE(data, offset);
     offset += 4;
@@ -130,8 +140,7 @@ VersionMessage VersionMessage::deserialize(const std::vector<uint8_t>& data, siz
     offset += userAgentResult.second;
     msg.startHeight = Serialize::decodeUint32LE(data, offset);
     offset += 4;
-    // For simplicity, assuming encodeUint8LE exists or using a single byte
-    msg.relay = (data[offset] != 0);
+    msg.relay = (Serialize::decodeUint8LE(data, offset) != 0);
     offset += 1;
     return msg;
 }
@@ -139,23 +148,25 @@ VersionMessage VersionMessage::deserialize(const std::vector<uint8_t>& data, siz
 // InvMessage implementation
 std::vector<uint8_t> InvMessage::serialize() const {
     std::vector<uint8_t> result;
-    auto countBytes = Serialize::encodeVarInt(inventory.size());
-    result.insert(result.end(), countBytes.begin(), countBytes.end());
-    
+    serializeInto(result);
+    return result;
+}
+
+void InvMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendVarInt(out, inventory.size());
     for (const auto& inv : inventory) {
-        auto invBytes = inv.serialize();
-        result.insert(result.end(), invBytes.begin(), invBytes.end());
+        inv.serializeInto(out);
     }
-    return result;
 }
 
-InvMessage InvMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+InvMessage InvMessage::deserialize(ByteSpan data, size_t& offset) {
     InvMessage msg;
     auto countResult = Serialize::decodeVarInt(data, offset);
     uint64_t count = countResult.first;
     offset += countResult.second;
     
-    msg.inventory.reserve(count);
+    // Never trust the count for the reservation; each entry is at least 5 bytes
+    msg.inventory.reserve(std::min<uint64_t>(count, data.size() / 5));
     for (uint64_t i = 0; i < count; ++i) {
         msg.inventory.push_back(InventoryVector::deserialize(data, offset));
     }
@@ -165,23 +176,51 @@ InvMessage InvMessage::deserialize(const std::vector<uint8_t>& data, size_t& off
 // GetDataMessage implementation
 std::vector<uint8_t> GetDataMessage::serialize() const {
     std::vector<uint8_t> result;
-    auto countBytes = Serialize::encodeVarInt(inventory.size());
-    result.insert(result.end(), countBytes.begin(), countBytes.end());
-    
+    serializeInto(result);
+    return result;
+}
+
+void GetDataMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendVarInt(out, inventory.size());
     for (const auto& inv : inventory) {
-        auto invBytes = inv.serialize();
-        result.insert(result.end(), invBytes.begin(), invBytes.end());
+        inv.serializeInto(out);
     }
-    return result;
 }
 
-GetDataMessage GetDataMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+GetDataMessage GetDataMessage::deserialize(ByteSpan data, size_t& offset) {
     GetDataMessage msg;
     auto countResult = Serialize::decodeVarInt(data, offset);
     uint64_t count = countResult.first;
     offset += countResult.second;
     
-    msg.inventory.reserve(count);
+    msg.inventory.reserve(std::min<uint64_t>(count, data.size() / 5));
+    for (uint64_t i = 0; i < count; ++i) {
+        msg.inventory.push_back(InventoryVector::deserialize(data, offset));
+    }
+    return msg;
+}
+
+// NotFoundMessage implementation
+std::vector<uint8_t> NotFoundMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void NotFoundMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendVarInt(out, inventory.size());
+    for (const auto& inv : inventory) {
+        inv.serializeInto(out);
+    }
+}
+
+NotFoundMessage NotFoundMessage::deserialize(ByteSpan data, size_t& offset) {
+    NotFoundMessage msg;
+    auto countResult = Serialize::decodeVarInt(data, offset);
+    uint64_t count = countResult.first;
+    offset += countResult.second;
+    
+    msg.inventory.reserve(std::min<uint64_t>(count, data.size() / 5));
     for (uint64_t i = 0; i < count; ++i) {
         msg.inventory.push_back(InventoryVector::deserialize(data, offset));
     }
@@ -190,52 +229,317 @@ GetDataMessage GetDataMessage::deserialize(const std::vector<uint8_t>& data, siz
 
 // TxMessage implementation
 std::vector<uint8_t> TxMessage::serialize() const {
-    // This would need to use Transaction's serialize method
-    // For now, return empty vector as placeholder
-    return std::vector<uint8_t>();
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void TxMessage::serializeInto(std::vector<uint8_t>& out) const {
+    if (transaction) {
+        transaction->serializeInto(out);
+    }
 }
 
-TxMessage TxMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+TxMessage TxMessage::deserialize(ByteSpan data, size_t& offset) {
     TxMessage msg;
-    // This would need to use Transaction's deserialize method
-    // For now, return empty message as placeholder
+    msg.transaction = std::make_shared<Transaction>(Transaction::deserialize(data, offset));
     return msg;
 }
 
 // BlockMessage implementation
 std::vector<uint8_t> BlockMessage::serialize() const {
-    // This would need to use Block's serialize method
-    // For now, return empty vector as placeholder
-    return std::vector<uint8_t>();
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
 }
 
-BlockMessage BlockMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void BlockMessage::serializeInto(std::vector<uint8_t>& out) const {
+    if (serialized) {
+        out.insert(out.end(), serialized->begin(), serialized->end());
+    } else if (block) {
+        block->serializeInto(out);
+    }
+}
+
+BlockMessage BlockMessage::deserialize(ByteSpan data, size_t& offset) {
     BlockMessage msg;
-    // This would need to use Block's deserialize method
-    // For now, return empty message as placeholder
+    msg.block = std::make_shared<Block>(Block::deserialize(data, offset));
     return msg;
 }
 
-// GetHeadersMessage implementation
-std::vector<uint8_t> GetHeadersMessage::serialize() const {
+// SendCmpctMessage implementation
+std::vector<uint8_t> SendCmpctMessage::serialize() const {
     std::vector<uint8_t> result;
-    auto versionBytes = Serialize::encodeUint32LE(version);
-    auto countBytes = Serialize::encodeVarInt(locatorHashes.size());
-    auto stopHashBytes = Serialize::encodeString(stopHash);
+    serializeInto(result);
+    return result;
+}
+
+void SendCmpctMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint8LE(out, highBandwidth ? 1 : 0);
+    Serialize::appendUint64LE(out, version);
+}
+
+SendCmpctMessage SendCmpctMessage::deserialize(ByteSpan data, size_t& offset) {
+    SendCmpctMessage msg;
+    msg.highBandwidth = (Serialize::decodeUint8LE(data, offset) != 0);
+    offset += 1;
+    msg.version = Serialize::decodeUint64LE(data, offset);
+    offset += 8;
+    return msg;
+}
+
+// CompactBlockMessage implementation
+std::vector<uint8_t> CompactBlockMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void CompactBlockMessage::serializeInto(std::vector<uint8_t>& out) const {
+    header.serializeInto(out);
+    Serialize::appendUint64LE(out, nonce);
     
-    result.insert(result.end(), versionBytes.begin(), versionBytes.end());
-    result.insert(result.end(), countBytes.begin(), countBytes.end());
+    // Short IDs are 6 bytes each
+    Serialize::appendVarInt(out, shortIds.size());
+    for (uint64_t shortId : shortIds) {
+        Serialize::appendUint32LE(out, static_cast<uint32_t>(shortId));
+        Serialize::appendUint16LE(out, static_cast<uint16_t>(shortId >> 32));
+    }
     
-    for (const auto& hash : locatorHashes) {
-        auto hashBytes = Serialize::encodeString(hash);
-        result.insert(result.end(), hashBytes.begin(), hashBytes.end());
+    // Prefilled indexes are differentially encoded
+    Serialize::appendVarInt(out, prefilled.size());
+    uint32_t nextIndex = 0;
+    for (const auto& entry : prefilled) {
+        Serialize::appendVarInt(out, entry.index - nextIndex);
+        entry.tx.serializeInto(out);
+        nextIndex = entry.index + 1;
+    }
+}
+
+CompactBlockMessage CompactBlockMessage::deserialize(ByteSpan data, size_t& offset) {
+    CompactBlockMessage msg;
+    msg.header = BlockHeader::deserialize(data, offset);
+    msg.nonce = Serialize::decodeUint64LE(data, offset);
+    offset += 8;
+    
+    auto shortIdCount = Serialize::decodeVarInt(data, offset);
+    offset += shortIdCount.second;
+    if (shortIdCount.first > (data.size() - offset) / 6) {
+        throw std::runtime_error("Compact block decode: short ID count exceeds payload");
+    }
+    msg.shortIds.reserve(shortIdCount.first);
+    for (uint64_t i = 0; i < shortIdCount.first; ++i) {
+        uint64_t low = Serialize::decodeUint32LE(data, offset);
+        uint64_t high = Serialize::decodeUint16LE(data, offset + 4);
+        msg.shortIds.push_back(low | (high << 32));
+        offset += 6;
     }
     
-    result.insert(result.end(), stopHashBytes.begin(), stopHashBytes.end());
+    auto prefilledCount = Serialize::decodeVarInt(data, offset);
+    offset += prefilledCount.second;
+    uint64_t nextIndex = 0;
+    for (uint64_t i = 0; i < prefilledCount.first; ++i) {
+        auto delta = Serialize::decodeVarInt(data, offset);
+        offset += delta.second;
+        uint64_t index = nextIndex + delta.first;
+        if (index > UINT32_MAX) {
+            throw std::runtime_error("Compact block decode: prefilled index overflow");
+        }
+        PrefilledTransaction entry;
+        entry.index = static_cast<uint32_t>(index);
+        entry.tx = Transaction::deserialize(data, offset);
+        msg.prefilled.push_back(std::move(entry));
+        nextIndex = index + 1;
+    }
+    return msg;
+}
+
+// GetBlockTxnMessage implementation
+std::vector<uint8_t> GetBlockTxnMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
     return result;
 }
 
-GetHeadersMessage GetHeadersMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void GetBlockTxnMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendString(out, blockHash);
+    Serialize::appendVarInt(out, indexes.size());
+    uint32_t nextIndex = 0;
+    for (uint32_t index : indexes) {
+        Serialize::appendVarInt(out, index - nextIndex);
+        nextIndex = index + 1;
+    }
+}
+
+GetBlockTxnMessage GetBlockTxnMessage::deserialize(ByteSpan data, size_t& offset) {
+    GetBlockTxnMessage msg;
+    auto hashResult = Serialize::decodeString(data, offset);
+    msg.blockHash = hashResult.first;
+    offset += hashResult.second;
+    
+    auto countResult = Serialize::decodeVarInt(data, offset);
+    offset += countResult.second;
+    msg.indexes.reserve(std::min<uint64_t>(countResult.first, data.size() - offset));
+    uint64_t nextIndex = 0;
+    for (uint64_t i = 0; i < countResult.first; ++i) {
+        auto delta = Serialize::decodeVarInt(data, offset);
+        offset += delta.second;
+        uint64_t index = nextIndex + delta.first;
+        if (index > UINT32_MAX) {
+            throw std::runtime_error("GetBlockTxn decode: index overflow");
+        }
+        msg.indexes.push_back(static_cast<uint32_t>(index));
+        nextIndex = index + 1;
+    }
+    return msg;
+}
+
+// BlockTxnMessage implementation
+std::vector<uint8_t> BlockTxnMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void BlockTxnMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendString(out, blockHash);
+    Serialize::appendVarInt(out, transactions.size());
+    for (const auto& tx : transactions) {
+        tx.serializeInto(out);
+    }
+}
+
+BlockTxnMessage BlockTxnMessage::deserialize(ByteSpan data, size_t& offset) {
+    BlockTxnMessage msg;
+    auto hashResult = Serialize::decodeString(data, offset);
+    msg.blockHash = hashResult.first;
+    offset += hashResult.second;
+    
+    auto countResult = Serialize::decodeVarInt(data, offset);
+    offset += countResult.second;
+    msg.transactions.reserve(std::min<uint64_t>(countResult.first, data.size() - offset));
+    for (uint64_t i = 0; i < countResult.first; ++i) {
+        msg.transactions.push_back(Transaction::deserialize(data, offset));
+    }
+    return msg;
+}
+
+// SendTxRcnclMessage implementation
+std::vector<uint8_t> SendTxRcnclMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void SendTxRcnclMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint32LE(out, version);
+    Serialize::appendUint64LE(out, salt);
+}
+
+SendTxRcnclMessage SendTxRcnclMessage::deserialize(ByteSpan data, size_t& offset) {
+    SendTxRcnclMessage msg;
+    msg.version = Serialize::decodeUint32LE(data, offset);
+    offset += 4;
+    msg.salt = Serialize::decodeUint64LE(data, offset);
+    offset += 8;
+    return msg;
+}
+
+// ReqReconMessage implementation
+std::vector<uint8_t> ReqReconMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void ReqReconMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint16LE(out, setSize);
+    Serialize::appendUint16LE(out, q);
+}
+
+ReqReconMessage ReqReconMessage::deserialize(ByteSpan data, size_t& offset) {
+    ReqReconMessage msg;
+    msg.setSize = Serialize::decodeUint16LE(data, offset);
+    offset += 2;
+    msg.q = Serialize::decodeUint16LE(data, offset);
+    offset += 2;
+    return msg;
+}
+
+// SketchMessage implementation
+std::vector<uint8_t> SketchMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void SketchMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendVarInt(out, sketch.size());
+    Serialize::appendBytes(out, sketch.data(), sketch.size());
+}
+
+SketchMessage SketchMessage::deserialize(ByteSpan data, size_t& offset) {
+    SketchMessage msg;
+    auto sizeResult = Serialize::decodeVarInt(data, offset);
+    offset += sizeResult.second;
+    if (sizeResult.first > Protocol::MAX_SKETCH_SIZE || sizeResult.first > data.size() - offset) {
+        throw std::runtime_error("Sketch decode: size exceeds payload");
+    }
+    msg.sketch.assign(data.data() + offset, data.data() + offset + sizeResult.first);
+    offset += sizeResult.first;
+    return msg;
+}
+
+// ReconcilDiffMessage implementation
+std::vector<uint8_t> ReconcilDiffMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void ReconcilDiffMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint8LE(out, success ? 1 : 0);
+    Serialize::appendVarInt(out, askShortIds.size());
+    for (uint32_t shortId : askShortIds) {
+        Serialize::appendUint32LE(out, shortId);
+    }
+}
+
+ReconcilDiffMessage ReconcilDiffMessage::deserialize(ByteSpan data, size_t& offset) {
+    ReconcilDiffMessage msg;
+    msg.success = (Serialize::decodeUint8LE(data, offset) != 0);
+    offset += 1;
+    
+    auto countResult = Serialize::decodeVarInt(data, offset);
+    offset += countResult.second;
+    if (countResult.first > (data.size() - offset) / 4) {
+        throw std::runtime_error("ReconcilDiff decode: count exceeds payload");
+    }
+    msg.askShortIds.reserve(countResult.first);
+    for (uint64_t i = 0; i < countResult.first; ++i) {
+        msg.askShortIds.push_back(Serialize::decodeUint32LE(data, offset));
+        offset += 4;
+    }
+    return msg;
+}
+
+// GetHeadersMessage implementation
+std::vector<uint8_t> GetHeadersMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void GetHeadersMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint32LE(out, version);
+    Serialize::appendVarInt(out, locatorHashes.size());
+    for (const auto& hash : locatorHashes) {
+        Serialize::appendString(out, hash);
+    }
+    Serialize::appendString(out, stopHash);
+}
+
+GetHeadersMessage GetHeadersMessage::deserialize(ByteSpan data, size_t& offset) {
     GetHeadersMessage msg;
     msg.version = Serialize::decodeUint32LE(data, offset);
     offset += 4;
@@ -244,7 +548,7 @@ GetHeadersMessage GetHeadersMessage::deserialize(const std::vector<uint8_t>& dat
     uint64_t count = countResult.first;
     offset += countResult.second;
     
-    msg.locatorHashes.reserve(count);
+    msg.locatorHashes.reserve(std::min<uint64_t>(count, data.size()));
     for (uint64_t i = 0; i < count; ++i) {
         auto hashResult = Serialize::decodeString(data, offset);
         msg.locatorHashes.push_back(hashResult.first);
@@ -261,22 +565,166 @@ GetHeadersMessage GetHeadersMessage::deserialize(const std::vector<uint8_t>& dat
 // HeadersMessage implementation
 std::vector<uint8_t> HeadersMessage::serialize() const {
     std::vector<uint8_t> result;
-    auto countBytes = Serialize::encodeVarInt(headers.size());
-    result.insert(result.end(), countBytes.begin(), countBytes.end());
-    
-    // This would need to serialize block headers
-    // For now, return basic structure
+    serializeInto(result);
     return result;
 }
 
-HeadersMessage HeadersMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+namespace {
+
+// Per-header flags of the compressed headers encoding
+constexpr uint8_t HEADER_VERSION_SAME = 0x01;   // Version repeats the previous header's
+constexpr uint8_t HEADER_PREV_IMPLIED = 0x02;   // prevHash is the previous header's hash
+constexpr uint8_t HEADER_BITS_SAME = 0x04;      // Difficulty bits repeat the previous header's
+constexpr uint8_t HEADER_TIME_DELTA = 0x08;     // Timestamp is an int16 delta from the previous
+constexpr uint8_t HEADER_STRING_HASHES = 0x10;  // Hashes are not canonical hex, sent as strings
+constexpr uint8_t HEADER_KNOWN_FLAGS = 0x1F;
+
+constexpr size_t RAW_HASH_SIZE = 32;
+
+// Lowercase 64-digit hex round-trips through 32 raw bytes unchanged
+bool isCanonicalHash(const std::string& hash) {
+    if (hash.size() != RAW_HASH_SIZE * 2) {
+        return false;
+    }
+    for (char c : hash) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t hexNibble(char c) {
+    return static_cast<uint8_t>(c <= '9' ? c - '0' : c - 'a' + 10);
+}
+
+void appendHeaderHash(std::vector<uint8_t>& out, const std::string& hash, bool asString) {
+    if (asString) {
+        Serialize::appendString(out, hash);
+        return;
+    }
+    for (size_t i = 0; i < RAW_HASH_SIZE; ++i) {
+        out.push_back(static_cast<uint8_t>((hexNibble(hash[2 * i]) << 4) | hexNibble(hash[2 * i + 1])));
+    }
+}
+
+std::string decodeHeaderHash(ByteSpan data, size_t& offset, bool asString) {
+    if (asString) {
+        auto result = Serialize::decodeString(data, offset);
+        offset += result.second;
+        return result.first;
+    }
+    if (offset + RAW_HASH_SIZE > data.size()) {
+        throw std::runtime_error("Headers decode: insufficient data for hash");
+    }
+    static const char digits[] = "0123456789abcdef";
+    std::string hash(RAW_HASH_SIZE * 2, '0');
+    for (size_t i = 0; i < RAW_HASH_SIZE; ++i) {
+        uint8_t byte = data[offset + i];
+        hash[2 * i] = digits[byte >> 4];
+        hash[2 * i + 1] = digits[byte & 0x0F];
+    }
+    offset += RAW_HASH_SIZE;
+    return hash;
+}
+
+} // namespace
+
+// Headers are delta-encoded against the previous entry: in a contiguous run
+// the prevHash, version and bits are implied and the timestamp is a small
+// delta, leaving a flags byte, the merkle root and the nonce
+void HeadersMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendVarInt(out, headers.size());
+    out.reserve(out.size() + headers.size() * (RAW_HASH_SIZE + 8));
+
+    const Block* previous = nullptr;
+    for (const auto& block : headers) {
+        const BlockHeader& header = block->header;
+        uint8_t flags = 0;
+        int64_t timeDelta = 0;
+        if (previous) {
+            const BlockHeader& last = previous->header;
+            if (header.version == last.version) flags |= HEADER_VERSION_SAME;
+            if (!previous->hash.empty() && header.prevHash == previous->hash) flags |= HEADER_PREV_IMPLIED;
+            if (header.bits == last.bits) flags |= HEADER_BITS_SAME;
+            timeDelta = static_cast<int64_t>(header.timestamp - last.timestamp);
+            if (timeDelta >= INT16_MIN && timeDelta <= INT16_MAX) flags |= HEADER_TIME_DELTA;
+        }
+        if (!isCanonicalHash(header.merkleRoot) ||
+            (!(flags & HEADER_PREV_IMPLIED) && !isCanonicalHash(header.prevHash))) {
+            flags |= HEADER_STRING_HASHES;
+        }
+
+        Serialize::appendUint8LE(out, flags);
+        if (!(flags & HEADER_VERSION_SAME)) {
+            Serialize::appendUint32LE(out, header.version);
+        }
+        if (!(flags & HEADER_PREV_IMPLIED)) {
+            appendHeaderHash(out, header.prevHash, flags & HEADER_STRING_HASHES);
+        }
+        appendHeaderHash(out, header.merkleRoot, flags & HEADER_STRING_HASHES);
+        if (flags & HEADER_TIME_DELTA) {
+            Serialize::appendUint16LE(out, static_cast<uint16_t>(static_cast<int16_t>(timeDelta)));
+        } else {
+            Serialize::appendUint64LE(out, header.timestamp);
+        }
+        if (!(flags & HEADER_BITS_SAME)) {
+            Serialize::appendUint32LE(out, header.bits);
+        }
+        Serialize::appendUint32LE(out, header.nonce);
+        previous = block.get();
+    }
+}
+
+HeadersMessage HeadersMessage::deserialize(ByteSpan data, size_t& offset) {
     HeadersMessage msg;
     auto countResult = Serialize::decodeVarInt(data, offset);
     uint64_t count = countResult.first;
     offset += countResult.second;
+    if (count > Protocol::MAX_HEADERS) {
+        throw std::runtime_error("Headers decode: too many headers");
+    }
     
-    // This would need to deserialize block headers
-    // For now, return empty message
+    msg.headers.reserve(std::min<uint64_t>(count, data.size()));
+    const Block* previous = nullptr;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint8_t flags = Serialize::decodeUint8LE(data, offset);
+        offset += 1;
+        if ((flags & ~HEADER_KNOWN_FLAGS) ||
+            (!previous && (flags & (HEADER_VERSION_SAME | HEADER_PREV_IMPLIED | HEADER_BITS_SAME | HEADER_TIME_DELTA)))) {
+            throw std::runtime_error("Headers decode: invalid header flags");
+        }
+        bool asString = flags & HEADER_STRING_HASHES;
+
+        BlockHeader header;
+        if (flags & HEADER_VERSION_SAME) {
+            header.version = previous->header.version;
+        } else {
+            header.version = Serialize::decodeUint32LE(data, offset);
+            offset += 4;
+        }
+        header.prevHash = (flags & HEADER_PREV_IMPLIED) ? previous->hash : decodeHeaderHash(data, offset, asString);
+        header.merkleRoot = decodeHeaderHash(data, offset, asString);
+        if (flags & HEADER_TIME_DELTA) {
+            auto delta = static_cast<int16_t>(Serialize::decodeUint16LE(data, offset));
+            header.timestamp = previous->header.timestamp + static_cast<int64_t>(delta);
+            offset += 2;
+        } else {
+            header.timestamp = Serialize::decodeUint64LE(data, offset);
+            offset += 8;
+        }
+        if (flags & HEADER_BITS_SAME) {
+            header.bits = previous->header.bits;
+        } else {
+            header.bits = Serialize::decodeUint32LE(data, offset);
+            offset += 4;
+        }
+        header.nonce = Serialize::decodeUint32LE(data, offset);
+        offset += 4;
+
+        msg.headers.push_back(std::make_shared<Block>(header, std::vector<Transaction>()));
+        previous = msg.headers.back().get();
+    }
     return msg;
 }
 
@@ -285,7 +733,11 @@ std::vector<uint8_t> PingMessage::serialize() const {
     return Serialize::encodeUint64LE(nonce);
 }
 
-PingMessage PingMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void PingMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint64LE(out, nonce);
+}
+
+PingMessage PingMessage::deserialize(ByteSpan data, size_t& offset) {
     PingMessage msg;
     msg.nonce = Serialize::decodeUint64LE(data, offset);
     offset += 8;
@@ -297,33 +749,164 @@ std::vector<uint8_t> PongMessage::serialize() const {
     return Serialize::encodeUint64LE(nonce);
 }
 
-PongMessage PongMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void PongMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint64LE(out, nonce);
+}
+
+PongMessage PongMessage::deserialize(ByteSpan data, size_t& offset) {
     PongMessage msg;
     msg.nonce = Serialize::decodeUint64LE(data, offset);
     offset += 8;
     return msg;
 }
 
+// GetCFiltersMessage implementation
+std::vector<uint8_t> GetCFiltersMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void GetCFiltersMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint8LE(out, filterType);
+    Serialize::appendUint32LE(out, startHeight);
+    Serialize::appendString(out, stopHash);
+}
+
+GetCFiltersMessage GetCFiltersMessage::deserialize(ByteSpan data, size_t& offset) {
+    GetCFiltersMessage msg;
+    msg.filterType = Serialize::decodeUint8LE(data, offset);
+    offset += 1;
+    msg.startHeight = Serialize::decodeUint32LE(data, offset);
+    offset += 4;
+    auto stopHashResult = Serialize::decodeString(data, offset);
+    msg.stopHash = stopHashResult.first;
+    offset += stopHashResult.second;
+    return msg;
+}
+
+// CFilterMessage implementation
+std::vector<uint8_t> CFilterMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void CFilterMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint8LE(out, filterType);
+    Serialize::appendString(out, blockHash);
+    Serialize::appendVarInt(out, filter.size());
+    out.insert(out.end(), filter.begin(), filter.end());
+}
+
+CFilterMessage CFilterMessage::deserialize(ByteSpan data, size_t& offset) {
+    CFilterMessage msg;
+    msg.filterType = Serialize::decodeUint8LE(data, offset);
+    offset += 1;
+    auto hashResult = Serialize::decodeString(data, offset);
+    msg.blockHash = hashResult.first;
+    offset += hashResult.second;
+    
+    auto sizeResult = Serialize::decodeVarInt(data, offset);
+    offset += sizeResult.second;
+    if (sizeResult.first > data.size() - offset) {
+        throw std::runtime_error("CFilter decode: insufficient data");
+    }
+    msg.filter.assign(data.begin() + offset, data.begin() + offset + sizeResult.first);
+    offset += sizeResult.first;
+    return msg;
+}
+
+// GetCFHeadersMessage implementation
+std::vector<uint8_t> GetCFHeadersMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void GetCFHeadersMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint8LE(out, filterType);
+    Serialize::appendUint32LE(out, startHeight);
+    Serialize::appendString(out, stopHash);
+}
+
+GetCFHeadersMessage GetCFHeadersMessage::deserialize(ByteSpan data, size_t& offset) {
+    GetCFHeadersMessage msg;
+    msg.filterType = Serialize::decodeUint8LE(data, offset);
+    offset += 1;
+    msg.startHeight = Serialize::decodeUint32LE(data, offset);
+    offset += 4;
+    auto stopHashResult = Serialize::decodeString(data, offset);
+    msg.stopHash = stopHashResult.first;
+    offset += stopHashResult.second;
+    return msg;
+}
+
+// CFHeadersMessage implementation
+std::vector<uint8_t> CFHeadersMessage::serialize() const {
+    std::vector<uint8_t> result;
+    serializeInto(result);
+    return result;
+}
+
+void CFHeadersMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendUint8LE(out, filterType);
+    Serialize::appendString(out, stopHash);
+    Serialize::appendString(out, prevFilterHeader);
+    Serialize::appendVarInt(out, filterHashes.size());
+    for (const auto& hash : filterHashes) {
+        Serialize::appendString(out, hash);
+    }
+}
+
+CFHeadersMessage CFHeadersMessage::deserialize(ByteSpan data, size_t& offset) {
+    CFHeadersMessage msg;
+    msg.filterType = Serialize::decodeUint8LE(data, offset);
+    offset += 1;
+    auto stopHashResult = Serialize::decodeString(data, offset);
+    msg.stopHash = stopHashResult.first;
+    offset += stopHashResult.second;
+    auto prevResult = Serialize::decodeString(data, offset);
+    msg.prevFilterHeader = prevResult.first;
+    offset += prevResult.second;
+    
+    auto countResult = Serialize::decodeVarInt(data, offset);
+    uint64_t count = countResult.first;
+    offset += countResult.second;
+    if (count > Protocol::MAX_GETCFHEADERS_SIZE) {
+        throw std::runtime_error("CFHeaders decode: too many filter hashes");
+    }
+    
+    msg.filterHashes.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        auto hashResult = Serialize::decodeString(data, offset);
+        msg.filterHashes.push_back(hashResult.first);
+        offset += hashResult.second;
+    }
+    return msg;
+}
+
 // AddrMessage implementation
 std::vector<uint8_t> AddrMessage::serialize() const {
     std::vector<uint8_t> result;
-    auto countBytes = Serialize::encodeVarInt(addresses.size());
-    result.insert(result.end(), countBytes.begin(), countBytes.end());
-    
+    serializeInto(result);
+    return result;
+}
+
+void AddrMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendVarInt(out, addresses.size());
     for (const auto& addr : addresses) {
-        auto addrBytes = addr.serialize();
-        result.insert(result.end(), addrBytes.begin(), addrBytes.end());
+        addr.serializeInto(out);
     }
-    return result;
 }
 
-AddrMessage AddrMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+AddrMessage AddrMessage::deserialize(ByteSpan data, size_t& offset) {
     AddrMessage msg;
     auto countResult = Serialize::decodeVarInt(data, offset);
     uint64_t count = countResult.first;
     offset += countResult.second;
     
-    msg.addresses.reserve(count);
+    msg.addresses.reserve(std::min<uint64_t>(count, data.size() / 19));
     for (uint64_t i = 0; i < count; ++i) {
         msg.addresses.push_back(NetworkAddress::deserialize(data, offset));
     }
@@ -333,128 +916,150 @@ AddrMessage AddrMessage::deserialize(const std::vector<uint8_t>& data, size_t& o
 // RejectMessage implementation
 std::vector<uint8_t> RejectMessage::serialize() const {
     std::vector<uint8_t> result;
-    auto messageBytes = Serialize::encodeString(message);
-    auto codeBytes = Serialize::encodeUint8LE(code);
-    auto reasonBytes = Serialize::encodeString(reason);
-    auto dataBytes = Serialize::encodeBytes(data);
-    
-    result.insert(result.end(), messageBytes.begin(), messageBytes.end());
-    result.insert(result.end(), codeBytes.begin(), codeBytes.end());
-    result.insert(result.end(), reasonBytes.begin(), reasonBytes.end());
-    result.insert(result.end(), dataBytes.begin(), dataBytes.end());
+    serializeInto(result);
     return result;
 }
 
-RejectMessage RejectMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+void RejectMessage::serializeInto(std::vector<uint8_t>& out) const {
+    Serialize::appendString(out, message);
+    Serialize::appendUint8LE(out, code);
+    Serialize::appendString(out, reason);
+    Serialize::appendBytes(out, data.data(), data.size());
+}
+
+RejectMessage RejectMessage::deserialize(ByteSpan data, size_t& offset) {
     RejectMessage msg;
     auto messageResult = Serialize::decodeString(data, offset);
     msg.message = messageResult.first;
     offset += messageResult.second;
     
-    // For simplicity, assuming encodeUint8LE exists or using a single byte
-    msg.code = data[offset];
+    msg.code = Serialize::decodeUint8LE(data, offset);
     offset += 1;
     
     auto reasonResult = Serialize::decodeString(data, offset);
     msg.reason = reasonResult.first;
     offset += reasonResult.second;
     
-    // For simplicity, reading remaining data
+    // Remaining bytes are the rejected object's data
     msg.data.assign(data.begin() + offset, data.end());
+    offset = data.size();
     
     return msg;
 }
 
 // P2PMessage implementation
 std::vector<uint8_t> P2PMessage::serialize() const {
-    std::vector<uint8_t> payload;
+    std::vector<uint8_t> result;
+    encodeInto(result);
+    return result;
+}
+
+void P2PMessage::encodeInto(std::vector<uint8_t>& out, ChecksumType checksumType, bool compress) const {
+    // Reserve the header slot; length and checksum are patched once the payload is in place
+    size_t headerOffset = out.size();
+    MessageHeader updatedHeader = header;
+    updatedHeader.length = 0;
+    updatedHeader.checksum = 0;
+    updatedHeader.checksumType = checksumType;
+    updatedHeader.compressed = false;
+    updatedHeader.serializeInto(out);
+    size_t payloadOffset = out.size();
     
-    switch (header.command) {
-        case MessageType::VERSION:
-            if (auto* version = std::get_if<VersionMessage>(&data)) {
-                payload = version->serialize();
-            }
-            break;
-        case MessageType::VERACK:
-            // Empty payload
-            break;
-        case MessageType::INV:
-            if (auto* inv = std::get_if<InvMessage>(&data)) {
-                payload = inv->serialize();
-            }
-            break;
-        case MessageType::GETDATA:
-            if (auto* getdata = std::get_if<GetDataMessage>(&data)) {
-                payload = getdata->serialize();
-            }
-            break;
-        case MessageType::TX:
-            if (auto* tx = std::get_if<TxMessage>(&data)) {
-                payload = tx->serialize();
-            }
-            break;
-        case MessageType::BLOCK:
-            if (auto* block = std::get_if<BlockMessage>(&data)) {
-                payload = block->serialize();
-            }
-            break;
-        case MessageType::GETHEADERS:
-            if (auto* getheaders = std::get_if<GetHeadersMessage>(&data)) {
-                payload = getheaders->serialize();
-            }
-            break;
-        case MessageType::HEADERS:
-            if (auto* headers = std::get_if<HeadersMessage>(&data)) {
-                payload = headers->serialize();
-            }
-            break;
-        case MessageType::PING:
-            if (auto* ping = std::get_if<PingMessage>(&data)) {
-                payload = ping->serialize();
-            }
-            break;
-        case MessageType::PONG:
-            if (auto* pong = std::get_if<PongMessage>(&data)) {
-                payload = pong->serialize();
-            }
-            break;
-        case MessageType::ADDR:
-            if (auto* addr = std::get_if<AddrMessage>(&data)) {
-                payload = addr->serialize();
-            }
-            break;
-        case MessageType::REJECT:
-            if (auto* reject = std::get_if<RejectMessage>(&data)) {
-                payload = reject->serialize();
-            }
-            break;
+    std::visit([&out](const auto& payload) {
+        using PayloadType = std::decay_t<decltype(payload)>;
+        if constexpr (!std::is_same_v<PayloadType, std::monostate>) {
+            payload.serializeInto(out);
+        }
+    }, data);
+    
+    // Compressed payload: varint original size, then the LZ4 block. Kept
+    // only if it actually saves bytes
+    size_t payloadSize = out.size() - payloadOffset;
+    if (compress && payloadSize >= Protocol::MIN_COMPRESS_SIZE && isCompressible(header.command)) {
+        std::vector<uint8_t> compressed;
+        Serialize::appendVarInt(compressed, payloadSize);
+        LZ4::compress(out.data() + payloadOffset, payloadSize, compressed);
+        if (compressed.size() < payloadSize) {
+            out.resize(payloadOffset);
+            out.insert(out.end(), compressed.begin(), compressed.end());
+            payloadSize = compressed.size();
+            uint32_t commandField = static_cast<uint32_t>(header.command) | Protocol::COMPRESSED_COMMAND_FLAG |
+                (checksumType == ChecksumType::CRC32C ? Protocol::CRC32C_COMMAND_FLAG : 0);
+            std::memcpy(out.data() + headerOffset + 4, &commandField, 4);
+        }
     }
     
-    // Update header with payload info
-    MessageHeader updatedHeader = header;
-    updatedHeader.length = static_cast<uint32_t>(payload.size());
-    updatedHeader.checksum = Utils::calculateChecksum(payload);
+    uint32_t length = static_cast<uint32_t>(payloadSize);
+    uint32_t checksum = Checksum::compute(checksumType, out.data() + payloadOffset, payloadSize);
+    std::memcpy(out.data() + headerOffset + 8, &length, 4);
+    std::memcpy(out.data() + headerOffset + 12, &checksum, 4);
+}
+
+std::shared_ptr<const MessageBuffer> P2PMessage::getWireBuffer(ChecksumType checksumType, bool compress) const {
+    // Small or incompressible messages encode the same either way
+    compress = compress && isCompressible(header.command);
+    auto& slot = wireBuffers[static_cast<size_t>(checksumType) * 2 + (compress ? 1 : 0)];
+    auto cached = std::atomic_load(&slot);
+    if (cached) {
+        return cached;
+    }
     
-    auto headerBytes = updatedHeader.serialize();
-    headerBytes.insert(headerBytes.end(), payload.begin(), payload.end());
+    auto buffer = BufferPool::instance().acquire(Protocol::HEADER_SIZE + 256);
+    encodeInto(buffer->bytes, checksumType, compress);
+    std::shared_ptr<const MessageBuffer> encoded = buffer;
     
-    return headerBytes;
+    // Concurrent callers may both encode; either result is identical
+    std::atomic_store(&slot, encoded);
+    return encoded;
+}
+
+bool P2PMessage::isCompressible(MessageType type) {
+    switch (type) {
+        case MessageType::BLOCK:
+        case MessageType::HEADERS:
+        case MessageType::TX:
+        case MessageType::INV:
+        case MessageType::GETDATA:
+        case MessageType::ADDR:
+        case MessageType::CMPCTBLOCK:
+        case MessageType::BLOCKTXN:
+        case MessageType::CFHEADERS:
+            return true;
+        default:
+            return false;
+    }
 }
 
-P2PMessage P2PMessage::deserialize(const std::vector<uint8_t>& data, size_t& offset) {
+P2PMessage P2PMessage::deserialize(ByteSpan data, size_t& offset) {
     P2PMessage msg;
     msg.header = MessageHeader::deserialize(data, offset);
     
-    // Extract payload
-    std::vector<uint8_t> payload(data.begin() + offset, data.begin() + offset + msg.header.length);
+    if (msg.header.length > data.size() - offset) {
+        throw std::runtime_error("Message decode: payload exceeds available data");
+    }
+    
+    // View the payload in place instead of copying it out of the frame;
+    // compressed payloads are expanded into a scratch buffer first
+    ByteSpan payload = data.subspan(offset, msg.header.length);
     size_t payloadOffset = 0;
+    std::vector<uint8_t> expanded;
+    if (msg.header.compressed) {
+        auto sizeResult = Serialize::decodeVarInt(payload, 0);
+        // LZ4 expands at most ~255x, so a larger claim is bogus; checked before allocating
+        if (sizeResult.first > Protocol::MAX_MESSAGE_SIZE || sizeResult.first / 255 > payload.size() ||
+            !LZ4::decompress(payload.data() + sizeResult.second, payload.size() - sizeResult.second,
+                             sizeResult.first, expanded)) {
+            throw std::runtime_error("Message decode: invalid compressed payload");
+        }
+        payload = ByteSpan(expanded);
+    }
     
     switch (msg.header.command) {
         case MessageType::VERSION:
             msg.data = VersionMessage::deserialize(payload, payloadOffset);
             break;
         case MessageType::VERACK:
-            // Empty payload
+            msg.data = std::monostate{};
             break;
         case MessageType::INV:
             msg.data = InvMessage::deserialize(payload, payloadOffset);
@@ -462,6 +1067,9 @@ P2PMessage P2PMessage::deserialize(const std::vector<uint8_t>& data, size_t& off
         case MessageType::GETDATA:
             msg.data = GetDataMessage::deserialize(payload, payloadOffset);
             break;
+        case MessageType::NOTFOUND:
+            msg.data = NotFoundMessage::deserialize(payload, payloadOffset);
+            break;
         case MessageType::TX:
             msg.data = TxMessage::deserialize(payload, payloadOffset);
             break;
@@ -486,6 +1094,46 @@ P2PMessage P2PMessage::deserialize(const std::vector<uint8_t>& data, size_t& off
         case MessageType::REJECT:
             msg.data = RejectMessage::deserialize(payload, payloadOffset);
             break;
+        case MessageType::SENDCMPCT:
+            msg.data = SendCmpctMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::CMPCTBLOCK:
+            msg.data = CompactBlockMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::GETBLOCKTXN:
+            msg.data = GetBlockTxnMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::BLOCKTXN:
+            msg.data = BlockTxnMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::SENDTXRCNCL:
+            msg.data = SendTxRcnclMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::REQRECON:
+            msg.data = ReqReconMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::SKETCH:
+            msg.data = SketchMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::RECONCILDIFF:
+            msg.data = ReconcilDiffMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::GETCFILTERS:
+            msg.data = GetCFiltersMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::CFILTER:
+            msg.data = CFilterMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::GETCFHEADERS:
+            msg.data = GetCFHeadersMessage::deserialize(payload, payloadOffset);
+            break;
+        case MessageType::CFHEADERS:
+            msg.data = CFHeadersMessage::deserialize(payload, payloadOffset);
+            break;
+        default:
+            // Payload-less or unknown commands carry no decoded body
+            msg.data = std::monostate{};
+            break;
     }
     
     offset += msg.header.length;
@@ -538,6 +1186,18 @@ std::shared_ptr<P2PMessage> P2PMessage::createGetData(const std::vector<Inventor
     return message;
 }
 
+std::shared_ptr<P2PMessage> P2PMessage::createNotFound(const std::vector<InventoryVector>& inv) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::NOTFOUND;
+    
+    NotFoundMessage notFoundMsg;
+    notFoundMsg.inventory = inv;
+    message->data = notFoundMsg;
+    
+    return message;
+}
+
 std::shared_ptr<P2PMessage> P2PMessage::createTx(std::shared_ptr<Transaction> tx) {
     auto message = std::make_shared<P2PMessage>();
     message->header.magic = Protocol::MAGIC_BYTES;
@@ -562,6 +1222,13 @@ std::shared_ptr<P2PMessage> P2PMessage::createBlock(std::shared_ptr<Block> block
     return message;
 }
 
+std::shared_ptr<P2PMessage> P2PMessage::createBlock(std::shared_ptr<Block> block,
+                                                    std::shared_ptr<const std::vector<uint8_t>> serialized) {
+    auto message = createBlock(std::move(block));
+    std::get<BlockMessage>(message->data).serialized = std::move(serialized);
+    return message;
+}
+
 std::shared_ptr<P2PMessage> P2PMessage::createGetHeaders(const GetHeadersMessage& getHeaders) {
     auto message = std::make_shared<P2PMessage>();
     message->header.magic = Protocol::MAGIC_BYTES;
@@ -626,6 +1293,102 @@ std::shared_ptr<P2PMessage> P2PMessage::createReject(const RejectMessage& reject
     return message;
 }
 
+std::shared_ptr<P2PMessage> P2PMessage::createSendCmpct(bool highBandwidth) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::SENDCMPCT;
+    message->data = SendCmpctMessage(highBandwidth);
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createCompactBlock(const CompactBlockMessage& compactBlock) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::CMPCTBLOCK;
+    message->data = compactBlock;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createGetBlockTxn(const GetBlockTxnMessage& getBlockTxn) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::GETBLOCKTXN;
+    message->data = getBlockTxn;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createBlockTxn(const BlockTxnMessage& blockTxn) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::BLOCKTXN;
+    message->data = blockTxn;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createSendTxRcncl(uint64_t salt) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::SENDTXRCNCL;
+    message->data = SendTxRcnclMessage(1, salt);
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createReqRecon(const ReqReconMessage& reqRecon) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::REQRECON;
+    message->data = reqRecon;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createSketch(const SketchMessage& sketch) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::SKETCH;
+    message->data = sketch;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createReconcilDiff(const ReconcilDiffMessage& reconcilDiff) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::RECONCILDIFF;
+    message->data = reconcilDiff;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createGetCFilters(const GetCFiltersMessage& getCFilters) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::GETCFILTERS;
+    message->data = getCFilters;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createCFilter(const CFilterMessage& cfilter) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::CFILTER;
+    message->data = cfilter;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createGetCFHeaders(const GetCFHeadersMessage& getCFHeaders) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::GETCFHEADERS;
+    message->data = getCFHeaders;
+    return message;
+}
+
+std::shared_ptr<P2PMessage> P2PMessage::createCFHeaders(const CFHeadersMessage& cfheaders) {
+    auto message = std::make_shared<P2PMessage>();
+    message->header.magic = Protocol::MAGIC_BYTES;
+    message->header.command = MessageType::CFHEADERS;
+    message->data = cfheaders;
+    return message;
+}
+
 // Message type checking methods
 bool P2PMessage::isVersion() const {
     return header.command == MessageType::VERSION;
@@ -643,6 +1406,10 @@ bool P2PMessage::isGetData() const {
     return header.command == MessageType::GETDATA;
 }
 
+bool P2PMessage::isNotFound() const {
+    return header.command == MessageType::NOTFOUND;
+}
+
 bool P2PMessage::isTx() const {
     return header.command == MessageType::TX;
 }
@@ -675,6 +1442,54 @@ bool P2PMessage::isReject() const {
     return header.command == MessageType::REJECT;
 }
 
+bool P2PMessage::isSendCmpct() const {
+    return header.command == MessageType::SENDCMPCT;
+}
+
+bool P2PMessage::isCompactBlock() const {
+    return header.command == MessageType::CMPCTBLOCK;
+}
+
+bool P2PMessage::isGetBlockTxn() const {
+    return header.command == MessageType::GETBLOCKTXN;
+}
+
+bool P2PMessage::isBlockTxn() const {
+    return header.command == MessageType::BLOCKTXN;
+}
+
+bool P2PMessage::isSendTxRcncl() const {
+    return header.command == MessageType::SENDTXRCNCL;
+}
+
+bool P2PMessage::isReqRecon() const {
+    return header.command == MessageType::REQRECON;
+}
+
+bool P2PMessage::isSketch() const {
+    return header.command == MessageType::SKETCH;
+}
+
+bool P2PMessage::isReconcilDiff() const {
+    return header.command == MessageType::RECONCILDIFF;
+}
+
+bool P2PMessage::isGetCFilters() const {
+    return header.command == MessageType::GETCFILTERS;
+}
+
+bool P2PMessage::isCFilter() const {
+    return header.command == MessageType::CFILTER;
+}
+
+bool P2PMessage::isGetCFHeaders() const {
+    return header.command == MessageType::GETCFHEADERS;
+}
+
+bool P2PMessage::isCFHeaders() const {
+    return header.command == MessageType::CFHEADERS;
+}
+
 // Payload extraction methods
 const VersionMessage* P2PMessage::getVersion() const {
     return std::get_if<VersionMessage>(&data);
@@ -688,6 +1503,10 @@ const GetDataMessage* P2PMessage::getGetData() const {
     return std::get_if<GetDataMessage>(&data);
 }
 
+const NotFoundMessage* P2PMessage::getNotFound() const {
+    return std::get_if<NotFoundMessage>(&data);
+}
+
 const TxMessage* P2PMessage::getTx() const {
     return std::get_if<TxMessage>(&data);
 }
@@ -720,4 +1539,52 @@ const RejectMessage* P2PMessage::getReject() const {
     return std::get_if<RejectMessage>(&data);
 }
 
+const SendCmpctMessage* P2PMessage::getSendCmpct() const {
+    return std::get_if<SendCmpctMessage>(&data);
+}
+
+const CompactBlockMessage* P2PMessage::getCompactBlock() const {
+    return std::get_if<CompactBlockMessage>(&data);
+}
+
+const GetBlockTxnMessage* P2PMessage::getGetBlockTxn() const {
+    return std::get_if<GetBlockTxnMessage>(&data);
+}
+
+const BlockTxnMessage* P2PMessage::getBlockTxn() const {
+    return std::get_if<BlockTxnMessage>(&data);
+}
+
+const SendTxRcnclMessage* P2PMessage::getSendTxRcncl() const {
+    return std::get_if<SendTxRcnclMessage>(&data);
+}
+
+const ReqReconMessage* P2PMessage::getReqRecon() const {
+    return std::get_if<ReqReconMessage>(&data);
+}
+
+const SketchMessage* P2PMessage::getSketch() const {
+    return std::get_if<SketchMessage>(&data);
+}
+
+const ReconcilDiffMessage* P2PMessage::getReconcilDiff() const {
+    return std::get_if<ReconcilDiffMessage>(&data);
+}
+
+const GetCFiltersMessage* P2PMessage::getGetCFilters() const {
+    return std::get_if<GetCFiltersMessage>(&data);
+}
+
+const CFilterMessage* P2PMessage::getCFilter() const {
+    return std::get_if<CFilterMessage>(&data);
+}
+
+const GetCFHeadersMessage* P2PMessage::getGetCFHeaders() const {
+    return std::get_if<GetCFHeadersMessage>(&data);
+}
+
+const CFHeadersMessage* P2PMessage::getCFHeaders() const {
+    return std::get_if<CFHeadersMessage>(&data);
+}
+
 } // namespace pragma
@@ -5,12 +5,16 @@
 #include <cstdint>
 #include <variant>
 #include <memory>
+#include "../primitives/serialize.h"
+#include "../primitives/checksum.h"
+#include "../core/block.h"
 
 namespace pragma {
 
 // Forward declarations
 struct Transaction;
 struct Block;
+struct MessageBuffer;
 
 /**
  * P2P Message types
@@ -31,7 +35,19 @@ enum class MessageType : uint32_t {
     GETADDR = 13,
     REJECT = 14,
     MEMPOOL = 15,
-    NOTFOUND = 16
+    NOTFOUND = 16,
+    SENDCMPCT = 17,
+    CMPCTBLOCK = 18,
+    GETBLOCKTXN = 19,
+    BLOCKTXN = 20,
+    SENDTXRCNCL = 21,
+    REQRECON = 22,
+    SKETCH = 23,
+    RECONCILDIFF = 24,
+    GETCFILTERS = 25,
+    CFILTER = 26,
+    GETCFHEADERS = 27,
+    CFHEADERS = 28
 };
 
 /**
@@ -56,7 +72,8 @@ struct InventoryVector {
     InventoryVector(InventoryType t, const std::string& h) : type(t), hash(h) {}
     
     std::vector<uint8_t> serialize() const;
-    static InventoryVector deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static InventoryVector deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -73,7 +90,8 @@ struct NetworkAddress {
         : services(serv), ip(addr), port(p), timestamp(0) {}
     
     std::vector<uint8_t> serialize() const;
-    static NetworkAddress deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static NetworkAddress deserialize(ByteSpan data, size_t& offset);
     std::string toString() const;
 };
 
@@ -85,13 +103,16 @@ struct MessageHeader {
     MessageType command;
     uint32_t length;
     uint32_t checksum;
+    ChecksumType checksumType = ChecksumType::DOUBLE_SHA256; // Carried in the command's flag bit
+    bool compressed = false;                                  // Payload is LZ4-compressed (flag bit)
     
     MessageHeader() = default;
     MessageHeader(uint32_t m, MessageType cmd, uint32_t len = 0, uint32_t cs = 0)
         : magic(m), command(cmd), length(len), checksum(cs) {}
     
     std::vector<uint8_t> serialize() const;
-    static MessageHeader deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static MessageHeader deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -111,7 +132,8 @@ struct VersionMessage {
     VersionMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static VersionMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static VersionMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -124,7 +146,8 @@ struct PingMessage {
     PingMessage(uint64_t n) : nonce(n) {}
     
     std::vector<uint8_t> serialize() const;
-    static PingMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static PingMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 struct PongMessage {
@@ -134,7 +157,8 @@ struct PongMessage {
     PongMessage(uint64_t n) : nonce(n) {}
     
     std::vector<uint8_t> serialize() const;
-    static PongMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static PongMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -146,7 +170,8 @@ struct InvMessage {
     InvMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static InvMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static InvMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -158,7 +183,21 @@ struct GetDataMessage {
     GetDataMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static GetDataMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static GetDataMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * NotFound message - the items of a getdata the peer cannot serve
+ */
+struct NotFoundMessage {
+    std::vector<InventoryVector> inventory;
+    
+    NotFoundMessage() = default;
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static NotFoundMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -170,7 +209,8 @@ struct TxMessage {
     TxMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static TxMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static TxMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -178,11 +218,140 @@ struct TxMessage {
  */
 struct BlockMessage {
     std::shared_ptr<Block> block;
+    std::shared_ptr<const std::vector<uint8_t>> serialized;    // Stored encoding of block, sent as is when set
     
     BlockMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static BlockMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static BlockMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * SendCmpct message - announces compact block support and relay mode
+ */
+struct SendCmpctMessage {
+    bool highBandwidth;     // Push compact blocks without waiting for an inv
+    uint64_t version;
+    
+    SendCmpctMessage() : highBandwidth(false), version(1) {}
+    SendCmpctMessage(bool hb, uint64_t v = 1) : highBandwidth(hb), version(v) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static SendCmpctMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * Transaction sent in full inside a compact block (e.g. the coinbase)
+ */
+struct PrefilledTransaction {
+    uint32_t index;         // Absolute position in the block
+    Transaction tx;
+};
+
+/**
+ * Compact block: header, salted 6-byte short transaction IDs and prefilled
+ * transactions. Receivers rebuild the block from their mempool.
+ */
+struct CompactBlockMessage {
+    BlockHeader header;
+    uint64_t nonce;                                 // Salt for the short ID key
+    std::vector<uint64_t> shortIds;                 // Low 48 bits used
+    std::vector<PrefilledTransaction> prefilled;    // Sorted by index
+    
+    CompactBlockMessage() : nonce(0) {}
+    
+    size_t getTransactionCount() const { return shortIds.size() + prefilled.size(); }
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static CompactBlockMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * GetBlockTxn message - requests transactions missing after reconstruction
+ */
+struct GetBlockTxnMessage {
+    std::string blockHash;
+    std::vector<uint32_t> indexes;  // Ascending, differentially encoded on the wire
+    
+    GetBlockTxnMessage() = default;
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static GetBlockTxnMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * BlockTxn message - transactions answering a GetBlockTxn, in request order
+ */
+struct BlockTxnMessage {
+    std::string blockHash;
+    std::vector<Transaction> transactions;
+    
+    BlockTxnMessage() = default;
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static BlockTxnMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * SendTxRcncl message - offers set-reconciliation transaction relay
+ */
+struct SendTxRcnclMessage {
+    uint32_t version;
+    uint64_t salt;          // Combined with the peer's salt to key short IDs
+    
+    SendTxRcnclMessage() : version(1), salt(0) {}
+    SendTxRcnclMessage(uint32_t v, uint64_t s) : version(v), salt(s) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static SendTxRcnclMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * ReqRecon message - the initiator asks for a sketch of the responder's set
+ */
+struct ReqReconMessage {
+    uint16_t setSize;       // Initiator's reconciliation set size
+    uint16_t q;             // Difference estimate coefficient, scaled by 32767
+    
+    ReqReconMessage() : setSize(0), q(0) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static ReqReconMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * Sketch message - serialized set sketch of the responder's short IDs
+ */
+struct SketchMessage {
+    std::vector<uint8_t> sketch;
+    
+    SketchMessage() = default;
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static SketchMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * ReconcilDiff message - decode result; on success lists the short IDs the
+ * initiator is missing, on failure both sides fall back to announcing
+ */
+struct ReconcilDiffMessage {
+    bool success;
+    std::vector<uint32_t> askShortIds;
+    
+    ReconcilDiffMessage() : success(false) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static ReconcilDiffMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -196,7 +365,8 @@ struct GetHeadersMessage {
     GetHeadersMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static GetHeadersMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static GetHeadersMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -208,7 +378,72 @@ struct HeadersMessage {
     HeadersMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static HeadersMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static HeadersMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * GetCFilters message - asks for the compact filters of a range of blocks on
+ * the sender's best chain, ending at stopHash
+ */
+struct GetCFiltersMessage {
+    uint8_t filterType;
+    uint32_t startHeight;
+    std::string stopHash;
+    
+    GetCFiltersMessage() : filterType(0), startHeight(0) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static GetCFiltersMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * CFilter message - one block's compact filter
+ */
+struct CFilterMessage {
+    uint8_t filterType;
+    std::string blockHash;
+    std::vector<uint8_t> filter;    // Encoded GCS filter
+    
+    CFilterMessage() : filterType(0) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static CFilterMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * GetCFHeaders message - asks for the filter hashes of a range of blocks
+ * plus the filter header preceding it
+ */
+struct GetCFHeadersMessage {
+    uint8_t filterType;
+    uint32_t startHeight;
+    std::string stopHash;
+    
+    GetCFHeadersMessage() : filterType(0), startHeight(0) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static GetCFHeadersMessage deserialize(ByteSpan data, size_t& offset);
+};
+
+/**
+ * CFHeaders message - filter hashes from startHeight to stopHash; the client
+ * rebuilds the header chain from prevFilterHeader
+ */
+struct CFHeadersMessage {
+    uint8_t filterType;
+    std::string stopHash;
+    std::string prevFilterHeader;
+    std::vector<std::string> filterHashes;
+    
+    CFHeadersMessage() : filterType(0) {}
+    
+    std::vector<uint8_t> serialize() const;
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static CFHeadersMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -220,7 +455,8 @@ struct AddrMessage {
     AddrMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static AddrMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static AddrMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -235,7 +471,8 @@ struct RejectMessage {
     RejectMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static RejectMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    void serializeInto(std::vector<uint8_t>& out) const;
+    static RejectMessage deserialize(ByteSpan data, size_t& offset);
 };
 
 /**
@@ -255,33 +492,79 @@ struct P2PMessage {
         PingMessage,
         PongMessage,
         AddrMessage,
-        RejectMessage
+        RejectMessage,
+        SendCmpctMessage,
+        CompactBlockMessage,
+        GetBlockTxnMessage,
+        BlockTxnMessage,
+        SendTxRcnclMessage,
+        ReqReconMessage,
+        SketchMessage,
+        ReconcilDiffMessage,
+        GetCFiltersMessage,
+        CFilterMessage,
+        GetCFHeadersMessage,
+        CFHeadersMessage,
+        NotFoundMessage
     > data;
     
     P2PMessage() = default;
     
     std::vector<uint8_t> serialize() const;
-    static P2PMessage deserialize(const std::vector<uint8_t>& data, size_t& offset);
+    static P2PMessage deserialize(ByteSpan data, size_t& offset);
+    
+    // Frame the message (header + payload) directly into the end of a buffer
+    // Compressible payloads of at least MIN_COMPRESS_SIZE are compressed if asked
+    void encodeInto(std::vector<uint8_t>& out, ChecksumType checksumType = ChecksumType::DOUBLE_SHA256,
+                    bool compress = false) const;
+    
+    // Pooled wire encoding, built on first use and shared by every peer the
+    // message is queued to. Messages must not be modified once queued.
+    std::shared_ptr<const MessageBuffer> getWireBuffer(ChecksumType checksumType = ChecksumType::DOUBLE_SHA256,
+                                                       bool compress = false) const;
+    
+    static bool isCompressible(MessageType type);
+    
+private:
+    mutable std::shared_ptr<const MessageBuffer> wireBuffers[4]; // Per ChecksumType, plain and compressed
+    
+public:
     
     // Factory methods for creating specific message types
     static std::shared_ptr<P2PMessage> createVersion(const VersionMessage& version);
     static std::shared_ptr<P2PMessage> createVerack();
     static std::shared_ptr<P2PMessage> createInv(const std::vector<InventoryVector>& inv);
     static std::shared_ptr<P2PMessage> createGetData(const std::vector<InventoryVector>& inv);
+    static std::shared_ptr<P2PMessage> createNotFound(const std::vector<InventoryVector>& inv);
     static std::shared_ptr<P2PMessage> createTx(std::shared_ptr<Transaction> tx);
     static std::shared_ptr<P2PMessage> createBlock(std::shared_ptr<Block> block);
+    static std::shared_ptr<P2PMessage> createBlock(std::shared_ptr<Block> block,
+                                                   std::shared_ptr<const std::vector<uint8_t>> serialized);
     static std::shared_ptr<P2PMessage> createGetHeaders(const GetHeadersMessage& getHeaders);
     static std::shared_ptr<P2PMessage> createHeaders(const std::vector<std::shared_ptr<Block>>& headers);
     static std::shared_ptr<P2PMessage> createPing(uint64_t nonce);
     static std::shared_ptr<P2PMessage> createPong(uint64_t nonce);
     static std::shared_ptr<P2PMessage> createAddr(const std::vector<NetworkAddress>& addresses);
     static std::shared_ptr<P2PMessage> createReject(const RejectMessage& reject);
+    static std::shared_ptr<P2PMessage> createSendCmpct(bool highBandwidth);
+    static std::shared_ptr<P2PMessage> createCompactBlock(const CompactBlockMessage& compactBlock);
+    static std::shared_ptr<P2PMessage> createGetBlockTxn(const GetBlockTxnMessage& getBlockTxn);
+    static std::shared_ptr<P2PMessage> createBlockTxn(const BlockTxnMessage& blockTxn);
+    static std::shared_ptr<P2PMessage> createSendTxRcncl(uint64_t salt);
+    static std::shared_ptr<P2PMessage> createReqRecon(const ReqReconMessage& reqRecon);
+    static std::shared_ptr<P2PMessage> createSketch(const SketchMessage& sketch);
+    static std::shared_ptr<P2PMessage> createReconcilDiff(const ReconcilDiffMessage& reconcilDiff);
+    static std::shared_ptr<P2PMessage> createGetCFilters(const GetCFiltersMessage& getCFilters);
+    static std::shared_ptr<P2PMessage> createCFilter(const CFilterMessage& cfilter);
+    static std::shared_ptr<P2PMessage> createGetCFHeaders(const GetCFHeadersMessage& getCFHeaders);
+    static std::shared_ptr<P2PMessage> createCFHeaders(const CFHeadersMessage& cfheaders);
     
     // Message type checking
     bool isVersion() const;
     bool isVerack() const;
     bool isInv() const;
     bool isGetData() const;
+    bool isNotFound() const;
     bool isTx() const;
     bool isBlock() const;
     bool isGetHeaders() const;
@@ -290,11 +573,24 @@ struct P2PMessage {
     bool isPong() const;
     bool isAddr() const;
     bool isReject() const;
+    bool isSendCmpct() const;
+    bool isCompactBlock() const;
+    bool isGetBlockTxn() const;
+    bool isBlockTxn() const;
+    bool isSendTxRcncl() const;
+    bool isReqRecon() const;
+    bool isSketch() const;
+    bool isReconcilDiff() const;
+    bool isGetCFilters() const;
+    bool isCFilter() const;
+    bool isGetCFHeaders() const;
+    bool isCFHeaders() const;
     
     // Payload extraction (with type safety)
     const VersionMessage* getVersion() const;
     const InvMessage* getInv() const;
     const GetDataMessage* getGetData() const;
+    const NotFoundMessage* getNotFound() const;
     const TxMessage* getTx() const;
     const BlockMessage* getBlock() const;
     const GetHeadersMessage* getGetHeaders() const;
@@ -303,6 +599,18 @@ struct P2PMessage {
     const PongMessage* getPong() const;
     const AddrMessage* getAddr() const;
     const RejectMessage* getReject() const;
+    const SendCmpctMessage* getSendCmpct() const;
+    const CompactBlockMessage* getCompactBlock() const;
+    const GetBlockTxnMessage* getGetBlockTxn() const;
+    const BlockTxnMessage* getBlockTxn() const;
+    const SendTxRcnclMessage* getSendTxRcncl() const;
+    const ReqReconMessage* getReqRecon() const;
+    const SketchMessage* getSketch() const;
+    const ReconcilDiffMessage* getReconcilDiff() const;
+    const GetCFiltersMessage* getGetCFilters() const;
+    const CFilterMessage* getCFilter() const;
+    const GetCFHeadersMessage* getGetCFHeaders() const;
+    const CFHeadersMessage* getCFHeaders() const;
 };
 
 /**
@@ -312,15 +620,28 @@ namespace Protocol {
     constexpr uint32_t MAGIC_BYTES = 0xF9BEB4D9;
     constexpr uint32_t PROTOCOL_VERSION = 70015;
     constexpr uint64_t NODE_NETWORK = 1;
+    constexpr uint64_t NODE_COMPACT_FILTERS = 1 << 6;     // Serves compact block filters
+    constexpr uint64_t NODE_CRC32C = 1 << 10;             // Accepts CRC32C frame checksums
+    constexpr uint64_t NODE_COMPRESSION = 1 << 11;        // Accepts LZ4-compressed payloads
+    constexpr uint32_t CRC32C_COMMAND_FLAG = 0x80000000;  // Set in the command field of CRC32C frames
+    constexpr uint32_t COMPRESSED_COMMAND_FLAG = 0x40000000; // Set in the command field of compressed frames
+    constexpr uint32_t COMMAND_FLAGS = CRC32C_COMMAND_FLAG | COMPRESSED_COMMAND_FLAG;
+    constexpr size_t HEADER_SIZE = 16;                   // magic + command + length + checksum
     constexpr size_t MAX_MESSAGE_SIZE = 32 * 1024 * 1024; // 32MB
     constexpr size_t MAX_INV_SIZE = 50000;
+    constexpr size_t MIN_COMPRESS_SIZE = 1024;            // Smaller payloads are not worth compressing
     constexpr size_t MAX_ADDR_SIZE = 1000;
+    constexpr size_t MAX_HEADERS = 2000;                  // Per headers message
+    constexpr size_t MAX_SKETCH_SIZE = 64 * 1024;         // Serialized reconciliation sketch
+    constexpr size_t MAX_GETCFILTERS_SIZE = 1000;         // Blocks per getcfilters request
+    constexpr size_t MAX_GETCFHEADERS_SIZE = 2000;        // Blocks per getcfheaders request
     
     // Message commands as strings
     const std::string CMD_VERSION = "version";
     const std::string CMD_VERACK = "verack";
     const std::string CMD_INV = "inv";
     const std::string CMD_GETDATA = "getdata";
+    const std::string CMD_NOTFOUND = "notfound";
     const std::string CMD_TX = "tx";
     const std::string CMD_BLOCK = "block";
     const std::string CMD_GETHEADERS = "getheaders";
@@ -330,6 +651,18 @@ namespace Protocol {
     const std::string CMD_ADDR = "addr";
     const std::string CMD_GETADDR = "getaddr";
     const std::string CMD_REJECT = "reject";
+    const std::string CMD_SENDCMPCT = "sendcmpct";
+    const std::string CMD_CMPCTBLOCK = "cmpctblock";
+    const std::string CMD_GETBLOCKTXN = "getblocktxn";
+    const std::string CMD_BLOCKTXN = "blocktxn";
+    const std::string CMD_SENDTXRCNCL = "sendtxrcncl";
+    const std::string CMD_REQRECON = "reqrecon";
+    const std::string CMD_SKETCH = "sketch";
+    const std::string CMD_RECONCILDIFF = "reconcildiff";
+    const std::string CMD_GETCFILTERS = "getcfilters";
+    const std::string CMD_CFILTER = "cfilter";
+    const std::string CMD_GETCFHEADERS = "getcfheaders";
+    const std::string CMD_CFHEADERS = "cfheaders";
 }
 
 } // namespace pragma
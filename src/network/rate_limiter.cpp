@@ -0,0 +1,145 @@
+#include "rate_limiter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pragma {
+
+TrafficClass trafficClassOf(MessageType type) {
+    switch (type) {
+        case MessageType::GETHEADERS:
+        case MessageType::HEADERS:
+        case MessageType::HEADERS_NEW:
+        case MessageType::BLOCK:
+        case MessageType::CMPCTBLOCK:
+        case MessageType::GETBLOCKTXN:
+        case MessageType::BLOCKTXN:
+        case MessageType::GETCFILTERS:
+        case MessageType::CFILTER:
+        case MessageType::GETCFHEADERS:
+        case MessageType::CFHEADERS:
+            return TrafficClass::BLOCK;
+        case MessageType::GETDATA:
+        case MessageType::INV:
+        case MessageType::NOTFOUND:
+        case MessageType::TX:
+        case MessageType::MEMPOOL:
+        case MessageType::REQRECON:
+        case MessageType::SKETCH:
+        case MessageType::RECONCILDIFF:
+            return TrafficClass::TX;
+        default:
+            return TrafficClass::CONTROL;
+    }
+}
+
+TrafficClass trafficClassOf(const P2PMessage& message) {
+    const std::vector<InventoryVector>* inventory = nullptr;
+    if (auto inv = message.getInv()) {
+        inventory = &inv->inventory;
+    } else if (auto getData = message.getGetData()) {
+        inventory = &getData->inventory;
+    } else if (auto notFound = message.getNotFound()) {
+        inventory = &notFound->inventory;
+    }
+
+    if (inventory) {
+        for (const auto& item : *inventory) {
+            if (item.type != InventoryType::TX) {
+                return TrafficClass::BLOCK;
+            }
+        }
+    }
+    return trafficClassOf(message.header.command);
+}
+
+const char* trafficClassName(TrafficClass trafficClass) {
+    switch (trafficClass) {
+        case TrafficClass::CONTROL: return "control";
+        case TrafficClass::BLOCK: return "block";
+        case TrafficClass::TX: return "tx";
+    }
+    return "unknown";
+}
+
+// TokenBucket implementation
+TokenBucket::TokenBucket() : TokenBucket(0.0, 0.0) {}
+
+TokenBucket::TokenBucket(double ratePerSecond, double burstSize)
+    : rate(ratePerSecond), burst(std::max(burstSize, 1.0)), tokens(burst), lastRefill(Clock::now()) {}
+
+void TokenBucket::configure(double ratePerSecond, double burstSize) {
+    std::lock_guard<std::mutex> lock(bucketMutex);
+    rate = ratePerSecond;
+    burst = std::max(burstSize, 1.0);
+    tokens = burst;
+    lastRefill = Clock::now();
+}
+
+void TokenBucket::refill(Clock::time_point now) {
+    if (now <= lastRefill) {
+        return;
+    }
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    tokens = std::min(burst, tokens + elapsed * rate);
+    lastRefill = now;
+}
+
+double TokenBucket::available(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(bucketMutex);
+    if (isUnlimited()) {
+        return HUGE_VAL;
+    }
+    refill(now);
+    return std::max(0.0, std::floor(tokens));
+}
+
+bool TokenBucket::tryConsume(double amount, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(bucketMutex);
+    if (isUnlimited()) {
+        return true;
+    }
+    refill(now);
+    if (tokens <= 0.0) {
+        return false;
+    }
+    tokens -= amount;
+    return true;
+}
+
+void TokenBucket::consume(double amount, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(bucketMutex);
+    if (isUnlimited()) {
+        return;
+    }
+    refill(now);
+    tokens -= amount;
+}
+
+TokenBucket::Clock::duration TokenBucket::timeUntilAvailable(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(bucketMutex);
+    if (isUnlimited()) {
+        return Clock::duration::zero();
+    }
+    refill(now);
+    if (tokens >= 1.0) {
+        return Clock::duration::zero();
+    }
+    double seconds = (1.0 - tokens) / rate;
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+// PeerRateLimiter implementation
+void PeerRateLimiter::configure(const RateLimitConfig& config) {
+    auto setup = [&config](TokenBucket& bucket, double rate) {
+        bucket.configure(rate, rate * config.burstSeconds);
+    };
+
+    setup(recvBytes, config.peerRecvBytesPerSecond);
+    setup(sendBytes, config.peerSendBytesPerSecond);
+    for (size_t i = 0; i < TRAFFIC_CLASS_COUNT; ++i) {
+        setup(recvMessages[i], config.peerRecvMessagesPerSecond[i]);
+        setup(sendBytesByClass[i], config.peerSendBytesPerSecondByClass[i]);
+    }
+}
+
+} // namespace pragma
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "protocol.h"
+#include <array>
+#include <chrono>
+#include <mutex>
+
+namespace pragma {
+
+/**
+ * Traffic classes used for per-type budgets.
+ * Block data (and the requests that lead to it) is budgeted apart from
+ * transaction relay so serving historical blocks cannot crowd out relay,
+ * and neither can starve the small control messages.
+ */
+enum class TrafficClass : size_t {
+    CONTROL = 0,    // Handshake, ping, addresses, feature negotiation
+    BLOCK = 1,      // Headers, blocks, compact blocks and their requests
+    TX = 2          // Inventory, transactions, reconciliation
+};
+
+constexpr size_t TRAFFIC_CLASS_COUNT = 3;
+
+TrafficClass trafficClassOf(MessageType type);
+
+// Also looks inside inv and getdata: any block inventory makes them block traffic
+TrafficClass trafficClassOf(const P2PMessage& message);
+const char* trafficClassName(TrafficClass trafficClass);
+
+/**
+ * Token bucket refilled continuously at a fixed rate up to a burst size.
+ * A consume may take the balance negative so a single message larger than
+ * the burst still goes through; the debt is paid off before anything else.
+ * A rate of zero means unlimited. Thread-safe, so global buckets can be
+ * shared by all event loops.
+ */
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    double rate;        // Tokens per second
+    double burst;
+    double tokens;
+    Clock::time_point lastRefill;
+    mutable std::mutex bucketMutex;
+
+    void refill(Clock::time_point now);
+
+public:
+    TokenBucket();
+    TokenBucket(double ratePerSecond, double burstSize);
+
+    // Reconfigures the bucket and fills it to the new burst
+    void configure(double ratePerSecond, double burstSize);
+
+    bool isUnlimited() const { return rate <= 0.0; }
+
+    // Whole tokens available now; zero while in debt
+    double available(Clock::time_point now = Clock::now());
+
+    // Takes the tokens if the balance is positive; false leaves it untouched
+    bool tryConsume(double amount, Clock::time_point now = Clock::now());
+
+    // Unconditional charge for work already done (bytes actually read or written)
+    void consume(double amount, Clock::time_point now = Clock::now());
+
+    // Time until the balance is positive again
+    Clock::duration timeUntilAvailable(Clock::time_point now = Clock::now());
+};
+
+/**
+ * Bandwidth and message-rate limits. Byte rates are bytes per second and
+ * message rates messages per second; zero disables a limit. Buckets hold
+ * burstSeconds worth of their rate.
+ */
+struct RateLimitConfig {
+    // Inbound, per peer
+    double peerRecvBytesPerSecond = 0;
+    std::array<double, TRAFFIC_CLASS_COUNT> peerRecvMessagesPerSecond{{100, 200, 1000}};
+
+    // Outbound, per peer; block serving and tx relay have separate budgets
+    double peerSendBytesPerSecond = 0;
+    std::array<double, TRAFFIC_CLASS_COUNT> peerSendBytesPerSecondByClass{{0, 4 * 1024 * 1024, 1024 * 1024}};
+
+    // Shared by every connection
+    double globalRecvBytesPerSecond = 0;
+    double globalSendBytesPerSecond = 0;
+
+    double burstSeconds = 2.0;
+};
+
+/**
+ * Buckets for one connection. Not thread-safe beyond what TokenBucket
+ * provides; the owning event loop is the only user.
+ */
+struct PeerRateLimiter {
+    TokenBucket recvBytes;
+    TokenBucket sendBytes;
+    std::array<TokenBucket, TRAFFIC_CLASS_COUNT> recvMessages;
+    std::array<TokenBucket, TRAFFIC_CLASS_COUNT> sendBytesByClass;
+
+    void configure(const RateLimitConfig& config);
+};
+
+} // namespace pragma
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pragma {
+
+namespace detail {
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+inline size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace detail
+
+/**
+ * Bounded multi-producer single-consumer ring queue.
+ * Each slot carries a sequence number (Vyukov's bounded queue): producers
+ * claim a slot with one CAS on the tail and publish it by bumping the
+ * slot's sequence, so they never wait for each other to finish writing.
+ * The single consumer needs no atomic read-modify-write at all.
+ */
+template <typename T>
+class MpscRingQueue {
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> tail{0};   // Next slot to claim
+    alignas(detail::CACHE_LINE_SIZE) std::atomic<size_t> head{0};   // Next slot to pop; written by the consumer
+
+public:
+    explicit MpscRingQueue(size_t capacity)
+        : slots(new Slot[detail::roundUpToPowerOfTwo(capacity)]), mask(detail::roundUpToPowerOfTwo(capacity) - 1) {
+        for (size_t i = 0; i <= mask; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingQueue(const MpscRingQueue&) = delete;
+    MpscRingQueue& operator=(const MpscRingQueue&) = delete;
+
+    // Any thread; false (value untouched) if the queue is full
+    bool tryPush(T&& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // The consumer has not freed this slot yet
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool tryPop(T& out) {
+        size_t position = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[position & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            return false; // Empty, or the producer that claimed it is still writing
+        }
+        out = std::move(slot.value);
+        slot.value = T();
+        slot.sequence.store(position + mask + 1, std::memory_order_release);
+        head.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer only; appends up to maxCount items and returns how many
+    size_t popBatch(std::vector<T>& out, size_t maxCount) {
+        size_t count = 0;
+        T value;
+        while (count < maxCount && tryPop(value)) {
+            out.push_back(std::move(value));
+            count++;
+        }
+        return count;
+    }
+
+    // Approximate; includes slots claimed but not yet published
+    size_t size() const {
+        size_t first = head.load(std::memory_order_relaxed);
+        size_t last = tail.load(std::memory_order_relaxed);
+        return last > first ? last - first : 0;
+    }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return mask + 1; }
+};
+
+} // namespace pragma
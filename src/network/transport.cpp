@@ -0,0 +1,777 @@
+#include "transport.h"
+#include "../primitives/utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace pragma {
+
+namespace {
+
+void setNoDelay(int fd) {
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+uint32_t readUint32LE(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+Transport::Transport(PeerManager* peers, NetworkEventHandler* eventHandler, size_t numLoops)
+    : peerManager(peers), handler(eventHandler), listenFd(-1), listenPort(0) {
+    numLoops = std::max<size_t>(1, numLoops);
+    for (size_t i = 0; i < numLoops; ++i) {
+        auto loop = std::make_unique<EventLoop>();
+        loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = loop->wakeFd;
+        epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->wakeFd, &ev);
+
+        loops.push_back(std::move(loop));
+    }
+}
+
+Transport::~Transport() {
+    stop();
+
+    for (auto& loop : loops) {
+        if (loop->wakeFd >= 0) close(loop->wakeFd);
+        if (loop->epollFd >= 0) close(loop->epollFd);
+    }
+}
+
+bool Transport::start() {
+    if (running.exchange(true)) {
+        return false;
+    }
+
+    for (auto& loop : loops) {
+        loop->thread = std::thread(&Transport::runLoop, this, loop.get());
+    }
+    return true;
+}
+
+void Transport::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    for (auto& loop : loops) {
+        wake(loop.get());
+    }
+    for (auto& loop : loops) {
+        if (loop->thread.joinable()) {
+            loop->thread.join();
+        }
+    }
+
+    // Loops are stopped, so it is safe to tear down sockets from this thread
+    std::vector<std::shared_ptr<Connection>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (const auto& pair : connections) {
+            remaining.push_back(pair.second);
+        }
+    }
+    for (auto& conn : remaining) {
+        closeConnection(conn);
+    }
+
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+bool Transport::listen(const std::string& bindAddress, uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        Utils::logError("Transport: failed to create listen socket");
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, bindAddress.c_str(), &addr.sin_addr) != 1) {
+        close(fd);
+        Utils::logError("Transport: invalid bind address " + bindAddress);
+        return false;
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        Utils::logError("Transport: failed to listen on " + bindAddress + ":" + std::to_string(port));
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    listenPort = ntohs(addr.sin_port);
+    listenFd = fd;
+
+    // The listener lives on the first loop; accepted sockets are spread over all loops
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = listenFd;
+    epoll_ctl(loops[0]->epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    return true;
+}
+
+std::shared_ptr<Peer> Transport::connect(const NetworkAddress& address) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(address.port);
+    if (inet_pton(AF_INET, address.ip.c_str(), &addr.sin_addr) != 1) {
+        return nullptr;
+    }
+
+    auto peer = peerManager->addPeer(address, false);
+    if (peer && peer->getState() == PeerState::DISCONNECTED) {
+        // Stale entry from a previous session that has not been reaped yet
+        peerManager->removePeer(peer->getId());
+        peer = peerManager->addPeer(address, false);
+    }
+    if (!peer) {
+        return nullptr;
+    }
+    if (isConnected(peer->getId())) {
+        return peer;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        peerManager->removePeer(peer->getId());
+        return nullptr;
+    }
+
+    int rc = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    if (rc < 0 && errno != EINPROGRESS) {
+        close(fd);
+        peerManager->removePeer(peer->getId());
+        return nullptr;
+    }
+    setNoDelay(fd);
+
+    // Completion (or an immediate success) is reported as EPOLLOUT on the owning loop
+    peer->setState(PeerState::CONNECTING);
+    auto conn = registerConnection(fd, peer, true);
+    if (!armConnection(conn)) {
+        // It never connected, so there is no disconnect to report
+        unregisterConnection(conn);
+        close(fd);
+        peerManager->removePeer(peer->getId());
+        return nullptr;
+    }
+    return peer;
+}
+
+void Transport::disconnect(const std::string& peerId) {
+    std::shared_ptr<Connection> conn;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        auto it = peerSockets.find(peerId);
+        if (it == peerSockets.end()) {
+            return;
+        }
+        auto connIt = connections.find(it->second);
+        if (connIt == connections.end()) {
+            return;
+        }
+        conn = connIt->second;
+    }
+
+    // Sockets are only closed by their own loop
+    EventLoop* loop = loops[conn->loopIndex].get();
+    {
+        std::lock_guard<std::mutex> lock(loop->pendingMutex);
+        loop->pendingClose.push_back(conn);
+    }
+    wake(loop);
+}
+
+bool Transport::isConnected(const std::string& peerId) const {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    return peerSockets.find(peerId) != peerSockets.end();
+}
+
+size_t Transport::getConnectionCount() const {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    return connections.size();
+}
+
+void Transport::setRateLimits(const RateLimitConfig& config) {
+    std::lock_guard<std::mutex> lock(rateLimitsMutex);
+    rateLimits = config;
+    globalRecvBytes.configure(config.globalRecvBytesPerSecond, config.globalRecvBytesPerSecond * config.burstSeconds);
+    globalSendBytes.configure(config.globalSendBytesPerSecond, config.globalSendBytesPerSecond * config.burstSeconds);
+}
+
+RateLimitConfig Transport::getRateLimits() const {
+    std::lock_guard<std::mutex> lock(rateLimitsMutex);
+    return rateLimits;
+}
+
+std::shared_ptr<Connection> Transport::registerConnection(int fd, std::shared_ptr<Peer> peer, bool connecting) {
+    size_t loopIndex = nextLoop.fetch_add(1) % loops.size();
+    auto conn = std::make_shared<Connection>(fd, loopIndex, peer, connecting);
+    {
+        std::lock_guard<std::mutex> lock(rateLimitsMutex);
+        conn->limits.configure(rateLimits);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        connections[fd] = conn;
+        peerSockets[peer->getId()] = fd;
+    }
+
+    std::weak_ptr<Connection> weakConn = conn;
+    peer->setOutboundNotifier([this, weakConn]() {
+        if (auto c = weakConn.lock()) {
+            scheduleFlush(c);
+        }
+    });
+    return conn;
+}
+
+bool Transport::armConnection(const std::shared_ptr<Connection>& conn) {
+    // Both directions stay registered; edge triggering only reports transitions
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = conn->fd;
+    return epoll_ctl(loops[conn->loopIndex]->epollFd, EPOLL_CTL_ADD, conn->fd, &ev) == 0;
+}
+
+std::shared_ptr<Connection> Transport::findConnection(int fd) const {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    auto it = connections.find(fd);
+    return it != connections.end() ? it->second : nullptr;
+}
+
+void Transport::wake(EventLoop* loop) {
+    uint64_t one = 1;
+    ssize_t ignored = write(loop->wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void Transport::scheduleFlush(const std::shared_ptr<Connection>& conn) {
+    if (conn->closed.load() || conn->flushPending.exchange(true)) {
+        return;
+    }
+
+    EventLoop* loop = loops[conn->loopIndex].get();
+    {
+        std::lock_guard<std::mutex> lock(loop->pendingMutex);
+        loop->pendingFlush.push_back(conn);
+    }
+    wake(loop);
+}
+
+void Transport::runLoop(EventLoop* loop) {
+    epoll_event events[MAX_EVENTS];
+
+    while (running.load()) {
+        int count = epoll_wait(loop->epollFd, events, MAX_EVENTS, loopTimeout(loop));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            Utils::logError("Transport: epoll_wait failed: " + std::string(std::strerror(errno)));
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+
+            if (fd == loop->wakeFd) {
+                uint64_t value;
+                while (read(loop->wakeFd, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            if (fd == listenFd) {
+                handleAccept();
+                continue;
+            }
+
+            auto conn = findConnection(fd);
+            if (!conn || conn->closed.load()) {
+                continue;
+            }
+
+            if (conn->connecting) {
+                handleConnectComplete(conn);
+                if (conn->closed.load() || conn->connecting) continue;
+            }
+            if (ev & EPOLLERR) {
+                closeConnection(conn);
+                continue;
+            }
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+                handleReadable(conn);
+            }
+            if ((ev & EPOLLOUT) && !conn->closed.load()) {
+                flushConnection(conn);
+            }
+        }
+
+        processPending(loop);
+        resumeThrottled(loop);
+    }
+}
+
+void Transport::processPending(EventLoop* loop) {
+    std::vector<std::shared_ptr<Connection>> toFlush;
+    std::vector<std::shared_ptr<Connection>> toClose;
+    {
+        std::lock_guard<std::mutex> lock(loop->pendingMutex);
+        toFlush.swap(loop->pendingFlush);
+        toClose.swap(loop->pendingClose);
+    }
+
+    for (auto& conn : toFlush) {
+        conn->flushPending.store(false);
+        if (!conn->closed.load()) {
+            flushConnection(conn);
+        }
+    }
+    for (auto& conn : toClose) {
+        closeConnection(conn);
+    }
+}
+
+void Transport::handleAccept() {
+    while (true) {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        int fd = accept4(listenFd, reinterpret_cast<sockaddr*>(&addr), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break; // EAGAIN: backlog drained
+        }
+
+        char ip[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        NetworkAddress remote(ip, ntohs(addr.sin_port));
+
+        auto peer = peerManager->addPeer(remote, true);
+        if (!peer) {
+            close(fd); // Connection limits reached or address banned
+            continue;
+        }
+        setNoDelay(fd);
+
+        auto conn = registerConnection(fd, peer, false);
+        peer->setState(PeerState::CONNECTED);
+
+        // Announce before arming so no frame can be dispatched ahead of the connect event
+        handler->onPeerConnected(peer->getId());
+        if (!armConnection(conn)) {
+            closeConnection(conn);
+        }
+    }
+}
+
+void Transport::handleConnectComplete(const std::shared_ptr<Connection>& conn) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+        closeConnection(conn);
+        return;
+    }
+
+    // Spurious wakeup before the handshake finished
+    sockaddr_in addr{};
+    len = sizeof(addr);
+    if (getpeername(conn->fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+        if (errno == ENOTCONN) return;
+        closeConnection(conn);
+        return;
+    }
+
+    conn->connecting = false;
+    conn->peer->setState(PeerState::CONNECTED);
+    handler->onPeerConnected(conn->peer->getId());
+}
+
+void Transport::handleReadable(const std::shared_ptr<Connection>& conn) {
+    if (conn->readThrottled) {
+        return; // Resumed by the loop once the budget refills
+    }
+    if (!conn->recvBuffer) {
+        conn->recvBuffer = BufferPool::instance().acquire(READ_CHUNK);
+        conn->recvBuffer->bytes.resize(READ_CHUNK);
+    }
+    auto& buffer = conn->recvBuffer->bytes;
+
+    while (!conn->closed.load() && !conn->readThrottled) {
+        // Keep at least a quarter chunk of free space, compacting before growing
+        if (buffer.size() - conn->recvEnd < READ_CHUNK / 4) {
+            if (conn->recvStart > 0) {
+                std::memmove(buffer.data(), buffer.data() + conn->recvStart, conn->recvEnd - conn->recvStart);
+                conn->recvEnd -= conn->recvStart;
+                conn->recvStart = 0;
+            }
+            if (buffer.size() - conn->recvEnd < READ_CHUNK / 4) {
+                buffer.resize(std::max(buffer.size() * 2, conn->recvEnd + READ_CHUNK));
+            }
+        }
+
+        // Read no more than the peer and global budgets allow; when either is dry
+        // stop reading so the kernel buffer fills and TCP pushes back on the sender
+        auto now = Clock::now();
+        Clock::duration wait;
+        size_t budget = byteBudget(conn->limits.recvBytes, globalRecvBytes, now, wait);
+        if (budget == 0) {
+            conn->readThrottled = true;
+            readThrottles.fetch_add(1);
+            throttle(conn, wait);
+            return;
+        }
+
+        size_t want = std::min(buffer.size() - conn->recvEnd, budget);
+        ssize_t bytesRead = recv(conn->fd, buffer.data() + conn->recvEnd, want, 0);
+        if (bytesRead > 0) {
+            conn->recvEnd += static_cast<size_t>(bytesRead);
+            conn->limits.recvBytes.consume(static_cast<double>(bytesRead), now);
+            globalRecvBytes.consume(static_cast<double>(bytesRead), now);
+            conn->peer->updateStats(static_cast<uint64_t>(bytesRead), 0);
+            if (!parseFrames(conn)) {
+                closeConnection(conn);
+                return;
+            }
+            continue;
+        }
+
+        if (bytesRead == 0) {
+            closeConnection(conn); // Orderly shutdown by the remote side
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // A buffer grown for a large block is handed back once it is drained
+            if (conn->recvStart == conn->recvEnd && buffer.size() > MAX_IDLE_RECV_BUFFER) {
+                conn->recvBuffer.reset();
+            }
+            return;
+        }
+
+        closeConnection(conn);
+        return;
+    }
+}
+
+bool Transport::deliver(const std::shared_ptr<Connection>& conn, const std::string& peerId,
+                        std::shared_ptr<P2PMessage> message) {
+    if (handler->onMessageReceived(peerId, message)) {
+        return true;
+    }
+
+    // The handler is backed up: keep the message and stop reading from this
+    // peer alone, leaving later frames in the kernel until it is taken
+    conn->heldMessage = std::move(message);
+    conn->readThrottled = true;
+    throttle(conn, HANDOFF_RETRY);
+    return false;
+}
+
+bool Transport::parseFrames(const std::shared_ptr<Connection>& conn) {
+    const std::string& peerId = conn->peer->getId();
+
+    // A refused message goes ahead of everything buffered behind it
+    if (conn->heldMessage && !deliver(conn, peerId, std::move(conn->heldMessage))) {
+        return true;
+    }
+
+    while (conn->recvEnd - conn->recvStart >= HEADER_SIZE) {
+        const uint8_t* frame = conn->recvBuffer->bytes.data() + conn->recvStart;
+        uint32_t magic = readUint32LE(frame);
+        uint32_t command = readUint32LE(frame + 4);
+        uint32_t length = readUint32LE(frame + 8);
+        uint32_t checksum = readUint32LE(frame + 12);
+
+        if (magic != Protocol::MAGIC_BYTES) {
+            handler->onInvalidMessage(peerId, "bad magic bytes");
+            return false;
+        }
+        if (length > Protocol::MAX_MESSAGE_SIZE) {
+            handler->onInvalidMessage(peerId, "oversized message: " + std::to_string(length));
+            return false;
+        }
+
+        ChecksumType checksumType = (command & Protocol::CRC32C_COMMAND_FLAG) ? ChecksumType::CRC32C
+                                                                              : ChecksumType::DOUBLE_SHA256;
+        if (checksumType == ChecksumType::CRC32C && !acceptCrc32c.load()) {
+            handler->onInvalidMessage(peerId, "CRC32C checksum not negotiated");
+            return false;
+        }
+        if ((command & Protocol::COMPRESSED_COMMAND_FLAG) && !acceptCompression.load()) {
+            handler->onInvalidMessage(peerId, "compression not negotiated");
+            return false;
+        }
+
+        // Hash payload bytes as they arrive so a large block is verified in the
+        // same pass that receives it rather than in a second sweep at the end
+        if (conn->frameChecked == 0) {
+            conn->frameChecksum.reset(checksumType);
+        }
+        size_t available = std::min<size_t>(conn->recvEnd - conn->recvStart - HEADER_SIZE, length);
+        if (available > conn->frameChecked) {
+            conn->frameChecksum.update(frame + HEADER_SIZE + conn->frameChecked, available - conn->frameChecked);
+            conn->frameChecked = available;
+        }
+        if (available < length) {
+            break; // Wait for the rest of the payload
+        }
+
+        // Message budget per traffic class; an over-budget frame stays buffered
+        // and reading pauses until the class refills
+        auto type = static_cast<MessageType>(command & ~Protocol::COMMAND_FLAGS);
+        auto& messageBudget = conn->limits.recvMessages[static_cast<size_t>(trafficClassOf(type))];
+        if (!messageBudget.tryConsume(1.0)) {
+            conn->readThrottled = true;
+            readThrottles.fetch_add(1);
+            throttle(conn, messageBudget.timeUntilAvailable());
+            break;
+        }
+
+        size_t frameSize = HEADER_SIZE + length;
+        uint32_t computed = conn->frameChecksum.finalize();
+        conn->frameChecked = 0;
+
+        if (computed != checksum) {
+            conn->peer->incrementInvalidMessages();
+            handler->onInvalidMessage(peerId, "checksum mismatch");
+        } else {
+            try {
+                // Decode straight out of the receive buffer; the frame is never copied
+                size_t offset = 0;
+                auto message = std::make_shared<P2PMessage>(P2PMessage::deserialize(ByteSpan(frame, frameSize), offset));
+                conn->peer->incrementMessageCount(true);
+                deliver(conn, peerId, std::move(message));
+            } catch (const std::exception& e) {
+                conn->peer->incrementInvalidMessages();
+                handler->onInvalidMessage(peerId, std::string("malformed payload: ") + e.what());
+            }
+        }
+
+        conn->recvStart += frameSize;
+        if (conn->heldMessage) {
+            break;
+        }
+    }
+
+    if (conn->recvStart == conn->recvEnd) {
+        conn->recvStart = 0;
+        conn->recvEnd = 0;
+    }
+    return true;
+}
+
+void Transport::flushConnection(const std::shared_ptr<Connection>& conn) {
+    if (conn->connecting || conn->closed.load() || conn->writeThrottled) {
+        return;
+    }
+    auto now = Clock::now();
+
+    // Move queued messages onto the wire queue in priority order; relayed messages
+    // share one encoding. Each message is charged to its class budget, so block
+    // serving and tx relay cannot use up each other's share; classes that are
+    // over budget are skipped until they refill
+    uint32_t excluded = 0;
+    Clock::duration wait = Clock::duration::max();
+    while (true) {
+        for (size_t i = 0; i < TRAFFIC_CLASS_COUNT; ++i) {
+            auto& classBudget = conn->limits.sendBytesByClass[i];
+            if (!(excluded & (1u << i)) && classBudget.available(now) < 1.0) {
+                excluded |= 1u << i;
+                wait = std::min(wait, classBudget.timeUntilAvailable(now));
+            }
+        }
+
+        auto message = conn->peer->getNextOutboundMessage(excluded);
+        if (!message) {
+            break;
+        }
+        auto buffer = message->getWireBuffer(conn->peer->getFrameChecksum(), conn->peer->getFrameCompression());
+        conn->limits.sendBytesByClass[static_cast<size_t>(trafficClassOf(*message))]
+            .consume(static_cast<double>(buffer->size()), now);
+        conn->sendQueue.push_back(std::move(buffer));
+        conn->peer->incrementMessageCount(false);
+    }
+    if (excluded != 0 && conn->peer->hasOutboundMessages()) {
+        throttle(conn, wait);
+    }
+
+    while (!conn->sendQueue.empty()) {
+        size_t budget = byteBudget(conn->limits.sendBytes, globalSendBytes, now, wait);
+        if (budget == 0) {
+            conn->writeThrottled = true;
+            writeThrottles.fetch_add(1);
+            throttle(conn, wait);
+            return;
+        }
+
+        iovec iov[MAX_IOVECS];
+        size_t count = 0;
+        for (auto it = conn->sendQueue.begin(); it != conn->sendQueue.end() && count < MAX_IOVECS && budget > 0;
+             ++it, ++count) {
+            size_t skip = (count == 0) ? conn->sendOffset : 0;
+            size_t length = std::min((*it)->size() - skip, budget);
+            iov[count].iov_base = const_cast<uint8_t*>((*it)->data() + skip);
+            iov[count].iov_len = length;
+            budget -= length;
+        }
+
+        // sendmsg is writev with flags, so a dead peer cannot raise SIGPIPE
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t written = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return; // EPOLLOUT resumes the flush
+            closeConnection(conn);
+            return;
+        }
+        conn->limits.sendBytes.consume(static_cast<double>(written), now);
+        globalSendBytes.consume(static_cast<double>(written), now);
+        conn->peer->updateStats(0, static_cast<uint64_t>(written));
+
+        size_t remaining = static_cast<size_t>(written);
+        while (remaining > 0) {
+            size_t frontLeft = conn->sendQueue.front()->size() - conn->sendOffset;
+            if (remaining >= frontLeft) {
+                remaining -= frontLeft;
+                conn->sendQueue.pop_front();
+                conn->sendOffset = 0;
+            } else {
+                conn->sendOffset += remaining;
+                remaining = 0;
+            }
+        }
+    }
+}
+
+size_t Transport::byteBudget(TokenBucket& peerBucket, TokenBucket& globalBucket, Clock::time_point now,
+                             Clock::duration& wait) {
+    double budget = std::min(peerBucket.available(now), globalBucket.available(now));
+    if (budget < 1.0) {
+        wait = std::max(peerBucket.timeUntilAvailable(now), globalBucket.timeUntilAvailable(now));
+        return 0;
+    }
+    return budget >= static_cast<double>(SIZE_MAX) ? SIZE_MAX : static_cast<size_t>(budget);
+}
+
+void Transport::throttle(const std::shared_ptr<Connection>& conn, Clock::duration delay) {
+    auto resumeAt = Clock::now() + std::max<Clock::duration>(delay, std::chrono::milliseconds(1));
+    if (conn->throttleListed) {
+        conn->resumeTime = std::min(conn->resumeTime, resumeAt);
+        return;
+    }
+    conn->throttleListed = true;
+    conn->resumeTime = resumeAt;
+    loops[conn->loopIndex]->throttled.push_back(conn);
+}
+
+void Transport::resumeThrottled(EventLoop* loop) {
+    if (loop->throttled.empty()) {
+        return;
+    }
+
+    auto now = Clock::now();
+    std::vector<std::shared_ptr<Connection>> due;
+    auto it = std::partition(loop->throttled.begin(), loop->throttled.end(),
+                             [now](const std::shared_ptr<Connection>& conn) {
+                                 return !conn->closed.load() && conn->resumeTime > now;
+                             });
+    due.assign(it, loop->throttled.end());
+    loop->throttled.erase(it, loop->throttled.end());
+
+    for (auto& conn : due) {
+        conn->throttleListed = false;
+        if (conn->closed.load()) {
+            continue;
+        }
+
+        // Edge-triggered epoll will not report data that arrived while paused,
+        // so buffered frames are parsed and the socket drained explicitly
+        bool resumeRead = conn->readThrottled;
+        conn->readThrottled = false;
+        conn->writeThrottled = false;
+        if (resumeRead) {
+            if (!parseFrames(conn)) {
+                closeConnection(conn);
+                continue;
+            }
+            handleReadable(conn);
+        }
+        if (!conn->closed.load()) {
+            flushConnection(conn);
+        }
+    }
+}
+
+int Transport::loopTimeout(const EventLoop* loop) const {
+    int timeout = 1000;
+    auto now = Clock::now();
+    for (const auto& conn : loop->throttled) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(conn->resumeTime - now).count() + 1;
+        timeout = std::min<int>(timeout, static_cast<int>(std::max<int64_t>(remaining, 0)));
+    }
+    return timeout;
+}
+
+bool Transport::unregisterConnection(const std::shared_ptr<Connection>& conn) {
+    if (conn->closed.exchange(true)) {
+        return false;
+    }
+
+    std::string peerId = conn->peer->getId();
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        auto it = connections.find(conn->fd);
+        if (it != connections.end() && it->second == conn) {
+            connections.erase(it);
+        }
+        auto peerIt = peerSockets.find(peerId);
+        if (peerIt != peerSockets.end() && peerIt->second == conn->fd) {
+            peerSockets.erase(peerIt);
+        }
+    }
+    conn->peer->setOutboundNotifier(nullptr);
+    return true;
+}
+
+void Transport::closeConnection(const std::shared_ptr<Connection>& conn) {
+    if (!unregisterConnection(conn)) {
+        return;
+    }
+
+    epoll_ctl(loops[conn->loopIndex]->epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+
+    // Bans are remembered by address in the PeerManager, so the peer entry can be reaped
+    conn->peer->setState(PeerState::DISCONNECTED);
+    handler->onPeerDisconnected(conn->peer->getId());
+}
+
+} // namespace pragma
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "peer.h"
+#include "protocol.h"
+#include "message_buffer.h"
+#include "rate_limiter.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Socket state for a single peer connection.
+ * Buffers are only touched by the event loop that owns the socket.
+ */
+struct Connection {
+    int fd;
+    size_t loopIndex;
+    std::shared_ptr<Peer> peer;
+    bool connecting;                       // Non-blocking connect still in progress
+    std::atomic<bool> closed{false};
+    std::atomic<bool> flushPending{false}; // A flush request is already queued on the loop
+
+    // Pooled receive buffer: bytes in [recvStart, recvEnd) have not been framed yet
+    std::shared_ptr<MessageBuffer> recvBuffer;
+    size_t recvStart;
+    size_t recvEnd;
+    
+    // Running checksum of the frame at recvStart, fed as its payload arrives
+    Checksum frameChecksum;
+    size_t frameChecked;                   // Payload bytes already fed to frameChecksum
+
+    // Encoded frames waiting for the socket, shared with other peers' queues
+    std::deque<std::shared_ptr<const MessageBuffer>> sendQueue;
+    size_t sendOffset;                     // Bytes of sendQueue.front() already written
+
+    // Rate limiting: a throttled direction stays paused until resumeTime, which
+    // leaves unread data in the kernel so TCP flow control slows the sender
+    PeerRateLimiter limits;
+    bool readThrottled;
+    bool writeThrottled;
+    bool throttleListed;                   // In the owning loop's throttled list
+    std::chrono::steady_clock::time_point resumeTime;
+
+    // Decoded message the handler refused; offered again before any later frame
+    std::shared_ptr<P2PMessage> heldMessage;
+
+    Connection(int socketFd, size_t loop, std::shared_ptr<Peer> p, bool isConnecting)
+        : fd(socketFd), loopIndex(loop), peer(std::move(p)), connecting(isConnecting),
+          recvStart(0), recvEnd(0), frameChecked(0), sendOffset(0),
+          readThrottled(false), writeThrottled(false), throttleListed(false) {}
+};
+
+/**
+ * Non-blocking TCP transport driven by edge-triggered epoll event loops.
+ * Connections are spread over a small fixed pool of loops, so hundreds of
+ * peers are served by a few threads instead of one thread per peer.
+ */
+class Transport {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct EventLoop {
+        int epollFd = -1;
+        int wakeFd = -1;
+        std::thread thread;
+        std::mutex pendingMutex;
+        std::vector<std::shared_ptr<Connection>> pendingFlush;
+        std::vector<std::shared_ptr<Connection>> pendingClose;
+        std::vector<std::shared_ptr<Connection>> throttled;  // Loop thread only
+    };
+
+    PeerManager* peerManager;
+    NetworkEventHandler* handler;
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::atomic<bool> running{false};
+    std::atomic<size_t> nextLoop{0};
+    std::atomic<bool> acceptCrc32c{false};
+    std::atomic<bool> acceptCompression{false};
+
+    // Bandwidth limits; per-connection buckets are configured when a socket registers
+    RateLimitConfig rateLimits;
+    mutable std::mutex rateLimitsMutex;
+    TokenBucket globalRecvBytes;
+    TokenBucket globalSendBytes;
+    std::atomic<uint64_t> readThrottles{0};
+    std::atomic<uint64_t> writeThrottles{0};
+
+    int listenFd;
+    uint16_t listenPort;
+
+    std::unordered_map<int, std::shared_ptr<Connection>> connections; // fd -> connection
+    std::unordered_map<std::string, int> peerSockets;                 // peerId -> fd
+    mutable std::mutex connectionsMutex;
+
+    // Event loop internals
+    void runLoop(EventLoop* loop);
+    void processPending(EventLoop* loop);
+    void wake(EventLoop* loop);
+    void handleAccept();
+    void handleConnectComplete(const std::shared_ptr<Connection>& conn);
+    void handleReadable(const std::shared_ptr<Connection>& conn);
+    bool parseFrames(const std::shared_ptr<Connection>& conn);
+    bool deliver(const std::shared_ptr<Connection>& conn, const std::string& peerId,
+                 std::shared_ptr<P2PMessage> message);
+    void flushConnection(const std::shared_ptr<Connection>& conn);
+    void scheduleFlush(const std::shared_ptr<Connection>& conn);
+    void closeConnection(const std::shared_ptr<Connection>& conn);
+
+    // Throttling
+    static size_t byteBudget(TokenBucket& peerBucket, TokenBucket& globalBucket, Clock::time_point now,
+                             Clock::duration& wait);
+    void throttle(const std::shared_ptr<Connection>& conn, Clock::duration delay);
+    void resumeThrottled(EventLoop* loop);
+    int loopTimeout(const EventLoop* loop) const;
+
+    // Connection bookkeeping
+    std::shared_ptr<Connection> registerConnection(int fd, std::shared_ptr<Peer> peer, bool connecting);
+    bool armConnection(const std::shared_ptr<Connection>& conn);
+    bool unregisterConnection(const std::shared_ptr<Connection>& conn);  // False if already closed
+    std::shared_ptr<Connection> findConnection(int fd) const;
+
+public:
+    static constexpr size_t HEADER_SIZE = Protocol::HEADER_SIZE;
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+    static constexpr size_t MAX_IDLE_RECV_BUFFER = 4 * READ_CHUNK; // Larger idle buffers go back to the pool
+    static constexpr size_t MAX_IOVECS = 64;
+    static constexpr int MAX_EVENTS = 256;
+    static constexpr auto HANDOFF_RETRY = std::chrono::milliseconds(2); // Retry delay for a refused message
+
+    Transport(PeerManager* peers, NetworkEventHandler* eventHandler, size_t numLoops = 1);
+    ~Transport();
+
+    // Lifecycle
+    bool start();
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+    // Listening socket (port 0 picks an ephemeral port)
+    bool listen(const std::string& bindAddress, uint16_t port);
+    uint16_t getListenPort() const { return listenPort; }
+
+    // Outbound connections and teardown
+    std::shared_ptr<Peer> connect(const NetworkAddress& address);
+    void disconnect(const std::string& peerId);
+    bool isConnected(const std::string& peerId) const;
+    size_t getConnectionCount() const;
+    size_t getLoopCount() const { return loops.size(); }
+    
+    // Whether inbound frames may use CRC32C instead of double SHA-256
+    void setAcceptCrc32c(bool accept) { acceptCrc32c.store(accept); }
+    void setAcceptCompression(bool accept) { acceptCompression.store(accept); }
+
+    // Bandwidth and message-rate limits; per-peer budgets apply to new connections
+    void setRateLimits(const RateLimitConfig& config);
+    RateLimitConfig getRateLimits() const;
+    uint64_t getReadThrottleCount() const { return readThrottles.load(); }
+    uint64_t getWriteThrottleCount() const { return writeThrottles.load(); }
+};
+
+} // namespace pragma
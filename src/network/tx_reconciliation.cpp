@@ -0,0 +1,411 @@
+#include "tx_reconciliation.h"
+#include "../primitives/serialize.h"
+#include "../primitives/siphash.h"
+#include "../primitives/utils.h"
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace pragma {
+
+namespace {
+
+// Murmur3 finalizer; short IDs are already salted hashes, this only spreads them
+uint32_t mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t cellCheck(uint32_t shortId) {
+    return mix32(shortId ^ 0x5BD1E995);
+}
+
+} // namespace
+
+// TxSketch implementation
+TxSketch::TxSketch(size_t capacity) : cells(cellsForCapacity(capacity)) {}
+
+size_t TxSketch::cellsForCapacity(size_t capacity) {
+    // Peeling with three hashes needs about 1.25x the difference for large
+    // differences and proportionally more headroom for small ones
+    size_t wanted = static_cast<size_t>(std::ceil(1.5 * capacity)) + 12;
+    return (wanted + HASH_COUNT - 1) / HASH_COUNT * HASH_COUNT;
+}
+
+TxSketch TxSketch::withCellCount(size_t cellCount) {
+    TxSketch sketch;
+    sketch.cells.resize(cellCount);
+    return sketch;
+}
+
+size_t TxSketch::cellIndex(uint32_t shortId, uint32_t n) const {
+    // One sub-table per hash function so an ID never hits the same cell twice
+    size_t subtable = cells.size() / HASH_COUNT;
+    uint32_t h = mix32(shortId + n * 0x9E3779B9);
+    return n * subtable + h % subtable;
+}
+
+void TxSketch::toggle(uint32_t shortId, int32_t direction) {
+    uint32_t check = cellCheck(shortId);
+    for (uint32_t n = 0; n < HASH_COUNT; ++n) {
+        Cell& cell = cells[cellIndex(shortId, n)];
+        cell.count += direction;
+        cell.keySum ^= shortId;
+        cell.checkSum ^= check;
+    }
+}
+
+void TxSketch::add(uint32_t shortId) {
+    toggle(shortId, 1);
+}
+
+void TxSketch::subtract(const TxSketch& other) {
+    if (other.cells.size() != cells.size()) {
+        throw std::invalid_argument("TxSketch::subtract: sketch sizes differ");
+    }
+    for (size_t i = 0; i < cells.size(); ++i) {
+        cells[i].count -= other.cells[i].count;
+        cells[i].keySum ^= other.cells[i].keySum;
+        cells[i].checkSum ^= other.cells[i].checkSum;
+    }
+}
+
+bool TxSketch::decode(std::vector<uint32_t>& onlyHere, std::vector<uint32_t>& onlyThere) const {
+    TxSketch work = *this;
+    auto isPure = [](const Cell& cell) {
+        return (cell.count == 1 || cell.count == -1) && cell.checkSum == cellCheck(cell.keySum);
+    };
+
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < work.cells.size(); ++i) {
+        if (isPure(work.cells[i])) pending.push_back(i);
+    }
+
+    // Peel pure cells; removing each ID may expose new pure cells
+    while (!pending.empty()) {
+        size_t index = pending.back();
+        pending.pop_back();
+        const Cell& cell = work.cells[index];
+        if (!isPure(cell)) continue;
+
+        uint32_t shortId = cell.keySum;
+        int32_t direction = cell.count;
+        (direction > 0 ? onlyHere : onlyThere).push_back(shortId);
+        work.toggle(shortId, -direction);
+        for (uint32_t n = 0; n < HASH_COUNT; ++n) {
+            size_t neighbour = work.cellIndex(shortId, n);
+            if (isPure(work.cells[neighbour])) pending.push_back(neighbour);
+        }
+    }
+
+    return std::all_of(work.cells.begin(), work.cells.end(), [](const Cell& cell) {
+        return cell.count == 0 && cell.keySum == 0 && cell.checkSum == 0;
+    });
+}
+
+std::vector<uint8_t> TxSketch::serialize() const {
+    std::vector<uint8_t> result;
+    result.reserve(cells.size() * CELL_SIZE);
+    for (const auto& cell : cells) {
+        Serialize::appendUint32LE(result, static_cast<uint32_t>(cell.count));
+        Serialize::appendUint32LE(result, cell.keySum);
+        Serialize::appendUint32LE(result, cell.checkSum);
+    }
+    return result;
+}
+
+bool TxSketch::deserialize(const std::vector<uint8_t>& data, TxSketch& sketch) {
+    size_t cellCount = data.size() / CELL_SIZE;
+    if (data.size() % CELL_SIZE != 0 || cellCount == 0 || cellCount % HASH_COUNT != 0) {
+        return false;
+    }
+
+    ByteSpan span(data);
+    sketch.cells.resize(cellCount);
+    for (size_t i = 0; i < cellCount; ++i) {
+        size_t offset = i * CELL_SIZE;
+        sketch.cells[i].count = static_cast<int32_t>(Serialize::decodeUint32LE(span, offset));
+        sketch.cells[i].keySum = Serialize::decodeUint32LE(span, offset + 4);
+        sketch.cells[i].checkSum = Serialize::decodeUint32LE(span, offset + 8);
+    }
+    return true;
+}
+
+// TxReconciliationTracker implementation
+TxReconciliationTracker::TxReconciliationTracker() : TxReconciliationTracker(Config()) {}
+
+TxReconciliationTracker::TxReconciliationTracker(const Config& cfg) : config(cfg), floodPeerCount(0) {}
+
+uint64_t TxReconciliationTracker::preRegisterPeer(const std::string& peerId) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    PeerState& peer = peers[peerId];
+    if (peer.localSalt == 0) {
+        peer.localSalt = Utils::randomUint64();
+    }
+    return peer.localSalt;
+}
+
+bool TxReconciliationTracker::registerPeer(const std::string& peerId, bool inbound, uint32_t version, uint64_t remoteSalt) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    if (it == peers.end() || it->second.registered || version < VERSION) {
+        return false; // We never offered reconciliation, or the peer repeated itself
+    }
+
+    PeerState& peer = it->second;
+    // Both salts, in canonical order, key the short IDs for this link
+    std::vector<uint8_t> preimage;
+    Serialize::appendString(preimage, "Tx Relay Salting");
+    Serialize::appendUint64LE(preimage, std::min(peer.localSalt, remoteSalt));
+    Serialize::appendUint64LE(preimage, std::max(peer.localSalt, remoteSalt));
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(preimage.data(), preimage.size(), digest);
+    std::memcpy(&peer.k0, digest, 8);
+    std::memcpy(&peer.k1, digest + 8, 8);
+
+    peer.registered = true;
+    peer.initiator = !inbound;
+    if (peer.initiator) {
+        initiatorQueue.push_back(peerId);
+        if (floodPeerCount < config.floodOutboundPeers) {
+            peer.flood = true;
+            floodPeerCount++;
+        }
+    }
+    return true;
+}
+
+void TxReconciliationTracker::forgetPeer(const std::string& peerId) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    if (it == peers.end()) return;
+
+    bool freedFloodSlot = it->second.flood;
+    initiatorQueue.erase(std::remove(initiatorQueue.begin(), initiatorQueue.end(), peerId), initiatorQueue.end());
+    peers.erase(it);
+    if (!freedFloodSlot) return;
+
+    // Hand the slot to the longest-standing outbound peer that only reconciles
+    floodPeerCount--;
+    for (const auto& candidate : initiatorQueue) {
+        auto next = peers.find(candidate);
+        if (next != peers.end() && !next->second.flood) {
+            next->second.flood = true;
+            floodPeerCount++;
+            break;
+        }
+    }
+}
+
+bool TxReconciliationTracker::isPeerRegistered(const std::string& peerId) const {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    return it != peers.end() && it->second.registered;
+}
+
+bool TxReconciliationTracker::shouldFlood(const std::string& peerId) const {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    return it == peers.end() || !it->second.registered || it->second.flood;
+}
+
+bool TxReconciliationTracker::addToSet(const std::string& peerId, const std::string& txid) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    if (it == peers.end() || !it->second.registered) {
+        return false;
+    }
+    it->second.set[shortId(it->second, txid)] = txid;
+    return true;
+}
+
+void TxReconciliationTracker::removeFromSet(const std::string& peerId, const std::string& txid) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    if (it != peers.end() && it->second.registered) {
+        it->second.set.erase(shortId(it->second, txid));
+    }
+}
+
+std::vector<std::string> TxReconciliationTracker::takeOversizedSet(const std::string& peerId) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    std::vector<std::string> txids;
+    auto it = peers.find(peerId);
+    if (it == peers.end() || it->second.set.size() <= config.maxSetSize) {
+        return txids;
+    }
+
+    txids.reserve(it->second.set.size());
+    for (auto& entry : it->second.set) {
+        txids.push_back(std::move(entry.second));
+    }
+    it->second.set.clear();
+    return txids;
+}
+
+std::string TxReconciliationTracker::nextPeerToReconcile(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    if (initiatorQueue.empty() || now < nextRequestTime) {
+        return "";
+    }
+    // Every peer is visited once per requestInterval
+    nextRequestTime = now + config.requestInterval / initiatorQueue.size();
+
+    for (size_t i = 0; i < initiatorQueue.size(); ++i) {
+        std::string peerId = initiatorQueue.front();
+        initiatorQueue.pop_front();
+        initiatorQueue.push_back(peerId);
+
+        auto it = peers.find(peerId);
+        if (it == peers.end()) continue;
+        if (!it->second.awaitingSketch || now - it->second.requestTime > config.responseTimeout) {
+            return peerId;
+        }
+    }
+    return "";
+}
+
+bool TxReconciliationTracker::initiateReconciliation(const std::string& peerId, ReqReconMessage& request,
+                                                     Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    if (it == peers.end() || !it->second.initiator) {
+        return false; // Forgotten between picking and asking, or never ours to drive
+    }
+    PeerState& peer = it->second;
+    peer.awaitingSketch = true;
+    peer.requestTime = now;
+
+    request.setSize = static_cast<uint16_t>(std::min<size_t>(peer.set.size(), 0xFFFF));
+    request.q = static_cast<uint16_t>(config.q * 32767);
+    return true;
+}
+
+TxReconciliationTracker::SketchResult TxReconciliationTracker::handleSketch(const std::string& peerId,
+                                                                            const SketchMessage& sketch,
+                                                                            std::vector<std::string>& announce,
+                                                                            std::vector<uint32_t>& ask) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    if (it == peers.end() || !it->second.initiator || !it->second.awaitingSketch) {
+        return SketchResult::UNEXPECTED;
+    }
+    PeerState& peer = it->second;
+    peer.awaitingSketch = false;
+
+    TxSketch remote;
+    if (!TxSketch::deserialize(sketch.sketch, remote)) {
+        return SketchResult::UNEXPECTED;
+    }
+
+    // Our sketch must match the responder's size for the cells to line up
+    TxSketch difference = TxSketch::withCellCount(remote.getCellCount());
+    for (const auto& entry : peer.set) {
+        difference.add(entry.first);
+    }
+    difference.subtract(remote);
+
+    std::vector<uint32_t> onlyLocal;
+    SketchResult result = SketchResult::FAILED;
+    if (difference.decode(onlyLocal, ask)) {
+        result = SketchResult::SUCCESS;
+        for (uint32_t id : onlyLocal) {
+            auto entry = peer.set.find(id);
+            if (entry != peer.set.end()) {
+                announce.push_back(std::move(entry->second));
+            }
+        }
+    } else {
+        // Fall back to announcing our whole set
+        ask.clear();
+        for (auto& entry : peer.set) {
+            announce.push_back(std::move(entry.second));
+        }
+    }
+    peer.set.clear();
+    return result;
+}
+
+bool TxReconciliationTracker::handleReconciliationRequest(const std::string& peerId, const ReqReconMessage& request,
+                                                          SketchMessage& response) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    if (it == peers.end() || !it->second.registered || it->second.initiator) {
+        return false;
+    }
+    PeerState& peer = it->second;
+
+    // Freeze the set the sketch describes; later transactions wait for the next round
+    for (auto& entry : peer.set) {
+        peer.snapshot.insert(std::move(entry));
+    }
+    peer.set.clear();
+
+    size_t capacity = estimateCapacity(peer.snapshot.size(), request.setSize, request.q);
+    response.sketch = buildSketch(peer.snapshot, capacity).serialize();
+    return true;
+}
+
+std::vector<std::string> TxReconciliationTracker::handleReconciliationDiff(const std::string& peerId,
+                                                                          const ReconcilDiffMessage& diff) {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    std::vector<std::string> txids;
+    auto it = peers.find(peerId);
+    if (it == peers.end() || !it->second.registered || it->second.initiator) {
+        return txids;
+    }
+    PeerState& peer = it->second;
+
+    if (diff.success) {
+        for (uint32_t id : diff.askShortIds) {
+            auto entry = peer.snapshot.find(id);
+            if (entry != peer.snapshot.end()) {
+                txids.push_back(entry->second);
+            }
+        }
+    } else {
+        for (const auto& entry : peer.snapshot) {
+            txids.push_back(entry.second);
+        }
+    }
+    peer.snapshot.clear();
+    return txids;
+}
+
+size_t TxReconciliationTracker::getSetSize(const std::string& peerId) const {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    auto it = peers.find(peerId);
+    return it != peers.end() ? it->second.set.size() : 0;
+}
+
+size_t TxReconciliationTracker::getRegisteredPeerCount() const {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    return std::count_if(peers.begin(), peers.end(), [](const auto& entry) { return entry.second.registered; });
+}
+
+uint32_t TxReconciliationTracker::shortId(const PeerState& peer, const std::string& txid) const {
+    return static_cast<uint32_t>(SipHash::hash(peer.k0, peer.k1, txid));
+}
+
+size_t TxReconciliationTracker::estimateCapacity(size_t localSize, size_t remoteSize, uint16_t q) const {
+    // Expected difference: the size mismatch plus a fraction of the overlap
+    size_t larger = std::max(localSize, remoteSize);
+    size_t smaller = std::min(localSize, remoteSize);
+    double estimate = (larger - smaller) + (q / 32767.0) * smaller + 1;
+    return std::min(static_cast<size_t>(std::ceil(estimate)), config.maxCapacity);
+}
+
+TxSketch TxReconciliationTracker::buildSketch(const std::unordered_map<uint32_t, std::string>& set, size_t capacity) {
+    TxSketch sketch(capacity);
+    for (const auto& entry : set) {
+        sketch.add(entry.first);
+    }
+    return sketch;
+}
+
+} // namespace pragma
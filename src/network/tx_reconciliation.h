@@ -0,0 +1,144 @@
+#pragma once
+
+#include "protocol.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Set sketch over 32-bit short transaction IDs (an invertible Bloom lookup
+ * table). Subtracting two sketches cancels the common elements; decoding
+ * the result recovers the symmetric difference as long as it is within the
+ * capacity the sketch was sized for. Its size depends only on capacity, not
+ * on the size of the sets.
+ */
+class TxSketch {
+private:
+    static constexpr uint32_t HASH_COUNT = 3;
+
+    struct Cell {
+        int32_t count = 0;
+        uint32_t keySum = 0;
+        uint32_t checkSum = 0;
+    };
+
+    std::vector<Cell> cells;
+
+    size_t cellIndex(uint32_t shortId, uint32_t n) const;
+    void toggle(uint32_t shortId, int32_t direction);
+
+public:
+    static constexpr size_t CELL_SIZE = 12;  // Serialized bytes per cell
+
+    TxSketch() = default;
+    explicit TxSketch(size_t capacity);
+
+    static size_t cellsForCapacity(size_t capacity);
+    static TxSketch withCellCount(size_t cellCount);
+
+    void add(uint32_t shortId);
+    void subtract(const TxSketch& other);
+
+    // Splits the difference into IDs only in this sketch and IDs only in the
+    // subtracted one; false if it could not be fully decoded
+    bool decode(std::vector<uint32_t>& onlyHere, std::vector<uint32_t>& onlyThere) const;
+
+    size_t getCellCount() const { return cells.size(); }
+    std::vector<uint8_t> serialize() const;
+    static bool deserialize(const std::vector<uint8_t>& data, TxSketch& sketch);
+};
+
+/**
+ * Per-peer state for set-reconciliation transaction relay.
+ * Instead of announcing every transaction to every peer, transactions for
+ * reconciling peers collect in a per-peer set. Periodically the side that
+ * opened the connection asks for a sketch of the other side's set, decodes
+ * the difference against its own, announces what the peer lacks and asks
+ * for what it lacks itself. A few outbound peers still get plain flooding
+ * so transactions keep propagating quickly across the network.
+ */
+class TxReconciliationTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        size_t floodOutboundPeers = 4;                          // Outbound peers that keep getting invs
+        std::chrono::milliseconds requestInterval{2000};        // Between requests, round-robin over peers
+        std::chrono::milliseconds responseTimeout{10000};
+        double q = 0.25;                                        // Difference estimate coefficient
+        size_t maxSetSize = 3000;                               // Larger sets are flushed as invs
+        size_t maxCapacity = 2000;
+    };
+
+    static constexpr uint32_t VERSION = 1;
+
+    enum class SketchResult {
+        SUCCESS,        // Difference decoded; announce and ask as returned
+        FAILED,         // Difference too large; our whole set is returned to announce
+        UNEXPECTED      // Unsolicited or malformed sketch
+    };
+
+private:
+    struct PeerState {
+        bool initiator = false;                 // We opened the connection and drive reconciliation
+        bool flood = false;                     // Also announce by inv to this peer
+        bool registered = false;
+        uint64_t localSalt = 0;
+        uint64_t k0 = 0, k1 = 0;                // Short ID key from both salts
+        std::unordered_map<uint32_t, std::string> set;          // Short ID -> txid
+        std::unordered_map<uint32_t, std::string> snapshot;     // Set the peer's sketch was built from
+        bool awaitingSketch = false;
+        Clock::time_point requestTime;
+    };
+
+    Config config;
+    std::unordered_map<std::string, PeerState> peers;
+    std::deque<std::string> initiatorQueue;     // Round-robin order of peers we reconcile with
+    size_t floodPeerCount;
+    Clock::time_point nextRequestTime;
+    mutable std::mutex trackerMutex;
+
+    uint32_t shortId(const PeerState& peer, const std::string& txid) const;
+    size_t estimateCapacity(size_t localSize, size_t remoteSize, uint16_t q) const;
+    static TxSketch buildSketch(const std::unordered_map<uint32_t, std::string>& set, size_t capacity);
+
+public:
+    TxReconciliationTracker();
+    explicit TxReconciliationTracker(const Config& cfg);
+
+    // Registration: our salt is sent in sendtxrcncl, the peer's completes it
+    uint64_t preRegisterPeer(const std::string& peerId);
+    bool registerPeer(const std::string& peerId, bool inbound, uint32_t version, uint64_t remoteSalt);
+    void forgetPeer(const std::string& peerId);
+    bool isPeerRegistered(const std::string& peerId) const;
+    bool shouldFlood(const std::string& peerId) const;
+
+    // Returns false if the peer does not reconcile; the caller announces instead
+    bool addToSet(const std::string& peerId, const std::string& txid);
+    void removeFromSet(const std::string& peerId, const std::string& txid);
+    std::vector<std::string> takeOversizedSet(const std::string& peerId);
+
+    // Initiator side
+    std::string nextPeerToReconcile(Clock::time_point now = Clock::now());
+    // Returns false if the peer is unknown or we are not its initiator
+    bool initiateReconciliation(const std::string& peerId, ReqReconMessage& request,
+                                Clock::time_point now = Clock::now());
+    SketchResult handleSketch(const std::string& peerId, const SketchMessage& sketch,
+                              std::vector<std::string>& announce, std::vector<uint32_t>& ask);
+
+    // Responder side
+    bool handleReconciliationRequest(const std::string& peerId, const ReqReconMessage& request,
+                                     SketchMessage& response);
+    std::vector<std::string> handleReconciliationDiff(const std::string& peerId, const ReconcilDiffMessage& diff);
+
+    // Status
+    size_t getSetSize(const std::string& peerId) const;
+    size_t getRegisteredPeerCount() const;
+};
+
+} // namespace pragma
@@ -0,0 +1,121 @@
+#include "tx_request.h"
+#include <algorithm>
+
+namespace pragma {
+
+// TxRequestTracker implementation
+TxRequestTracker::TxRequestTracker() : TxRequestTracker(Config()) {}
+
+TxRequestTracker::TxRequestTracker(const Config& cfg) : config(cfg), nextExpiry(Clock::time_point::max()) {}
+
+bool TxRequestTracker::onAnnounced(const std::string& peerId, const std::string& txid, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = requests.find(txid);
+    if (it == requests.end()) {
+        if (requests.size() >= config.maxTracked) {
+            return true;
+        }
+        Request& request = requests[txid];
+        request.peerId = peerId;
+        request.expiry = now + config.requestTimeout;
+        nextExpiry = std::min(nextExpiry, request.expiry);
+        return true;
+    }
+
+    Request& request = it->second;
+    if (request.peerId == peerId) {
+        return false;
+    }
+    if (request.peerId.empty()) {
+        // The peer we asked left; take over without waiting for expire()
+        request.peerId = peerId;
+        request.expiry = now + config.requestTimeout;
+        nextExpiry = std::min(nextExpiry, request.expiry);
+        return true;
+    }
+    if (request.announcers.size() < config.maxAnnouncers &&
+        std::find(request.announcers.begin(), request.announcers.end(), peerId) == request.announcers.end()) {
+        request.announcers.push_back(peerId);
+    }
+    return false;
+}
+
+void TxRequestTracker::onReceived(const std::string& txid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.erase(txid);
+}
+
+std::string TxRequestTracker::onNotFound(const std::string& peerId, const std::string& txid, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = requests.find(txid);
+    if (it == requests.end() || it->second.peerId != peerId) {
+        return "";
+    }
+
+    Request& request = it->second;
+    if (request.announcers.empty()) {
+        requests.erase(it);
+        return "";
+    }
+    request.peerId = std::move(request.announcers.front());
+    request.announcers.pop_front();
+    request.expiry = now + config.requestTimeout;
+    nextExpiry = std::min(nextExpiry, request.expiry);
+    return request.peerId;
+}
+
+std::unordered_map<std::string, std::vector<std::string>> TxRequestTracker::expire(Clock::time_point now) {
+    std::unordered_map<std::string, std::vector<std::string>> reassigned;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (now < nextExpiry) {
+        return reassigned;
+    }
+
+    nextExpiry = Clock::time_point::max();
+    for (auto it = requests.begin(); it != requests.end();) {
+        Request& request = it->second;
+        if (request.expiry > now) {
+            nextExpiry = std::min(nextExpiry, request.expiry);
+            ++it;
+            continue;
+        }
+        if (request.announcers.empty()) {
+            it = requests.erase(it);
+            continue;
+        }
+
+        request.peerId = std::move(request.announcers.front());
+        request.announcers.pop_front();
+        request.expiry = now + config.requestTimeout;
+        nextExpiry = std::min(nextExpiry, request.expiry);
+        reassigned[request.peerId].push_back(it->first);
+        ++it;
+    }
+    return reassigned;
+}
+
+void TxRequestTracker::removePeer(const std::string& peerId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [txid, request] : requests) {
+        request.announcers.erase(std::remove(request.announcers.begin(), request.announcers.end(), peerId),
+                                 request.announcers.end());
+        if (request.peerId == peerId) {
+            request.peerId.clear();
+            request.expiry = Clock::time_point::min();
+            nextExpiry = Clock::time_point::min();
+        }
+    }
+}
+
+size_t TxRequestTracker::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requests.size();
+}
+
+std::string TxRequestTracker::getRequestPeer(const std::string& txid) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = requests.find(txid);
+    return it != requests.end() ? it->second.peerId : "";
+}
+
+} // namespace pragma
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * In-flight transaction request table.
+ * Each announced transaction is requested from one peer at a time; peers
+ * that announce it meanwhile are remembered as fallbacks instead of being
+ * asked as well. If the peer answers notfound, the next fallback is asked
+ * at once; if the request times out, or the peer disconnects, on the next
+ * expire(). A transaction is thus downloaded and validated once however
+ * many peers announce it. Thread-safe.
+ */
+class TxRequestTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        std::chrono::milliseconds requestTimeout{30000};
+        size_t maxAnnouncers = 8;       // Fallback peers remembered per transaction
+        size_t maxTracked = 100000;     // Beyond this, announcements are requested untracked
+    };
+
+private:
+    struct Request {
+        std::string peerId;             // Peer asked; empty once it disconnected
+        Clock::time_point expiry;
+        std::deque<std::string> announcers;
+    };
+
+    Config config;
+    std::unordered_map<std::string, Request> requests;
+    Clock::time_point nextExpiry;       // No request expires before this
+    mutable std::mutex mutex;
+
+public:
+    TxRequestTracker();
+    explicit TxRequestTracker(const Config& cfg);
+
+    // True if the peer should be asked for the transaction now
+    bool onAnnounced(const std::string& peerId, const std::string& txid, Clock::time_point now = Clock::now());
+    void onReceived(const std::string& txid);
+
+    // The peer asked cannot serve the transaction: moves the request to the
+    // next announcer and returns it, or forgets the transaction and returns
+    // empty. Ignored (empty) unless peerId holds the request
+    std::string onNotFound(const std::string& peerId, const std::string& txid, Clock::time_point now = Clock::now());
+
+    // Moves expired requests to their next announcer and returns the new
+    // requests by peer; transactions nobody else announced are forgotten
+    std::unordered_map<std::string, std::vector<std::string>> expire(Clock::time_point now = Clock::now());
+
+    // The peer's requests are reassigned by the next expire()
+    void removePeer(const std::string& peerId);
+
+    // Status
+    size_t size() const;
+    std::string getRequestPeer(const std::string& txid) const;  // Empty if not in flight
+};
+
+} // namespace pragma
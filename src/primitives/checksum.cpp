@@ -0,0 +1,162 @@
+#include "checksum.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define PRAGMA_CRC32C_X86 1
+#endif
+
+namespace pragma {
+
+namespace {
+
+constexpr uint32_t CRC32C_POLY = 0x82F63B78; // Reflected Castagnoli polynomial
+
+// Slicing-by-8 lookup tables for the portable CRC32C path
+struct Crc32cTables {
+    std::array<std::array<uint32_t, 256>, 8> table;
+
+    Crc32cTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (size_t slice = 1; slice < 8; ++slice) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const Crc32cTables& crcTables() {
+    static const Crc32cTables tables;
+    return tables;
+}
+
+uint32_t crc32cSoftware(uint32_t crc, const uint8_t* data, size_t length) {
+    const auto& t = crcTables().table;
+
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        word ^= crc;
+        crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^
+              t[5][(word >> 16) & 0xFF] ^ t[4][(word >> 24) & 0xFF] ^
+              t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^
+              t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef PRAGMA_CRC32C_X86
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(uint32_t crc, const uint8_t* data, size_t length) {
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    while (length-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+bool detectHardwareCrc32c() {
+#ifdef PRAGMA_CRC32C_X86
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+// Checksum implementation
+Checksum::Checksum(ChecksumType checksumType) {
+    reset(checksumType);
+}
+
+void Checksum::reset(ChecksumType checksumType) {
+    type = checksumType;
+    if (type == ChecksumType::CRC32C) {
+        crc = 0xFFFFFFFF;
+    } else {
+        SHA256_Init(&sha);
+    }
+}
+
+void Checksum::update(const uint8_t* data, size_t length) {
+    if (type == ChecksumType::CRC32C) {
+        crc = crc32cUpdate(crc, data, length);
+    } else {
+        SHA256_Update(&sha, data, length);
+    }
+}
+
+uint32_t Checksum::finalize() {
+    if (type == ChecksumType::CRC32C) {
+        return crc ^ 0xFFFFFFFF;
+    }
+
+    unsigned char first[SHA256_DIGEST_LENGTH];
+    unsigned char second[SHA256_DIGEST_LENGTH];
+    SHA256_Final(first, &sha);
+    SHA256(first, SHA256_DIGEST_LENGTH, second);
+
+    uint32_t result;
+    std::memcpy(&result, second, sizeof(result));
+    return result;
+}
+
+uint32_t Checksum::compute(ChecksumType checksumType, const uint8_t* data, size_t length) {
+    return checksumType == ChecksumType::CRC32C ? crc32c(data, length) : doubleSha256(data, length);
+}
+
+uint32_t Checksum::doubleSha256(const uint8_t* data, size_t length) {
+    unsigned char first[SHA256_DIGEST_LENGTH];
+    unsigned char second[SHA256_DIGEST_LENGTH];
+    SHA256(data, length, first);
+    SHA256(first, SHA256_DIGEST_LENGTH, second);
+
+    uint32_t result;
+    std::memcpy(&result, second, sizeof(result));
+    return result;
+}
+
+uint32_t Checksum::crc32c(const uint8_t* data, size_t length) {
+    return crc32cUpdate(0xFFFFFFFF, data, length) ^ 0xFFFFFFFF;
+}
+
+uint32_t Checksum::crc32cUpdate(uint32_t crc, const uint8_t* data, size_t length) {
+#ifdef PRAGMA_CRC32C_X86
+    if (hasHardwareCrc32c()) {
+        return crc32cHardware(crc, data, length);
+    }
+#endif
+    return crc32cSoftware(crc, data, length);
+}
+
+bool Checksum::hasHardwareCrc32c() {
+    static const bool supported = detectHardwareCrc32c();
+    return supported;
+}
+
+} // namespace pragma
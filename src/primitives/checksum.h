@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <openssl/sha.h>
+
+namespace pragma {
+
+/**
+ * Algorithms available for P2P frame checksums
+ */
+enum class ChecksumType : uint8_t {
+    DOUBLE_SHA256 = 0,  // First 4 bytes of SHA256(SHA256(payload)), Bitcoin-style
+    CRC32C = 1          // Castagnoli CRC, hardware accelerated; trusted links only
+};
+
+/**
+ * Frame checksum that can be computed in one shot or fed incrementally as
+ * bytes arrive, so verification costs no extra pass over the payload.
+ */
+class Checksum {
+private:
+    ChecksumType type;
+    SHA256_CTX sha;
+    uint32_t crc;
+
+public:
+    explicit Checksum(ChecksumType checksumType = ChecksumType::DOUBLE_SHA256);
+
+    // Incremental interface
+    void reset(ChecksumType checksumType);
+    void update(const uint8_t* data, size_t length);
+    uint32_t finalize();
+    ChecksumType getType() const { return type; }
+
+    // One-shot helpers
+    static uint32_t compute(ChecksumType checksumType, const uint8_t* data, size_t length);
+    static uint32_t doubleSha256(const uint8_t* data, size_t length);
+    static uint32_t crc32c(const uint8_t* data, size_t length);
+
+    // Raw CRC32C register update (pre/post inversion is up to the caller)
+    static uint32_t crc32cUpdate(uint32_t crc, const uint8_t* data, size_t length);
+    static bool hasHardwareCrc32c();
+};
+
+} // namespace pragma
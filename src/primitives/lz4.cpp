@@ -0,0 +1,180 @@
+#include "lz4.h"
+#include <cstring>
+
+namespace pragma {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;     // The block always ends in at least this many literals
+constexpr size_t MF_LIMIT = 12;         // No match may start closer than this to the end
+constexpr size_t MAX_DISTANCE = 65535;
+constexpr int HASH_LOG = 12;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hashPosition(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+void appendLength(std::vector<uint8_t>& out, size_t length) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(255);
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+void appendSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength,
+                    size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength - MIN_MATCH;
+    uint8_t token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+    if (matchLength > 0) {
+        token |= static_cast<uint8_t>(matchCode >= 15 ? 15 : matchCode);
+    }
+    out.push_back(token);
+    if (literalLength >= 15) {
+        appendLength(out, literalLength - 15);
+    }
+    out.insert(out.end(), literals, literals + literalLength);
+
+    // The final sequence is literals only
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back(static_cast<uint8_t>(offset & 0xFF));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (matchCode >= 15) {
+        appendLength(out, matchCode - 15);
+    }
+}
+
+// Reads an extended length; false if the input ends first
+bool readLength(const uint8_t* data, size_t size, size_t& pos, size_t& length) {
+    uint8_t byte;
+    do {
+        if (pos >= size) {
+            return false;
+        }
+        byte = data[pos++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+void LZ4::compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + maxCompressedSize(size));
+
+    size_t anchor = 0;
+    if (size > MF_LIMIT) {
+        std::vector<uint32_t> table(size_t(1) << HASH_LOG, 0);   // Position + 1; 0 is empty
+        size_t matchStartLimit = size - MF_LIMIT;
+        size_t matchEndLimit = size - LAST_LITERALS;
+
+        size_t pos = 0;
+        while (pos < matchStartLimit) {
+            uint32_t sequence = read32(data + pos);
+            uint32_t& slot = table[hashPosition(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos + 1);
+
+            if (candidate == 0 || pos - (candidate - 1) > MAX_DISTANCE || read32(data + candidate - 1) != sequence) {
+                pos++;
+                continue;
+            }
+            size_t ref = candidate - 1;
+
+            // Extend the match backwards into pending literals, then forwards
+            while (pos > anchor && ref > 0 && data[pos - 1] == data[ref - 1]) {
+                pos--;
+                ref--;
+            }
+            size_t length = MIN_MATCH;
+            while (pos + length < matchEndLimit && data[pos + length] == data[ref + length]) {
+                length++;
+            }
+
+            appendSequence(out, data + anchor, pos - anchor, pos - ref, length);
+            pos += length;
+            anchor = pos;
+            if (pos - 2 < matchStartLimit) {
+                table[hashPosition(read32(data + pos - 2))] = static_cast<uint32_t>(pos - 2 + 1);
+            }
+        }
+    }
+    appendSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+bool LZ4::decompress(const uint8_t* data, size_t size, size_t originalSize, std::vector<uint8_t>& out) {
+    size_t base = out.size();
+    out.resize(base + originalSize);
+    uint8_t* dest = out.data() + base;
+    size_t produced = 0;
+    size_t pos = 0;
+
+    auto fail = [&out, base]() {
+        out.resize(base);
+        return false;
+    };
+
+    while (true) {
+        if (pos >= size) {
+            return fail();
+        }
+        uint8_t token = data[pos++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(data, size, pos, literalLength)) {
+            return fail();
+        }
+        if (literalLength > size - pos || literalLength > originalSize - produced) {
+            return fail();
+        }
+        if (literalLength > 0) {
+            std::memcpy(dest + produced, data + pos, literalLength);
+        }
+        pos += literalLength;
+        produced += literalLength;
+
+        if (pos == size) {
+            break; // Last sequence carries no match
+        }
+
+        if (size - pos < 2) {
+            return fail();
+        }
+        size_t offset = data[pos] | (static_cast<size_t>(data[pos + 1]) << 8);
+        pos += 2;
+        if (offset == 0 || offset > produced) {
+            return fail();
+        }
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(data, size, pos, matchLength)) {
+            return fail();
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > originalSize - produced) {
+            return fail();
+        }
+
+        // Byte-wise so overlapping matches replicate short runs
+        const uint8_t* from = dest + produced - offset;
+        for (size_t i = 0; i < matchLength; ++i) {
+            dest[produced + i] = from[i];
+        }
+        produced += matchLength;
+    }
+
+    if (produced != originalSize) {
+        return fail();
+    }
+    return true;
+}
+
+} // namespace pragma
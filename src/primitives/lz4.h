@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * LZ4 block-format codec, used to compress large P2P payloads.
+ * Greedy single-pass matcher with a 4K-entry hash table: fast enough to run
+ * on every block we serve, and the hex-string hashes that fill our payloads
+ * compress well. Each call is independent, so one compressed frame can be
+ * shared by every peer it is sent to.
+ */
+class LZ4 {
+public:
+    // Appends the compressed form of data to out
+    static void compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+    // Appends exactly originalSize decompressed bytes to out; false if the
+    // input is malformed or does not expand to that size
+    static bool decompress(const uint8_t* data, size_t size, size_t originalSize, std::vector<uint8_t>& out);
+
+    static size_t maxCompressedSize(size_t size) { return size + size / 255 + 16; }
+};
+
+} // namespace pragma
@@ -0,0 +1,86 @@
+#include "rolling_bloom.h"
+#include "siphash.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pragma {
+
+// RollingBloomFilter implementation
+RollingBloomFilter::RollingBloomFilter(uint32_t nElements, double fpRate) {
+    double logFpRate = std::log(fpRate);
+    // Optimal number of hash functions for the requested false-positive rate
+    hashFunctions = std::max(1, std::min(static_cast<int>(std::round(logFpRate / std::log(0.5))), 50));
+    // Three generations of half the requested size each: between nElements
+    // and 1.5 * nElements of the most recent keys are always remembered
+    entriesPerGeneration = (nElements + 1) / 2;
+    uint32_t maxElements = entriesPerGeneration * 3;
+    // Filter size for maxElements at fpRate with hashFunctions functions
+    uint64_t filterBits = static_cast<uint64_t>(std::ceil(
+        -1.0 * hashFunctions * maxElements / std::log(1.0 - std::exp(logFpRate / hashFunctions))));
+    data.assign(((filterBits + 63) / 64) << 1, 0);
+
+    k0 = Utils::randomUint64();
+    k1 = Utils::randomUint64();
+    reset();
+}
+
+void RollingBloomFilter::cellPosition(uint64_t h1, uint64_t h2, uint32_t n, size_t& word, uint32_t& bit) const {
+    // Kirsch-Mitzenmacher: hash n is derived from two independent hashes
+    uint64_t h = h1 + n * h2;
+    bit = static_cast<uint32_t>(h & 63);
+    // Map the high bits onto the word pairs without a modulo
+    size_t pairs = data.size() >> 1;
+    word = static_cast<size_t>((static_cast<unsigned __int128>(h >> 6) * pairs) >> 58) << 1;
+}
+
+void RollingBloomFilter::insert(const std::string& key) {
+    if (entriesThisGeneration == entriesPerGeneration) {
+        entriesThisGeneration = 0;
+        generation = generation % 3 + 1;
+        // Clear every cell that belongs to the generation being reused
+        uint64_t mask1 = 0 - static_cast<uint64_t>(generation & 1);
+        uint64_t mask2 = 0 - static_cast<uint64_t>(generation >> 1);
+        for (size_t p = 0; p < data.size(); p += 2) {
+            uint64_t low = data[p];
+            uint64_t high = data[p + 1];
+            uint64_t keep = (low ^ mask1) | (high ^ mask2);
+            data[p] = low & keep;
+            data[p + 1] = high & keep;
+        }
+    }
+    entriesThisGeneration++;
+
+    uint64_t h1 = SipHash::hash(k0, k1, key);
+    uint64_t h2 = SipHash::hash(k1, k0, key) | 1;
+    for (uint32_t n = 0; n < hashFunctions; ++n) {
+        size_t word;
+        uint32_t bit;
+        cellPosition(h1, h2, n, word, bit);
+        data[word] = (data[word] & ~(1ULL << bit)) | (static_cast<uint64_t>(generation & 1) << bit);
+        data[word + 1] = (data[word + 1] & ~(1ULL << bit)) | (static_cast<uint64_t>(generation >> 1) << bit);
+    }
+}
+
+bool RollingBloomFilter::contains(const std::string& key) const {
+    uint64_t h1 = SipHash::hash(k0, k1, key);
+    uint64_t h2 = SipHash::hash(k1, k0, key) | 1;
+    for (uint32_t n = 0; n < hashFunctions; ++n) {
+        size_t word;
+        uint32_t bit;
+        cellPosition(h1, h2, n, word, bit);
+        // A cell in any live generation is non-zero in one of the two planes
+        if (!(((data[word] | data[word + 1]) >> bit) & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RollingBloomFilter::reset() {
+    entriesThisGeneration = 0;
+    generation = 1;
+    std::fill(data.begin(), data.end(), 0);
+}
+
+} // namespace pragma
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Fixed-memory rolling bloom filter.
+ * Remembers roughly the last nElements to 1.5 * nElements inserted keys with
+ * the given false-positive rate. Each cell holds a 2-bit generation number;
+ * starting a new generation wipes the cells of the oldest one, so items age
+ * out in insertion order instead of being forgotten at random. Not
+ * thread-safe.
+ */
+class RollingBloomFilter {
+private:
+    uint32_t hashFunctions;
+    uint32_t entriesPerGeneration;
+    uint32_t entriesThisGeneration;
+    uint32_t generation;              // 1..3; 0 marks an empty cell
+    std::vector<uint64_t> data;       // Pairs of words: low and high generation bit planes
+    uint64_t k0, k1;                  // Random SipHash key, so peers cannot craft collisions
+
+    void cellPosition(uint64_t h1, uint64_t h2, uint32_t n, size_t& word, uint32_t& bit) const;
+
+public:
+    RollingBloomFilter(uint32_t nElements, double fpRate);
+
+    void insert(const std::string& key);
+    bool contains(const std::string& key) const;
+    void reset();
+
+    size_t getMemoryUsage() const { return data.size() * sizeof(uint64_t); }
+    uint32_t getHashFunctions() const { return hashFunctions; }
+};
+
+} // namespace pragma
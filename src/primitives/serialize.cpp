@@ -26,7 +26,7 @@ std::vector<uint8_t> Serialize::encodeVarInt(uint64_t value) {
     return result;
 }
 
-std::pair<uint64_t, size_t> Serialize::decodeVarInt(const std::vector<uint8_t>& data, size_t offset) {
+std::pair<uint64_t, size_t> Serialize::decodeVarInt(ByteSpan data, size_t offset) {
     if (offset >= data.size()) {
         throw std::runtime_error("VarInt decode: insufficient data");
     }
@@ -72,22 +72,22 @@ std::vector<uint8_t> Serialize::encodeUint64LE(uint64_t value) {
     return toLittleEndian(value);
 }
 
-uint8_t Serialize::decodeUint8LE(const std::vector<uint8_t>& data, size_t offset) {
+uint8_t Serialize::decodeUint8LE(ByteSpan data, size_t offset) {
     if (offset >= data.size()) {
         throw std::runtime_error("Uint8 decode: insufficient data");
     }
     return data[offset];
 }
 
-uint16_t Serialize::decodeUint16LE(const std::vector<uint8_t>& data, size_t offset) {
+uint16_t Serialize::decodeUint16LE(ByteSpan data, size_t offset) {
     return fromLittleEndian<uint16_t>(data, offset);
 }
 
-uint32_t Serialize::decodeUint32LE(const std::vector<uint8_t>& data, size_t offset) {
+uint32_t Serialize::decodeUint32LE(ByteSpan data, size_t offset) {
     return fromLittleEndian<uint32_t>(data, offset);
 }
 
-uint64_t Serialize::decodeUint64LE(const std::vector<uint8_t>& data, size_t offset) {
+uint64_t Serialize::decodeUint64LE(ByteSpan data, size_t offset) {
     return fromLittleEndian<uint64_t>(data, offset);
 }
 
@@ -102,10 +102,10 @@ std::vector<uint8_t> Serialize::encodeString(const std::string& str) {
     return result;
 }
 
-std::pair<std::string, size_t> Serialize::decodeString(const std::vector<uint8_t>& data, size_t offset) {
+std::pair<std::string, size_t> Serialize::decodeString(ByteSpan data, size_t offset) {
     auto [length, lengthSize] = decodeVarInt(data, offset);
     
-    if (offset + lengthSize + length > data.size()) {
+    if (length > data.size() || offset + lengthSize + length > data.size()) {
         throw std::runtime_error("String decode: insufficient data");
     }
     
@@ -133,6 +133,53 @@ std::vector<uint8_t> Serialize::combine(const std::vector<std::vector<uint8_t>>&
     return result;
 }
 
+void Serialize::appendVarInt(std::vector<uint8_t>& out, uint64_t value) {
+    if (value < 0xFD) {
+        out.push_back(static_cast<uint8_t>(value));
+    } else if (value <= 0xFFFF) {
+        out.push_back(0xFD);
+        appendLittleEndian(out, static_cast<uint16_t>(value));
+    } else if (value <= 0xFFFFFFFF) {
+        out.push_back(0xFE);
+        appendLittleEndian(out, static_cast<uint32_t>(value));
+    } else {
+        out.push_back(0xFF);
+        appendLittleEndian(out, value);
+    }
+}
+
+void Serialize::appendUint8LE(std::vector<uint8_t>& out, uint8_t value) {
+    out.push_back(value);
+}
+
+void Serialize::appendUint16LE(std::vector<uint8_t>& out, uint16_t value) {
+    appendLittleEndian(out, value);
+}
+
+void Serialize::appendUint32LE(std::vector<uint8_t>& out, uint32_t value) {
+    appendLittleEndian(out, value);
+}
+
+void Serialize::appendUint64LE(std::vector<uint8_t>& out, uint64_t value) {
+    appendLittleEndian(out, value);
+}
+
+void Serialize::appendString(std::vector<uint8_t>& out, const std::string& str) {
+    appendVarInt(out, str.length());
+    out.insert(out.end(), str.begin(), str.end());
+}
+
+void Serialize::appendBytes(std::vector<uint8_t>& out, const uint8_t* data, size_t length) {
+    out.insert(out.end(), data, data + length);
+}
+
+template<typename T>
+void Serialize::appendLittleEndian(std::vector<uint8_t>& out, T value) {
+    size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
 template<typename T>
 std::vector<uint8_t> Serialize::toLittleEndian(T value) {
     std::vector<uint8_t> result(sizeof(T));
@@ -141,7 +188,7 @@ std::vector<uint8_t> Serialize::toLittleEndian(T value) {
 }
 
 template<typename T>
-T Serialize::fromLittleEndian(const std::vector<uint8_t>& data, size_t offset) {
+T Serialize::fromLittleEndian(ByteSpan data, size_t offset) {
     if (offset + sizeof(T) > data.size()) {
         throw std::runtime_error("Insufficient data for type conversion");
     }
@@ -155,8 +202,8 @@ T Serialize::fromLittleEndian(const std::vector<uint8_t>& data, size_t offset) {
 template std::vector<uint8_t> Serialize::toLittleEndian<uint16_t>(uint16_t);
 template std::vector<uint8_t> Serialize::toLittleEndian<uint32_t>(uint32_t);
 template std::vector<uint8_t> Serialize::toLittleEndian<uint64_t>(uint64_t);
-template uint16_t Serialize::fromLittleEndian<uint16_t>(const std::vector<uint8_t>&, size_t);
-template uint32_t Serialize::fromLittleEndian<uint32_t>(const std::vector<uint8_t>&, size_t);
-template uint64_t Serialize::fromLittleEndian<uint64_t>(const std::vector<uint8_t>&, size_t);
+template uint16_t Serialize::fromLittleEndian<uint16_t>(ByteSpan, size_t);
+template uint32_t Serialize::fromLittleEndian<uint32_t>(ByteSpan, size_t);
+template uint64_t Serialize::fromLittleEndian<uint64_t>(ByteSpan, size_t);
 
 } // namespace pragma
@@ -6,6 +6,27 @@
 
 namespace pragma {
 
+/**
+ * Non-owning view over serialized bytes (e.g. a frame inside a receive buffer)
+ */
+struct ByteSpan {
+    const uint8_t* ptr;
+    size_t len;
+    
+    ByteSpan() : ptr(nullptr), len(0) {}
+    ByteSpan(const uint8_t* p, size_t n) : ptr(p), len(n) {}
+    ByteSpan(const std::vector<uint8_t>& bytes) : ptr(bytes.data()), len(bytes.size()) {}
+    
+    const uint8_t* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    const uint8_t* begin() const { return ptr; }
+    const uint8_t* end() const { return ptr + len; }
+    uint8_t operator[](size_t i) const { return ptr[i]; }
+    
+    ByteSpan subspan(size_t offset, size_t count) const { return ByteSpan(ptr + offset, count); }
+};
+
 /**
  * Serialization utilities for blockchain data structures
  */
@@ -13,21 +34,21 @@ class Serialize {
 public:
     // VarInt encoding/decoding (Bitcoin-style)
     static std::vector<uint8_t> encodeVarInt(uint64_t value);
-    static std::pair<uint64_t, size_t> decodeVarInt(const std::vector<uint8_t>& data, size_t offset = 0);
+    static std::pair<uint64_t, size_t> decodeVarInt(ByteSpan data, size_t offset = 0);
     
     // Little-endian encoding/decoding
     static std::vector<uint8_t> encodeUint8LE(uint8_t value);
     static std::vector<uint8_t> encodeUint16LE(uint16_t value);
     static std::vector<uint8_t> encodeUint32LE(uint32_t value);
     static std::vector<uint8_t> encodeUint64LE(uint64_t value);
-    static uint8_t decodeUint8LE(const std::vector<uint8_t>& data, size_t offset = 0);
-    static uint16_t decodeUint16LE(const std::vector<uint8_t>& data, size_t offset = 0);
-    static uint32_t decodeUint32LE(const std::vector<uint8_t>& data, size_t offset = 0);
-    static uint64_t decodeUint64LE(const std::vector<uint8_t>& data, size_t offset = 0);
+    static uint8_t decodeUint8LE(ByteSpan data, size_t offset = 0);
+    static uint16_t decodeUint16LE(ByteSpan data, size_t offset = 0);
+    static uint32_t decodeUint32LE(ByteSpan data, size_t offset = 0);
+    static uint64_t decodeUint64LE(ByteSpan data, size_t offset = 0);
     
     // String encoding (length-prefixed)
     static std::vector<uint8_t> encodeString(const std::string& str);
-    static std::pair<std::string, size_t> decodeString(const std::vector<uint8_t>& data, size_t offset = 0);
+    static std::pair<std::string, size_t> decodeString(ByteSpan data, size_t offset = 0);
     
     // Raw bytes
     static std::vector<uint8_t> encodeBytes(const std::vector<uint8_t>& bytes);
@@ -36,13 +57,25 @@ public:
     // Combine multiple byte vectors
     static std::vector<uint8_t> combine(const std::vector<std::vector<uint8_t>>& parts);
     
+    // Append helpers - write directly into an existing buffer without temporaries
+    static void appendVarInt(std::vector<uint8_t>& out, uint64_t value);
+    static void appendUint8LE(std::vector<uint8_t>& out, uint8_t value);
+    static void appendUint16LE(std::vector<uint8_t>& out, uint16_t value);
+    static void appendUint32LE(std::vector<uint8_t>& out, uint32_t value);
+    static void appendUint64LE(std::vector<uint8_t>& out, uint64_t value);
+    static void appendString(std::vector<uint8_t>& out, const std::string& str);
+    static void appendBytes(std::vector<uint8_t>& out, const uint8_t* data, size_t length);
+    
 private:
     // Helper functions for endian conversion
     template<typename T>
     static std::vector<uint8_t> toLittleEndian(T value);
     
     template<typename T>
-    static T fromLittleEndian(const std::vector<uint8_t>& data, size_t offset);
+    static T fromLittleEndian(ByteSpan data, size_t offset);
+    
+    template<typename T>
+    static void appendLittleEndian(std::vector<uint8_t>& out, T value);
 };
 
 } // namespace pragma
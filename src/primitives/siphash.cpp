@@ -0,0 +1,60 @@
+#include "siphash.h"
+#include <cstring>
+
+namespace pragma {
+
+namespace {
+
+inline uint64_t rotl(uint64_t x, int b) {
+    return (x << b) | (x >> (64 - b));
+}
+
+inline void sipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+}
+
+} // namespace
+
+uint64_t SipHash::hash(uint64_t k0, uint64_t k1, const uint8_t* data, size_t length) {
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    size_t blocks = length / 8;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t m;
+        std::memcpy(&m, data + i * 8, 8);
+        v3 ^= m;
+        sipRound(v0, v1, v2, v3);
+        sipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    // Final block: remaining bytes plus the message length in the top byte
+    uint64_t last = static_cast<uint64_t>(length) << 56;
+    const uint8_t* tail = data + blocks * 8;
+    for (size_t i = 0; i < (length & 7); ++i) {
+        last |= static_cast<uint64_t>(tail[i]) << (8 * i);
+    }
+    v3 ^= last;
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xFF;
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+uint64_t SipHash::hash(uint64_t k0, uint64_t k1, const std::string& data) {
+    return hash(k0, k1, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+}
+
+} // namespace pragma
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace pragma {
+
+/**
+ * SipHash-2-4 keyed hash, used where short salted identifiers are needed
+ * (compact block short IDs, filters). Fast for small inputs and resistant to
+ * collisions chosen by a remote peer that does not know the key.
+ */
+class SipHash {
+public:
+    static uint64_t hash(uint64_t k0, uint64_t k1, const uint8_t* data, size_t length);
+    static uint64_t hash(uint64_t k0, uint64_t k1, const std::string& data);
+};
+
+} // namespace pragma
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "checksum.h"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
@@ -99,12 +100,12 @@ void Utils::logInfo(const std::string& message) {
 }
 
 uint32_t Utils::calculateChecksum(const std::vector<uint8_t>& data) {
-    // Simple checksum calculation - in production, use SHA256 double hash
-    uint32_t checksum = 0;
-    for (size_t i = 0; i < data.size(); ++i) {
-        checksum += data[i] * (i + 1);
-    }
-    return checksum;
+    return calculateChecksum(data.data(), data.size());
+}
+
+uint32_t Utils::calculateChecksum(const uint8_t* data, size_t length) {
+    // First 4 bytes of the double SHA-256 hash
+    return Checksum::doubleSha256(data, length);
 }
 
 void Utils::logWarning(const std::string& message) {
@@ -31,6 +31,7 @@ public:
     
     // Checksum utilities
     static uint32_t calculateChecksum(const std::vector<uint8_t>& data);
+    static uint32_t calculateChecksum(const uint8_t* data, size_t length);
     static uint32_t randomUint32();
     static uint64_t randomUint64();
     
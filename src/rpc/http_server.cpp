@@ -0,0 +1,918 @@
+#include "http_server.h"
+#include "../primitives/utils.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace pragma {
+
+namespace {
+
+constexpr size_t MAX_CHUNK_LINE = 1024;
+
+std::string toLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+std::string trim(const std::string& value) {
+    size_t begin = value.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t");
+    return value.substr(begin, end - begin + 1);
+}
+
+// True if the comma-separated header value lists token (case-insensitive)
+bool hasToken(const std::string& value, const std::string& token) {
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos) comma = value.size();
+        if (toLower(trim(value.substr(start, comma - start))) == token) {
+            return true;
+        }
+        start = comma + 1;
+    }
+    return false;
+}
+
+void setNoDelay(int fd) {
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+} // namespace
+
+// HttpRequest implementation
+std::string HttpRequest::getHeader(const std::string& name) const {
+    for (const auto& [key, value] : headers) {
+        if (key == name) {
+            return value;
+        }
+    }
+    return "";
+}
+
+bool HttpRequest::keepAlive() const {
+    std::string connection = getHeader("connection");
+    if (versionMinor == 0) {
+        return hasToken(connection, "keep-alive");
+    }
+    return !hasToken(connection, "close");
+}
+
+// HttpResponse implementation
+std::string HttpResponse::serialize(bool keepAlive, bool http10) const {
+    std::string result;
+    result.reserve(128 + body.size());
+    result += "HTTP/1.1 " + std::to_string(status) + " " + reasonPhrase(status) + "\r\n";
+    if (!contentType.empty()) {
+        result += "Content-Type: " + contentType + "\r\n";
+    }
+    result += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    if (!keepAlive || close) {
+        result += "Connection: close\r\n";
+    } else if (http10) {
+        result += "Connection: keep-alive\r\n";
+    }
+    for (const auto& [name, value] : headers) {
+        result += name + ": " + value + "\r\n";
+    }
+    result += "\r\n";
+    result += body;
+    return result;
+}
+
+const char* HttpResponse::reasonPhrase(int status) {
+    switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 505: return "HTTP Version Not Supported";
+        default: return "Unknown";
+    }
+}
+
+// HttpRequestParser implementation
+HttpRequestParser::HttpRequestParser() : HttpRequestParser(Limits()) {}
+
+HttpRequestParser::HttpRequestParser(const Limits& limits) : limits_(limits) {
+    reset();
+}
+
+void HttpRequestParser::reset() {
+    state_ = State::HEADERS;
+    request_ = HttpRequest();
+    line_.clear();
+    scanned_ = 0;
+    remaining_ = 0;
+    trailerBytes_ = 0;
+    errorStatus_ = 0;
+}
+
+bool HttpRequestParser::headersComplete() const {
+    return state_ != State::HEADERS && state_ != State::FAILED;
+}
+
+HttpRequestParser::Result HttpRequestParser::fail(int status) {
+    state_ = State::FAILED;
+    errorStatus_ = status;
+    return Result::ERROR;
+}
+
+bool HttpRequestParser::readLine(const char*& data, const char* end, size_t limit, bool& overflow) {
+    const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+    size_t count = newline ? static_cast<size_t>(newline - data) + 1 : static_cast<size_t>(end - data);
+    if (line_.size() + count > limit) {
+        overflow = true;
+        return false;
+    }
+    line_.append(data, count);
+    data += count;
+    if (!newline) {
+        return false;
+    }
+
+    line_.pop_back();
+    if (!line_.empty() && line_.back() == '\r') {
+        line_.pop_back();
+    }
+    return true;
+}
+
+HttpRequestParser::Result HttpRequestParser::feed(const char* data, size_t size, size_t& consumed) {
+    const char* p = data;
+    const char* end = data + size;
+    consumed = 0;
+    if (state_ == State::FAILED) {
+        return Result::ERROR;
+    }
+
+    while (state_ != State::DONE) {
+        if (p == end) {
+            consumed = size;
+            return Result::INCOMPLETE;
+        }
+
+        switch (state_) {
+            case State::HEADERS: {
+                // Empty lines ahead of the request line are ignored (RFC 7230 3.5)
+                if (line_.empty()) {
+                    while (p < end && (*p == '\r' || *p == '\n')) ++p;
+                    if (p == end) continue;
+                }
+
+                size_t previous = line_.size();
+                size_t take = std::min<size_t>(end - p, limits_.maxHeaderBytes + 4 - previous);
+                line_.append(p, take);
+                size_t pos = line_.find("\r\n\r\n", scanned_ >= 3 ? scanned_ - 3 : 0);
+                if (pos == std::string::npos) {
+                    scanned_ = line_.size();
+                    p += take;
+                    if (line_.size() >= limits_.maxHeaderBytes + 4) {
+                        return fail(431);
+                    }
+                    continue;
+                }
+
+                p += pos + 4 - previous;
+                line_.resize(pos);
+                if (!parseHeaderBlock()) {
+                    return Result::ERROR;
+                }
+                line_.clear();
+                scanned_ = 0;
+                break;
+            }
+
+            case State::BODY: {
+                size_t take = std::min<size_t>(end - p, remaining_);
+                request_.body.append(p, take);
+                p += take;
+                remaining_ -= take;
+                if (remaining_ == 0) {
+                    state_ = State::DONE;
+                }
+                break;
+            }
+
+            case State::CHUNK_SIZE: {
+                bool overflow = false;
+                if (!readLine(p, end, MAX_CHUNK_LINE, overflow)) {
+                    if (overflow) return fail(400);
+                    continue;
+                }
+
+                // Hex size, optionally followed by ";extension"
+                size_t chunkSize = 0;
+                size_t digits = 0;
+                for (char c : line_) {
+                    int value;
+                    if (c >= '0' && c <= '9') value = c - '0';
+                    else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+                    else break;
+                    if (++digits > 15) return fail(400);
+                    chunkSize = chunkSize * 16 + static_cast<size_t>(value);
+                }
+                if (digits == 0 || (digits < line_.size() && line_[digits] != ';' &&
+                                    line_[digits] != ' ' && line_[digits] != '\t')) {
+                    return fail(400);
+                }
+                line_.clear();
+
+                if (chunkSize == 0) {
+                    state_ = State::TRAILERS;
+                } else if (chunkSize > limits_.maxBodyBytes - request_.body.size()) {
+                    return fail(413);
+                } else {
+                    remaining_ = chunkSize;
+                    state_ = State::CHUNK_DATA;
+                }
+                break;
+            }
+
+            case State::CHUNK_DATA: {
+                size_t take = std::min<size_t>(end - p, remaining_);
+                request_.body.append(p, take);
+                p += take;
+                remaining_ -= take;
+                if (remaining_ == 0) {
+                    state_ = State::CHUNK_END;
+                }
+                break;
+            }
+
+            case State::CHUNK_END: {
+                bool overflow = false;
+                if (!readLine(p, end, 2, overflow)) {
+                    if (overflow) return fail(400);
+                    continue;
+                }
+                if (!line_.empty()) {
+                    return fail(400);
+                }
+                state_ = State::CHUNK_SIZE;
+                break;
+            }
+
+            case State::TRAILERS: {
+                // Trailer fields are read and dropped; none are used
+                bool overflow = false;
+                if (!readLine(p, end, limits_.maxHeaderBytes - std::min(trailerBytes_, limits_.maxHeaderBytes),
+                              overflow)) {
+                    if (overflow) return fail(431);
+                    continue;
+                }
+                if (line_.empty()) {
+                    state_ = State::DONE;
+                } else {
+                    trailerBytes_ += line_.size() + 2;
+                    line_.clear();
+                }
+                break;
+            }
+
+            case State::DONE:
+            case State::FAILED:
+                break;
+        }
+    }
+
+    consumed = static_cast<size_t>(p - data);
+    return Result::COMPLETE;
+}
+
+bool HttpRequestParser::parseHeaderBlock() {
+    size_t lineEnd = line_.find("\r\n");
+    std::string requestLine = line_.substr(0, lineEnd);
+
+    // METHOD SP request-target SP HTTP-version
+    size_t firstSpace = requestLine.find(' ');
+    size_t lastSpace = requestLine.rfind(' ');
+    if (firstSpace == std::string::npos || firstSpace == 0 || lastSpace == firstSpace) {
+        fail(400);
+        return false;
+    }
+    request_.method = requestLine.substr(0, firstSpace);
+    request_.target = requestLine.substr(firstSpace + 1, lastSpace - firstSpace - 1);
+    std::string version = requestLine.substr(lastSpace + 1);
+    if (request_.target.empty() || request_.target.find(' ') != std::string::npos) {
+        fail(400);
+        return false;
+    }
+    if (version == "HTTP/1.1") {
+        request_.versionMinor = 1;
+    } else if (version == "HTTP/1.0") {
+        request_.versionMinor = 0;
+    } else {
+        fail(version.compare(0, 5, "HTTP/") == 0 ? 505 : 400);
+        return false;
+    }
+
+    size_t start = lineEnd == std::string::npos ? line_.size() : lineEnd + 2;
+    while (start < line_.size()) {
+        size_t next = line_.find("\r\n", start);
+        if (next == std::string::npos) next = line_.size();
+        std::string field = line_.substr(start, next - start);
+        start = next + 2;
+
+        // Obsolete line folding and whitespace before the colon are rejected (RFC 7230 3.2.4)
+        size_t colon = field.find(':');
+        if (colon == std::string::npos || colon == 0 || field[0] == ' ' || field[0] == '\t' ||
+            field.find_first_of(" \t") < colon) {
+            fail(400);
+            return false;
+        }
+        request_.headers.emplace_back(toLower(field.substr(0, colon)), trim(field.substr(colon + 1)));
+    }
+
+    // Framing: chunked coding or a single Content-Length, never both
+    bool chunked = false;
+    bool hasLength = false;
+    size_t contentLength = 0;
+    for (const auto& [name, value] : request_.headers) {
+        if (name == "transfer-encoding") {
+            if (toLower(value) != "chunked" || chunked) {
+                fail(501);
+                return false;
+            }
+            chunked = true;
+        } else if (name == "content-length") {
+            if (value.empty() || value.size() > 18 ||
+                value.find_first_not_of("0123456789") != std::string::npos) {
+                fail(400);
+                return false;
+            }
+            size_t length = std::stoull(value);
+            if (hasLength && length != contentLength) {
+                fail(400);
+                return false;
+            }
+            hasLength = true;
+            contentLength = length;
+        }
+    }
+    if (chunked && hasLength) {
+        fail(400);
+        return false;
+    }
+
+    if (chunked) {
+        state_ = State::CHUNK_SIZE;
+    } else if (contentLength > limits_.maxBodyBytes) {
+        fail(413);
+        return false;
+    } else if (contentLength > 0) {
+        request_.body.reserve(contentLength);
+        remaining_ = contentLength;
+        state_ = State::BODY;
+    } else {
+        state_ = State::DONE;
+    }
+    return true;
+}
+
+// HttpServer::ConnectionStream implementation
+class HttpServer::ConnectionStream : public HttpStream {
+private:
+    HttpServer* server_;
+    std::shared_ptr<Connection> conn_;
+    bool keepAlive_;
+    bool http10_;
+    bool sized_;                    // Content-Length framing instead of chunks
+    bool started_;
+    bool failed_;
+
+    // Hands bytes to the loop, first waiting while the connection is backlogged
+    bool push(std::string bytes, bool final, bool close) {
+        if (!final) {
+            std::unique_lock<std::mutex> lock(conn_->streamMutex);
+            conn_->streamWaiters++;
+            conn_->streamCv.wait(lock, [this] {
+                return conn_->closed.load() || conn_->unsent.load() < server_->config_.maxStreamBuffer;
+            });
+            conn_->streamWaiters--;
+            if (conn_->closed.load()) {
+                failed_ = true;
+                return false;
+            }
+        }
+        conn_->unsent += bytes.size();
+        server_->complete(Completion{conn_, std::move(bytes), close, final});
+        return true;
+    }
+
+    bool start(const HttpResponse& response, bool sized, size_t contentLength) {
+        if (started_) {
+            return !failed_;
+        }
+        started_ = true;
+        sized_ = sized;
+        keepAlive_ = keepAlive_ && !response.close;
+
+        // HTTP/1.0 has no chunked coding; without a length the end of the body is the end of the connection
+        std::string head = "HTTP/1.1 " + std::to_string(response.status) + " " +
+                           HttpResponse::reasonPhrase(response.status) + "\r\n";
+        if (!response.contentType.empty()) {
+            head += "Content-Type: " + response.contentType + "\r\n";
+        }
+        if (sized_) {
+            head += "Content-Length: " + std::to_string(contentLength) + "\r\n";
+        } else if (!http10_) {
+            head += "Transfer-Encoding: chunked\r\n";
+        }
+        if (!keepAlive_) {
+            head += "Connection: close\r\n";
+        }
+        for (const auto& [name, value] : response.headers) {
+            head += name + ": " + value + "\r\n";
+        }
+        head += "\r\n";
+        return push(std::move(head), false, false);
+    }
+
+public:
+    ConnectionStream(HttpServer* server, std::shared_ptr<Connection> conn, bool keepAlive, bool http10)
+        : server_(server), conn_(std::move(conn)), keepAlive_(keepAlive && !http10), http10_(http10),
+          sized_(false), started_(false), failed_(false) {}
+
+    bool begin(const HttpResponse& response) override {
+        return start(response, false, 0);
+    }
+
+    bool begin(const HttpResponse& response, size_t contentLength) override {
+        return start(response, true, contentLength);
+    }
+
+    bool write(std::string_view data) override {
+        if (!started_ || failed_) {
+            return false;
+        }
+        if (data.empty()) {
+            return true;
+        }
+        if (http10_ || sized_) {
+            return push(std::string(data), false, false);
+        }
+        char size[20];
+        auto result = std::to_chars(size, size + sizeof(size), data.size(), 16);
+        std::string chunk;
+        chunk.reserve(static_cast<size_t>(result.ptr - size) + data.size() + 4);
+        chunk.append(size, result.ptr).append("\r\n").append(data).append("\r\n");
+        return push(std::move(chunk), false, false);
+    }
+
+    bool started() const override { return started_; }
+
+    // Last chunk; the connection moves on to its next request
+    void finish() {
+        push(http10_ || sized_ ? std::string() : std::string("0\r\n\r\n"), true, !keepAlive_);
+    }
+
+    // The body cannot be completed: close without the last chunk so the client sees it truncated
+    void abort() {
+        push(std::string(), true, true);
+    }
+};
+
+// HttpServer implementation
+HttpServer::HttpServer(const Config& config, Handler handler)
+    : config_(config), handler_(std::move(handler)), running_(false), epollFd_(-1), wakeFd_(-1),
+      listenFd_(-1), listenPort_(0), connectionCount_(0), requestsServed_(0), rejectedConnections_(0),
+      rejectedRequests_(0) {}
+
+HttpServer::~HttpServer() {
+    stop();
+}
+
+bool HttpServer::start() {
+    if (running_.load()) {
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config_.port);
+    if (inet_pton(AF_INET, config_.bindAddress.c_str(), &addr.sin_addr) != 1) {
+        Utils::logError("HttpServer: invalid bind address " + config_.bindAddress);
+        return false;
+    }
+
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        Utils::logError("HttpServer: socket failed: " + std::string(std::strerror(errno)));
+        return false;
+    }
+    int opt = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd_, SOMAXCONN) < 0) {
+        Utils::logError("HttpServer: cannot listen on " + config_.bindAddress + ":" + std::to_string(config_.port) +
+                        ": " + std::strerror(errno));
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    listenPort_ = ntohs(addr.sin_port);
+
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = wakeFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+    ev.data.fd = listenFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+
+    workers_ = std::make_unique<WorkerPool>(config_.workerThreads, config_.maxQueuedRequests);
+    running_ = true;
+    loopThread_ = std::thread(&HttpServer::runLoop, this);
+    return true;
+}
+
+void HttpServer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    wake();
+    if (loopThread_.joinable()) {
+        loopThread_.join();
+    }
+
+    // Closing first releases handlers waiting on a stream; the running ones
+    // then finish and their responses are dropped with the connections
+    std::vector<std::shared_ptr<Connection>> remaining;
+    for (auto& [fd, conn] : connections_) {
+        remaining.push_back(conn);
+    }
+    for (auto& conn : remaining) {
+        closeConnection(conn);
+    }
+    workers_->stop();
+    workers_.reset();
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex_);
+        completions_.clear();
+    }
+
+    close(listenFd_);
+    close(wakeFd_);
+    close(epollFd_);
+    listenFd_ = wakeFd_ = epollFd_ = -1;
+}
+
+void HttpServer::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeFd_, &one, sizeof(one));
+    (void)ignored;
+}
+
+void HttpServer::runLoop() {
+    epoll_event events[MAX_EVENTS];
+    Clock::time_point nextSweep = Clock::now() + std::chrono::seconds(1);
+
+    while (running_.load()) {
+        int count = epoll_wait(epollFd_, events, MAX_EVENTS, 1000);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            Utils::logError("HttpServer: epoll_wait failed: " + std::string(std::strerror(errno)));
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+
+            if (fd == wakeFd_) {
+                uint64_t value;
+                while (read(wakeFd_, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            if (fd == listenFd_) {
+                handleAccept();
+                continue;
+            }
+
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            auto conn = it->second;
+
+            if (ev & EPOLLERR) {
+                closeConnection(conn);
+                continue;
+            }
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+                handleReadable(conn);
+            }
+            if ((ev & EPOLLOUT) && !conn->closed) {
+                flushConnection(conn);
+            }
+        }
+
+        processCompletions();
+
+        Clock::time_point now = Clock::now();
+        if (now >= nextSweep) {
+            closeIdleConnections(now);
+            nextSweep = now + std::chrono::seconds(1);
+        }
+    }
+}
+
+void HttpServer::handleAccept() {
+    while (true) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break; // EAGAIN: backlog drained
+        }
+
+        if (connections_.size() >= config_.maxConnections) {
+            static const char busy[] =
+                "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            ssize_t ignored = send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+            (void)ignored;
+            close(fd);
+            rejectedConnections_++;
+            continue;
+        }
+        setNoDelay(fd);
+
+        // Both directions stay registered; edge triggering only reports transitions
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        connections_[fd] = std::make_shared<Connection>(fd, config_.limits);
+        connectionCount_++;
+    }
+}
+
+void HttpServer::handleReadable(const std::shared_ptr<Connection>& conn) {
+    while (!conn->closed) {
+        // While a handler runs, unread bytes stay in the kernel so TCP slows the client
+        if (conn->busy && conn->in.size() - conn->inStart >= READ_CHUNK) {
+            return;
+        }
+
+        size_t previous = conn->in.size();
+        conn->in.resize(previous + READ_CHUNK);
+        ssize_t n = recv(conn->fd, &conn->in[previous], READ_CHUNK, 0);
+        if (n > 0) {
+            conn->in.resize(previous + static_cast<size_t>(n));
+            conn->lastActive = Clock::now();
+            dispatchRequests(conn);
+            continue;
+        }
+        conn->in.resize(previous);
+
+        if (n == 0) {
+            // Client finished sending; answer what is in flight, then close
+            conn->closeAfterWrite = true;
+            if (!conn->busy && conn->outOffset >= conn->out.size()) {
+                closeConnection(conn);
+            }
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            closeConnection(conn);
+        }
+        return;
+    }
+}
+
+void HttpServer::dispatchRequests(const std::shared_ptr<Connection>& conn) {
+    while (!conn->busy && !conn->closed && !conn->closeAfterWrite && conn->inStart < conn->in.size()) {
+        size_t consumed = 0;
+        auto result = conn->parser.feed(conn->in.data() + conn->inStart, conn->in.size() - conn->inStart, consumed);
+        conn->inStart += consumed;
+
+        if (result == HttpRequestParser::Result::INCOMPLETE) {
+            // Clients such as curl hold back large bodies until told to continue
+            const HttpRequest& pending = conn->parser.request();
+            if (conn->parser.headersComplete() && !conn->continueSent && pending.versionMinor >= 1 &&
+                toLower(pending.getHeader("expect")) == "100-continue") {
+                conn->continueSent = true;
+                queueResponse(conn, "HTTP/1.1 100 Continue\r\n\r\n", false);
+            }
+            break;
+        }
+        if (result == HttpRequestParser::Result::ERROR) {
+            HttpResponse response;
+            response.status = conn->parser.errorStatus();
+            response.contentType = "text/plain";
+            response.body = HttpResponse::reasonPhrase(response.status);
+            queueResponse(conn, response.serialize(false, false), true);
+            break;
+        }
+
+        HttpRequest request = std::move(conn->parser.request());
+        conn->parser.reset();
+        conn->continueSent = false;
+        dispatch(conn, std::move(request));
+    }
+
+    if (conn->inStart == conn->in.size()) {
+        conn->in.clear();
+        conn->inStart = 0;
+    } else if (conn->inStart >= READ_CHUNK) {
+        conn->in.erase(0, conn->inStart);
+        conn->inStart = 0;
+    }
+}
+
+void HttpServer::dispatch(const std::shared_ptr<Connection>& conn, HttpRequest request) {
+    bool keepAlive = request.keepAlive();
+    bool http10 = request.versionMinor == 0;
+    conn->busy = true;
+
+    bool queued = workers_->trySubmit([this, conn, request = std::move(request), keepAlive, http10]() {
+        ConnectionStream stream(this, conn, keepAlive, http10);
+        HttpResponse response;
+        response.stream = &stream;
+        try {
+            handler_(request, response);
+        } catch (const std::exception& e) {
+            if (stream.started()) {
+                stream.abort();
+                return;
+            }
+            response = HttpResponse();
+            response.status = 500;
+            response.contentType = "text/plain";
+            response.body = e.what();
+        }
+
+        if (stream.started()) {
+            stream.write(response.body);
+            stream.finish();
+            return;
+        }
+        bool keep = keepAlive && !response.close;
+        std::string bytes = response.serialize(keep, http10);
+        conn->unsent += bytes.size();
+        complete(Completion{conn, std::move(bytes), !keep, true});
+    });
+
+    if (!queued) {
+        // Every worker is busy and the queue is full: shed the request, keep the connection
+        rejectedRequests_++;
+        conn->busy = false;
+        HttpResponse response;
+        response.status = 503;
+        response.contentType = "text/plain";
+        response.body = "Server busy";
+        queueResponse(conn, response.serialize(keepAlive, http10), !keepAlive);
+    }
+}
+
+void HttpServer::complete(Completion completion) {
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex_);
+        completions_.push_back(std::move(completion));
+    }
+    wake();
+}
+
+void HttpServer::processCompletions() {
+    std::vector<Completion> completed;
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex_);
+        completed.swap(completions_);
+    }
+
+    for (auto& completion : completed) {
+        auto& conn = completion.conn;
+        if (completion.final) {
+            conn->busy = false;
+        }
+        if (conn->closed) {
+            continue;
+        }
+        if (!completion.final) {
+            sendOutput(conn, std::move(completion.bytes), false);
+            continue;
+        }
+        requestsServed_++;
+        sendOutput(conn, std::move(completion.bytes), completion.close);
+
+        // Pipelined requests, then anything left in the kernel while the handler ran
+        if (!conn->closed && !conn->closeAfterWrite) {
+            dispatchRequests(conn);
+            handleReadable(conn);
+        }
+    }
+}
+
+void HttpServer::queueResponse(const std::shared_ptr<Connection>& conn, std::string bytes, bool close) {
+    conn->unsent += bytes.size();
+    sendOutput(conn, std::move(bytes), close);
+}
+
+// Bytes already counted in conn->unsent
+void HttpServer::sendOutput(const std::shared_ptr<Connection>& conn, std::string bytes, bool close) {
+    if (close) {
+        conn->closeAfterWrite = true;
+    }
+    if (conn->outOffset >= conn->out.size()) {
+        conn->out = std::move(bytes);
+        conn->outOffset = 0;
+    } else {
+        conn->out += bytes;
+    }
+    flushConnection(conn);
+}
+
+void HttpServer::flushConnection(const std::shared_ptr<Connection>& conn) {
+    while (conn->outOffset < conn->out.size()) {
+        ssize_t n = send(conn->fd, conn->out.data() + conn->outOffset, conn->out.size() - conn->outOffset,
+                         MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->outOffset += static_cast<size_t>(n);
+            conn->unsent -= static_cast<size_t>(n);
+            conn->lastActive = Clock::now();
+            if (conn->streamWaiters.load() > 0) {
+                std::lock_guard<std::mutex> lock(conn->streamMutex);
+                conn->streamCv.notify_all();
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return; // EPOLLOUT resumes the write
+        }
+        closeConnection(conn);
+        return;
+    }
+
+    conn->out.clear();
+    conn->outOffset = 0;
+    if (conn->closeAfterWrite && !conn->busy) {
+        closeConnection(conn);
+    }
+}
+
+void HttpServer::closeConnection(const std::shared_ptr<Connection>& conn) {
+    if (conn->closed) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(conn->streamMutex);
+        conn->closed = true;
+    }
+    conn->streamCv.notify_all();
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+    connections_.erase(conn->fd);
+    close(conn->fd);
+    connectionCount_--;
+}
+
+void HttpServer::closeIdleConnections(Clock::time_point now) {
+    std::vector<std::shared_ptr<Connection>> idle;
+    for (auto& [fd, conn] : connections_) {
+        // A handler waiting on a client that stopped reading counts as idle too
+        bool stalled = !conn->busy || conn->streamWaiters.load() > 0;
+        if (stalled && now - conn->lastActive >= config_.idleTimeout) {
+            idle.push_back(conn);
+        }
+    }
+    for (auto& conn : idle) {
+        closeConnection(conn);
+    }
+}
+
+} // namespace pragma
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "worker_pool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * A parsed HTTP/1.x request. Header names are stored lower-cased.
+ */
+struct HttpRequest {
+    std::string method;
+    std::string target;
+    int versionMinor = 1;           // HTTP/1.<versionMinor>
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    // Empty if the header is absent
+    std::string getHeader(const std::string& name) const;
+
+    // Persistent unless the client asked otherwise (HTTP/1.0 defaults to close)
+    bool keepAlive() const;
+};
+
+class HttpStream;
+
+struct HttpResponse {
+    int status = 200;
+    std::string contentType = "application/json";
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+    bool close = false;             // Close the connection once this is sent
+
+    // Set by the server for handlers that want to send the body as they
+    // produce it; null when the response can only be returned whole
+    HttpStream* stream = nullptr;
+
+    // Status line, headers and body, ready for the socket
+    std::string serialize(bool keepAlive, bool http10) const;
+
+    static const char* reasonPhrase(int status);
+};
+
+/**
+ * Sends a response body in pieces while the handler is still producing it,
+ * using chunked transfer coding (HTTP/1.0 clients get the raw body and a
+ * close instead). Writes block while the client is behind, so a large
+ * result costs a bounded buffer rather than its full size in memory, and
+ * the first bytes leave before the last are computed. Whatever is left in
+ * HttpResponse::body when the handler returns is sent as the final piece.
+ */
+class HttpStream {
+public:
+    virtual ~HttpStream() = default;
+
+    // Sends the status line and headers of response; the body follows through write()
+    virtual bool begin(const HttpResponse& response) = 0;
+
+    // As above for a body of known size, sent unframed with a Content-Length;
+    // the handler must write exactly contentLength bytes
+    virtual bool begin(const HttpResponse& response, size_t contentLength) = 0;
+
+    // False once the client has gone; the handler should stop producing
+    virtual bool write(std::string_view data) = 0;
+
+    virtual bool started() const = 0;
+};
+
+/**
+ * Incremental HTTP/1.x request parser.
+ * Bytes may arrive split at any point; bodies are delimited by
+ * Content-Length or chunked transfer coding. Parsing stops at the end of
+ * each request, so pipelined requests are left for the next call.
+ */
+class HttpRequestParser {
+public:
+    enum class Result { INCOMPLETE, COMPLETE, ERROR };
+
+    struct Limits {
+        size_t maxHeaderBytes = 64 * 1024;      // Request line plus headers (and trailers)
+        size_t maxBodyBytes = 32 * 1024 * 1024;
+    };
+
+private:
+    enum class State { HEADERS, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_END, TRAILERS, DONE, FAILED };
+
+    Limits limits_;
+    State state_;
+    HttpRequest request_;
+    std::string line_;              // Header block, chunk-size line or trailer being accumulated
+    size_t scanned_;                // Bytes of line_ already searched for a terminator
+    size_t remaining_;              // Body or chunk bytes still expected
+    size_t trailerBytes_;
+    int errorStatus_;
+
+    Result fail(int status);
+    bool parseHeaderBlock();
+    bool readLine(const char*& data, const char* end, size_t limit, bool& overflow);
+
+public:
+    HttpRequestParser();
+    explicit HttpRequestParser(const Limits& limits);
+
+    // Consumes bytes up to the end of the current request; consumed reports how many
+    Result feed(const char* data, size_t size, size_t& consumed);
+
+    // Starts on the next request, keeping the limits
+    void reset();
+
+    // Request line and headers are parsed; the body may still be arriving
+    bool headersComplete() const;
+
+    HttpRequest& request() { return request_; }
+    int errorStatus() const { return errorStatus_; }    // HTTP status to answer a failed parse with
+};
+
+/**
+ * HTTP/1.1 server on a single edge-triggered epoll loop.
+ * The loop owns the sockets, parses requests and writes responses; the
+ * handler runs on a bounded worker pool so slow calls never stall other
+ * connections. Connections persist between requests (keep-alive), and
+ * requests pipelined on one connection are answered in order.
+ */
+class HttpServer {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Handler = std::function<void(const HttpRequest& request, HttpResponse& response)>;
+
+    struct Config {
+        std::string bindAddress = "127.0.0.1";
+        uint16_t port = 8332;                   // 0 picks an ephemeral port
+        size_t maxConnections = 100;            // Further clients get 503 and are closed
+        size_t workerThreads = 4;
+        size_t maxQueuedRequests = 256;         // Requests beyond this get 503
+        std::chrono::seconds idleTimeout{30};   // Idle keep-alive connections are closed after this
+        size_t maxStreamBuffer = 256 * 1024;    // Unsent bytes a streaming handler may queue before it waits
+        HttpRequestParser::Limits limits;
+    };
+
+private:
+    class ConnectionStream;
+
+    struct Connection {
+        int fd;
+        HttpRequestParser parser;
+        std::string in;                 // Received bytes not yet parsed start at inStart
+        size_t inStart = 0;
+        std::string out;                // Response bytes not yet written start at outOffset
+        size_t outOffset = 0;
+        bool busy = false;              // A request is with a worker
+        bool continueSent = false;      // Answered "Expect: 100-continue" for the current request
+        bool closeAfterWrite = false;
+        std::atomic<bool> closed{false};
+        Clock::time_point lastActive;
+
+        // Backpressure for streamed responses: bytes handed to the connection
+        // but not yet written to the socket, and workers waiting for it to drain
+        std::atomic<size_t> unsent{0};
+        std::atomic<int> streamWaiters{0};
+        std::mutex streamMutex;
+        std::condition_variable streamCv;
+
+        Connection(int socketFd, const HttpRequestParser::Limits& limits)
+            : fd(socketFd), parser(limits), lastActive(Clock::now()) {}
+    };
+
+    struct Completion {
+        std::shared_ptr<Connection> conn;
+        std::string bytes;
+        bool close;
+        bool final;                     // Last piece of the response; the connection takes its next request
+    };
+
+    Config config_;
+    Handler handler_;
+    std::atomic<bool> running_;
+    std::thread loopThread_;
+    std::unique_ptr<WorkerPool> workers_;
+    int epollFd_;
+    int wakeFd_;
+    int listenFd_;
+    uint16_t listenPort_;
+
+    // Loop thread only
+    std::unordered_map<int, std::shared_ptr<Connection>> connections_;
+
+    // Responses produced by workers, waiting for the loop
+    std::vector<Completion> completions_;
+    std::mutex completionsMutex_;
+
+    std::atomic<size_t> connectionCount_;
+    std::atomic<uint64_t> requestsServed_;
+    std::atomic<uint64_t> rejectedConnections_;
+    std::atomic<uint64_t> rejectedRequests_;
+
+    void runLoop();
+    void wake();
+    void handleAccept();
+    void handleReadable(const std::shared_ptr<Connection>& conn);
+    void dispatchRequests(const std::shared_ptr<Connection>& conn);
+    void dispatch(const std::shared_ptr<Connection>& conn, HttpRequest request);
+    void complete(Completion completion);
+    void processCompletions();
+    void queueResponse(const std::shared_ptr<Connection>& conn, std::string bytes, bool close);
+    void sendOutput(const std::shared_ptr<Connection>& conn, std::string bytes, bool close);
+    void flushConnection(const std::shared_ptr<Connection>& conn);
+    void closeConnection(const std::shared_ptr<Connection>& conn);
+    void closeIdleConnections(Clock::time_point now);
+
+public:
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+    static constexpr int MAX_EVENTS = 128;
+
+    HttpServer(const Config& config, Handler handler);
+    ~HttpServer();
+
+    // Lifecycle
+    bool start();
+    void stop();
+    bool isRunning() const { return running_.load(); }
+    uint16_t getPort() const { return listenPort_; }
+
+    // Pool the handlers run on; null while stopped
+    WorkerPool* getWorkers() const { return workers_.get(); }
+
+    // Status
+    size_t getConnectionCount() const { return connectionCount_.load(); }
+    uint64_t getRequestsServed() const { return requestsServed_.load(); }
+    uint64_t getRejectedConnections() const { return rejectedConnections_.load(); }
+    uint64_t getRejectedRequests() const { return rejectedRequests_.load(); }
+};
+
+} // namespace pragma
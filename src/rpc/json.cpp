@@ -0,0 +1,561 @@
+#include "json.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace pragma {
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+void skipWhitespace(std::string_view input, size_t& pos) {
+    while (pos < input.size() && isSpace(input[pos])) {
+        pos++;
+    }
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+uint32_t readHex4(std::string_view text, size_t pos) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value = value * 16 + static_cast<uint32_t>(hexValue(text[pos + i]));
+    }
+    return value;
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+const char* typeName(JsonType type) {
+    switch (type) {
+        case JsonType::NULL_VALUE: return "null";
+        case JsonType::BOOLEAN: return "boolean";
+        case JsonType::NUMBER: return "number";
+        case JsonType::STRING: return "string";
+        case JsonType::ARRAY: return "array";
+        case JsonType::OBJECT: return "object";
+    }
+    return "unknown";
+}
+
+[[noreturn]] void typeMismatch(JsonType expected, JsonType actual) {
+    throw std::runtime_error(std::string("Expected JSON ") + typeName(expected) + ", got " + typeName(actual));
+}
+
+} // namespace
+
+// JsonDocument implementation
+bool JsonDocument::parse(std::string_view input) {
+    nodes_.clear();
+    error_.clear();
+    nodes_.reserve(input.size() / 8 + 1);
+
+    size_t pos = 0;
+    if (!parseValue(input, pos, 0)) {
+        nodes_.clear();
+        return false;
+    }
+    skipWhitespace(input, pos);
+    if (pos != input.size()) {
+        nodes_.clear();
+        return fail("unexpected trailing characters", pos);
+    }
+    return true;
+}
+
+JsonValue JsonDocument::root() const {
+    return nodes_.empty() ? JsonValue() : JsonValue(this, 0);
+}
+
+bool JsonDocument::fail(const std::string& message, size_t pos) {
+    error_ = message + " at offset " + std::to_string(pos);
+    return false;
+}
+
+bool JsonDocument::parseValue(std::string_view input, size_t& pos, size_t depth) {
+    skipWhitespace(input, pos);
+    if (pos >= input.size()) {
+        return fail("unexpected end of input", pos);
+    }
+
+    auto literal = [&](std::string_view word, JsonType type, bool value) {
+        if (input.substr(pos, word.size()) != word) {
+            return fail("invalid literal", pos);
+        }
+        uint32_t index = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(Node{type, false, value, 0, index + 1, input.substr(pos, word.size())});
+        pos += word.size();
+        return true;
+    };
+
+    char c = input[pos];
+    switch (c) {
+        case '{': return parseContainer(input, pos, depth, true);
+        case '[': return parseContainer(input, pos, depth, false);
+        case '"': return parseString(input, pos);
+        case 't': return literal("true", JsonType::BOOLEAN, true);
+        case 'f': return literal("false", JsonType::BOOLEAN, false);
+        case 'n': return literal("null", JsonType::NULL_VALUE, false);
+        default:
+            if (c == '-' || isDigit(c)) {
+                return parseNumber(input, pos);
+            }
+            return fail("unexpected character", pos);
+    }
+}
+
+bool JsonDocument::parseString(std::string_view input, size_t& pos) {
+    size_t start = ++pos;
+    bool escaped = false;
+    while (true) {
+        if (pos >= input.size()) {
+            return fail("unterminated string", start - 1);
+        }
+        unsigned char c = static_cast<unsigned char>(input[pos]);
+        if (c == '"') {
+            break;
+        }
+        if (c == '\\') {
+            escaped = true;
+            if (pos + 1 >= input.size()) {
+                return fail("unterminated string", start - 1);
+            }
+            char e = input[pos + 1];
+            if (e == 'u') {
+                if (pos + 6 > input.size()) {
+                    return fail("invalid \\u escape", pos);
+                }
+                for (size_t i = 2; i < 6; ++i) {
+                    if (hexValue(input[pos + i]) < 0) return fail("invalid \\u escape", pos);
+                }
+                pos += 6;
+            } else if (e == '"' || e == '\\' || e == '/' || e == 'b' || e == 'f' || e == 'n' || e == 'r' || e == 't') {
+                pos += 2;
+            } else {
+                return fail("invalid escape", pos);
+            }
+            continue;
+        }
+        if (c < 0x20) {
+            return fail("control character in string", pos);
+        }
+        pos++;
+    }
+
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node{JsonType::STRING, escaped, false, 0, index + 1, input.substr(start, pos - start)});
+    pos++; // Closing quote
+    return true;
+}
+
+bool JsonDocument::parseNumber(std::string_view input, size_t& pos) {
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    size_t start = pos;
+    if (input[pos] == '-') pos++;
+    if (pos >= input.size() || !isDigit(input[pos])) {
+        return fail("invalid number", start);
+    }
+    if (input[pos] == '0') {
+        pos++;
+    } else {
+        while (pos < input.size() && isDigit(input[pos])) pos++;
+    }
+    if (pos < input.size() && input[pos] == '.') {
+        pos++;
+        if (pos >= input.size() || !isDigit(input[pos])) return fail("invalid number", start);
+        while (pos < input.size() && isDigit(input[pos])) pos++;
+    }
+    if (pos < input.size() && (input[pos] == 'e' || input[pos] == 'E')) {
+        pos++;
+        if (pos < input.size() && (input[pos] == '+' || input[pos] == '-')) pos++;
+        if (pos >= input.size() || !isDigit(input[pos])) return fail("invalid number", start);
+        while (pos < input.size() && isDigit(input[pos])) pos++;
+    }
+
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node{JsonType::NUMBER, false, false, 0, index + 1, input.substr(start, pos - start)});
+    return true;
+}
+
+bool JsonDocument::parseContainer(std::string_view input, size_t& pos, size_t depth, bool object) {
+    if (depth >= MAX_DEPTH) {
+        return fail("nesting too deep", pos);
+    }
+
+    size_t start = pos++;
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node{object ? JsonType::OBJECT : JsonType::ARRAY, false, false, 0, 0, {}});
+    char close = object ? '}' : ']';
+
+    uint32_t count = 0;
+    skipWhitespace(input, pos);
+    if (pos < input.size() && input[pos] == close) {
+        pos++;
+    } else {
+        while (true) {
+            if (object) {
+                // Member name, stored as a string node right before its value
+                skipWhitespace(input, pos);
+                if (pos >= input.size() || input[pos] != '"') {
+                    return fail("expected member name", pos);
+                }
+                if (!parseString(input, pos)) {
+                    return false;
+                }
+                skipWhitespace(input, pos);
+                if (pos >= input.size() || input[pos] != ':') {
+                    return fail("expected ':'", pos);
+                }
+                pos++;
+            }
+            if (!parseValue(input, pos, depth + 1)) {
+                return false;
+            }
+            count++;
+
+            skipWhitespace(input, pos);
+            if (pos >= input.size()) {
+                return fail(object ? "unterminated object" : "unterminated array", start);
+            }
+            if (input[pos] == ',') {
+                pos++;
+                continue;
+            }
+            if (input[pos] == close) {
+                pos++;
+                break;
+            }
+            return fail(object ? "expected ',' or '}'" : "expected ',' or ']'", pos);
+        }
+    }
+
+    Node& node = nodes_[index];
+    node.size = count;
+    node.end = static_cast<uint32_t>(nodes_.size());
+    node.text = input.substr(start, pos - start);
+    return true;
+}
+
+std::string JsonDocument::unescape(std::string_view raw) {
+    std::string out;
+    out.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c != '\\' || i + 1 >= raw.size()) {
+            out += c;
+            continue;
+        }
+
+        char e = raw[++i];
+        switch (e) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (i + 4 >= raw.size()) {
+                    return out; // Truncated; parse() never produces this
+                }
+                uint32_t codePoint = readHex4(raw, i + 1);
+                i += 4;
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && i + 6 < raw.size() &&
+                    raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+                    uint32_t low = readHex4(raw, i + 3);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                if (codePoint >= 0xD800 && codePoint < 0xE000) {
+                    codePoint = 0xFFFD; // Unpaired surrogate
+                }
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default: out += e; break; // \" \\ \/
+        }
+    }
+    return out;
+}
+
+// JsonValue implementation
+JsonType JsonValue::type() const {
+    return doc_ ? doc_->nodes_[index_].type : JsonType::NULL_VALUE;
+}
+
+size_t JsonValue::size() const {
+    JsonType t = type();
+    return (t == JsonType::ARRAY || t == JsonType::OBJECT) ? doc_->nodes_[index_].size : 0;
+}
+
+JsonValue JsonValue::operator[](size_t index) const {
+    if (index >= size()) {
+        return JsonValue();
+    }
+    auto it = begin();
+    for (size_t i = 0; i < index; ++i) {
+        ++it;
+    }
+    return *it;
+}
+
+JsonValue JsonValue::operator[](std::string_view key) const {
+    if (!isObject()) {
+        return JsonValue();
+    }
+    const auto& nodes = doc_->nodes_;
+    uint32_t end = nodes[index_].end;
+    for (uint32_t i = index_ + 1; i < end; i = nodes[i + 1].end) {
+        const auto& name = nodes[i];
+        if (name.escaped ? JsonDocument::unescape(name.text) == key : name.text == key) {
+            return JsonValue(doc_, i + 1);
+        }
+    }
+    return JsonValue();
+}
+
+bool JsonValue::getBool() const {
+    if (!isBool()) typeMismatch(JsonType::BOOLEAN, type());
+    return doc_->nodes_[index_].boolean;
+}
+
+double JsonValue::getDouble() const {
+    if (!isNumber()) typeMismatch(JsonType::NUMBER, type());
+    std::string_view text = doc_->nodes_[index_].text;
+    double value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+int64_t JsonValue::getInt64() const {
+    if (!isNumber()) typeMismatch(JsonType::NUMBER, type());
+    std::string_view text = doc_->nodes_[index_].text;
+    int64_t value = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc() && result.ptr == text.data() + text.size()) {
+        return value;
+    }
+
+    // Fraction or exponent, e.g. 1e3: fine as long as the value is whole
+    double number = getDouble();
+    if (number != std::floor(number) || number < -9.2233720368547758e18 || number >= 9.2233720368547758e18) {
+        throw std::runtime_error("Expected an integer, got " + std::string(text));
+    }
+    return static_cast<int64_t>(number);
+}
+
+std::string JsonValue::getString() const {
+    if (!isString()) typeMismatch(JsonType::STRING, type());
+    const auto& node = doc_->nodes_[index_];
+    return node.escaped ? JsonDocument::unescape(node.text) : std::string(node.text);
+}
+
+std::string_view JsonValue::getRawString() const {
+    if (!isString()) typeMismatch(JsonType::STRING, type());
+    return doc_->nodes_[index_].text;
+}
+
+std::string_view JsonValue::raw() const {
+    if (!doc_) {
+        return "null";
+    }
+    const auto& node = doc_->nodes_[index_];
+    if (node.type == JsonType::STRING) {
+        return std::string_view(node.text.data() - 1, node.text.size() + 2);
+    }
+    return node.text;
+}
+
+JsonValue::Iterator JsonValue::begin() const {
+    if (!isArray() && !isObject()) {
+        return end();
+    }
+    return Iterator(doc_, index_ + 1, isObject());
+}
+
+JsonValue::Iterator JsonValue::end() const {
+    if (!isArray() && !isObject()) {
+        return Iterator(doc_, 0, false);
+    }
+    return Iterator(doc_, doc_->nodes_[index_].end, isObject());
+}
+
+JsonValue JsonValue::Iterator::operator*() const {
+    return JsonValue(doc_, object_ ? index_ + 1 : index_);
+}
+
+JsonValue::Iterator& JsonValue::Iterator::operator++() {
+    index_ = doc_->nodes_[object_ ? index_ + 1 : index_].end;
+    return *this;
+}
+
+// JsonWriter implementation
+void JsonWriter::setFlush(Flush flush, size_t flushBytes) {
+    flush_ = std::move(flush);
+    flushBytes_ = flushBytes;
+}
+
+void JsonWriter::separator() {
+    if (flush_ && out_.size() >= flushBytes_) {
+        flush_(out_);
+    }
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (!first_.empty()) {
+        if (!first_.back()) {
+            out_ += ',';
+        }
+        first_.back() = false;
+    }
+}
+
+void JsonWriter::appendEscaped(std::string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    size_t run = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        // Copy the clean run before this character in one go
+        out_.append(value.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            case '\b': out_ += "\\b"; break;
+            case '\f': out_ += "\\f"; break;
+            default:
+                out_ += "\\u00";
+                out_ += hex[c >> 4];
+                out_ += hex[c & 0xF];
+                break;
+        }
+    }
+    out_.append(value.data() + run, value.size() - run);
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separator();
+    out_ += '{';
+    first_.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    out_ += '}';
+    first_.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separator();
+    out_ += '[';
+    first_.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    out_ += ']';
+    first_.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+    separator();
+    out_ += '"';
+    appendEscaped(name);
+    out_ += "\":";
+    afterKey_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::string(std::string_view value) {
+    separator();
+    out_ += '"';
+    appendEscaped(value);
+    out_ += '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::boolean(bool value) {
+    separator();
+    out_ += value ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    separator();
+    out_ += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(double value) {
+    if (!std::isfinite(value)) {
+        return null(); // JSON has no NaN or infinity
+    }
+    separator();
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, result.ptr);
+    return *this;
+}
+
+JsonWriter& JsonWriter::fixed(double value, int decimals) {
+    if (!std::isfinite(value)) {
+        return null();
+    }
+    separator();
+    char buffer[400];   // Enough for any finite double in fixed notation
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, decimals);
+    out_.append(buffer, result.ptr);
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json) {
+    separator();
+    out_ += json;
+    return *this;
+}
+
+std::string JsonWriter::quote(std::string_view value) {
+    std::string out;
+    JsonWriter(out).string(value);
+    return out;
+}
+
+} // namespace pragma
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace pragma {
+
+enum class JsonType : uint8_t { NULL_VALUE, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+class JsonDocument;
+
+/**
+ * Read-only handle to one value of a parsed JsonDocument.
+ * Copying it is free; it stays valid as long as the document and the
+ * buffer the document was parsed from. Looking up something that is not
+ * there yields a missing value, which reads as null.
+ */
+class JsonValue {
+private:
+    const JsonDocument* doc_;
+    uint32_t index_;
+
+    friend class JsonDocument;
+    JsonValue(const JsonDocument* doc, uint32_t index) : doc_(doc), index_(index) {}
+
+public:
+    JsonValue() : doc_(nullptr), index_(0) {}
+
+    bool exists() const { return doc_ != nullptr; }
+    JsonType type() const;
+    bool isNull() const { return type() == JsonType::NULL_VALUE; }
+    bool isBool() const { return type() == JsonType::BOOLEAN; }
+    bool isNumber() const { return type() == JsonType::NUMBER; }
+    bool isString() const { return type() == JsonType::STRING; }
+    bool isArray() const { return type() == JsonType::ARRAY; }
+    bool isObject() const { return type() == JsonType::OBJECT; }
+
+    // Elements of an array or members of an object
+    size_t size() const;
+    JsonValue operator[](size_t index) const;
+    JsonValue operator[](std::string_view key) const;
+
+    // Accessors throw std::runtime_error on a type mismatch
+    bool getBool() const;
+    double getDouble() const;
+    int64_t getInt64() const;       // Rejects fractions and out-of-range values
+    std::string getString() const;  // Escapes decoded
+
+    // String contents as they appear in the input, escapes undecoded
+    std::string_view getRawString() const;
+
+    // Exact source text of the value, e.g. to echo it back unchanged
+    std::string_view raw() const;
+
+    // Iterates elements of an array or member values of an object
+    class Iterator {
+    private:
+        const JsonDocument* doc_;
+        uint32_t index_;
+        bool object_;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = JsonValue;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = JsonValue;
+
+        Iterator(const JsonDocument* doc, uint32_t index, bool object) : doc_(doc), index_(index), object_(object) {}
+        JsonValue operator*() const;
+        Iterator& operator++();
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+    };
+    Iterator begin() const;
+    Iterator end() const;
+};
+
+/**
+ * Single-pass JSON parser producing a flat tape of nodes.
+ * Strings and numbers are views into the input buffer and are only decoded
+ * when read, so a request is parsed without copying its contents. The
+ * input must outlive the document.
+ */
+class JsonDocument {
+public:
+    static constexpr size_t MAX_DEPTH = 128;
+
+private:
+    struct Node {
+        JsonType type;
+        bool escaped;               // String holds escape sequences
+        bool boolean;
+        uint32_t size;              // Elements or members
+        uint32_t end;               // Index just past this node's subtree
+        std::string_view text;      // String contents, number literal, or whole container
+    };
+
+    std::vector<Node> nodes_;
+    std::string error_;
+
+    friend class JsonValue;
+
+    bool parseValue(std::string_view input, size_t& pos, size_t depth);
+    bool parseString(std::string_view input, size_t& pos);
+    bool parseNumber(std::string_view input, size_t& pos);
+    bool parseContainer(std::string_view input, size_t& pos, size_t depth, bool object);
+    bool fail(const std::string& message, size_t pos);
+
+public:
+    JsonDocument() = default;
+
+    // False on malformed input; getError() says what and where
+    bool parse(std::string_view input);
+
+    JsonValue root() const;
+    const std::string& getError() const { return error_; }
+
+    // Decodes a string's escape sequences (input is the raw contents without quotes)
+    static std::string unescape(std::string_view raw);
+};
+
+/**
+ * Streaming JSON writer appending to a caller-owned buffer.
+ * Separators are inserted automatically, so values are written in order
+ * without building intermediate strings:
+ *   writer.beginObject().key("height").number(h).key("hash").string(hash).endObject();
+ * With a flush callback the buffer is handed off whenever it grows past a
+ * threshold, so arbitrarily large output is produced in bounded memory.
+ */
+class JsonWriter {
+public:
+    // Takes the buffered text (e.g. sends it) and leaves the buffer empty
+    using Flush = std::function<void(std::string& buffer)>;
+
+private:
+    std::string& out_;
+    std::vector<bool> first_;       // Per open container: nothing written in it yet
+    bool afterKey_;
+    Flush flush_;
+    size_t flushBytes_;
+
+    void separator();
+    void appendEscaped(std::string_view value);
+
+public:
+    explicit JsonWriter(std::string& out) : out_(out), afterKey_(false), flushBytes_(0) {}
+
+    // Calls flush between values once the buffer holds at least flushBytes
+    void setFlush(Flush flush, size_t flushBytes);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& string(std::string_view value);
+    JsonWriter& boolean(bool value);
+    JsonWriter& null();
+    JsonWriter& number(double value);                       // Shortest form that reads back exactly
+    JsonWriter& fixed(double value, int decimals);          // e.g. amounts with 8 decimals
+
+    template <typename T>
+    std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, JsonWriter&> number(T value) {
+        separator();
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out_.append(buffer, result.ptr);
+        return *this;
+    }
+
+    // Already-encoded JSON, inserted as one value
+    JsonWriter& raw(std::string_view json);
+
+    std::string& buffer() { return out_; }
+
+    // Escaped and quoted
+    static std::string quote(std::string_view value);
+};
+
+} // namespace pragma
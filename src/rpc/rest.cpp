@@ -0,0 +1,454 @@
+#include "rest.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+
+namespace pragma {
+
+namespace {
+
+// Bodies beyond this are streamed in pieces of this size
+constexpr size_t STREAM_PIECE = 64 * 1024;
+
+bool isHash(const std::string& value) {
+    return value.size() == 64 && std::all_of(value.begin(), value.end(),
+                                             [](unsigned char c) { return std::isxdigit(c) != 0; });
+}
+
+bool isNumber(const std::string& value) {
+    return !value.empty() && value.size() <= 9 &&
+           std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+}
+
+void appendHex(std::string& out, const uint8_t* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0x0f];
+    }
+}
+
+std::vector<std::string> splitPath(const std::string& path) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t slash = path.find('/', start);
+        if (slash == std::string::npos) slash = path.size();
+        parts.push_back(path.substr(start, slash - start));
+        start = slash + 1;
+    }
+    return parts;
+}
+
+} // namespace
+
+// RESTServer implementation
+RESTServer::RESTServer(const Config& config)
+    : config_(config), running_(false), chainLock_(std::make_shared<std::shared_mutex>()) {}
+
+RESTServer::RESTServer()
+    : config_({}), running_(false), chainLock_(std::make_shared<std::shared_mutex>()) {}
+
+RESTServer::~RESTServer() {
+    stop();
+}
+
+bool RESTServer::start() {
+    if (running_) {
+        return false;
+    }
+
+    HttpServer::Config httpConfig;
+    httpConfig.bindAddress = config_.bindAddress;
+    httpConfig.port = config_.port;
+    httpConfig.maxConnections = static_cast<size_t>(std::max(1, config_.maxConnections));
+    httpConfig.workerThreads = config_.workerThreads;
+    httpConfig.maxQueuedRequests = config_.maxQueuedRequests;
+    httpConfig.idleTimeout = std::chrono::seconds(config_.idleTimeoutSeconds);
+    httpConfig.limits.maxBodyBytes = 0;     // GET only
+
+    http_ = std::make_unique<HttpServer>(httpConfig, [this](const HttpRequest& request, HttpResponse& response) {
+        handleRequest(request, response);
+    });
+    if (!http_->start()) {
+        std::cerr << "[REST] Failed to listen on " << config_.bindAddress << ":" << config_.port << std::endl;
+        http_.reset();
+        return false;
+    }
+
+    running_ = true;
+    std::cout << "[REST] Server listening on " << config_.bindAddress << ":" << http_->getPort() << std::endl;
+    return true;
+}
+
+void RESTServer::stop() {
+    if (!running_) {
+        return;
+    }
+
+    running_ = false;
+    http_->stop();
+    http_.reset();
+
+    std::cout << "[REST] Server stopped" << std::endl;
+}
+
+uint16_t RESTServer::getPort() const {
+    return http_ ? http_->getPort() : 0;
+}
+
+void RESTServer::handleRequest(const HttpRequest& request, HttpResponse& response) {
+    if (request.method != "GET") {
+        response.headers.emplace_back("Allow", "GET");
+        sendError(response, 405, "REST endpoints are read-only; use GET");
+        return;
+    }
+
+    std::string path = request.target.substr(0, request.target.find('?'));
+    const std::string prefix = "/rest/";
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        sendError(response, 404, "Not found");
+        return;
+    }
+    path.erase(0, prefix.size());
+
+    // The extension of the last segment picks the output format
+    Format format = Format::JSON;
+    size_t dot = path.find('.', path.rfind('/') == std::string::npos ? 0 : path.rfind('/'));
+    if (dot != std::string::npos) {
+        std::string extension = path.substr(dot + 1);
+        path.resize(dot);
+        if (extension == "bin") {
+            format = Format::BINARY;
+        } else if (extension == "hex") {
+            format = Format::HEX;
+        } else if (extension != "json") {
+            sendError(response, 404, "Output format not found (available: .bin, .hex, .json)");
+            return;
+        }
+    }
+
+    if (!chainState_) {
+        sendError(response, 503, "Chain state not available");
+        return;
+    }
+
+    std::vector<std::string> parts = splitPath(path);
+    const std::string& endpoint = parts[0];
+    if (endpoint == "block" && parts.size() == 2) {
+        serveBlock(parts[1], format, response);
+    } else if (endpoint == "headers" && parts.size() == 3) {
+        serveHeaders(parts[1], parts[2], format, response);
+    } else if (endpoint == "tx" && parts.size() == 2) {
+        serveTransaction(parts[1], format, response);
+    } else if (endpoint == "getutxos") {
+        serveUtxos(std::vector<std::string>(parts.begin() + 1, parts.end()), format, response);
+    } else {
+        sendError(response, 404, "Not found");
+    }
+}
+
+void RESTServer::serveBlock(const std::string& hash, Format format, HttpResponse& response) {
+    if (!isHash(hash)) {
+        sendError(response, 400, "Invalid hash: " + hash);
+        return;
+    }
+    std::shared_ptr<ChainEntry> entry;
+    {
+        std::shared_lock<std::shared_mutex> lock(*chainLock_);
+        entry = chainState_->getBlock(hash);
+    }
+    if (!entry || !entry->serialized) {
+        sendError(response, 404, hash + " not found");
+        return;
+    }
+
+    // The entry keeps its bytes alive while they stream out
+    if (format != Format::JSON) {
+        sendBytes(entry->serialized->data(), entry->serialized->size(), format, response);
+        return;
+    }
+
+    JsonWriter writer(response.body);
+    writer.setFlush(streamFlush(response), STREAM_PIECE);
+    writer.beginObject();
+    writeHeaderFields(writer, *entry);
+    writer.key("size").number(entry->serialized->size());
+    writer.key("tx").beginArray();
+    for (const auto& tx : entry->block.transactions) {
+        writeTransaction(writer, tx);
+    }
+    writer.endArray().endObject();
+}
+
+void RESTServer::serveHeaders(const std::string& count, const std::string& hash, Format format,
+                              HttpResponse& response) {
+    size_t requested = isNumber(count) ? std::stoul(count) : 0;
+    if (requested == 0 || requested > config_.maxHeadersCount) {
+        sendError(response, 400, "Header count is invalid or out of acceptable range (1-" +
+                                 std::to_string(config_.maxHeadersCount) + "): " + count);
+        return;
+    }
+    if (!isHash(hash)) {
+        sendError(response, 400, "Invalid hash: " + hash);
+        return;
+    }
+    // Empty when the block is not on the best chain
+    std::vector<std::shared_ptr<ChainEntry>> chain;
+    {
+        std::shared_lock<std::shared_mutex> lock(*chainLock_);
+        if (!chainState_->getBlock(hash)) {
+            lock.unlock();
+            sendError(response, 404, hash + " not found");
+            return;
+        }
+        chain = chainState_->getChainFrom(hash, requested);
+    }
+
+    if (format != Format::JSON) {
+        std::vector<uint8_t> bytes;
+        for (const auto& entry : chain) {
+            entry->block.header.serializeInto(bytes);
+        }
+        sendBytes(bytes.data(), bytes.size(), format, response);
+        return;
+    }
+
+    JsonWriter writer(response.body);
+    writer.beginArray();
+    for (const auto& entry : chain) {
+        writer.beginObject();
+        writeHeaderFields(writer, *entry);
+        writer.endObject();
+    }
+    writer.endArray();
+}
+
+void RESTServer::serveTransaction(const std::string& txid, Format format, HttpResponse& response) {
+    if (!isHash(txid)) {
+        sendError(response, 400, "Invalid hash: " + txid);
+        return;
+    }
+
+    // Mempool first, then any stored block
+    std::shared_ptr<MempoolEntry> pooled;
+    std::shared_ptr<ChainEntry> block;
+    {
+        std::shared_lock<std::shared_mutex> lock(*chainLock_);
+        pooled = mempool_ ? mempool_->getTransaction(txid) : nullptr;
+        if (!pooled) {
+            block = chainState_->getTransactionBlock(txid);
+        }
+    }
+    const Transaction* tx = pooled ? &pooled->transaction : nullptr;
+    if (block) {
+        for (const auto& candidate : block->block.transactions) {
+            if (candidate.txid == txid) {
+                tx = &candidate;
+                break;
+            }
+        }
+    }
+    if (!tx) {
+        sendError(response, 404, txid + " not found");
+        return;
+    }
+
+    if (format != Format::JSON) {
+        std::vector<uint8_t> bytes;
+        tx->serializeInto(bytes);
+        sendBytes(bytes.data(), bytes.size(), format, response);
+        return;
+    }
+
+    JsonWriter writer(response.body);
+    writeTransaction(writer, *tx, block.get());
+}
+
+void RESTServer::serveUtxos(const std::vector<std::string>& args, Format format, HttpResponse& response) {
+    bool checkMempool = !args.empty() && args[0] == "checkmempool";
+    size_t first = checkMempool ? 1 : 0;
+    size_t count = args.size() - first;
+    if (count == 0 || count > config_.maxUtxoQueries) {
+        sendError(response, 400, "Number of outpoints must be between 1 and " +
+                                 std::to_string(config_.maxUtxoQueries));
+        return;
+    }
+    if (!utxoSet_) {
+        sendError(response, 503, "UTXO set not available");
+        return;
+    }
+
+    std::vector<OutPoint> outpoints;
+    for (size_t i = first; i < args.size(); ++i) {
+        size_t dash = args[i].rfind('-');
+        std::string index = dash == std::string::npos ? "" : args[i].substr(dash + 1);
+        if (dash == std::string::npos || !isHash(args[i].substr(0, dash)) || !isNumber(index)) {
+            sendError(response, 400, "Parse error: expected <txid>-<n>, got " + args[i]);
+            return;
+        }
+        outpoints.emplace_back(args[i].substr(0, dash), static_cast<uint32_t>(std::stoul(index)));
+    }
+
+    // With checkmempool, outputs spent in the pool are gone and outputs it creates exist
+    std::vector<uint8_t> bitmap((outpoints.size() + 7) / 8, 0);
+    std::string bits;
+    std::vector<UTXO> found;
+    std::shared_lock<std::shared_mutex> lock(*chainLock_);
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        const OutPoint& outpoint = outpoints[i];
+        bool hit = false;
+        if (!(checkMempool && mempool_ && mempool_->isSpent(outpoint))) {
+            if (const UTXO* utxo = utxoSet_->getUTXO(outpoint)) {
+                found.push_back(*utxo);
+                hit = true;
+            } else if (checkMempool && mempool_) {
+                auto pooled = mempool_->getTransaction(outpoint.txid);
+                if (pooled && outpoint.index < pooled->transaction.vout.size()) {
+                    found.emplace_back(pooled->transaction.vout[outpoint.index], MEMPOOL_HEIGHT, false);
+                    hit = true;
+                }
+            }
+        }
+        if (hit) {
+            bitmap[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+        }
+        bits += hit ? '1' : '0';
+    }
+
+    auto tip = chainState_->getBestTip();
+    lock.unlock();
+    uint32_t height = tip ? tip->height : 0;
+    std::string tipHash = tip ? tip->block.hash : "";
+
+    if (format != Format::JSON) {
+        std::vector<uint8_t> bytes;
+        Serialize::appendUint32LE(bytes, height);
+        Serialize::appendString(bytes, tipHash);
+        Serialize::appendVarInt(bytes, bitmap.size());
+        Serialize::appendBytes(bytes, bitmap.data(), bitmap.size());
+        Serialize::appendVarInt(bytes, found.size());
+        for (const auto& utxo : found) {
+            auto encoded = utxo.serialize();
+            Serialize::appendBytes(bytes, encoded.data(), encoded.size());
+        }
+        sendBytes(bytes.data(), bytes.size(), format, response);
+        return;
+    }
+
+    JsonWriter writer(response.body);
+    writer.beginObject()
+          .key("chainHeight").number(height)
+          .key("chaintipHash").string(tipHash)
+          .key("bitmap").string(bits)
+          .key("utxos").beginArray();
+    for (const auto& utxo : found) {
+        writer.beginObject()
+              .key("height").number(utxo.height)
+              .key("value").fixed(utxo.output.value / 100000000.0, 8)
+              .key("address").string(utxo.output.pubKeyHash)
+              .key("coinbase").boolean(utxo.isCoinbase)
+              .endObject();
+    }
+    writer.endArray().endObject();
+}
+
+void RESTServer::sendBytes(const uint8_t* data, size_t size, Format format, HttpResponse& response) {
+    bool binary = format == Format::BINARY;
+    response.contentType = binary ? "application/octet-stream" : "text/plain";
+    size_t length = binary ? size : size * 2 + 1;
+
+    // Small bodies go out in one piece with the headers
+    if (!response.stream || length <= STREAM_PIECE) {
+        if (binary) {
+            response.body.assign(reinterpret_cast<const char*>(data), size);
+        } else {
+            response.body.reserve(length);
+            appendHex(response.body, data, size);
+            response.body += '\n';
+        }
+        return;
+    }
+
+    if (!response.stream->begin(response, length)) {
+        return;
+    }
+    std::string piece;
+    size_t step = binary ? STREAM_PIECE : STREAM_PIECE / 2;
+    for (size_t offset = 0; offset < size; offset += step) {
+        size_t n = std::min(step, size - offset);
+        bool sent;
+        if (binary) {
+            sent = response.stream->write(std::string_view(reinterpret_cast<const char*>(data + offset), n));
+        } else {
+            piece.clear();
+            appendHex(piece, data + offset, n);
+            sent = response.stream->write(piece);
+        }
+        if (!sent) {
+            return;
+        }
+    }
+    if (!binary) {
+        response.body = "\n";   // Sent as the final piece
+    }
+}
+
+void RESTServer::sendError(HttpResponse& response, int status, const std::string& message) {
+    response.status = status;
+    response.contentType = "text/plain";
+    response.body = message + "\r\n";
+}
+
+JsonWriter::Flush RESTServer::streamFlush(HttpResponse& response) {
+    if (!response.stream) {
+        return nullptr;
+    }
+    return [&response](std::string& buffer) {
+        if (!response.stream->begin(response) || !response.stream->write(buffer)) {
+            throw std::runtime_error("Client disconnected");
+        }
+        buffer.clear();
+    };
+}
+
+void RESTServer::writeHeaderFields(JsonWriter& writer, const ChainEntry& entry) {
+    const BlockHeader& header = entry.block.header;
+    writer.key("hash").string(entry.block.hash)
+          .key("height").number(entry.height)
+          .key("version").number(header.version)
+          .key("previousblockhash").string(header.prevHash)
+          .key("merkleroot").string(header.merkleRoot)
+          .key("time").number(header.timestamp)
+          .key("bits").number(header.bits)
+          .key("nonce").number(header.nonce)
+          .key("chainwork").string(entry.cumulativeWork);
+}
+
+void RESTServer::writeTransaction(JsonWriter& writer, const Transaction& tx, const ChainEntry* block) {
+    writer.beginObject()
+          .key("txid").string(tx.txid)
+          .key("coinbase").boolean(tx.isCoinbase)
+          .key("vin").beginArray();
+    for (const auto& input : tx.vin) {
+        writer.beginObject()
+              .key("txid").string(input.prevout.txid)
+              .key("vout").number(input.prevout.index)
+              .endObject();
+    }
+    writer.endArray().key("vout").beginArray();
+    for (size_t n = 0; n < tx.vout.size(); ++n) {
+        writer.beginObject()
+              .key("n").number(n)
+              .key("value").fixed(tx.vout[n].value / 100000000.0, 8)
+              .key("address").string(tx.vout[n].pubKeyHash)
+              .endObject();
+    }
+    writer.endArray();
+    if (block) {
+        writer.key("blockhash").string(block->block.hash);
+    }
+    writer.endObject();
+}
+
+} // namespace pragma
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <shared_mutex>
+#include "../core/chainstate.h"
+#include "../core/mempool.h"
+#include "../core/utxo.h"
+#include "http_server.h"
+#include "json.h"
+
+namespace pragma {
+
+/**
+ * Read-only REST interface to chain data, for indexers that only want bytes.
+ *   GET /rest/block/<hash>.<bin|hex|json>
+ *   GET /rest/headers/<count>/<hash>.<bin|hex|json>
+ *   GET /rest/tx/<txid>.<bin|hex|json>
+ *   GET /rest/getutxos[/checkmempool]/<txid>-<n>[/<txid>-<n>...].<bin|hex|json>
+ * A missing extension means JSON. Binary blocks are the stored serialized
+ * bytes, streamed to the socket as they are. There is no authentication, so
+ * it listens on its own address rather than the JSON-RPC port.
+ */
+class RESTServer {
+public:
+    struct Config {
+        std::string bindAddress = "127.0.0.1";
+        uint16_t port = 8334;
+        int maxConnections = 100;
+        size_t workerThreads = 4;
+        size_t maxQueuedRequests = 256;
+        int idleTimeoutSeconds = 30;
+        size_t maxHeadersCount = 2000;              // Per /rest/headers request
+        size_t maxUtxoQueries = 15;                 // Outpoints per /rest/getutxos request
+    };
+
+    enum class Format { BINARY, HEX, JSON };
+
+    // Height reported for outputs that only exist in the mempool
+    static constexpr uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
+
+    explicit RESTServer(const Config& config);
+    RESTServer();
+    ~RESTServer();
+
+    // Server management
+    bool start();
+    void stop();
+    bool isRunning() const { return running_; }
+    uint16_t getPort() const;                       // Bound port, once started
+
+    // Data sources; endpoints needing a missing one answer 503
+    void setChainState(std::shared_ptr<ChainState> chainState) { chainState_ = chainState; }
+    void setMempool(std::shared_ptr<Mempool> mempool) { mempool_ = mempool; }
+    void setUTXOSet(std::shared_ptr<UTXOSet> utxoSet) { utxoSet_ = utxoSet; }
+
+    // Lookups hold this shared, so it must be the lock that whoever changes
+    // the data sources holds exclusively (RPCServer::getChainLock)
+    void setChainLock(std::shared_ptr<std::shared_mutex> chainLock) { chainLock_ = chainLock; }
+
+private:
+    Config config_;
+    std::atomic<bool> running_;
+    std::unique_ptr<HttpServer> http_;
+    std::shared_ptr<ChainState> chainState_;
+    std::shared_ptr<Mempool> mempool_;
+    std::shared_ptr<UTXOSet> utxoSet_;
+    std::shared_ptr<std::shared_mutex> chainLock_;
+
+    // Endpoints
+    void handleRequest(const HttpRequest& request, HttpResponse& response);
+    void serveBlock(const std::string& hash, Format format, HttpResponse& response);
+    void serveHeaders(const std::string& count, const std::string& hash, Format format, HttpResponse& response);
+    void serveTransaction(const std::string& txid, Format format, HttpResponse& response);
+    void serveUtxos(const std::vector<std::string>& args, Format format, HttpResponse& response);
+
+    // Output helpers
+    static void sendBytes(const uint8_t* data, size_t size, Format format, HttpResponse& response);
+    static void sendError(HttpResponse& response, int status, const std::string& message);
+    static JsonWriter::Flush streamFlush(HttpResponse& response);
+    static void writeHeaderFields(JsonWriter& writer, const ChainEntry& entry);
+    static void writeTransaction(JsonWriter& writer, const Transaction& tx, const ChainEntry* block = nullptr);
+};
+
+} // namespace pragma
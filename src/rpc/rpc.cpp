@@ -1,22 +1,19 @@
 #include "rpc.h"
+#include "../primitives/hash.h"
+#include "../network/p2p.h"
 #include <iostream>
-#include <sstream>
-#include <regex>
-#include <iomanip>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <cstring>
+#include <algorithm>
+#include <ctime>
 
 namespace pragma {
 
 // RPCServer implementation
-RPCServer::RPCServer(const Config& config) : config_(config), running_(false) {
+RPCServer::RPCServer(const Config& config)
+    : config_(config), running_(false), chainLock_(std::make_shared<std::shared_mutex>()) {
     registerDefaultMethods();
 }
 
-RPCServer::RPCServer() : config_({}), running_(false) {
+RPCServer::RPCServer() : config_({}), running_(false), chainLock_(std::make_shared<std::shared_mutex>()) {
     registerDefaultMethods();
 }
 
@@ -29,10 +26,26 @@ bool RPCServer::start() {
         return false;
     }
 
+    HttpServer::Config httpConfig;
+    httpConfig.bindAddress = config_.bindAddress;
+    httpConfig.port = config_.port;
+    httpConfig.maxConnections = static_cast<size_t>(std::max(1, config_.maxConnections));
+    httpConfig.workerThreads = config_.workerThreads;
+    httpConfig.maxQueuedRequests = config_.maxQueuedRequests;
+    httpConfig.idleTimeout = std::chrono::seconds(config_.idleTimeoutSeconds);
+    httpConfig.limits.maxBodyBytes = config_.maxRequestBytes;
+
+    http_ = std::make_unique<HttpServer>(httpConfig, [this](const HttpRequest& request, HttpResponse& response) {
+        handleHttpRequest(request, response);
+    });
+    if (!http_->start()) {
+        std::cerr << "[RPC] Failed to listen on " << config_.bindAddress << ":" << config_.port << std::endl;
+        http_.reset();
+        return false;
+    }
+
     running_ = true;
-    serverThread_ = std::thread(&RPCServer::serverLoop, this);
-    
-    std::cout << "[RPC] Server starting on " << config_.bindAddress << ":" << config_.port << std::endl;
+    std::cout << "[RPC] Server listening on " << config_.bindAddress << ":" << http_->getPort() << std::endl;
     return true;
 }
 
@@ -42,152 +55,236 @@ void RPCServer::stop() {
     }
 
     running_ = false;
-    if (serverThread_.joinable()) {
-        serverThread_.join();
-    }
+    http_->stop();
+    http_.reset();
     
     std::cout << "[RPC] Server stopped" << std::endl;
 }
 
-void RPCServer::serverLoop() {
-    int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket < 0) {
-        std::cerr << "[RPC] Failed to create socket" << std::endl;
-        return;
-    }
-
-    int opt = 1;
-    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+uint16_t RPCServer::getPort() const {
+    return http_ ? http_->getPort() : 0;
+}
 
-    sockaddr_in serverAddr{};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(config_.port);
-    inet_pton(AF_INET, config_.bindAddress.c_str(), &serverAddr.sin_addr);
+void RPCServer::handleHttpRequest(const HttpRequest& request, HttpResponse& response) {
+    response.headers.emplace_back("Access-Control-Allow-Origin", "*");
 
-    if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        std::cerr << "[RPC] Failed to bind socket" << std::endl;
-        close(serverSocket);
+    if (request.method != "POST") {
+        response.status = 405;
+        response.headers.emplace_back("Allow", "POST");
+        writeError(response.body, "null", RPC_INVALID_REQUEST, "JSON-RPC requests must be POSTed");
         return;
     }
 
-    if (listen(serverSocket, config_.maxConnections) < 0) {
-        std::cerr << "[RPC] Failed to listen on socket" << std::endl;
-        close(serverSocket);
-        return;
+    if (config_.enableAuth) {
+        std::string authHeader = request.getHeader("authorization");
+        const std::string scheme = "Basic ";
+        if (authHeader.compare(0, scheme.size(), scheme) != 0 || !authenticate(authHeader.substr(scheme.size()))) {
+            response.status = 401;
+            response.headers.emplace_back("WWW-Authenticate", "Basic realm=\"jsonrpc\"");
+            writeError(response.body, "null", RPC_MISC_ERROR, "Authentication required");
+            return;
+        }
     }
 
-    std::cout << "[RPC] Server listening on " << config_.bindAddress << ":" << config_.port << std::endl;
-
-    while (running_) {
-        sockaddr_in clientAddr{};
-        socklen_t clientLen = sizeof(clientAddr);
-        
-        int clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientLen);
-        if (clientSocket < 0) {
-            if (running_) {
-                std::cerr << "[RPC] Failed to accept connection" << std::endl;
+    // Once the response outgrows a flush its headers go out and the rest follows as chunks
+    JsonWriter::Flush flush;
+    if (response.stream) {
+        flush = [&response](std::string& buffer) {
+            if (!response.stream->begin(response) || !response.stream->write(buffer)) {
+                throw std::runtime_error("Client disconnected");
             }
-            continue;
-        }
+            buffer.clear();
+        };
+    }
+    processRequest(request.body, response.body, flush);
+}
 
-        // Handle connection in separate thread
-        std::thread clientThread(&RPCServer::handleConnection, this, clientSocket);
-        clientThread.detach();
+void RPCServer::processRequest(std::string_view request, std::string& out, const JsonWriter::Flush& flush) {
+    // The document points into the request body; nothing is copied until a handler asks
+    JsonDocument document;
+    if (!document.parse(request)) {
+        writeError(out, "null", RPC_PARSE_ERROR, "Parse error: " + document.getError());
+        return;
     }
 
-    close(serverSocket);
+    JsonValue root = document.root();
+    if (root.isArray()) {
+        processBatch(root, out, flush);
+    } else {
+        processCall(root, out, flush);
+    }
 }
 
-void RPCServer::handleConnection(int clientSocket) {
-    char buffer[4096];
-    ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+void RPCServer::processCall(const JsonValue& call, std::string& out, const JsonWriter::Flush& flush) {
+    std::string_view id = call["id"].raw();
+    if (!call.isObject() || !call["method"].isString()) {
+        writeError(out, id, RPC_INVALID_REQUEST, "Invalid JSON-RPC request");
+        return;
+    }
     
-    if (bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        std::string request(buffer);
-        
-        // Parse HTTP request
-        std::string httpResponse;
-        std::string jsonResponse;
-        
-        // Simple HTTP parsing - look for JSON-RPC in POST body
-        size_t bodyPos = request.find("\r\n\r\n");
-        if (bodyPos != std::string::npos) {
-            std::string body = request.substr(bodyPos + 4);
-            
-            // Basic authentication check
-            bool authenticated = !config_.enableAuth;
-            if (config_.enableAuth) {
-                std::string authHeader = "Authorization: Basic ";
-                size_t authPos = request.find(authHeader);
-                if (authPos != std::string::npos) {
-                    size_t authEnd = request.find("\r\n", authPos);
-                    if (authEnd != std::string::npos) {
-                        std::string auth = request.substr(authPos + authHeader.length(), 
-                                                        authEnd - authPos - authHeader.length());
-                        authenticated = authenticate(auth);
-                    }
-                }
-            }
-            
-            if (authenticated) {
-                jsonResponse = processRequest(body);
-            } else {
-                jsonResponse = createResponse("", "", "Authentication required");
-            }
+    MethodEntry method;
+    {
+        std::lock_guard<std::mutex> lock(serverMutex_);
+        auto methodIt = methods_.find(call["method"].getString());
+        if (methodIt == methods_.end()) {
+            writeError(out, id, RPC_METHOD_NOT_FOUND, "Method not found");
+            return;
+        }
+        method = methodIt->second;
+    }
+    
+    // Plain methods build their whole result under the lock; a streaming one
+    // only takes its snapshot there and writes once the lock is released, so
+    // a slow client never holds up writers
+    RPCWriter writer;
+    {
+        // Queries share the chain lock with each other and with the REST server;
+        // anything else runs alone
+        std::shared_lock<std::shared_mutex> readLock(*chainLock_, std::defer_lock);
+        std::unique_lock<std::shared_mutex> writeLock(*chainLock_, std::defer_lock);
+        if (method.readOnly) {
+            readLock.lock();
         } else {
-            jsonResponse = createResponse("", "", "Invalid HTTP request");
+            writeLock.lock();
         }
         
-        // Create HTTP response
-        httpResponse = "HTTP/1.1 200 OK\r\n";
-        httpResponse += "Content-Type: application/json\r\n";
-        httpResponse += "Content-Length: " + std::to_string(jsonResponse.length()) + "\r\n";
-        httpResponse += "Access-Control-Allow-Origin: *\r\n";
-        httpResponse += "\r\n";
-        httpResponse += jsonResponse;
-        
-        send(clientSocket, httpResponse.c_str(), httpResponse.length(), 0);
+        if (!method.snapshot) {
+            writeResult(out, id, [&](JsonWriter& result) { method.handler(call["params"], result); }, nullptr);
+        } else {
+            try {
+                writer = method.snapshot(call["params"]);
+            } catch (const RPCError& e) {
+                writeError(out, id, e.code, e.what());
+                return;
+            } catch (const std::exception& e) {
+                writeError(out, id, RPC_MISC_ERROR, e.what());
+                return;
+            }
+        }
     }
     
-    close(clientSocket);
-}
-
-std::string RPCServer::processRequest(const std::string& request) {
+    if (method.snapshot) {
+        if (!writer) {
+            writer = [](JsonWriter&) {};
+        }
+        writeResult(out, id, writer, flush);
+    } else if (flush && out.size() >= STREAM_FLUSH_BYTES) {
+        streamOut(out, flush);
+    }
+}
+
+void RPCServer::writeResult(std::string& out, std::string_view id, const RPCWriter& writer,
+                            const JsonWriter::Flush& flush) {
+    // The result is written straight into the response; on error it is cut off
+    // again, unless part of it was already flushed, in which case the error
+    // propagates and the connection is cut instead
+    size_t start = out.size();
+    out += "{\"jsonrpc\":\"2.0\",\"id\":";
+    out += id;
+    out += ",\"result\":";
+    size_t resultStart = out.size();
+    bool flushed = false;
     try {
-        auto json = JSONParser::parse(request);
-        
-        if (json.type != JSONParser::Value::OBJECT) {
-            return createResponse("", "", "Invalid JSON-RPC request");
+        JsonWriter result(out);
+        if (flush) {
+            result.setFlush([&flush, &flushed](std::string& buffer) {
+                flushed = true;
+                flush(buffer);
+            }, STREAM_FLUSH_BYTES);
         }
-        
-        std::string method = json.objectValue["method"].stringValue;
-        std::string params = JSONParser::stringify(json.objectValue["params"]);
-        std::string id = json.objectValue["id"].stringValue;
-        
-        auto methodIt = methods_.find(method);
-        if (methodIt == methods_.end()) {
-            return createResponse(id, "", "Method not found");
+        writer(result);
+        if (!flushed && out.size() == resultStart) {
+            out += "null";
         }
-        
-        std::string result = methodIt->second(params);
-        return createResponse(id, result);
-        
+        out += '}';
+    } catch (const RPCError& e) {
+        if (flushed) throw;
+        out.resize(start);
+        writeError(out, id, e.code, e.what());
     } catch (const std::exception& e) {
-        return createResponse("", "", "Parse error: " + std::string(e.what()));
+        if (flushed) throw;
+        out.resize(start);
+        writeError(out, id, RPC_MISC_ERROR, e.what());
     }
 }
 
-std::string RPCServer::createResponse(const std::string& id, const std::string& result, const std::string& error) {
-    std::string response = "{\"jsonrpc\":\"2.0\",\"id\":\"" + id + "\"";
-    
-    if (error.empty()) {
-        response += ",\"result\":" + result + "}";
-    } else {
-        response += ",\"error\":{\"code\":-1,\"message\":\"" + error + "\"}}";
+void RPCServer::streamOut(std::string& out, const JsonWriter::Flush& flush) {
+    // Pieces keep the connection's send buffer bounded; the tail stays in out
+    // to go out with whatever follows
+    std::string piece;
+    size_t offset = 0;
+    for (; out.size() - offset >= STREAM_FLUSH_BYTES; offset += STREAM_FLUSH_BYTES) {
+        piece.assign(out, offset, STREAM_FLUSH_BYTES);
+        flush(piece);
     }
-    
-    return response;
+    out.erase(0, offset);
+}
+
+void RPCServer::processBatch(const JsonValue& calls, std::string& out, const JsonWriter::Flush& flush) {
+    if (calls.size() == 0) {
+        writeError(out, "null", RPC_INVALID_REQUEST, "Invalid JSON-RPC request: empty batch");
+        return;
+    }
+    if (calls.size() > config_.maxBatchSize) {
+        writeError(out, "null", RPC_INVALID_REQUEST, "Batch too large: " + std::to_string(calls.size()) +
+                                                     " calls, limit " + std::to_string(config_.maxBatchSize));
+        return;
+    }
+
+    // Runs of read-only calls go out in parallel; any other call waits for the
+    // calls before it and holds back the ones after, so writes keep their order
+    std::vector<JsonValue> items(calls.begin(), calls.end());
+    WorkerPool* workers = http_ ? http_->getWorkers() : nullptr;
+    out += '[';
+    bool first = true;
+    size_t index = 0;
+    while (index < items.size()) {
+        size_t end = index;
+        while (end < items.size() && isReadOnlyCall(items[end])) {
+            end++;
+        }
+
+        if (end - index > 1 && workers) {
+            std::vector<std::string> responses(end - index);
+            workers->runParallel(end - index, [&, index](size_t offset) {
+                processCall(items[index + offset], responses[offset]);
+            });
+            for (const auto& response : responses) {
+                if (!first) out += ',';
+                first = false;
+                out += response;
+                if (flush && out.size() >= STREAM_FLUSH_BYTES) {
+                    streamOut(out, flush);
+                }
+            }
+        } else {
+            end = std::max(end, index + 1);
+            for (size_t i = index; i < end; ++i) {
+                if (!first) out += ',';
+                first = false;
+                processCall(items[i], out, flush);
+            }
+        }
+        index = end;
+    }
+    out += ']';
+}
+
+bool RPCServer::isReadOnlyCall(const JsonValue& call) const {
+    if (!call["method"].isString()) {
+        return true; // Answered with an error without running anything
+    }
+    std::lock_guard<std::mutex> lock(serverMutex_);
+    auto it = methods_.find(call["method"].getString());
+    return it == methods_.end() || it->second.readOnly;
+}
+
+void RPCServer::writeError(std::string& out, std::string_view id, int code, const std::string& message) {
+    out += "{\"jsonrpc\":\"2.0\",\"id\":";
+    out += id;
+    out += ",\"error\":";
+    JsonWriter(out).beginObject().key("code").number(code).key("message").string(message).endObject();
+    out += '}';
 }
 
 bool RPCServer::authenticate(const std::string& auth) {
@@ -199,18 +296,23 @@ bool RPCServer::authenticate(const std::string& auth) {
 
 void RPCServer::registerDefaultMethods() {
     // Register basic methods
-    registerMethod("help", [this](const std::string& params) {
-        return "\"Available methods: getblockchaininfo, getbestblockhash, getblockcount, getbalance, getnewaddress, sendtoaddress\"";
-    });
+    registerMethod("help", [](const JsonValue& params, JsonWriter& result) {
+        result.string("Available methods: getblockchaininfo, getbestblockhash, getblockcount, getblockfilter, getpeerinfo, getbalance, getnewaddress, sendtoaddress");
+    }, true);
     
-    registerMethod("ping", [this](const std::string& params) {
-        return "\"pong\"";
-    });
+    registerMethod("ping", [](const JsonValue& params, JsonWriter& result) {
+        result.string("pong");
+    }, true);
+}
+
+void RPCServer::registerMethod(const std::string& method, RPCMethod handler, bool readOnly) {
+    std::lock_guard<std::mutex> lock(serverMutex_);
+    methods_[method] = MethodEntry{std::move(handler), nullptr, readOnly};
 }
 
-void RPCServer::registerMethod(const std::string& method, RPCMethod handler) {
+void RPCServer::registerStreamingMethod(const std::string& method, RPCSnapshotMethod snapshot, bool readOnly) {
     std::lock_guard<std::mutex> lock(serverMutex_);
-    methods_[method] = handler;
+    methods_[method] = MethodEntry{nullptr, std::move(snapshot), readOnly};
 }
 
 // RPCCommands implementation
@@ -220,159 +322,220 @@ RPCCommands::RPCCommands(std::shared_ptr<ChainState> chainState,
     : chainState_(chainState), mempool_(mempool), walletManager_(walletManager) {
 }
 
-std::string RPCCommands::getBlockchainInfo(const std::string& params) {
+void RPCCommands::getBlockchainInfo(const JsonValue& params, JsonWriter& result) {
     if (!chainState_) {
-        return createJSONError(-1, "ChainState not available");
+        throw RPCError(RPC_MISC_ERROR, "ChainState not available");
     }
     
     auto stats = chainState_->getChainStats();
     
-    std::stringstream ss;
-    ss << "{"
-       << "\"chain\":\"pragma\","
-       << "\"blocks\":" << stats.height << ","
-       << "\"headers\":" << stats.height << ","
-       << "\"bestblockhash\":\"" << stats.bestHash.substr(0, 16) << "\","
-       << "\"difficulty\":" << stats.difficulty << ","
-       << "\"mediantime\":" << std::time(nullptr) << ","
-       << "\"verificationprogress\":1.0,"
-       << "\"chainwork\":\"" << std::hex << stats.totalWork << "\","
-       << "\"size_on_disk\":" << (stats.totalBlocks * 1000) << ","
-       << "\"pruned\":false"
-       << "}";
+    result.beginObject()
+          .key("chain").string("pragma")
+          .key("blocks").number(stats.height)
+          .key("headers").number(stats.height)
+          .key("bestblockhash").string(stats.bestHash.substr(0, 16))
+          .key("difficulty").number(stats.difficulty)
+          .key("mediantime").number(static_cast<int64_t>(std::time(nullptr)))
+          .key("verificationprogress").number(1.0)
+          .key("chainwork").string(stats.totalWork)
+          .key("size_on_disk").number(stats.totalBlocks * 1000)
+          .key("pruned").boolean(false)
+          .endObject();
+}
+
+void RPCCommands::getBestBlockHash(const JsonValue& params, JsonWriter& result) {
+    if (!chainState_) {
+        throw RPCError(RPC_MISC_ERROR, "ChainState not available");
+    }
     
-    return ss.str();
+    auto stats = chainState_->getChainStats();
+    result.string(stats.bestHash.substr(0, 16));
 }
 
-std::string RPCCommands::getBestBlockHash(const std::string& params) {
+void RPCCommands::getBlockCount(const JsonValue& params, JsonWriter& result) {
     if (!chainState_) {
-        return createJSONError(-1, "ChainState not available");
+        throw RPCError(RPC_MISC_ERROR, "ChainState not available");
     }
     
     auto stats = chainState_->getChainStats();
-    return "\"" + stats.bestHash.substr(0, 16) + "\"";
+    result.number(stats.height);
 }
 
-std::string RPCCommands::getBlockCount(const std::string& params) {
+void RPCCommands::getBlockFilter(const JsonValue& params, JsonWriter& result) {
     if (!chainState_) {
-        return createJSONError(-1, "ChainState not available");
+        throw RPCError(RPC_MISC_ERROR, "ChainState not available");
     }
     
-    auto stats = chainState_->getChainStats();
-    return std::to_string(stats.height);
+    // Params: blockhash, optional filter type ("basic")
+    if (!params[0].isString()) {
+        throw RPCError(RPC_INVALID_PARAMETER, "blockhash is required");
+    }
+    std::string blockHash = params[0].getString();
+    if (params.size() > 1 && params[1].getString() != BlockFilter::typeName(BlockFilterType::BASIC)) {
+        throw RPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+    
+    auto filter = chainState_->getBlockFilter(blockHash);
+    if (!filter) {
+        throw RPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+    
+    result.beginObject()
+          .key("filter").string(Hash::toHex(filter->getEncoded()))
+          .key("header").string(chainState_->getFilterHeader(blockHash))
+          .endObject();
+}
+
+namespace {
+
+void writeHistogram(JsonWriter& result, const LatencyHistogram& histogram) {
+    result.beginArray();
+    for (uint64_t count : histogram.counts) {
+        result.number(count);
+    }
+    result.endArray();
+}
+
+} // namespace
+
+void RPCCommands::getPeerInfo(const JsonValue& params, JsonWriter& result) {
+    result.beginArray();
+    if (network_) {
+        for (const auto& peer : network_->getPeerManager()->getConnectedPeers()) {
+            auto stats = peer->getStats();
+            auto telemetry = peer->getTelemetry().getSnapshot();
+            
+            // Times in seconds as in bitcoind; histogram buckets are powers of two in ms
+            result.beginObject()
+                  .key("id").string(peer->getId())
+                  .key("addr").string(peer->getAddress().toString())
+                  .key("inbound").boolean(peer->isInbound())
+                  .key("version").number(peer->getVersion())
+                  .key("subver").string(peer->getUserAgent())
+                  .key("startingheight").number(peer->getStartHeight())
+                  .key("bytessent").number(stats.bytesSent)
+                  .key("bytesrecv").number(stats.bytesReceived)
+                  .key("banscore").number(stats.banScore)
+                  .key("pingtime").number(stats.latency / 1000.0)
+                  .key("pingavg").number(telemetry.pingTime.value / 1000.0)
+                  .key("responsetime").number(telemetry.responseTime.value / 1000.0)
+                  .key("requestdelay").number(telemetry.requestDelay.value / 1000.0)
+                  .key("blockthroughput").number(telemetry.blockThroughput.value)
+                  .key("stalls").number(telemetry.stalls)
+                  .key("estimatedblocktime").number(telemetry.estimatedBlockSeconds())
+                  .key("latencyhistograms").beginObject();
+            writeHistogram(result.key("ping"), telemetry.pingHistogram);
+            writeHistogram(result.key("response"), telemetry.responseHistogram);
+            writeHistogram(result.key("requestdelay"), telemetry.requestDelayHistogram);
+            result.endObject().endObject();
+        }
+    }
+    result.endArray();
 }
 
-std::string RPCCommands::getBalance(const std::string& params) {
+void RPCCommands::getBalance(const JsonValue& params, JsonWriter& result) {
     auto wallet = getDefaultWallet();
     if (!wallet) {
-        return createJSONError(-1, "Wallet not available");
+        throw RPCError(RPC_MISC_ERROR, "Wallet not available");
     }
     
     uint64_t balance = wallet->getBalance();
     double btcBalance = static_cast<double>(balance) / 100000000.0; // Convert satoshis to BTC
-    
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(8) << btcBalance;
-    return ss.str();
+    result.fixed(btcBalance, 8);
 }
 
-std::string RPCCommands::getNewAddress(const std::string& params) {
+void RPCCommands::getNewAddress(const JsonValue& params, JsonWriter& result) {
     auto wallet = getDefaultWallet();
     if (!wallet) {
-        return createJSONError(-1, "Wallet not available");
+        throw RPCError(RPC_MISC_ERROR, "Wallet not available");
     }
     
-    auto params_vec = splitParams(params);
-    std::string label = params_vec.size() > 0 ? params_vec[0] : "";
+    std::string label = params[0].isString() ? params[0].getString() : "";
     
     auto address = wallet->generateNewAddress(label);
-    return "\"" + address.toString() + "\"";
+    result.string(address.toString());
 }
 
-std::string RPCCommands::sendToAddress(const std::string& params) {
+void RPCCommands::sendToAddress(const JsonValue& params, JsonWriter& result) {
     auto wallet = getDefaultWallet();
     if (!wallet) {
-        return createJSONError(-1, "Wallet not available");
+        throw RPCError(RPC_MISC_ERROR, "Wallet not available");
     }
     
-    auto params_vec = splitParams(params);
-    if (params_vec.size() < 2) {
-        return createJSONError(-1, "sendtoaddress requires address and amount");
+    if (params.size() < 2) {
+        throw RPCError(RPC_MISC_ERROR, "sendtoaddress requires address and amount");
     }
     
-    std::string addressStr = params_vec[0];
-    double amount = std::stod(params_vec[1]);
-    std::string comment = params_vec.size() > 2 ? params_vec[2] : "";
+    std::string addressStr = params[0].getString();
+    double amount = params[1].getDouble();
+    std::string comment = params[2].isString() ? params[2].getString() : "";
     
     Address address(addressStr);
     if (!address.isValid()) {
-        return createJSONError(-1, "Invalid address");
+        throw RPCError(RPC_MISC_ERROR, "Invalid address");
     }
     
     uint64_t satoshis = static_cast<uint64_t>(amount * 100000000); // Convert BTC to satoshis
     std::string txid = wallet->sendToAddress(address, satoshis, comment);
     
     if (txid.empty()) {
-        return createJSONError(-1, "Failed to send transaction");
+        throw RPCError(RPC_MISC_ERROR, "Failed to send transaction");
     }
     
-    return "\"" + txid + "\"";
+    result.string(txid);
 }
 
-std::string RPCCommands::listUnspent(const std::string& params) {
+RPCServer::RPCWriter RPCCommands::listUnspent(const JsonValue& params) {
     auto wallet = getDefaultWallet();
     if (!wallet) {
-        return createJSONError(-1, "Wallet not available");
+        throw RPCError(RPC_MISC_ERROR, "Wallet not available");
     }
     
-    auto utxos = wallet->getSpendableUTXOs();
-    
-    std::stringstream ss;
-    ss << "[";
-    
-    for (size_t i = 0; i < utxos.size(); ++i) {
-        const auto& utxo = utxos[i];
+    // The copied outputs are all the writer needs once the lock is released
+    auto utxos = std::make_shared<std::vector<WalletUTXO>>(wallet->getSpendableUTXOs());
+    return [utxos](JsonWriter& result) {
+        writeUnspent(*utxos, result);
+    };
+}
+
+void RPCCommands::writeUnspent(const std::vector<WalletUTXO>& utxos, JsonWriter& result) {
+    result.beginArray();
+    for (const auto& utxo : utxos) {
         double amount = static_cast<double>(utxo.amount) / 100000000.0;
         
-        if (i > 0) ss << ",";
-        ss << "{"
-           << "\"txid\":\"" << utxo.txid << "\","
-           << "\"vout\":" << utxo.vout << ","
-           << "\"address\":\"" << utxo.address.toString() << "\","
-           << "\"amount\":" << std::fixed << std::setprecision(8) << amount << ","
-           << "\"confirmations\":" << utxo.confirmations << ","
-           << "\"spendable\":" << (utxo.spendable ? "true" : "false") << ","
-           << "\"solvable\":" << (utxo.solvable ? "true" : "false")
-           << "}";
+        result.beginObject()
+              .key("txid").string(utxo.txid)
+              .key("vout").number(utxo.vout)
+              .key("address").string(utxo.address.toString())
+              .key("amount").fixed(amount, 8)
+              .key("confirmations").number(utxo.confirmations)
+              .key("spendable").boolean(utxo.spendable)
+              .key("solvable").boolean(utxo.solvable)
+              .endObject();
     }
-    
-    ss << "]";
-    return ss.str();
+    result.endArray();
 }
 
-std::string RPCCommands::getWalletInfo(const std::string& params) {
+void RPCCommands::getWalletInfo(const JsonValue& params, JsonWriter& result) {
     auto wallet = getDefaultWallet();
     if (!wallet) {
-        return createJSONError(-1, "Wallet not available");
+        throw RPCError(RPC_MISC_ERROR, "Wallet not available");
     }
     
     auto info = wallet->getInfo();
     double balance = static_cast<double>(info.balance) / 100000000.0;
     double unconfirmed = static_cast<double>(info.unconfirmedBalance) / 100000000.0;
     
-    std::stringstream ss;
-    ss << "{"
-       << "\"walletname\":\"" << info.walletName << "\","
-       << "\"walletversion\":1,"
-       << "\"balance\":" << std::fixed << std::setprecision(8) << balance << ","
-       << "\"unconfirmed_balance\":" << std::fixed << std::setprecision(8) << unconfirmed << ","
-       << "\"txcount\":" << info.transactionCount << ","
-       << "\"keypoolsize\":" << info.keyCount << ","
-       << "\"encrypted\":" << (info.encrypted ? "true" : "false") << ","
-       << "\"unlocked_until\":0"
-       << "}";
-    
-    return ss.str();
+    result.beginObject()
+          .key("walletname").string(info.walletName)
+          .key("walletversion").number(1)
+          .key("balance").fixed(balance, 8)
+          .key("unconfirmed_balance").fixed(unconfirmed, 8)
+          .key("txcount").number(info.transactionCount)
+          .key("keypoolsize").number(info.keyCount)
+          .key("encrypted").boolean(info.encrypted)
+          .key("unlocked_until").number(0)
+          .endObject();
 }
 
 std::shared_ptr<Wallet> RPCCommands::getDefaultWallet() {
@@ -382,270 +545,4 @@ std::shared_ptr<Wallet> RPCCommands::getDefaultWallet() {
     return walletManager_->getWallet();
 }
 
-std::string RPCCommands::createJSONError(int code, const std::string& message) {
-    return "{\"error\":{\"code\":" + std::to_string(code) + ",\"message\":\"" + message + "\"}}";
-}
-
-std::vector<std::string> RPCCommands::splitParams(const std::string& params) {
-    std::vector<std::string> result;
-    
-    // Simple JSON array parsing for parameters
-    if (params.empty() || params == "[]") {
-        return result;
-    }
-    
-    // Remove brackets and split by comma
-    std::string cleaned = params;
-    if (cleaned.front() == '[') cleaned = cleaned.substr(1);
-    if (cleaned.back() == ']') cleaned = cleaned.substr(0, cleaned.length() - 1);
-    
-    std::stringstream ss(cleaned);
-    std::string item;
-    
-    while (std::getline(ss, item, ',')) {
-        // Remove quotes and whitespace
-        item.erase(std::remove(item.begin(), item.end(), '"'), item.end());
-        item.erase(std::remove(item.begin(), item.end(), ' '), item.end());
-        if (!item.empty()) {
-            result.push_back(item);
-        }
-    }
-    
-    return result;
-}
-
-// JSONParser implementation
-JSONParser::Value JSONParser::parse(const std::string& json) {
-    size_t pos = 0;
-    return parseValue(json, pos);
-}
-
-JSONParser::Value JSONParser::parseValue(const std::string& json, size_t& pos) {
-    skipWhitespace(json, pos);
-    
-    if (pos >= json.length()) {
-        return Value();
-    }
-    
-    char ch = json[pos];
-    switch (ch) {
-        case '"':
-            return parseString(json, pos);
-        case '[':
-            return parseArray(json, pos);
-        case '{':
-            return parseObject(json, pos);
-        case 't':
-        case 'f':
-            // Boolean
-            if (json.substr(pos, 4) == "true") {
-                pos += 4;
-                return Value(true);
-            } else if (json.substr(pos, 5) == "false") {
-                pos += 5;
-                return Value(false);
-            }
-            break;
-        case 'n':
-            // Null
-            if (json.substr(pos, 4) == "null") {
-                pos += 4;
-                return Value();
-            }
-            break;
-        default:
-            if (std::isdigit(ch) || ch == '-') {
-                return parseNumber(json, pos);
-            }
-            break;
-    }
-    
-    return Value();
-}
-
-JSONParser::Value JSONParser::parseString(const std::string& json, size_t& pos) {
-    if (json[pos] != '"') {
-        return Value();
-    }
-    
-    pos++; // Skip opening quote
-    size_t start = pos;
-    
-    while (pos < json.length() && json[pos] != '"') {
-        if (json[pos] == '\\') {
-            pos += 2; // Skip escaped character
-        } else {
-            pos++;
-        }
-    }
-    
-    if (pos >= json.length()) {
-        return Value();
-    }
-    
-    std::string str = json.substr(start, pos - start);
-    pos++; // Skip closing quote
-    
-    return Value(unescape(str));
-}
-
-JSONParser::Value JSONParser::parseNumber(const std::string& json, size_t& pos) {
-    size_t start = pos;
-    
-    if (json[pos] == '-') {
-        pos++;
-    }
-    
-    while (pos < json.length() && (std::isdigit(json[pos]) || json[pos] == '.')) {
-        pos++;
-    }
-    
-    std::string numStr = json.substr(start, pos - start);
-    return Value(std::stod(numStr));
-}
-
-JSONParser::Value JSONParser::parseArray(const std::string& json, size_t& pos) {
-    Value array;
-    array.type = Value::ARRAY;
-    
-    pos++; // Skip opening bracket
-    skipWhitespace(json, pos);
-    
-    if (pos < json.length() && json[pos] == ']') {
-        pos++;
-        return array;
-    }
-    
-    while (pos < json.length()) {
-        array.arrayValue.push_back(parseValue(json, pos));
-        skipWhitespace(json, pos);
-        
-        if (pos >= json.length()) break;
-        
-        if (json[pos] == ']') {
-            pos++;
-            break;
-        } else if (json[pos] == ',') {
-            pos++;
-            skipWhitespace(json, pos);
-        }
-    }
-    
-    return array;
-}
-
-JSONParser::Value JSONParser::parseObject(const std::string& json, size_t& pos) {
-    Value object;
-    object.type = Value::OBJECT;
-    
-    pos++; // Skip opening brace
-    skipWhitespace(json, pos);
-    
-    if (pos < json.length() && json[pos] == '}') {
-        pos++;
-        return object;
-    }
-    
-    while (pos < json.length()) {
-        // Parse key
-        auto key = parseString(json, pos);
-        skipWhitespace(json, pos);
-        
-        if (pos >= json.length() || json[pos] != ':') break;
-        pos++; // Skip colon
-        
-        // Parse value
-        auto value = parseValue(json, pos);
-        object.objectValue[key.stringValue] = value;
-        
-        skipWhitespace(json, pos);
-        
-        if (pos >= json.length()) break;
-        
-        if (json[pos] == '}') {
-            pos++;
-            break;
-        } else if (json[pos] == ',') {
-            pos++;
-            skipWhitespace(json, pos);
-        }
-    }
-    
-    return object;
-}
-
-void JSONParser::skipWhitespace(const std::string& json, size_t& pos) {
-    while (pos < json.length() && std::isspace(json[pos])) {
-        pos++;
-    }
-}
-
-std::string JSONParser::stringify(const Value& value) {
-    switch (value.type) {
-        case Value::STRING:
-            return "\"" + escape(value.stringValue) + "\"";
-        case Value::NUMBER:
-            return std::to_string(value.numberValue);
-        case Value::BOOLEAN:
-            return value.boolValue ? "true" : "false";
-        case Value::NULL_TYPE:
-            return "null";
-        case Value::ARRAY: {
-            std::string result = "[";
-            for (size_t i = 0; i < value.arrayValue.size(); ++i) {
-                if (i > 0) result += ",";
-                result += stringify(value.arrayValue[i]);
-            }
-            result += "]";
-            return result;
-        }
-        case Value::OBJECT: {
-            std::string result = "{";
-            bool first = true;
-            for (const auto& pair : value.objectValue) {
-                if (!first) result += ",";
-                result += "\"" + escape(pair.first) + "\":" + stringify(pair.second);
-                first = false;
-            }
-            result += "}";
-            return result;
-        }
-    }
-    return "null";
-}
-
-std::string JSONParser::escape(const std::string& str) {
-    std::string result;
-    for (char ch : str) {
-        switch (ch) {
-            case '"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default: result += ch; break;
-        }
-    }
-    return result;
-}
-
-std::string JSONParser::unescape(const std::string& str) {
-    std::string result;
-    for (size_t i = 0; i < str.length(); ++i) {
-        if (str[i] == '\\' && i + 1 < str.length()) {
-            switch (str[i + 1]) {
-                case '"': result += '"'; i++; break;
-                case '\\': result += '\\'; i++; break;
-                case 'n': result += '\n'; i++; break;
-                case 'r': result += '\r'; i++; break;
-                case 't': result += '\t'; i++; break;
-                default: result += str[i]; break;
-            }
-        } else {
-            result += str[i];
-        }
-    }
-    return result;
-}
-
 } // namespace pragma
@@ -7,18 +7,46 @@
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <atomic>
+#include <stdexcept>
 #include "../wallet/wallet.h"
 #include "../core/chainstate.h"
 #include "../core/mempool.h"
+#include "http_server.h"
+#include "json.h"
 
 namespace pragma {
 
 // Forward declarations
 class BlockValidator;
+class P2PNetwork;
+
+// JSON-RPC 2.0 error codes, plus the application codes the commands use
+enum RPCErrorCode {
+    RPC_PARSE_ERROR = -32700,
+    RPC_INVALID_REQUEST = -32600,
+    RPC_METHOD_NOT_FOUND = -32601,
+    RPC_INVALID_PARAMS = -32602,
+    RPC_INTERNAL_ERROR = -32603,
+    RPC_MISC_ERROR = -1,
+    RPC_INVALID_ADDRESS_OR_KEY = -5,
+    RPC_INVALID_PARAMETER = -8,
+};
 
 /**
- * JSON-RPC server for blockchain operations
+ * Thrown by RPC methods; reported as the call's JSON-RPC error object
+ */
+class RPCError : public std::runtime_error {
+public:
+    int code;
+    RPCError(int errorCode, const std::string& message) : std::runtime_error(message), code(errorCode) {}
+};
+
+/**
+ * JSON-RPC server for blockchain operations.
+ * Requests arrive over persistent HTTP/1.1 connections on an epoll loop and
+ * run on a bounded worker pool (see HttpServer).
  */
 class RPCServer {
 public:
@@ -29,6 +57,11 @@ public:
         std::string username = "pragma";
         std::string password = "pragma123";
         int maxConnections = 100;
+        size_t workerThreads = 4;
+        size_t maxQueuedRequests = 256;             // Requests beyond this are answered 503
+        int idleTimeoutSeconds = 30;                // Idle keep-alive connections are closed after this
+        size_t maxRequestBytes = 32 * 1024 * 1024;
+        size_t maxBatchSize = 1000;                 // Calls per JSON-RPC batch
         bool enableSSL = false;
         std::string certFile;
         std::string keyFile;
@@ -42,6 +75,7 @@ public:
     bool start();
     void stop();
     bool isRunning() const { return running_; }
+    uint16_t getPort() const;                       // Bound port, once started
 
     // Set blockchain components
     void setChainState(std::shared_ptr<ChainState> chainState) { chainState_ = chainState; }
@@ -49,26 +83,57 @@ public:
     void setWalletManager(std::shared_ptr<WalletManager> walletManager) { walletManager_ = walletManager; }
     void setValidator(std::shared_ptr<BlockValidator> validator) { validator_ = validator; }
 
-    // JSON-RPC method registration
-    using RPCMethod = std::function<std::string(const std::string& params)>;
-    void registerMethod(const std::string& method, RPCMethod handler);
+    // Read-only methods hold this shared while they run and all others hold
+    // it exclusively; hand it to anything else reading the same components
+    std::shared_ptr<std::shared_mutex> getChainLock() const { return chainLock_; }
+
+    // JSON-RPC method registration. A method writes exactly one JSON value as
+    // its result, or throws RPCError. Read-only methods may run in parallel
+    // with each other when they arrive in the same batch.
+    using RPCMethod = std::function<void(const JsonValue& params, JsonWriter& result)>;
+    void registerMethod(const std::string& method, RPCMethod handler, bool readOnly = false);
+
+    // Methods with large results split the work instead. The snapshot runs
+    // under the chain lock and captures what the result needs (shared_ptrs to
+    // entries, copies); the writer it returns then produces the result with
+    // the lock released, streamed to the client as it grows.
+    using RPCWriter = std::function<void(JsonWriter& result)>;
+    using RPCSnapshotMethod = std::function<RPCWriter(const JsonValue& params)>;
+    void registerStreamingMethod(const std::string& method, RPCSnapshotMethod snapshot, bool readOnly = false);
+
+    // Responses growing past this are sent with chunked transfer coding, in
+    // pieces of this size: as they are written for streaming methods, once
+    // complete and the chain lock is released for the others
+    static constexpr size_t STREAM_FLUSH_BYTES = 64 * 1024;
 
 private:
     Config config_;
     std::atomic<bool> running_;
-    std::thread serverThread_;
+    std::unique_ptr<HttpServer> http_;
     std::shared_ptr<ChainState> chainState_;
     std::shared_ptr<Mempool> mempool_;
     std::shared_ptr<WalletManager> walletManager_;
     std::shared_ptr<BlockValidator> validator_;
-    std::unordered_map<std::string, RPCMethod> methods_;
+    struct MethodEntry {
+        RPCMethod handler;
+        RPCSnapshotMethod snapshot;     // Set instead of handler for streaming methods
+        bool readOnly = false;
+    };
+    std::unordered_map<std::string, MethodEntry> methods_;
     mutable std::mutex serverMutex_;
+    std::shared_ptr<std::shared_mutex> chainLock_;
 
-    // Internal methods
-    void serverLoop();
-    void handleConnection(int clientSocket);
-    std::string processRequest(const std::string& request);
-    std::string createResponse(const std::string& id, const std::string& result, const std::string& error = "");
+    // Internal methods. With a flush, output is handed off in pieces as it
+    // grows instead of being returned whole in out.
+    void handleHttpRequest(const HttpRequest& request, HttpResponse& response);
+    void processRequest(std::string_view request, std::string& out, const JsonWriter::Flush& flush = nullptr);
+    void processCall(const JsonValue& call, std::string& out, const JsonWriter::Flush& flush = nullptr);
+    void processBatch(const JsonValue& calls, std::string& out, const JsonWriter::Flush& flush = nullptr);
+    bool isReadOnlyCall(const JsonValue& call) const;
+    static void writeResult(std::string& out, std::string_view id, const RPCWriter& writer,
+                            const JsonWriter::Flush& flush);
+    static void streamOut(std::string& out, const JsonWriter::Flush& flush);
+    static void writeError(std::string& out, std::string_view id, int code, const std::string& message);
     bool authenticate(const std::string& auth);
     void registerDefaultMethods();
 };
@@ -81,121 +146,89 @@ public:
     explicit RPCCommands(std::shared_ptr<ChainState> chainState,
                         std::shared_ptr<Mempool> mempool,
                         std::shared_ptr<WalletManager> walletManager);
+    
+    // Optional; network methods report no peers without it
+    void setNetwork(std::shared_ptr<P2PNetwork> network) { network_ = network; }
 
     // Blockchain information
-    std::string getBlockchainInfo(const std::string& params);
-    std::string getBestBlockHash(const std::string& params);
-    std::string getBlockCount(const std::string& params);
-    std::string getDifficulty(const std::string& params);
-    std::string getBlock(const std::string& params);
-    std::string getBlockHash(const std::string& params);
-    std::string getBlockHeader(const std::string& params);
-    std::string getChainTips(const std::string& params);
+    void getBlockchainInfo(const JsonValue& params, JsonWriter& result);
+    void getBestBlockHash(const JsonValue& params, JsonWriter& result);
+    void getBlockCount(const JsonValue& params, JsonWriter& result);
+    void getDifficulty(const JsonValue& params, JsonWriter& result);
+    void getBlock(const JsonValue& params, JsonWriter& result);
+    void getBlockHash(const JsonValue& params, JsonWriter& result);
+    void getBlockHeader(const JsonValue& params, JsonWriter& result);
+    void getChainTips(const JsonValue& params, JsonWriter& result);
+    void getBlockFilter(const JsonValue& params, JsonWriter& result);
 
     // Transaction operations
-    std::string getRawTransaction(const std::string& params);
-    std::string sendRawTransaction(const std::string& params);
-    std::string decodeRawTransaction(const std::string& params);
-    std::string createRawTransaction(const std::string& params);
-    std::string signRawTransaction(const std::string& params);
+    void getRawTransaction(const JsonValue& params, JsonWriter& result);
+    void sendRawTransaction(const JsonValue& params, JsonWriter& result);
+    void decodeRawTransaction(const JsonValue& params, JsonWriter& result);
+    void createRawTransaction(const JsonValue& params, JsonWriter& result);
+    void signRawTransaction(const JsonValue& params, JsonWriter& result);
 
     // UTXO operations
-    std::string getUTXOStats(const std::string& params);
-    std::string getTxOut(const std::string& params);
-    std::string getTxOutProof(const std::string& params);
-    std::string verifyTxOutProof(const std::string& params);
+    void getUTXOStats(const JsonValue& params, JsonWriter& result);
+    void getTxOut(const JsonValue& params, JsonWriter& result);
+    void getTxOutProof(const JsonValue& params, JsonWriter& result);
+    void verifyTxOutProof(const JsonValue& params, JsonWriter& result);
 
     // Mempool operations
-    std::string getMempoolInfo(const std::string& params);
-    std::string getRawMempool(const std::string& params);
-    std::string getMempoolEntry(const std::string& params);
-    std::string getMempoolAncestors(const std::string& params);
-    std::string getMempoolDescendants(const std::string& params);
+    void getMempoolInfo(const JsonValue& params, JsonWriter& result);
+    void getRawMempool(const JsonValue& params, JsonWriter& result);
+    void getMempoolEntry(const JsonValue& params, JsonWriter& result);
+    void getMempoolAncestors(const JsonValue& params, JsonWriter& result);
+    void getMempoolDescendants(const JsonValue& params, JsonWriter& result);
 
     // Mining operations
-    std::string getBlockTemplate(const std::string& params);
-    std::string submitBlock(const std::string& params);
-    std::string getMiningInfo(const std::string& params);
-    std::string estimateFee(const std::string& params);
+    void getBlockTemplate(const JsonValue& params, JsonWriter& result);
+    void submitBlock(const JsonValue& params, JsonWriter& result);
+    void getMiningInfo(const JsonValue& params, JsonWriter& result);
+    void estimateFee(const JsonValue& params, JsonWriter& result);
 
     // Wallet operations
-    std::string getWalletInfo(const std::string& params);
-    std::string getNewAddress(const std::string& params);
-    std::string getBalance(const std::string& params);
-    std::string listUnspent(const std::string& params);
-    std::string sendToAddress(const std::string& params);
-    std::string sendMany(const std::string& params);
-    std::string listTransactions(const std::string& params);
-    std::string getTransaction(const std::string& params);
-    std::string importPrivKey(const std::string& params);
-    std::string dumpPrivKey(const std::string& params);
-    std::string encryptWallet(const std::string& params);
-    std::string walletPassphrase(const std::string& params);
-    std::string walletLock(const std::string& params);
-    std::string backupWallet(const std::string& params);
+    void getWalletInfo(const JsonValue& params, JsonWriter& result);
+    void getNewAddress(const JsonValue& params, JsonWriter& result);
+    void getBalance(const JsonValue& params, JsonWriter& result);
+    RPCServer::RPCWriter listUnspent(const JsonValue& params);     // Streaming; see registerStreamingMethod
+    void sendToAddress(const JsonValue& params, JsonWriter& result);
+    void sendMany(const JsonValue& params, JsonWriter& result);
+    void listTransactions(const JsonValue& params, JsonWriter& result);
+    void getTransaction(const JsonValue& params, JsonWriter& result);
+    void importPrivKey(const JsonValue& params, JsonWriter& result);
+    void dumpPrivKey(const JsonValue& params, JsonWriter& result);
+    void encryptWallet(const JsonValue& params, JsonWriter& result);
+    void walletPassphrase(const JsonValue& params, JsonWriter& result);
+    void walletLock(const JsonValue& params, JsonWriter& result);
+    void backupWallet(const JsonValue& params, JsonWriter& result);
 
     // Network operations
-    std::string getNetworkInfo(const std::string& params);
-    std::string getPeerInfo(const std::string& params);
-    std::string addNode(const std::string& params);
-    std::string disconnectNode(const std::string& params);
-    std::string getConnectionCount(const std::string& params);
+    void getNetworkInfo(const JsonValue& params, JsonWriter& result);
+    void getPeerInfo(const JsonValue& params, JsonWriter& result);
+    void addNode(const JsonValue& params, JsonWriter& result);
+    void disconnectNode(const JsonValue& params, JsonWriter& result);
+    void getConnectionCount(const JsonValue& params, JsonWriter& result);
 
     // Utility operations
-    std::string validateAddress(const std::string& params);
-    std::string verifyMessage(const std::string& params);
-    std::string signMessage(const std::string& params);
-    std::string estimateSmartFee(const std::string& params);
-    std::string ping(const std::string& params);
-    std::string uptime(const std::string& params);
-    std::string help(const std::string& params);
+    void validateAddress(const JsonValue& params, JsonWriter& result);
+    void verifyMessage(const JsonValue& params, JsonWriter& result);
+    void signMessage(const JsonValue& params, JsonWriter& result);
+    void estimateSmartFee(const JsonValue& params, JsonWriter& result);
+    void ping(const JsonValue& params, JsonWriter& result);
+    void uptime(const JsonValue& params, JsonWriter& result);
+    void help(const JsonValue& params, JsonWriter& result);
 
 private:
     std::shared_ptr<ChainState> chainState_;
     std::shared_ptr<Mempool> mempool_;
     std::shared_ptr<WalletManager> walletManager_;
+    std::shared_ptr<P2PNetwork> network_;
 
     // Helper methods
-    std::string parseJSON(const std::string& json);
-    std::string createJSONResponse(const std::string& result);
-    std::string createJSONError(int code, const std::string& message);
-    std::vector<std::string> splitParams(const std::string& params);
     bool isValidHash(const std::string& hash);
     std::shared_ptr<Wallet> getDefaultWallet();
-};
-
-/**
- * Simple JSON parser/generator for RPC
- */
-class JSONParser {
-public:
-    struct Value {
-        enum Type { STRING, NUMBER, BOOLEAN, ARRAY, OBJECT, NULL_TYPE };
-        Type type;
-        std::string stringValue;
-        double numberValue;
-        bool boolValue;
-        std::vector<Value> arrayValue;
-        std::unordered_map<std::string, Value> objectValue;
-
-        Value() : type(NULL_TYPE), numberValue(0), boolValue(false) {}
-        explicit Value(const std::string& s) : type(STRING), stringValue(s), numberValue(0), boolValue(false) {}
-        explicit Value(double n) : type(NUMBER), numberValue(n), boolValue(false) {}
-        explicit Value(bool b) : type(BOOLEAN), numberValue(0), boolValue(b) {}
-    };
-
-    static Value parse(const std::string& json);
-    static std::string stringify(const Value& value);
-    static std::string escape(const std::string& str);
-    static std::string unescape(const std::string& str);
-
-private:
-    static Value parseValue(const std::string& json, size_t& pos);
-    static Value parseString(const std::string& json, size_t& pos);
-    static Value parseNumber(const std::string& json, size_t& pos);
-    static Value parseArray(const std::string& json, size_t& pos);
-    static Value parseObject(const std::string& json, size_t& pos);
-    static void skipWhitespace(const std::string& json, size_t& pos);
+    static void writeUnspent(const std::vector<WalletUTXO>& utxos, JsonWriter& result);
 };
 
 /**
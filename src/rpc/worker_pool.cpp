@@ -0,0 +1,129 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace pragma {
+
+// WorkerPool implementation
+WorkerPool::WorkerPool(size_t threads, size_t maxQueued)
+    : maxQueued_(std::max<size_t>(1, maxQueued)), active_(0), stopping_(false) {
+    threads = std::max<size_t>(1, threads);
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+bool WorkerPool::trySubmit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= maxQueued_) {
+            return false;
+        }
+        queue_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void WorkerPool::runParallel(size_t count, const std::function<void(size_t)>& fn) {
+    struct Shared {
+        std::function<void(size_t)> fn;
+        size_t count;
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto shared = std::make_shared<Shared>();
+    shared->fn = fn;
+    shared->count = count;
+
+    // Helpers that start after every item was claimed find nothing to do. A
+    // throwing item still counts as done; the first error goes to the caller
+    auto work = [shared]() {
+        size_t index;
+        while ((index = shared->next.fetch_add(1)) < shared->count) {
+            std::exception_ptr error;
+            try {
+                shared->fn(index);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (error && !shared->error) {
+                shared->error = error;
+            }
+            if (++shared->done == shared->count) {
+                shared->cv.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = count > 0 ? std::min(count - 1, threads_.size()) : 0;
+    for (size_t i = 0; i < helpers && trySubmit(work); ++i) {}
+    work();
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->cv.wait(lock, [&] { return shared->done == shared->count; });
+    if (shared->error) {
+        std::rethrow_exception(shared->error);
+    }
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && threads_.empty()) {
+            return;
+        }
+        stopping_ = true;
+        queue_.clear();
+    }
+    cv_.notify_all();
+
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+}
+
+size_t WorkerPool::getQueued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+size_t WorkerPool::getActive() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return active_;
+}
+
+void WorkerPool::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (stopping_) {
+            return;
+        }
+
+        Task task = std::move(queue_.front());
+        queue_.pop_front();
+        active_++;
+        lock.unlock();
+
+        task();
+
+        lock.lock();
+        active_--;
+    }
+}
+
+} // namespace pragma
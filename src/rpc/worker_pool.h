@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pragma {
+
+/**
+ * Fixed set of threads running tasks from a bounded queue.
+ * Submitting to a full queue fails instead of blocking, so callers on an
+ * event loop can shed load rather than stall every other connection.
+ */
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    std::vector<std::thread> threads_;
+    std::deque<Task> queue_;
+    size_t maxQueued_;
+    size_t active_;                 // Tasks currently running
+    bool stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+
+    void run();
+
+public:
+    WorkerPool(size_t threads, size_t maxQueued);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // False if the queue is full or the pool is stopping
+    bool trySubmit(Task task);
+
+    // Runs fn(0) .. fn(count - 1) on idle workers and the calling thread and
+    // returns once all have run. The caller takes items itself, so this never
+    // waits on a queued task and is safe to call from inside a worker. If
+    // any fn throws, the first exception is rethrown here after all have run.
+    void runParallel(size_t count, const std::function<void(size_t)>& fn);
+
+    // Drops queued tasks, waits for running ones and joins the threads
+    void stop();
+
+    // Status
+    size_t getThreadCount() const { return threads_.size(); }
+    size_t getQueued() const;
+    size_t getActive() const;
+};
+
+} // namespace pragma
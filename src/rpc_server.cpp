@@ -1,5 +1,6 @@
 #include "wallet/wallet.h"
 #include "rpc/rpc.h"
+#include "rpc/rest.h"
 #include "core/chainstate.h"
 #include "core/mempool.h"
 #include "core/utxo.h"
@@ -11,11 +12,15 @@
 
 using namespace pragma;
 
-// Global server instance for signal handling
+// Global server instances for signal handling
 std::unique_ptr<RPCServer> g_rpcServer;
+std::unique_ptr<RESTServer> g_restServer;
 
 void signalHandler(int signal) {
     std::cout << "\nShutting down RPC server..." << std::endl;
+    if (g_restServer) {
+        g_restServer->stop();
+    }
     if (g_rpcServer) {
         g_rpcServer->stop();
     }
@@ -35,6 +40,9 @@ int main(int argc, char* argv[]) {
     uint16_t port = 8332;
     std::string bindAddress = "127.0.0.1";
     bool enableAuth = true;
+    bool enableRest = false;
+    uint16_t restPort = 8334;
+    std::string restBindAddress = "127.0.0.1";
     
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -45,12 +53,23 @@ int main(int argc, char* argv[]) {
             bindAddress = argv[++i];
         } else if (arg == "--no-auth") {
             enableAuth = false;
+        } else if (arg == "--rest") {
+            enableRest = true;
+        } else if (arg == "--rest-port" && i + 1 < argc) {
+            restPort = static_cast<uint16_t>(std::stoi(argv[++i]));
+            enableRest = true;
+        } else if (arg == "--rest-bind" && i + 1 < argc) {
+            restBindAddress = argv[++i];
+            enableRest = true;
         } else if (arg == "--help" || arg == "-h") {
             std::cout << "Usage: " << argv[0] << " [options]" << std::endl;
             std::cout << "Options:" << std::endl;
             std::cout << "  --port <port>      Set RPC port (default: 8332)" << std::endl;
             std::cout << "  --bind <address>   Set bind address (default: 127.0.0.1)" << std::endl;
             std::cout << "  --no-auth          Disable authentication" << std::endl;
+            std::cout << "  --rest             Serve the unauthenticated read-only REST interface" << std::endl;
+            std::cout << "  --rest-port <port> Set REST port (default: 8334)" << std::endl;
+            std::cout << "  --rest-bind <addr> Set REST bind address (default: 127.0.0.1)" << std::endl;
             std::cout << "  --help             Show this help" << std::endl;
             return 0;
         }
@@ -103,38 +122,46 @@ int main(int argc, char* argv[]) {
         // Create RPC commands handler
         auto rpcCommands = std::make_shared<RPCCommands>(chainState, mempool, walletManager);
         
-        // Register RPC methods
-        g_rpcServer->registerMethod("getblockchaininfo", [rpcCommands](const std::string& params) {
-            return rpcCommands->getBlockchainInfo(params);
-        });
+        // Register RPC methods; queries are marked read-only so batches can run them in parallel
+        g_rpcServer->registerMethod("getblockchaininfo", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getBlockchainInfo(params, result);
+        }, true);
         
-        g_rpcServer->registerMethod("getbestblockhash", [rpcCommands](const std::string& params) {
-            return rpcCommands->getBestBlockHash(params);
-        });
+        g_rpcServer->registerMethod("getbestblockhash", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getBestBlockHash(params, result);
+        }, true);
         
-        g_rpcServer->registerMethod("getblockcount", [rpcCommands](const std::string& params) {
-            return rpcCommands->getBlockCount(params);
-        });
+        g_rpcServer->registerMethod("getblockcount", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getBlockCount(params, result);
+        }, true);
         
-        g_rpcServer->registerMethod("getbalance", [rpcCommands](const std::string& params) {
-            return rpcCommands->getBalance(params);
-        });
+        g_rpcServer->registerMethod("getblockfilter", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getBlockFilter(params, result);
+        }, true);
+        
+        g_rpcServer->registerMethod("getpeerinfo", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getPeerInfo(params, result);
+        }, true);
         
-        g_rpcServer->registerMethod("getnewaddress", [rpcCommands](const std::string& params) {
-            return rpcCommands->getNewAddress(params);
+        g_rpcServer->registerMethod("getbalance", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getBalance(params, result);
+        }, true);
+        
+        g_rpcServer->registerMethod("getnewaddress", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getNewAddress(params, result);
         });
         
-        g_rpcServer->registerMethod("sendtoaddress", [rpcCommands](const std::string& params) {
-            return rpcCommands->sendToAddress(params);
+        g_rpcServer->registerMethod("sendtoaddress", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->sendToAddress(params, result);
         });
         
-        g_rpcServer->registerMethod("listunspent", [rpcCommands](const std::string& params) {
+        g_rpcServer->registerStreamingMethod("listunspent", [rpcCommands](const JsonValue& params) {
             return rpcCommands->listUnspent(params);
-        });
+        }, true);
         
-        g_rpcServer->registerMethod("getwalletinfo", [rpcCommands](const std::string& params) {
-            return rpcCommands->getWalletInfo(params);
-        });
+        g_rpcServer->registerMethod("getwalletinfo", [rpcCommands](const JsonValue& params, JsonWriter& result) {
+            rpcCommands->getWalletInfo(params, result);
+        }, true);
         
         // Start the server
         std::cout << std::endl;
@@ -163,6 +190,24 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
+        if (enableRest) {
+            RESTServer::Config restConfig;
+            restConfig.port = restPort;
+            restConfig.bindAddress = restBindAddress;
+            
+            g_restServer = std::make_unique<RESTServer>(restConfig);
+            g_restServer->setChainState(chainState);
+            g_restServer->setMempool(mempool);
+            g_restServer->setUTXOSet(utxoSet);
+            g_restServer->setChainLock(g_rpcServer->getChainLock());   // Same lock sendtoaddress takes
+            if (!g_restServer->start()) {
+                std::cerr << "❌ Failed to start REST server" << std::endl;
+                g_rpcServer->stop();
+                return 1;
+            }
+            std::cout << "REST interface: http://" << restBindAddress << ":" << restPort << "/rest/" << std::endl;
+        }
+        
         std::cout << "✅ RPC server is running. Press Ctrl+C to stop." << std::endl;
         
         // Keep the server running
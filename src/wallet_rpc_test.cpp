@@ -7,6 +7,17 @@
 
 using namespace pragma;
 
+// Runs one RPC command with JSON params and returns its result as JSON text
+std::string callCommand(RPCCommands& commands, void (RPCCommands::*command)(const JsonValue&, JsonWriter&),
+                        const std::string& params) {
+    JsonDocument document;
+    document.parse(params);
+    std::string out;
+    JsonWriter result(out);
+    (commands.*command)(document.root(), result);
+    return out;
+}
+
 void testWalletFunctionality() {
     std::cout << "\n=== Testing Wallet Functionality ===" << std::endl;
     
@@ -121,52 +132,53 @@ void testRPCCommands() {
     RPCCommands rpcCommands(nullptr, nullptr, walletManagerPtr);
     
     // Test wallet info
-    std::string walletInfo = rpcCommands.getWalletInfo("[]");
+    std::string walletInfo = callCommand(rpcCommands, &RPCCommands::getWalletInfo, "[]");
     std::cout << "✅ Wallet info: " << walletInfo.substr(0, 100) << "..." << std::endl;
     
     // Test new address generation
-    std::string newAddress = rpcCommands.getNewAddress("[\"test-label\"]");
+    std::string newAddress = callCommand(rpcCommands, &RPCCommands::getNewAddress, "[\"test-label\"]");
     std::cout << "✅ New address: " << newAddress << std::endl;
     
     // Test balance
-    std::string balance = rpcCommands.getBalance("[]");
+    std::string balance = callCommand(rpcCommands, &RPCCommands::getBalance, "[]");
     std::cout << "✅ Balance: " << balance << std::endl;
     
     // Test list unspent
-    std::string unspent = rpcCommands.listUnspent("[]");
+    JsonDocument unspentParams;
+    unspentParams.parse("[]");
+    std::string unspent;
+    JsonWriter unspentResult(unspent);
+    rpcCommands.listUnspent(unspentParams.root())(unspentResult);
     std::cout << "✅ Unspent outputs: " << unspent.substr(0, 50) << "..." << std::endl;
 }
 
 void testJSONParser() {
     std::cout << "\n=== Testing JSON Parser ===" << std::endl;
     
-    // Test string parsing
+    // Test object parsing
     std::string jsonStr = R"({"method":"getbalance","params":[],"id":"test"})";
-    auto parsed = JSONParser::parse(jsonStr);
+    JsonDocument parsed;
     
-    if (parsed.type == JSONParser::Value::OBJECT) {
+    if (parsed.parse(jsonStr) && parsed.root().isObject()) {
         std::cout << "✅ JSON object parsed successfully" << std::endl;
-        std::cout << "  Method: " << parsed.objectValue["method"].stringValue << std::endl;
-        std::cout << "  ID: " << parsed.objectValue["id"].stringValue << std::endl;
+        std::cout << "  Method: " << parsed.root()["method"].getString() << std::endl;
+        std::cout << "  ID: " << parsed.root()["id"].getString() << std::endl;
     }
     
     // Test array parsing
     std::string arrayJson = R"(["address1", 1.5, true, null])";
-    auto arrayParsed = JSONParser::parse(arrayJson);
+    JsonDocument arrayParsed;
     
-    if (arrayParsed.type == JSONParser::Value::ARRAY) {
+    if (arrayParsed.parse(arrayJson) && arrayParsed.root().isArray()) {
         std::cout << "✅ JSON array parsed successfully" << std::endl;
-        std::cout << "  Array size: " << arrayParsed.arrayValue.size() << std::endl;
+        std::cout << "  Array size: " << arrayParsed.root().size() << std::endl;
     }
     
-    // Test stringify
-    JSONParser::Value testValue;
-    testValue.type = JSONParser::Value::OBJECT;
-    testValue.objectValue["result"] = JSONParser::Value("success");
-    testValue.objectValue["count"] = JSONParser::Value(42.0);
-    
-    std::string stringified = JSONParser::stringify(testValue);
-    std::cout << "✅ JSON stringify: " << stringified << std::endl;
+    // Test writer
+    std::string written;
+    JsonWriter writer(written);
+    writer.beginObject().key("result").string("success").key("count").number(42).endObject();
+    std::cout << "✅ JSON writer: " << written << std::endl;
 }
 
 void testRPCServer() {
@@ -189,8 +201,8 @@ void testRPCServer() {
         rpcServer.setWalletManager(walletManagerPtr);
         
         // Register additional test methods
-        rpcServer.registerMethod("test", [](const std::string& params) {
-            return "\"RPC server test successful\"";
+        rpcServer.registerMethod("test", [](const JsonValue& params, JsonWriter& result) {
+            result.string("RPC server test successful");
         });
         
         // Start server
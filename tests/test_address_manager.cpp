@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "network/address_manager.h"
+#include <cstdio>
+#include <fstream>
+
+using namespace pragma;
+
+class AddressManagerTest : public ::testing::Test {
+protected:
+    static constexpr int64_t NOW = 1700000000;
+
+    std::string filename;
+
+    void SetUp() override {
+        filename = "test_addrman_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + ".dat";
+    }
+
+    void TearDown() override {
+        std::remove(filename.c_str());
+    }
+
+    static NetworkAddress addr(int a, int b, int c, int d, uint16_t port = 8333) {
+        return NetworkAddress(std::to_string(a) + "." + std::to_string(b) + "." + std::to_string(c) + "." +
+                              std::to_string(d), port);
+    }
+};
+
+TEST_F(AddressManagerTest, DeduplicatesAddresses) {
+    AddressManager manager;
+    NetworkAddress source = addr(1, 2, 3, 4);
+
+    EXPECT_TRUE(manager.add(addr(10, 0, 0, 1), source, NOW));
+    EXPECT_FALSE(manager.add(addr(10, 0, 0, 1), source, NOW));
+    EXPECT_TRUE(manager.add(addr(11, 0, 0, 1), addr(5, 6, 7, 8), NOW));
+    EXPECT_EQ(manager.size(), 2u);
+    EXPECT_EQ(manager.getNewCount(), 2u);
+    EXPECT_TRUE(manager.contains(addr(10, 0, 0, 1)));
+}
+
+TEST_F(AddressManagerTest, SingleSourceCannotFillTable) {
+    AddressManager manager;
+    NetworkAddress source = addr(6, 6, 6, 6);
+
+    // Every address from one source group lands in a bounded set of new buckets
+    for (int i = 0; i < 20000; ++i) {
+        manager.add(addr(20 + i / 65536, (i / 256) % 256, i % 256, 1), source, NOW);
+    }
+    EXPECT_LE(manager.size(), AddressManager::NEW_BUCKETS_PER_SOURCE_GROUP * AddressManager::BUCKET_SIZE);
+}
+
+TEST_F(AddressManagerTest, GoodMovesToTriedAndSelectionPrefersIt) {
+    AddressManager manager;
+    NetworkAddress source = addr(1, 2, 3, 4);
+    NetworkAddress reachable = addr(30, 1, 1, 1);
+    manager.add(reachable, source, NOW);
+    for (int i = 0; i < 50; ++i) {
+        NetworkAddress failing = addr(40, i, 1, 1);
+        manager.add(failing, source, NOW);
+        for (int attempt = 0; attempt < 8; ++attempt) {
+            manager.attempt(failing, NOW - 3600);
+        }
+    }
+
+    manager.good(reachable, NOW);
+    EXPECT_EQ(manager.getTriedCount(), 1u);
+    AddressManager::Info info;
+    ASSERT_TRUE(manager.getInfo(reachable, info));
+    EXPECT_TRUE(info.tried);
+    EXPECT_EQ(info.attempts, 0u);
+
+    // Half the picks come from the tried table, and failing new entries rarely win
+    int reachablePicks = 0;
+    for (int i = 0; i < 200; ++i) {
+        NetworkAddress picked;
+        ASSERT_TRUE(manager.select(picked, false, NOW + 3600));
+        reachablePicks += picked.toString() == reachable.toString() ? 1 : 0;
+    }
+    EXPECT_GT(reachablePicks, 60);
+}
+
+TEST_F(AddressManagerTest, ManualPeersBecomeTriedInAFullTable) {
+    AddressManager manager;
+    NetworkAddress source = addr(70, 1, 0, 0);
+
+    // Fresh gossip from the manual peers' own group fills their new buckets
+    for (int i = 0; i < 20000; ++i) {
+        manager.add(addr(70, 1, i / 256, i % 256), source, NOW);
+    }
+    size_t before = manager.size();
+
+    for (int i = 0; i < 10; ++i) {
+        NetworkAddress manual = addr(70, 1, 200, i);
+        manager.good(manual, NOW);
+        AddressManager::Info info;
+        ASSERT_TRUE(manager.getInfo(manual, info));
+        EXPECT_TRUE(info.tried);
+    }
+    EXPECT_LE(manager.size(), before + 10);
+}
+
+TEST_F(AddressManagerTest, TerribleAddressesAreNotShared) {
+    AddressManager manager;
+    NetworkAddress source = addr(1, 2, 3, 4);
+    NetworkAddress dead = addr(50, 1, 1, 1);
+    manager.add(dead, source, NOW);
+    manager.add(addr(51, 1, 1, 1), source, NOW);
+    for (uint32_t i = 0; i < AddressManager::MAX_RETRIES; ++i) {
+        manager.attempt(dead, NOW);
+    }
+
+    auto shared = manager.getAddresses(10, NOW + 3600);
+    ASSERT_EQ(shared.size(), 1u);
+    EXPECT_EQ(shared[0].toString(), "51.1.1.1:8333");
+}
+
+TEST_F(AddressManagerTest, PersistsAcrossRestart) {
+    AddressManager manager;
+    NetworkAddress source = addr(1, 2, 3, 4);
+    for (int i = 0; i < 10; ++i) {
+        manager.good(addr(60, i, 0, 1), NOW);
+    }
+    for (int i = 0; i < 100; ++i) {
+        manager.add(addr(60, i, 0, 1), source, NOW);
+    }
+    ASSERT_GE(manager.getTriedCount(), 9u); // Bucket collisions may bump one
+    ASSERT_TRUE(manager.saveToFile(filename));
+
+    AddressManager restored;
+    ASSERT_TRUE(restored.loadFromFile(filename));
+    EXPECT_EQ(restored.size(), manager.size());
+    EXPECT_EQ(restored.getTriedCount(), manager.getTriedCount());
+    for (int i = 0; i < 10; ++i) {
+        AddressManager::Info before, after;
+        ASSERT_TRUE(manager.getInfo(addr(60, i, 0, 1), before));
+        ASSERT_TRUE(restored.getInfo(addr(60, i, 0, 1), after));
+        EXPECT_EQ(after.tried, before.tried);
+        EXPECT_EQ(after.lastSuccess, NOW);
+    }
+
+    EXPECT_FALSE(restored.loadFromFile(filename + ".missing"));
+
+    // Integers are little-endian on disk regardless of the host
+    std::ifstream file(filename, std::ios::binary);
+    char magic[4];
+    ASSERT_TRUE(file.read(magic, sizeof(magic)));
+    EXPECT_EQ(std::string(magic, sizeof(magic)), "PADR");
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "network/p2p.h"
+#include <algorithm>
+
+using namespace pragma;
+
+class AnnouncementTest : public ::testing::Test {
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static InventoryVector txInv(size_t i) {
+        return InventoryVector(InventoryType::TX, "tx" + std::to_string(i));
+    }
+
+    static std::shared_ptr<Peer> makePeer(bool inbound) {
+        return std::make_shared<Peer>("peer", NetworkAddress("10.0.0.1", 8333), inbound);
+    }
+};
+
+TEST_F(AnnouncementTest, SkipsInventoryThePeerAlreadyKnows) {
+    auto peer = makePeer(false);
+    peer->addKnownInventory("tx0");
+
+    peer->queueAnnouncement(txInv(0));
+    EXPECT_EQ(peer->getPendingAnnouncementCount(), 0u);
+
+    peer->queueAnnouncement(txInv(1));
+    peer->queueAnnouncement(txInv(1));
+    EXPECT_EQ(peer->getPendingAnnouncementCount(), 1u);
+
+    // Learned from the peer while waiting: dropped rather than echoed back
+    peer->queueAnnouncement(txInv(2));
+    peer->addKnownInventory("tx2");
+
+    auto sent = peer->takeAnnouncements(10);
+    ASSERT_EQ(sent.size(), 1u);
+    EXPECT_EQ(sent[0].hash, "tx1");
+    EXPECT_EQ(peer->getPendingAnnouncementCount(), 0u);
+
+    // Announced once, never queued again
+    peer->queueAnnouncement(txInv(1));
+    EXPECT_EQ(peer->getPendingAnnouncementCount(), 0u);
+}
+
+TEST_F(AnnouncementTest, CarriesOverWhatDoesNotFitOneMessage) {
+    auto peer = makePeer(false);
+    for (size_t i = 0; i < 2500; ++i) {
+        peer->queueAnnouncement(txInv(i));
+    }
+
+    auto first = peer->takeAnnouncements(1000);
+    ASSERT_EQ(first.size(), 1000u);
+    EXPECT_EQ(first.front().hash, "tx0");
+    EXPECT_EQ(first.back().hash, "tx999");
+    EXPECT_EQ(peer->getPendingAnnouncementCount(), 1500u);
+
+    auto second = peer->takeAnnouncements(1000);
+    ASSERT_EQ(second.size(), 1000u);
+    EXPECT_EQ(second.front().hash, "tx1000");
+
+    EXPECT_EQ(peer->takeAnnouncements(1000).size(), 500u);
+    EXPECT_TRUE(peer->takeAnnouncements(1000).empty());
+}
+
+TEST_F(AnnouncementTest, DropsOldestPastTheQueueCap) {
+    auto peer = makePeer(true);
+    const size_t cap = Peer::MAX_PENDING_ANNOUNCEMENTS;
+    for (size_t i = 0; i < cap + 10; ++i) {
+        peer->queueAnnouncement(txInv(i));
+    }
+    EXPECT_EQ(peer->getPendingAnnouncementCount(), cap);
+
+    auto sent = peer->takeAnnouncements(1);
+    ASSERT_EQ(sent.size(), 1u);
+    EXPECT_EQ(sent[0].hash, "tx10");
+
+    // A dropped entry is no longer pending, so it can be queued again
+    peer->queueAnnouncement(txInv(0));
+    EXPECT_EQ(peer->getPendingAnnouncementCount(), cap);
+}
+
+TEST_F(AnnouncementTest, PoissonDelaysAreSeededAndAverageTheMean) {
+    std::mt19937_64 gen(42);
+    std::mt19937_64 replay(42);
+    const Clock::time_point now{};
+    const std::chrono::milliseconds mean(2000);
+
+    double total = 0.0;
+    const int draws = 20000;
+    for (int i = 0; i < draws; ++i) {
+        auto next = poissonNextSend(gen, now, mean);
+        EXPECT_EQ(next, poissonNextSend(replay, now, mean));
+        EXPECT_GE(next, now);
+        total += std::chrono::duration<double, std::milli>(next - now).count();
+    }
+    EXPECT_NEAR(total / draws, 2000.0, 60.0);
+}
+
+TEST_F(AnnouncementTest, InboundPeersShareATimerAndOutboundPeersEachHaveOne) {
+    NetworkConfig config;
+    config.randomSeed = 7;
+    config.inboundInvInterval = std::chrono::milliseconds(5000);
+    config.outboundInvInterval = std::chrono::milliseconds(2000);
+    ChainState chainState;
+    P2PNetwork network(config, &chainState, nullptr);
+
+    std::vector<std::shared_ptr<Peer>> peers;
+    for (int i = 0; i < 4; ++i) {
+        bool inbound = i % 2 == 0;
+        auto peer = network.getPeerManager()->addPeer(NetworkAddress("10.0.0." + std::to_string(i + 1), 8333), inbound);
+        ASSERT_NE(peer, nullptr);
+        peer->setState(PeerState::READY);
+        peers.push_back(peer);
+    }
+
+    // The first pass arms every timer; draws go to the inbound timer first,
+    // then to outbound peers in address order
+    const Clock::time_point start{std::chrono::seconds(1000)};
+    network.simulateAnnouncements(start);
+    std::mt19937_64 replay(config.randomSeed);
+    std::unordered_map<std::string, Clock::time_point> due;
+    Clock::time_point inboundDue = poissonNextSend(replay, start, config.inboundInvInterval);
+    for (const auto& peer : peers) {
+        if (!peer->isInbound()) {
+            due[peer->getId()] = poissonNextSend(replay, start, config.outboundInvInterval);
+        } else {
+            due[peer->getId()] = inboundDue;
+        }
+    }
+
+    network.relayInventory({InventoryVector(InventoryType::BLOCK, "block1")});
+    std::unordered_map<std::string, Clock::time_point> sent;
+    for (auto now = start + std::chrono::milliseconds(1); sent.size() < peers.size(); now += std::chrono::milliseconds(1)) {
+        ASSERT_LT(now, start + std::chrono::minutes(5));
+        network.simulateAnnouncements(now);
+        for (const auto& peer : peers) {
+            if (!sent.count(peer->getId()) && peer->getPendingAnnouncementCount() == 0) {
+                sent[peer->getId()] = now;
+            }
+        }
+    }
+
+    for (const auto& peer : peers) {
+        auto expected = std::chrono::ceil<std::chrono::milliseconds>(due[peer->getId()] - start) + start;
+        EXPECT_EQ(sent[peer->getId()], std::max(expected, start + std::chrono::milliseconds(1)))
+            << (peer->isInbound() ? "inbound " : "outbound ") << peer->getAddress().toString();
+    }
+    EXPECT_EQ(sent[peers[0]->getId()], sent[peers[2]->getId()]);
+    EXPECT_NE(sent[peers[1]->getId()], sent[peers[3]->getId()]);
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "network/block_download.h"
+
+using namespace pragma;
+
+class BlockDownloadTest : public ::testing::Test {
+protected:
+    using Clock = BlockDownloadScheduler::Clock;
+
+    std::vector<std::string> hashes;
+    Clock::time_point start;
+
+    void SetUp() override {
+        for (int i = 0; i < 20; ++i) {
+            hashes.push_back("block" + std::to_string(i));
+        }
+        start = Clock::now();
+    }
+
+    void TearDown() override {}
+
+    static std::shared_ptr<Block> makeBlock(const std::string& hash) {
+        auto block = std::make_shared<Block>();
+        block->hash = hash;
+        return block;
+    }
+
+    static BlockDownloadScheduler::Config smallConfig() {
+        BlockDownloadScheduler::Config config;
+        config.windowSize = 8;
+        config.initialPerPeer = 4;
+        config.minPerPeer = 1;
+        config.maxPerPeer = 16;
+        config.stallTimeout = std::chrono::milliseconds(1000);
+        return config;
+    }
+};
+
+TEST_F(BlockDownloadTest, SpreadsWindowAcrossPeers) {
+    BlockDownloadScheduler scheduler(smallConfig());
+    scheduler.addBlocks(hashes);
+
+    auto first = scheduler.assignBlocks("peerA", start);
+    auto second = scheduler.assignBlocks("peerB", start);
+    auto third = scheduler.assignBlocks("peerC", start);
+
+    ASSERT_EQ(first.size(), 4u);
+    ASSERT_EQ(second.size(), 4u);
+    EXPECT_TRUE(third.empty()); // Window of 8 is fully in flight
+    EXPECT_EQ(first.front(), "block0");
+    EXPECT_EQ(second.front(), "block4");
+    EXPECT_EQ(scheduler.getInFlightCount(), 8u);
+}
+
+TEST_F(BlockDownloadTest, ConnectsInOrderAfterOutOfOrderArrival) {
+    BlockDownloadScheduler scheduler(smallConfig());
+    scheduler.addBlocks(hashes);
+    scheduler.assignBlocks("peerA", start);
+    scheduler.assignBlocks("peerB", start);
+
+    EXPECT_EQ(scheduler.blockReceived("peerB", makeBlock("block4"), 100, start),
+              BlockDownloadScheduler::ReceiveResult::ACCEPTED);
+    EXPECT_TRUE(scheduler.takeConnectable().empty());
+    EXPECT_EQ(scheduler.getBufferedBytes(), 100u);
+
+    scheduler.blockReceived("peerA", makeBlock("block0"), 100, start);
+    auto ready = scheduler.takeConnectable();
+    ASSERT_EQ(ready.size(), 1u);
+    EXPECT_EQ(ready[0]->hash, "block0");
+    EXPECT_EQ(scheduler.getPendingCount(), hashes.size() - 1);
+
+    EXPECT_EQ(scheduler.blockReceived("peerB", makeBlock("block4"), 100, start),
+              BlockDownloadScheduler::ReceiveResult::DUPLICATE);
+    EXPECT_EQ(scheduler.blockReceived("peerB", makeBlock("unknown"), 100, start),
+              BlockDownloadScheduler::ReceiveResult::UNSOLICITED);
+}
+
+TEST_F(BlockDownloadTest, StalledBlocksMoveToAnotherPeer) {
+    BlockDownloadScheduler scheduler(smallConfig());
+    scheduler.addBlocks(hashes);
+    scheduler.assignBlocks("slow", start);
+
+    auto stalled = scheduler.expireStalled(start + std::chrono::seconds(2));
+    ASSERT_EQ(stalled.size(), 1u);
+    EXPECT_EQ(stalled[0], "slow");
+    EXPECT_EQ(scheduler.getPeerInFlight("slow"), 0u);
+    EXPECT_EQ(scheduler.getPeerLimit("slow"), 2u);
+
+    auto reassigned = scheduler.assignBlocks("fast", start + std::chrono::seconds(2));
+    ASSERT_FALSE(reassigned.empty());
+    EXPECT_EQ(reassigned.front(), "block0");
+}
+
+TEST_F(BlockDownloadTest, RemovedPeerBlocksAreRequeued) {
+    BlockDownloadScheduler scheduler(smallConfig());
+    scheduler.addBlocks(hashes);
+    scheduler.assignBlocks("peerA", start);
+    EXPECT_EQ(scheduler.getQueuedCount(), hashes.size() - 4);
+
+    scheduler.removePeer("peerA");
+    EXPECT_EQ(scheduler.getInFlightCount(), 0u);
+    EXPECT_EQ(scheduler.getQueuedCount(), hashes.size());
+}
+
+TEST_F(BlockDownloadTest, FastPeersGetDeeperPipelines) {
+    BlockDownloadScheduler scheduler(smallConfig());
+    std::vector<std::string> many;
+    for (int i = 0; i < 200; ++i) {
+        many.push_back("b" + std::to_string(i));
+    }
+    scheduler.addBlocks(many);
+
+    // Deliver 40 blocks over two seconds: 20 blocks/s with a 2s pipeline
+    auto now = start;
+    size_t delivered = 0;
+    while (delivered < 40) {
+        for (const auto& hash : scheduler.assignBlocks("fast", now)) {
+            now += std::chrono::milliseconds(50);
+            scheduler.blockReceived("fast", makeBlock(hash), 10, now);
+            delivered++;
+        }
+        scheduler.takeConnectable();
+    }
+
+    EXPECT_GT(scheduler.getPeerRate("fast"), 10.0);
+    EXPECT_EQ(scheduler.getPeerLimit("fast"), 16u); // Clamped to maxPerPeer
+}
+
+TEST_F(BlockDownloadTest, BufferBudgetOnlyAdmitsNextBlock) {
+    auto config = smallConfig();
+    config.maxBufferedBytes = 150;
+    BlockDownloadScheduler scheduler(config);
+    scheduler.addBlocks(hashes);
+
+    auto assigned = scheduler.assignBlocks("peerA", start);
+    scheduler.blockReceived("peerA", makeBlock(assigned[1]), 200, start);
+    scheduler.removePeer("peerA");
+
+    // Over budget: only block0, which unblocks connecting, may be requested
+    auto next = scheduler.assignBlocks("peerB", start);
+    ASSERT_EQ(next.size(), 1u);
+    EXPECT_EQ(next[0], "block0");
+}
+
+TEST_F(BlockDownloadTest, UnrequestedBlocksAreOnlyTakenWhenConnectable) {
+    auto config = smallConfig();
+    config.maxBufferedBytes = 150;
+    BlockDownloadScheduler scheduler(config);
+    scheduler.addBlocks(hashes);
+
+    // Scheduled but never requested: would be buffered past the budget
+    EXPECT_EQ(scheduler.blockReceived("peerA", makeBlock("block12"), 1000, start),
+              BlockDownloadScheduler::ReceiveResult::UNSOLICITED);
+    EXPECT_EQ(scheduler.getBufferedBytes(), 0u);
+    EXPECT_EQ(scheduler.getQueuedCount(), hashes.size());
+
+    // The next block to connect is taken regardless
+    EXPECT_EQ(scheduler.blockReceived("peerA", makeBlock("block0"), 1000, start),
+              BlockDownloadScheduler::ReceiveResult::ACCEPTED);
+    auto ready = scheduler.takeConnectable();
+    ASSERT_EQ(ready.size(), 1u);
+    EXPECT_EQ(ready[0]->hash, "block0");
+    EXPECT_EQ(scheduler.getBufferedBytes(), 0u);
+
+    // A block requeued after its peer left is no longer expected from anyone
+    auto assigned = scheduler.assignBlocks("peerB", start);
+    ASSERT_GE(assigned.size(), 2u);
+    scheduler.removePeer("peerB");
+    EXPECT_EQ(scheduler.blockReceived("peerB", makeBlock(assigned[1]), 100, start),
+              BlockDownloadScheduler::ReceiveResult::UNSOLICITED);
+}
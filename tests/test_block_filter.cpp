@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "core/block_filter.h"
+#include "core/chainstate.h"
+#include "network/protocol.h"
+
+using namespace pragma;
+
+class BlockFilterTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    // Block paying to the given addresses and spending one outpoint
+    static Block createBlock(const std::vector<std::string>& addresses, const OutPoint& spent) {
+        std::vector<Transaction> txs;
+        txs.push_back(Transaction::createCoinbase(addresses.front(), 5000000000ULL));
+        std::vector<TxOut> outputs;
+        for (size_t i = 1; i < addresses.size(); ++i) {
+            outputs.emplace_back(1000 + i, addresses[i]);
+        }
+        txs.push_back(Transaction::create({TxIn(spent, "sig", "pubkey")}, outputs));
+        Block genesis = Block::createGenesis("1GenesisAddress", 5000000000ULL);
+        return Block::create(genesis, txs, addresses.front(), 5000000000ULL);
+    }
+};
+
+TEST_F(BlockFilterTest, MatchesEveryElementAndFewOthers) {
+    std::vector<std::string> elements;
+    for (int i = 0; i < 500; ++i) {
+        elements.push_back("address" + std::to_string(i));
+    }
+    GCSFilter filter(0x0123456789abcdefULL, 0xfedcba9876543210ULL, elements);
+    EXPECT_EQ(filter.getN(), 500u);
+
+    // No false negatives
+    for (const auto& element : elements) {
+        EXPECT_TRUE(filter.match(element));
+    }
+
+    // False positives near 1/M; a handful at most over 20000 probes
+    int falsePositives = 0;
+    for (int i = 0; i < 20000; ++i) {
+        falsePositives += filter.match("other" + std::to_string(i)) ? 1 : 0;
+    }
+    EXPECT_LT(falsePositives, 5);
+
+    // About P + 1.5 bits per element
+    EXPECT_LT(filter.getEncoded().size(), 500u * 21 / 8 + 10);
+    EXPECT_TRUE(filter.matchAny({"nope", "address42"}));
+    EXPECT_FALSE(GCSFilter().match("address0"));
+}
+
+TEST_F(BlockFilterTest, BlockFilterCoversOutputsAndSpentOutpoints) {
+    OutPoint spent(std::string(64, 'a'), 3);
+    Block block = createBlock({"1Miner", "1Alice", "1Bob"}, spent);
+    BlockFilter filter(block);
+
+    EXPECT_TRUE(filter.getFilter().match("1Alice"));
+    EXPECT_TRUE(filter.getFilter().match("1Bob"));
+    EXPECT_TRUE(filter.getFilter().match(BlockFilter::outpointElement(spent)));
+    EXPECT_FALSE(filter.getFilter().match("1Carol"));
+
+    // A client decoding the served bytes sees the same set
+    BlockFilter decoded(BlockFilterType::BASIC, block.hash, filter.getEncoded());
+    EXPECT_EQ(decoded.getHash(), filter.getHash());
+    EXPECT_TRUE(decoded.getFilter().match("1Alice"));
+
+    // Headers chain through the previous header
+    std::string first = filter.computeHeader(BlockFilter::genesisPrevHeader());
+    EXPECT_EQ(first.size(), 64u);
+    EXPECT_NE(filter.computeHeader(first), first);
+
+    std::vector<uint8_t> truncated(filter.getEncoded().begin(), filter.getEncoded().end() - 2);
+    EXPECT_THROW(BlockFilter(BlockFilterType::BASIC, block.hash, truncated), std::runtime_error);
+}
+
+TEST_F(BlockFilterTest, ChainStateIndexesFiltersAndMessagesRoundTrip) {
+    ChainState chainState;
+    Block genesis = Block::createGenesis("1GenesisAddress", 5000000000ULL);
+    ASSERT_TRUE(chainState.setGenesis(genesis));
+
+    auto filter = chainState.getBlockFilter(genesis.hash);
+    ASSERT_TRUE(filter);
+    EXPECT_TRUE(filter->getFilter().match("1GenesisAddress"));
+    EXPECT_EQ(chainState.getFilterHeader(genesis.hash), filter->computeHeader(BlockFilter::genesisPrevHeader()));
+    EXPECT_EQ(chainState.getBlockFilter("unknown"), nullptr);
+
+    CFilterMessage cfilter;
+    cfilter.blockHash = genesis.hash;
+    cfilter.filter = filter->getEncoded();
+    auto data = cfilter.serialize();
+    size_t offset = 0;
+    auto decoded = CFilterMessage::deserialize(ByteSpan(data), offset);
+    EXPECT_EQ(offset, data.size());
+    EXPECT_EQ(decoded.blockHash, genesis.hash);
+    EXPECT_EQ(decoded.filter, cfilter.filter);
+
+    CFHeadersMessage cfheaders;
+    cfheaders.stopHash = genesis.hash;
+    cfheaders.prevFilterHeader = BlockFilter::genesisPrevHeader();
+    cfheaders.filterHashes = {filter->getHash()};
+    data = cfheaders.serialize();
+    offset = 0;
+    auto decodedHeaders = CFHeadersMessage::deserialize(ByteSpan(data), offset);
+    EXPECT_EQ(decodedHeaders.filterHashes, cfheaders.filterHashes);
+    EXPECT_EQ(decodedHeaders.prevFilterHeader, cfheaders.prevFilterHeader);
+}
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "core/chainstate.h"
 #include "core/block.h"
+#include "network/protocol.h"
+#include "primitives/utils.h"
 
 using namespace pragma;
 
@@ -141,7 +143,7 @@ TEST_F(ChainStateTest, ChainPathTest) {
     chainState->addBlock(block2);
     
     auto path = chainState->getChainPath(genesis.hash, block2.hash);
-    EXPECT_EQ(path.size(), 3);
+    ASSERT_EQ(path.size(), 3);
     EXPECT_EQ(path[0], genesis.hash);
     EXPECT_EQ(path[1], block1.hash);
     EXPECT_EQ(path[2], block2.hash);
@@ -158,7 +160,7 @@ TEST_F(ChainStateTest, GetChainTest) {
     chainState->addBlock(block2);
     
     auto chain = chainState->getChain();
-    EXPECT_EQ(chain.size(), 3);
+    ASSERT_EQ(chain.size(), 3);
     EXPECT_EQ(chain[0]->height, 0);
     EXPECT_EQ(chain[1]->height, 1);
     EXPECT_EQ(chain[2]->height, 2);
@@ -270,3 +272,36 @@ TEST_F(ChainStateTest, SaveAndLoadTest) {
     // Clean up
     std::remove(filename.c_str());
 }
+
+TEST_F(ChainStateTest, SerializedBlockTest) {
+    chainState->setCheckProofOfWork(false);
+    Block genesis = createTestGenesis();
+    chainState->setGenesis(genesis);
+    
+    Block block1 = createTestBlock(genesis);
+    block1.header.timestamp = genesis.header.timestamp + 1;
+    block1.computeHash();
+    ASSERT_TRUE(chainState->addBlock(block1));
+    
+    // Stored bytes are the block's encoding
+    auto stored = chainState->getSerializedBlock(block1.hash);
+    ASSERT_NE(stored, nullptr);
+    EXPECT_EQ(*stored, block1.serialize());
+    EXPECT_EQ(chainState->getSerializedBlock("nonexistent"), nullptr);
+    
+    // A BLOCK message built from them frames exactly like a re-serialized one
+    auto entry = chainState->getBlock(block1.hash);
+    auto fromStore = P2PMessage::createBlock(std::shared_ptr<Block>(entry, &entry->block), stored);
+    auto reencoded = P2PMessage::createBlock(std::make_shared<Block>(block1));
+    EXPECT_EQ(fromStore->serialize(), reencoded->serialize());
+    
+    // Loading keeps the bytes read from the file
+    std::string filename = "/tmp/test_chainstate_serialized.dat";
+    ASSERT_TRUE(chainState->saveToFile(filename));
+    ChainState loaded;
+    ASSERT_TRUE(loaded.loadFromFile(filename));
+    auto reloaded = loaded.getSerializedBlock(block1.hash);
+    ASSERT_NE(reloaded, nullptr);
+    EXPECT_EQ(*reloaded, *stored);
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "primitives/checksum.h"
+#include "primitives/utils.h"
+#include <string>
+
+using namespace pragma;
+
+class ChecksumTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static std::vector<uint8_t> bytes(const std::string& str) {
+        return std::vector<uint8_t>(str.begin(), str.end());
+    }
+};
+
+TEST_F(ChecksumTest, DoubleSha256EmptyPayload) {
+    // Bitcoin's checksum of an empty payload is 5d f6 e0 e2
+    EXPECT_EQ(Checksum::doubleSha256(nullptr, 0), 0xE2E0F65Du);
+    EXPECT_EQ(Utils::calculateChecksum(std::vector<uint8_t>()), 0xE2E0F65Du);
+}
+
+TEST_F(ChecksumTest, Crc32cKnownVectors) {
+    auto digits = bytes("123456789");
+    EXPECT_EQ(Checksum::crc32c(digits.data(), digits.size()), 0xE3069283u);
+
+    std::vector<uint8_t> zeros(32, 0x00);
+    EXPECT_EQ(Checksum::crc32c(zeros.data(), zeros.size()), 0x8A9136AAu);
+
+    std::vector<uint8_t> ones(32, 0xFF);
+    EXPECT_EQ(Checksum::crc32c(ones.data(), ones.size()), 0x62A8AB43u);
+}
+
+TEST_F(ChecksumTest, IncrementalMatchesOneShot) {
+    std::vector<uint8_t> data(10000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+
+    for (auto type : {ChecksumType::DOUBLE_SHA256, ChecksumType::CRC32C}) {
+        Checksum checksum(type);
+        size_t offset = 0;
+        size_t chunk = 1;
+        while (offset < data.size()) {
+            size_t length = std::min(chunk, data.size() - offset);
+            checksum.update(data.data() + offset, length);
+            offset += length;
+            chunk = chunk * 3 + 1;
+        }
+        EXPECT_EQ(checksum.finalize(), Checksum::compute(type, data.data(), data.size()));
+    }
+}
+
+TEST_F(ChecksumTest, DetectsSingleBitFlip) {
+    auto payload = bytes("block payload with some transactions");
+    uint32_t sha = Checksum::doubleSha256(payload.data(), payload.size());
+    uint32_t crc = Checksum::crc32c(payload.data(), payload.size());
+
+    payload[5] ^= 0x01;
+    EXPECT_NE(Checksum::doubleSha256(payload.data(), payload.size()), sha);
+    EXPECT_NE(Checksum::crc32c(payload.data(), payload.size()), crc);
+}
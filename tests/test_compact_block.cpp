@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "network/compact_block.h"
+
+using namespace pragma;
+
+class CompactBlockTest : public ::testing::Test {
+protected:
+    Block block;
+
+    void SetUp() override {
+        Block genesis = Block::createGenesis("genesis_miner", 5000000000ULL);
+
+        std::vector<Transaction> txs;
+        for (uint32_t i = 0; i < 5; ++i) {
+            TxIn input(OutPoint(genesis.transactions[0].txid, i), "sig" + std::to_string(i), "pubkey");
+            TxOut output(1000 + i, "recipient" + std::to_string(i));
+            txs.push_back(Transaction::create({input}, {output}));
+        }
+        block = Block::create(genesis, txs, "miner", 5000000000ULL);
+    }
+
+    void TearDown() override {}
+};
+
+TEST_F(CompactBlockTest, BuildPrefillsCoinbase) {
+    auto compact = CompactBlocks::build(block, 42);
+
+    ASSERT_EQ(compact.prefilled.size(), 1u);
+    EXPECT_EQ(compact.prefilled[0].index, 0u);
+    EXPECT_EQ(compact.prefilled[0].tx.txid, block.transactions[0].txid);
+    EXPECT_EQ(compact.shortIds.size(), block.transactions.size() - 1);
+    EXPECT_EQ(compact.getTransactionCount(), block.transactions.size());
+
+    for (uint64_t shortId : compact.shortIds) {
+        EXPECT_EQ(shortId & ~CompactBlocks::SHORT_ID_MASK, 0u);
+    }
+}
+
+TEST_F(CompactBlockTest, ShortIdsDependOnNonce) {
+    auto first = CompactBlocks::build(block, 1);
+    auto second = CompactBlocks::build(block, 2);
+    EXPECT_EQ(first.shortIds, CompactBlocks::build(block, 1).shortIds);
+    EXPECT_NE(first.shortIds, second.shortIds);
+}
+
+TEST_F(CompactBlockTest, SerializationRoundTrip) {
+    auto compact = CompactBlocks::build(block, 7);
+    auto bytes = compact.serialize();
+
+    size_t offset = 0;
+    auto decoded = CompactBlockMessage::deserialize(bytes, offset);
+    EXPECT_EQ(offset, bytes.size());
+    EXPECT_EQ(decoded.header, compact.header);
+    EXPECT_EQ(decoded.nonce, compact.nonce);
+    EXPECT_EQ(decoded.shortIds, compact.shortIds);
+    ASSERT_EQ(decoded.prefilled.size(), 1u);
+    EXPECT_EQ(decoded.prefilled[0].tx.txid, compact.prefilled[0].tx.txid);
+}
+
+TEST_F(CompactBlockTest, ReconstructWithMissingTransactions) {
+    auto compact = CompactBlocks::build(block, 99);
+
+    PartiallyDownloadedBlock partial;
+    ASSERT_EQ(partial.initialize(compact, nullptr), PartiallyDownloadedBlock::Status::OK);
+    EXPECT_EQ(partial.getBlockHash(), block.hash);
+    EXPECT_TRUE(partial.isTxAvailable(0));
+
+    // Without a mempool every non-coinbase transaction has to be fetched
+    auto missing = partial.getMissingIndexes();
+    ASSERT_EQ(missing.size(), block.transactions.size() - 1);
+
+    std::vector<Transaction> fetched;
+    for (uint32_t index : missing) {
+        fetched.push_back(block.transactions[index]);
+    }
+
+    Block rebuilt;
+    ASSERT_EQ(partial.fillBlock(rebuilt, fetched), PartiallyDownloadedBlock::Status::OK);
+    EXPECT_EQ(rebuilt.hash, block.hash);
+    EXPECT_EQ(rebuilt.transactions.size(), block.transactions.size());
+}
+
+TEST_F(CompactBlockTest, WrongTransactionsFailReconstruction) {
+    auto compact = CompactBlocks::build(block, 5);
+    PartiallyDownloadedBlock partial;
+    ASSERT_EQ(partial.initialize(compact, nullptr), PartiallyDownloadedBlock::Status::OK);
+
+    auto missing = partial.getMissingIndexes();
+    std::vector<Transaction> fetched;
+    for (uint32_t index : missing) {
+        fetched.push_back(block.transactions[index]);
+    }
+    std::swap(fetched.front(), fetched.back());
+
+    Block rebuilt;
+    EXPECT_EQ(partial.fillBlock(rebuilt, fetched), PartiallyDownloadedBlock::Status::FAILED);
+
+    fetched.pop_back();
+    EXPECT_EQ(partial.fillBlock(rebuilt, fetched), PartiallyDownloadedBlock::Status::INVALID);
+}
+
+TEST_F(CompactBlockTest, RejectsOutOfRangePrefilledIndex) {
+    auto compact = CompactBlocks::build(block, 3);
+    compact.prefilled[0].index = static_cast<uint32_t>(compact.getTransactionCount());
+
+    PartiallyDownloadedBlock partial;
+    EXPECT_EQ(partial.initialize(compact, nullptr), PartiallyDownloadedBlock::Status::INVALID);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "network/protocol.h"
+#include "core/block.h"
+#include "primitives/hash.h"
+
+using namespace pragma;
+
+class HeadersMessageTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    // Contiguous chain of headers, as a sync peer would send them
+    static std::vector<std::shared_ptr<Block>> chain(size_t count) {
+        std::vector<std::shared_ptr<Block>> headers;
+        std::string prevHash(64, '0');
+        for (size_t i = 0; i < count; ++i) {
+            BlockHeader header(1, prevHash, Hash::sha256("merkle" + std::to_string(i)),
+                               1700000000 + i * 600, 0x1d00ffff, static_cast<uint32_t>(i * 7919));
+            headers.push_back(std::make_shared<Block>(header, std::vector<Transaction>()));
+            prevHash = headers.back()->hash;
+        }
+        return headers;
+    }
+
+    static HeadersMessage roundTrip(const HeadersMessage& message, size_t* bytes = nullptr) {
+        auto data = message.serialize();
+        if (bytes) *bytes = data.size();
+        size_t offset = 0;
+        HeadersMessage decoded = HeadersMessage::deserialize(ByteSpan(data), offset);
+        EXPECT_EQ(offset, data.size());
+        return decoded;
+    }
+};
+
+TEST_F(HeadersMessageTest, ContiguousRunRoundTripsCompactly) {
+    HeadersMessage message;
+    message.headers = chain(Protocol::MAX_HEADERS);
+
+    size_t bytes = 0;
+    HeadersMessage decoded = roundTrip(message, &bytes);
+    ASSERT_EQ(decoded.headers.size(), message.headers.size());
+    for (size_t i = 0; i < decoded.headers.size(); ++i) {
+        EXPECT_EQ(decoded.headers[i]->header, message.headers[i]->header);
+        EXPECT_EQ(decoded.headers[i]->hash, message.headers[i]->hash);
+    }
+
+    // Flags, merkle root, time delta and nonce per header
+    EXPECT_LT(bytes, Protocol::MAX_HEADERS * 40 + 100);
+}
+
+TEST_F(HeadersMessageTest, IrregularHeadersFallBackToFullFields) {
+    HeadersMessage message;
+    message.headers = chain(3);
+    BlockHeader odd(2, "not-a-hash", "ABCDEF", 1800000000, 0x1c00ffff, 5);
+    message.headers.push_back(std::make_shared<Block>(odd, std::vector<Transaction>()));
+    BlockHeader empty(2, "", Hash::sha256("x"), 1700000000, 0x1c00ffff, 6);
+    message.headers.push_back(std::make_shared<Block>(empty, std::vector<Transaction>()));
+
+    HeadersMessage decoded = roundTrip(message);
+    ASSERT_EQ(decoded.headers.size(), message.headers.size());
+    for (size_t i = 0; i < decoded.headers.size(); ++i) {
+        EXPECT_EQ(decoded.headers[i]->header, message.headers[i]->header);
+    }
+}
+
+TEST_F(HeadersMessageTest, RejectsMalformedInput) {
+    HeadersMessage message;
+    message.headers = chain(2);
+    auto data = message.serialize();
+
+    // Truncated payload
+    std::vector<uint8_t> truncated(data.begin(), data.end() - 3);
+    size_t offset = 0;
+    EXPECT_THROW(HeadersMessage::deserialize(ByteSpan(truncated), offset), std::runtime_error);
+
+    // The first header cannot refer to a previous one
+    std::vector<uint8_t> implied = data;
+    implied[1] |= 0x02;
+    offset = 0;
+    EXPECT_THROW(HeadersMessage::deserialize(ByteSpan(implied), offset), std::runtime_error);
+}
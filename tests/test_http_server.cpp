@@ -0,0 +1,659 @@
+#include <gtest/gtest.h>
+#include "rpc/http_server.h"
+#include "rpc/rpc.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace pragma;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Blocking loopback client that reads whole responses, by Content-Length or chunked
+class TestClient {
+public:
+    explicit TestClient(uint16_t port) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        connected = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+    ~TestClient() { close(fd); }
+
+    void send(const std::string& data) {
+        ASSERT_EQ(::send(fd, data.data(), data.size(), MSG_NOSIGNAL), static_cast<ssize_t>(data.size()));
+    }
+
+    // Status line through body, chunked bodies decoded; empty if the connection closed first
+    std::string readResponse() {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) return "";
+        }
+        size_t chunked = buffer.find("Transfer-Encoding: chunked");
+        if (chunked != std::string::npos && chunked < headerEnd) {
+            return readChunked(headerEnd + 4);
+        }
+        size_t length = 0;
+        size_t pos = buffer.find("Content-Length: ");
+        if (pos != std::string::npos && pos < headerEnd) {
+            length = std::stoul(buffer.substr(pos + 16));
+        }
+        while (buffer.size() < headerEnd + 4 + length) {
+            if (!fill()) return "";
+        }
+        std::string response = buffer.substr(0, headerEnd + 4 + length);
+        buffer.erase(0, response.size());
+        return response;
+    }
+
+    // Everything up to the server closing the connection
+    std::string readAll() {
+        while (fill()) {}
+        std::string all;
+        all.swap(buffer);
+        return all;
+    }
+
+    // Reads until text has arrived, leaving it buffered for readResponse
+    bool waitFor(const std::string& text) {
+        while (buffer.find(text) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        return true;
+    }
+
+    bool closedByServer() {
+        return buffer.empty() && !fill();
+    }
+
+    bool connected = false;
+
+private:
+    int fd;
+    std::string buffer;
+
+    bool fill() {
+        char chunk[65536];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    std::string readChunked(size_t bodyStart) {
+        std::string response = buffer.substr(0, bodyStart);
+        size_t pos = bodyStart;
+        while (true) {
+            size_t lineEnd;
+            while ((lineEnd = buffer.find("\r\n", pos)) == std::string::npos) {
+                if (!fill()) return "";
+            }
+            size_t size = std::stoul(buffer.substr(pos, lineEnd - pos), nullptr, 16);
+            while (buffer.size() < lineEnd + 2 + size + 2) {
+                if (!fill()) return "";
+            }
+            response.append(buffer, lineEnd + 2, size);
+            pos = lineEnd + 2 + size + 2;
+            if (size == 0) break;
+        }
+        buffer.erase(0, pos);
+        return response;
+    }
+};
+
+std::string body(const std::string& response) {
+    return response.substr(response.find("\r\n\r\n") + 4);
+}
+
+HttpRequestParser::Result feedAll(HttpRequestParser& parser, const std::string& data, size_t& consumed) {
+    return parser.feed(data.data(), data.size(), consumed);
+}
+
+} // namespace
+
+TEST(HttpRequestParserTest, ParsesContentLengthBodySplitAnywhere) {
+    const std::string request =
+        "POST /wallet HTTP/1.1\r\nHost: x\r\nContent-Type: application/json\r\nContent-Length: 11\r\n\r\nhello world";
+
+    HttpRequestParser parser;
+    HttpRequestParser::Result result = HttpRequestParser::Result::INCOMPLETE;
+    for (size_t i = 0; i < request.size(); ++i) {
+        size_t consumed = 0;
+        result = parser.feed(&request[i], 1, consumed);
+        EXPECT_EQ(consumed, 1u);
+        if (i + 1 < request.size()) {
+            ASSERT_EQ(result, HttpRequestParser::Result::INCOMPLETE) << "at byte " << i;
+        }
+    }
+    ASSERT_EQ(result, HttpRequestParser::Result::COMPLETE);
+    EXPECT_EQ(parser.request().method, "POST");
+    EXPECT_EQ(parser.request().target, "/wallet");
+    EXPECT_EQ(parser.request().getHeader("content-type"), "application/json");
+    EXPECT_EQ(parser.request().body, "hello world");
+    EXPECT_TRUE(parser.request().keepAlive());
+}
+
+TEST(HttpRequestParserTest, DecodesChunkedBodiesWithExtensionsAndTrailers) {
+    const std::string request =
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: yes\r\n\r\n";
+
+    HttpRequestParser parser;
+    size_t consumed = 0;
+    ASSERT_EQ(feedAll(parser, request, consumed), HttpRequestParser::Result::COMPLETE);
+    EXPECT_EQ(consumed, request.size());
+    EXPECT_EQ(parser.request().body, "hello world");
+}
+
+TEST(HttpRequestParserTest, StopsAtTheEndOfEachPipelinedRequest) {
+    const std::string first = "POST / HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc";
+    const std::string second = "GET /status HTTP/1.0\r\n\r\n";
+    const std::string both = first + second;
+
+    HttpRequestParser parser;
+    size_t consumed = 0;
+    ASSERT_EQ(feedAll(parser, both, consumed), HttpRequestParser::Result::COMPLETE);
+    EXPECT_EQ(consumed, first.size());
+    EXPECT_EQ(parser.request().body, "abc");
+
+    parser.reset();
+    ASSERT_EQ(parser.feed(both.data() + consumed, both.size() - consumed, consumed),
+              HttpRequestParser::Result::COMPLETE);
+    EXPECT_EQ(parser.request().target, "/status");
+    EXPECT_FALSE(parser.request().keepAlive());   // HTTP/1.0 without keep-alive
+}
+
+TEST(HttpRequestParserTest, RejectsMalformedAndOversizedRequests) {
+    struct Case {
+        std::string request;
+        int status;
+    };
+    HttpRequestParser::Limits limits;
+    limits.maxHeaderBytes = 256;
+    limits.maxBodyBytes = 16;
+
+    const std::vector<Case> cases = {
+        {"garbage\r\n\r\n", 400},
+        {"POST / HTTP/2.0\r\n\r\n", 505},
+        {"POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", 501},
+        {"POST / HTTP/1.1\r\nContent-Length: 17\r\n\r\n", 413},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n11\r\n", 413},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 400},
+        {"POST / HTTP/1.1\r\nX: " + std::string(300, 'a'), 431},
+    };
+    for (const auto& c : cases) {
+        HttpRequestParser parser(limits);
+        size_t consumed = 0;
+        EXPECT_EQ(feedAll(parser, c.request, consumed), HttpRequestParser::Result::ERROR) << c.request;
+        EXPECT_EQ(parser.errorStatus(), c.status) << c.request;
+    }
+}
+
+class HttpServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        config.port = 0;
+        config.workerThreads = 2;
+    }
+
+    HttpServer::Config config;
+};
+
+TEST_F(HttpServerTest, ServesManyRequestsOnOneConnection) {
+    HttpServer server(config, [](const HttpRequest& request, HttpResponse& response) {
+        response.body = request.method + " " + request.target + " " + request.body;
+    });
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    ASSERT_TRUE(client.connected);
+    for (int i = 0; i < 5; ++i) {
+        client.send("POST /" + std::to_string(i) + " HTTP/1.1\r\nContent-Length: 2\r\n\r\nhi");
+        std::string response = client.readResponse();
+        EXPECT_EQ(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+        EXPECT_EQ(body(response), "POST /" + std::to_string(i) + " hi");
+    }
+
+    // Pipelined requests, one chunked, come back in order
+    client.send("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"
+                "POST /b HTTP/1.1\r\nContent-Length: 1\r\nConnection: close\r\n\r\nz");
+    EXPECT_EQ(body(client.readResponse()), "POST /a abc");
+    std::string last = client.readResponse();
+    EXPECT_NE(last.find("Connection: close"), std::string::npos);
+    EXPECT_EQ(body(last), "POST /b z");
+    EXPECT_TRUE(client.closedByServer());
+    EXPECT_EQ(server.getRequestsServed(), 7u);
+}
+
+TEST_F(HttpServerTest, AnswersParseErrorsAndCloses) {
+    HttpServer server(config, [](const HttpRequest&, HttpResponse&) {});
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    client.send("POST / HTTP/1.1\r\nContent-Length: nope\r\n\r\n");
+    EXPECT_EQ(client.readResponse().compare(0, 24, "HTTP/1.1 400 Bad Request"), 0);
+    EXPECT_TRUE(client.closedByServer());
+}
+
+TEST_F(HttpServerTest, EnforcesMaxConnections) {
+    config.maxConnections = 1;
+    HttpServer server(config, [](const HttpRequest&, HttpResponse& response) { response.body = "ok"; });
+    ASSERT_TRUE(server.start());
+
+    TestClient first(server.getPort());
+    first.send("GET / HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(body(first.readResponse()), "ok");
+
+    TestClient second(server.getPort());
+    EXPECT_EQ(second.readResponse().compare(0, 12, "HTTP/1.1 503"), 0);
+    EXPECT_EQ(server.getRejectedConnections(), 1u);
+    EXPECT_EQ(server.getConnectionCount(), 1u);
+}
+
+TEST_F(HttpServerTest, ShedsRequestsWhenWorkersAreSaturated) {
+    config.workerThreads = 1;
+    config.maxQueuedRequests = 1;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool release = false;
+    HttpServer server(config, [&](const HttpRequest&, HttpResponse& response) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return release; });
+        response.body = "done";
+    });
+    ASSERT_TRUE(server.start());
+
+    // One request runs, one waits in the queue, the third is turned away
+    TestClient running(server.getPort()), queued(server.getPort()), shed(server.getPort());
+    running.send("GET / HTTP/1.1\r\n\r\n");
+    std::this_thread::sleep_for(100ms);
+    queued.send("GET / HTTP/1.1\r\n\r\n");
+    std::this_thread::sleep_for(100ms);
+    shed.send("GET / HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(shed.readResponse().compare(0, 12, "HTTP/1.1 503"), 0);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+    }
+    cv.notify_all();
+    EXPECT_EQ(body(running.readResponse()), "done");
+    EXPECT_EQ(body(queued.readResponse()), "done");
+    EXPECT_EQ(server.getRejectedRequests(), 1u);
+}
+
+TEST_F(HttpServerTest, StreamsChunkedResponsesUnderBackpressure) {
+    const size_t piece = 64 * 1024;
+    const size_t pieces = 512;     // 32 MiB in all
+    std::atomic<size_t> produced{0};
+    HttpServer server(config, [&](const HttpRequest&, HttpResponse& response) {
+        response.contentType = "application/octet-stream";
+        ASSERT_NE(response.stream, nullptr);
+        ASSERT_TRUE(response.stream->begin(response));
+        std::string data(piece, 'x');
+        for (size_t i = 0; i < pieces; ++i) {
+            if (!response.stream->write(data)) return;
+            produced += piece;
+        }
+        response.body = "end";
+    });
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    client.send("GET /big HTTP/1.1\r\n\r\n");
+
+    // Nothing read yet: the handler is held back by socket buffers plus the stream buffer
+    std::this_thread::sleep_for(300ms);
+    EXPECT_GT(produced.load(), 0u);
+    EXPECT_LT(produced.load(), piece * pieces / 2);
+
+    std::string response = client.readResponse();
+    ASSERT_FALSE(response.empty());
+    EXPECT_EQ(response.find("Content-Length"), std::string::npos);
+    std::string content = body(response);
+    EXPECT_EQ(content.size(), piece * pieces + 3);
+    EXPECT_EQ(content.compare(content.size() - 3, 3, "end"), 0);
+
+    // The connection is still usable afterwards
+    client.send("GET /again HTTP/1.1\r\nConnection: close\r\n\r\n");
+    EXPECT_EQ(body(client.readResponse()).size(), piece * pieces + 3);
+    EXPECT_TRUE(client.closedByServer());
+}
+
+TEST_F(HttpServerTest, StreamsToHttp10ClientsUntilClose) {
+    HttpServer server(config, [](const HttpRequest&, HttpResponse& response) {
+        response.stream->begin(response);
+        response.stream->write("first ");
+        response.body = "second";
+    });
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    client.send("GET / HTTP/1.0\r\n\r\n");
+    std::string response = client.readAll();
+    EXPECT_EQ(response.find("Transfer-Encoding"), std::string::npos);
+    EXPECT_NE(response.find("Connection: close"), std::string::npos);
+    EXPECT_EQ(body(response), "first second");
+}
+
+TEST(RPCServerHttpTest, KeepsJsonRpcConnectionsOpen) {
+    RPCServer::Config config;
+    config.port = 0;
+    config.enableAuth = false;
+    RPCServer server(config);
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    const std::string call = R"({"jsonrpc":"2.0","method":"ping","params":[],"id":"1"})";
+    for (int i = 0; i < 3; ++i) {
+        client.send("POST / HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: " +
+                    std::to_string(call.size()) + "\r\n\r\n" + call);
+        EXPECT_NE(body(client.readResponse()).find("\"result\":\"pong\""), std::string::npos);
+    }
+
+    client.send("GET / HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(client.readResponse().compare(0, 12, "HTTP/1.1 405"), 0);
+    server.stop();
+}
+
+TEST(RPCServerHttpTest, ChallengesUnauthenticatedCalls) {
+    RPCServer::Config config;
+    config.port = 0;
+    RPCServer server(config);
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    const std::string call = R"({"jsonrpc":"2.0","method":"ping","params":[],"id":"1"})";
+    client.send("POST / HTTP/1.1\r\nContent-Length: " + std::to_string(call.size()) + "\r\n\r\n" + call);
+    std::string response = client.readResponse();
+    EXPECT_EQ(response.compare(0, 25, "HTTP/1.1 401 Unauthorized"), 0);
+    EXPECT_NE(response.find("WWW-Authenticate: Basic realm=\"jsonrpc\"\r\n"), std::string::npos);
+
+    client.send("POST / HTTP/1.1\r\nAuthorization: Basic " + config.username + ":" + config.password +
+                "\r\nContent-Length: " + std::to_string(call.size()) + "\r\n\r\n" + call);
+    response = client.readResponse();
+    EXPECT_EQ(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    EXPECT_NE(body(response).find("\"result\":\"pong\""), std::string::npos);
+    server.stop();
+}
+
+TEST(RPCServerHttpTest, StreamsLargeResultsAndReportsFailedOnes) {
+    RPCServer::Config config;
+    config.port = 0;
+    config.enableAuth = false;
+    RPCServer server(config);
+    server.registerStreamingMethod("dump", [](const JsonValue& params) -> RPCServer::RPCWriter {
+        int64_t count = params[0].getInt64();
+        bool fail = params[1].getBool();
+        return [count, fail](JsonWriter& result) {
+            result.beginArray();
+            for (int64_t i = 0; i < count; ++i) {
+                result.beginObject().key("n").number(i).key("pad").string(std::string(100, 'p')).endObject();
+            }
+            if (fail) {
+                throw RPCError(RPC_MISC_ERROR, "failed midway");
+            }
+            result.endArray();
+        };
+    }, true);
+    server.registerMethod("whole", [](const JsonValue& params, JsonWriter& result) {
+        result.beginArray();
+        for (int64_t i = 0; i < params[0].getInt64(); ++i) {
+            result.beginObject().key("n").number(i).key("pad").string(std::string(100, 'p')).endObject();
+        }
+        throw RPCError(RPC_MISC_ERROR, "failed midway");
+    }, true);
+    server.registerStreamingMethod("refused", [](const JsonValue&) -> RPCServer::RPCWriter {
+        throw RPCError(RPC_INVALID_PARAMETER, "bad snapshot");
+    }, true);
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    auto post = [&client](const std::string& json) {
+        client.send("POST / HTTP/1.1\r\nContent-Length: " + std::to_string(json.size()) + "\r\n\r\n" + json);
+        return client.readResponse();
+    };
+
+    std::string small = post(R"({"method":"dump","params":[3,false],"id":1})");
+    EXPECT_NE(small.find("Content-Length"), std::string::npos);
+
+    std::string large = post(R"({"method":"dump","params":[20000,false],"id":2})");
+    EXPECT_NE(large.find("Transfer-Encoding: chunked"), std::string::npos);
+    std::string content = body(large);
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(content)) << document.getError();
+    EXPECT_EQ(document.root()["id"].getInt64(), 2);
+    ASSERT_EQ(document.root()["result"].size(), 20000u);
+    EXPECT_EQ(document.root()["result"][19999]["n"].getInt64(), 19999);
+
+    // Parallel batch members are flushed as they are appended
+    std::string batch = post(R"([{"method":"dump","params":[1000,false],"id":"a"},)"
+                             R"({"method":"dump","params":[1000,false],"id":"b"}])");
+    EXPECT_NE(batch.find("Transfer-Encoding: chunked"), std::string::npos);
+    std::string batchContent = body(batch);
+    ASSERT_TRUE(document.parse(batchContent)) << document.getError();
+    ASSERT_EQ(document.root().size(), 2u);
+    EXPECT_EQ(document.root()[1]["id"].getString(), "b");
+
+    // Failing before anything was sent is still an ordinary error response,
+    // as is any failure of a method that is not streamed
+    EXPECT_NE(body(post(R"({"method":"dump","params":[3,true],"id":3})")).find("failed midway"), std::string::npos);
+    EXPECT_NE(body(post(R"({"method":"refused","params":[],"id":4})")).find("bad snapshot"), std::string::npos);
+    std::string whole = post(R"({"method":"whole","params":[20000],"id":5})");
+    EXPECT_NE(whole.find("Content-Length"), std::string::npos);
+    EXPECT_NE(body(whole).find("failed midway"), std::string::npos);
+
+    // Once part of a result is out, a failure can only cut the connection short
+    // (the client sees it close before the last chunk)
+    EXPECT_EQ(post(R"({"method":"dump","params":[20000,true],"id":6})"), "");
+    server.stop();
+}
+
+TEST(RPCServerHttpTest, SendsTheFirstBytesBeforeTheResultIsDone) {
+    RPCServer::Config config;
+    config.port = 0;
+    config.enableAuth = false;
+    RPCServer server(config);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    server.registerStreamingMethod("gated", [released](const JsonValue&) -> RPCServer::RPCWriter {
+        return [released](JsonWriter& result) {
+            result.beginArray();
+            for (int i = 0; i < 2000; ++i) {
+                result.string(std::string(100, 'g'));
+            }
+            // The rest waits until the client has seen the start
+            released.wait_for(5s);
+            result.string("end").endArray();
+        };
+    }, true);
+    ASSERT_TRUE(server.start());
+
+    TestClient client(server.getPort());
+    const std::string call = R"({"method":"gated","params":[],"id":1})";
+    client.send("POST / HTTP/1.1\r\nContent-Length: " + std::to_string(call.size()) + "\r\n\r\n" + call);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(client.waitFor("Transfer-Encoding: chunked"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 2s);
+    release.set_value();
+
+    std::string content = body(client.readResponse());
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(content)) << document.getError();
+    ASSERT_EQ(document.root()["result"].size(), 2001u);
+    EXPECT_EQ(document.root()["result"][2000].getString(), "end");
+    server.stop();
+}
+
+TEST(RPCServerHttpTest, SlowReadersDoNotHoldUpWrites) {
+    RPCServer::Config config;
+    config.port = 0;
+    config.enableAuth = false;
+    config.workerThreads = 2;
+    RPCServer server(config);
+    server.registerStreamingMethod("dump", [](const JsonValue& params) -> RPCServer::RPCWriter {
+        int64_t count = params[0].getInt64();
+        return [count](JsonWriter& result) {
+            result.beginArray();
+            for (int64_t i = 0; i < count; ++i) {
+                result.beginObject().key("n").number(i).key("pad").string(std::string(100, 'p')).endObject();
+            }
+            result.endArray();
+        };
+    }, true);
+    server.registerMethod("write", [](const JsonValue& params, JsonWriter& result) {
+        result.string("written");
+    });
+    ASSERT_TRUE(server.start());
+
+    auto request = [](const std::string& json) {
+        return "POST / HTTP/1.1\r\nContent-Length: " + std::to_string(json.size()) + "\r\n\r\n" + json;
+    };
+
+    // Far more than the socket and stream buffers hold; nothing is read yet,
+    // so the worker streaming it stays blocked on the client
+    TestClient reader(server.getPort());
+    reader.send(request(R"({"method":"dump","params":[300000],"id":1})"));
+    std::this_thread::sleep_for(500ms);
+
+    TestClient writer(server.getPort());
+    auto start = std::chrono::steady_clock::now();
+    writer.send(request(R"({"method":"write","params":[],"id":2})"));
+    std::string written = writer.readResponse();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    EXPECT_NE(body(written).find("\"result\":\"written\""), std::string::npos);
+
+    std::string dumped = body(reader.readResponse());
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(dumped)) << document.getError();
+    EXPECT_EQ(document.root()["result"].size(), 300000u);
+    server.stop();
+}
+
+TEST(WorkerPoolTest, RunParallelFromInsideWorkersNeverDeadlocks) {
+    WorkerPool pool(2, 4);
+    std::atomic<int> total{0};
+    std::atomic<int> finished{0};
+    for (int task = 0; task < 2; ++task) {
+        ASSERT_TRUE(pool.trySubmit([&] {
+            pool.runParallel(100, [&](size_t) { total++; });
+            finished++;
+        }));
+    }
+    for (int i = 0; i < 500 && finished < 2; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(finished.load(), 2);
+    EXPECT_EQ(total.load(), 200);
+}
+
+TEST(WorkerPoolTest, RunParallelRethrowsOnTheCaller) {
+    WorkerPool pool(4, 8);
+    std::atomic<int> ran{0};
+    // Run off the test thread so a hang fails instead of blocking the suite
+    auto call = std::async(std::launch::async, [&] {
+        pool.runParallel(16, [&](size_t index) {
+            std::this_thread::sleep_for(5ms);
+            ran++;
+            if (index % 2 == 1) {
+                throw std::runtime_error("item " + std::to_string(index));
+            }
+        });
+    });
+    ASSERT_EQ(call.wait_for(5s), std::future_status::ready);
+    EXPECT_THROW(call.get(), std::runtime_error);
+    EXPECT_EQ(ran.load(), 16);
+}
+
+class RPCBatchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        config.port = 0;
+        config.enableAuth = false;
+        config.workerThreads = 4;
+        config.maxBatchSize = 8;
+        server = std::make_unique<RPCServer>(config);
+        server->registerMethod("slowread", [](const JsonValue& params, JsonWriter& result) {
+            std::this_thread::sleep_for(100ms);
+            result.raw(params.raw());
+        }, true);
+        server->registerMethod("write", [this](const JsonValue& params, JsonWriter& result) {
+            std::lock_guard<std::mutex> lock(mutex);
+            writes.emplace_back(params.raw());
+            result.number(writes.size());
+        });
+        ASSERT_TRUE(server->start());
+    }
+
+    std::string call(const std::string& json) {
+        TestClient client(server->getPort());
+        client.send("POST / HTTP/1.1\r\nContent-Length: " + std::to_string(json.size()) + "\r\n\r\n" + json);
+        return body(client.readResponse());
+    }
+
+    RPCServer::Config config;
+    std::unique_ptr<RPCServer> server;
+    std::mutex mutex;
+    std::vector<std::string> writes;
+};
+
+TEST_F(RPCBatchTest, RunsReadOnlyCallsInParallelAndAnswersInOrder) {
+    std::string batch = "[";
+    for (int i = 0; i < 4; ++i) {
+        batch += R"({"method":"slowread","params":["s)" + std::to_string(i) + R"("],"id":"r)" + std::to_string(i) + "\"},";
+    }
+    batch += R"({"method":"nosuchmethod","id":"x"}])";
+
+    auto start = std::chrono::steady_clock::now();
+    std::string response = call(batch);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, 300ms);   // Four 100ms calls, not run one after another
+
+    size_t previous = 0;
+    for (int i = 0; i < 4; ++i) {
+        size_t pos = response.find(R"("id":"r)" + std::to_string(i) + R"(","result":["s)" + std::to_string(i) + "\"]");
+        ASSERT_NE(pos, std::string::npos) << response;
+        EXPECT_GE(pos, previous);
+        previous = pos;
+    }
+    EXPECT_GT(response.find("Method not found"), previous);
+    EXPECT_EQ(response.front(), '[');
+    EXPECT_EQ(response.back(), ']');
+}
+
+TEST_F(RPCBatchTest, KeepsWritesInRequestOrder) {
+    std::string response = call(R"([{"method":"write","params":["a"],"id":"1"},)"
+                                R"({"method":"slowread","params":[],"id":"2"},)"
+                                R"({"method":"write","params":["b"],"id":"3"}])");
+    EXPECT_NE(response.find(R"("id":"3","result":2)"), std::string::npos) << response;
+    ASSERT_EQ(writes.size(), 2u);
+    EXPECT_EQ(writes[0], R"(["a"])");
+    EXPECT_EQ(writes[1], R"(["b"])");
+}
+
+TEST_F(RPCBatchTest, RejectsEmptyAndOversizedBatches) {
+    EXPECT_NE(call("[]").find("empty batch"), std::string::npos);
+
+    std::string batch = "[";
+    for (int i = 0; i < 9; ++i) {
+        batch += std::string(i ? "," : "") + R"({"method":"ping","id":"p"})";
+    }
+    batch += "]";
+    EXPECT_NE(call(batch).find("Batch too large"), std::string::npos);
+}
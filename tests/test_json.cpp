@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include "rpc/json.h"
+#include "rpc/rpc.h"
+#include <cmath>
+
+using namespace pragma;
+
+TEST(JsonDocumentTest, ParsesNestedValuesAsViewsIntoTheInput) {
+    const std::string input = R"( {"method":"getblock","params":["00ab", 2, true, null, {"x":-1.5e2}],"id":7} )";
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(input)) << document.getError();
+
+    JsonValue root = document.root();
+    ASSERT_TRUE(root.isObject());
+    EXPECT_EQ(root.size(), 3u);
+    EXPECT_EQ(root["method"].getString(), "getblock");
+    EXPECT_EQ(root["id"].getInt64(), 7);
+    EXPECT_EQ(root["id"].raw(), "7");
+
+    JsonValue params = root["params"];
+    ASSERT_TRUE(params.isArray());
+    EXPECT_EQ(params.size(), 5u);
+    EXPECT_EQ(params[0].raw(), "\"00ab\"");
+    EXPECT_EQ(params[0].getRawString().data(), input.data() + input.find("00ab"));   // No copy
+    EXPECT_EQ(params[1].getInt64(), 2);
+    EXPECT_TRUE(params[2].getBool());
+    EXPECT_TRUE(params[3].isNull());
+    EXPECT_DOUBLE_EQ(params[4]["x"].getDouble(), -150.0);
+    EXPECT_EQ(params.raw(), R"(["00ab", 2, true, null, {"x":-1.5e2}])");
+
+    // Absent values read as null and never throw on lookup
+    EXPECT_FALSE(root["missing"].exists());
+    EXPECT_TRUE(root["missing"].isNull());
+    EXPECT_FALSE(params[9].exists());
+    EXPECT_EQ(root["missing"].raw(), "null");
+
+    std::vector<std::string> seen;
+    for (JsonValue value : params) {
+        seen.emplace_back(value.raw());
+    }
+    EXPECT_EQ(seen.size(), 5u);
+    EXPECT_EQ(seen[4], R"({"x":-1.5e2})");
+}
+
+TEST(JsonDocumentTest, DecodesEscapesOnlyWhenRead) {
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(R"(["a\"b\\c\n", "\u00e9\ud83d\ude00", {"k\u0065y":1}])"));
+    JsonValue root = document.root();
+    EXPECT_EQ(root[0].getString(), "a\"b\\c\n");
+    EXPECT_EQ(root[0].getRawString(), R"(a\"b\\c\n)");
+    EXPECT_EQ(root[1].getString(), "\xC3\xA9\xF0\x9F\x98\x80");
+    EXPECT_EQ(root[2]["key"].getInt64(), 1);
+}
+
+TEST(JsonDocumentTest, RejectsMalformedInput) {
+    const std::vector<std::string> bad = {
+        "", "{", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[01]", "[1.]", "[-]", "[1e]", "tru", "nul",
+        "\"unterminated", "\"bad \\x escape\"", "\"\\u12g4\"", "\"tab\there\"", "[1] 2", "{1:2}",
+        std::string(JsonDocument::MAX_DEPTH + 1, '['),
+    };
+    for (const auto& input : bad) {
+        JsonDocument document;
+        EXPECT_FALSE(document.parse(input)) << input;
+        EXPECT_FALSE(document.getError().empty()) << input;
+        EXPECT_FALSE(document.root().exists());
+    }
+}
+
+TEST(JsonDocumentTest, TypedAccessorsCheckTypes) {
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(R"(["text", 1.5, 1e3, 9223372036854775807])"));
+    JsonValue root = document.root();
+    EXPECT_THROW(root[0].getInt64(), std::runtime_error);
+    EXPECT_THROW(root[1].getString(), std::runtime_error);
+    EXPECT_THROW(root[1].getInt64(), std::runtime_error);   // Not a whole number
+    EXPECT_EQ(root[2].getInt64(), 1000);
+    EXPECT_EQ(root[3].getInt64(), INT64_MAX);
+}
+
+TEST(JsonWriterTest, WritesSeparatorsEscapesAndNumbers) {
+    std::string out = "prefix:";
+    JsonWriter writer(out);
+    writer.beginObject()
+          .key("s").string("quote\" slash\\ nl\n ctl\x01")
+          .key("n").beginArray().number(0).number(-42).number(uint64_t(18446744073709551615ull)).endArray()
+          .key("d").number(0.1)
+          .key("amount").fixed(1.5, 8)
+          .key("nan").number(std::nan(""))
+          .key("flags").beginArray().boolean(true).null().beginObject().endObject().endArray()
+          .key("raw").raw(R"({"a":1})")
+          .endObject();
+
+    EXPECT_EQ(out, "prefix:"
+                   R"({"s":"quote\" slash\\ nl\n ctl\u0001","n":[0,-42,18446744073709551615],"d":0.1,)"
+                   R"("amount":1.50000000,"nan":null,"flags":[true,null,{}],"raw":{"a":1}})");
+
+    // What the writer produces, the parser reads back
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(std::string_view(out).substr(7))) << document.getError();
+    EXPECT_EQ(document.root()["s"].getString(), "quote\" slash\\ nl\n ctl\x01");
+}
+
+TEST(JsonRpcTest, CommandsWriteResultsAndRaiseErrors) {
+    RPCCommands commands(nullptr, nullptr, nullptr);
+    JsonDocument params;
+    ASSERT_TRUE(params.parse("[]"));
+
+    std::string out;
+    JsonWriter result(out);
+    commands.getPeerInfo(params.root(), result);
+    EXPECT_EQ(out, "[]");
+
+    try {
+        commands.getBlockCount(params.root(), result);
+        FAIL() << "expected RPCError";
+    } catch (const RPCError& e) {
+        EXPECT_EQ(e.code, RPC_MISC_ERROR);
+    }
+}
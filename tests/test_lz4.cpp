@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "primitives/lz4.h"
+#include "network/protocol.h"
+#include "network/message_buffer.h"
+#include "core/block.h"
+#include <random>
+
+using namespace pragma;
+
+class LZ4Test : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static std::vector<uint8_t> roundTrip(const std::vector<uint8_t>& input, size_t* compressedSize = nullptr) {
+        std::vector<uint8_t> compressed;
+        LZ4::compress(input.data(), input.size(), compressed);
+        if (compressedSize) *compressedSize = compressed.size();
+        EXPECT_LE(compressed.size(), LZ4::maxCompressedSize(input.size()));
+
+        std::vector<uint8_t> output;
+        EXPECT_TRUE(LZ4::decompress(compressed.data(), compressed.size(), input.size(), output));
+        return output;
+    }
+};
+
+TEST_F(LZ4Test, RoundTripsAssortedInputs) {
+    std::mt19937 rng(42);
+    std::vector<std::vector<uint8_t>> inputs = {{}, {1}, std::vector<uint8_t>(13, 'a'), std::vector<uint8_t>(100000, 0)};
+    std::vector<uint8_t> random(70000);
+    for (auto& byte : random) byte = static_cast<uint8_t>(rng());
+    inputs.push_back(random);
+    std::vector<uint8_t> text;
+    for (int i = 0; i < 3000; ++i) {
+        std::string line = "inv " + std::to_string(i % 97) + " 00000000deadbeef" + std::to_string(i) + "\n";
+        text.insert(text.end(), line.begin(), line.end());
+    }
+    inputs.push_back(text);
+
+    for (const auto& input : inputs) {
+        EXPECT_EQ(roundTrip(input), input);
+    }
+
+    size_t compressedSize = 0;
+    roundTrip(text, &compressedSize);
+    EXPECT_LT(compressedSize, text.size() / 2);
+}
+
+TEST_F(LZ4Test, RejectsMalformedInput) {
+    std::vector<uint8_t> input(5000, 'x');
+    std::vector<uint8_t> compressed;
+    LZ4::compress(input.data(), input.size(), compressed);
+
+    std::vector<uint8_t> output = {7};
+    EXPECT_FALSE(LZ4::decompress(compressed.data(), compressed.size() - 1, input.size(), output));
+    EXPECT_FALSE(LZ4::decompress(compressed.data(), compressed.size(), input.size() - 1, output));
+    EXPECT_FALSE(LZ4::decompress(compressed.data(), compressed.size(), input.size() + 1, output));
+    EXPECT_EQ(output, std::vector<uint8_t>{7}); // Left untouched on failure
+
+    // Match reaching before the start of the output
+    std::vector<uint8_t> badOffset = {0x10, 'a', 0x05, 0x00, 0x00};
+    EXPECT_FALSE(LZ4::decompress(badOffset.data(), badOffset.size(), 5, output));
+}
+
+TEST_F(LZ4Test, CompressedFramesDecodeToTheSameMessage) {
+    std::vector<Transaction> txs;
+    for (int i = 0; i < 50; ++i) {
+        txs.push_back(Transaction::createCoinbase("1Address" + std::to_string(i % 5), 5000000000ULL));
+    }
+    Block genesis = Block::createGenesis("1GenesisAddress", 5000000000ULL);
+    auto block = std::make_shared<Block>(Block::create(genesis, txs, "1Miner", 5000000000ULL));
+    auto message = P2PMessage::createBlock(block);
+
+    auto plain = message->getWireBuffer(ChecksumType::DOUBLE_SHA256, false);
+    auto compressed = message->getWireBuffer(ChecksumType::DOUBLE_SHA256, true);
+    EXPECT_LT(compressed->size(), plain->size());
+
+    size_t offset = 0;
+    auto decoded = P2PMessage::deserialize(ByteSpan(compressed->bytes), offset);
+    EXPECT_EQ(offset, compressed->size());
+    EXPECT_TRUE(decoded.header.compressed);
+    ASSERT_TRUE(decoded.getBlock());
+    EXPECT_EQ(decoded.getBlock()->block->hash, block->hash);
+    EXPECT_EQ(decoded.getBlock()->block->transactions.size(), block->transactions.size());
+
+    // Small control messages are never compressed
+    auto ping = P2PMessage::createPing(1);
+    EXPECT_EQ(ping->getWireBuffer(ChecksumType::DOUBLE_SHA256, true)->size(),
+              ping->getWireBuffer(ChecksumType::DOUBLE_SHA256, false)->size());
+}
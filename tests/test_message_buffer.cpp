@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "network/message_buffer.h"
+#include "network/protocol.h"
+#include "primitives/checksum.h"
+#include "primitives/lz4.h"
+#include "core/block.h"
+
+using namespace pragma;
+
+namespace {
+
+// Frame built the pre-pooling way: payload serialized on its own, then
+// compressed, checksummed and prefixed with a separately serialized header
+std::vector<uint8_t> referenceFrame(const P2PMessage& message, ChecksumType checksumType, bool compress) {
+    std::vector<uint8_t> payload = std::visit([](const auto& data) -> std::vector<uint8_t> {
+        if constexpr (std::is_same_v<std::decay_t<decltype(data)>, std::monostate>) {
+            return {};
+        } else {
+            return data.serialize();
+        }
+    }, message.data);
+
+    MessageHeader header = message.header;
+    header.checksumType = checksumType;
+    header.compressed = false;
+    if (compress && payload.size() >= Protocol::MIN_COMPRESS_SIZE && P2PMessage::isCompressible(header.command)) {
+        std::vector<uint8_t> packed = Serialize::encodeVarInt(payload.size());
+        LZ4::compress(payload.data(), payload.size(), packed);
+        if (packed.size() < payload.size()) {
+            payload = packed;
+            header.compressed = true;
+        }
+    }
+    header.length = static_cast<uint32_t>(payload.size());
+    header.checksum = Checksum::compute(checksumType, payload.data(), payload.size());
+
+    std::vector<uint8_t> frame = header.serialize();
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+std::shared_ptr<P2PMessage> createLargeBlockMessage() {
+    std::vector<Transaction> txs;
+    for (int i = 0; i < 50; ++i) {
+        txs.push_back(Transaction::createCoinbase("1Address" + std::to_string(i % 5), 5000000000ULL));
+    }
+    Block genesis = Block::createGenesis("1GenesisAddress", 5000000000ULL);
+    return P2PMessage::createBlock(std::make_shared<Block>(Block::create(genesis, txs, "1Miner", 5000000000ULL)));
+}
+
+} // namespace
+
+TEST(BufferPoolTest, ReusesBuffersWithinTheirSizeClass) {
+    BufferPool pool;
+    {
+        auto small = pool.acquire(100);
+        EXPECT_GE(small->bytes.capacity(), 256u);
+        EXPECT_TRUE(small->bytes.empty());
+        small->bytes.assign(100, 0xab);
+    }
+    EXPECT_EQ(pool.getPooledBuffers(), 1u);
+    EXPECT_EQ(pool.getMisses(), 1u);
+
+    // Same class: the released buffer comes back empty
+    {
+        auto again = pool.acquire(200);
+        EXPECT_TRUE(again->bytes.empty());
+        EXPECT_EQ(pool.getHits(), 1u);
+        EXPECT_EQ(pool.getPooledBuffers(), 0u);
+
+        // Another class misses even though a smaller buffer is in use
+        auto larger = pool.acquire(300);
+        EXPECT_GE(larger->bytes.capacity(), 512u);
+        EXPECT_EQ(pool.getMisses(), 2u);
+    }
+    EXPECT_EQ(pool.getPooledBuffers(), 2u);
+
+    // A buffer that grew is filed under the largest class its capacity covers
+    pool.clear();
+    {
+        auto grown = pool.acquire(256);
+        std::vector<uint8_t> data(1500, 1);
+        grown->bytes.insert(grown->bytes.end(), data.begin(), data.end());
+    }
+    uint64_t hits = pool.getHits();
+    auto reused = pool.acquire(1024);
+    EXPECT_EQ(pool.getHits(), hits + 1);
+    EXPECT_GE(reused->bytes.capacity(), 1024u);
+}
+
+TEST(BufferPoolTest, FreesOversizedBuffersInsteadOfPooling) {
+    BufferPool pool;
+    const size_t maxClass = 4 * 1024 * 1024;
+    {
+        auto largest = pool.acquire(maxClass);
+        EXPECT_GE(largest->bytes.capacity(), maxClass);
+    }
+    EXPECT_EQ(pool.getPooledBuffers(), 1u);
+    EXPECT_EQ(pool.getPooledBytes(), maxClass);
+
+    {
+        auto oversized = pool.acquire(maxClass + 1);
+        EXPECT_GE(oversized->bytes.capacity(), maxClass + 1);
+        EXPECT_EQ(pool.getPooledBuffers(), 1u);     // Did not take the pooled 4 MB buffer
+    }
+    EXPECT_EQ(pool.getPooledBuffers(), 1u);
+    EXPECT_EQ(pool.getPooledBytes(), maxClass);
+
+    {
+        auto reused = pool.acquire(maxClass);
+        EXPECT_EQ(pool.getPooledBuffers(), 0u);
+    }
+    EXPECT_EQ(pool.getHits(), 1u);
+}
+
+TEST(MessageBufferTest, WireBufferIsSharedByEveryHolder) {
+    BufferPool& pool = BufferPool::instance();
+    pool.clear();
+
+    std::vector<std::shared_ptr<const MessageBuffer>> holders;
+    std::vector<uint8_t> expected;
+    {
+        auto message = P2PMessage::createPing(42);
+        auto first = message->getWireBuffer();
+        expected = first->bytes;
+        for (int i = 0; i < 5; ++i) {
+            holders.push_back(message->getWireBuffer());
+            EXPECT_EQ(holders.back().get(), first.get());
+        }
+
+        // Each checksum type gets its own encoding
+        auto crc = message->getWireBuffer(ChecksumType::CRC32C);
+        EXPECT_NE(crc.get(), first.get());
+        EXPECT_NE(crc->bytes, first->bytes);
+    }
+
+    // The bytes outlive the message while anyone still holds them
+    EXPECT_EQ(pool.getPooledBuffers(), 1u);     // Only the CRC32C encoding has gone back
+    for (size_t i = 0; i + 1 < holders.size(); ++i) {
+        holders[i].reset();
+        EXPECT_EQ(holders.back()->bytes, expected);
+    }
+    EXPECT_EQ(pool.getPooledBuffers(), 1u);
+    holders.clear();
+    EXPECT_EQ(pool.getPooledBuffers(), 2u);
+}
+
+TEST(MessageBufferTest, EncodeIntoMatchesSeparateSerialization) {
+    std::vector<std::shared_ptr<P2PMessage>> messages = {
+        createLargeBlockMessage(),
+        P2PMessage::createPing(7),
+        P2PMessage::createVerack(),
+    };
+    std::vector<InventoryVector> inventory;
+    for (int i = 0; i < 200; ++i) {
+        inventory.emplace_back(InventoryType::TX, std::string(64, static_cast<char>('a' + i % 6)));
+    }
+    messages.push_back(P2PMessage::createInv(inventory));
+
+    for (const auto& message : messages) {
+        for (ChecksumType checksumType : {ChecksumType::DOUBLE_SHA256, ChecksumType::CRC32C}) {
+            for (bool compress : {false, true}) {
+                std::vector<uint8_t> expected = referenceFrame(*message, checksumType, compress);
+
+                // Framed after existing bytes, as when several frames share a buffer
+                std::vector<uint8_t> out = {0xde, 0xad};
+                message->encodeInto(out, checksumType, compress);
+                ASSERT_EQ(out.size(), expected.size() + 2);
+                EXPECT_TRUE(std::equal(expected.begin(), expected.end(), out.begin() + 2))
+                    << "command " << static_cast<uint32_t>(message->header.command)
+                    << " checksum " << static_cast<int>(checksumType) << " compress " << compress;
+
+                EXPECT_EQ(message->getWireBuffer(checksumType, compress)->bytes, expected);
+            }
+        }
+    }
+
+    // The block really exercises the compressed path
+    auto block = messages[0];
+    EXPECT_LT(referenceFrame(*block, ChecksumType::CRC32C, true).size(),
+              referenceFrame(*block, ChecksumType::CRC32C, false).size());
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include "network/message_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace pragma;
+
+class MessageSchedulerTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static bool waitFor(const std::function<bool()>& done) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!done()) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+};
+
+TEST_F(MessageSchedulerTest, KeepsEachPeersOrderAcrossShards) {
+    constexpr int peers = 16;
+    constexpr int perPeer = 2000;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<uint64_t>> seen;
+    std::atomic<int> handled{0};
+    MessageScheduler scheduler(4, [&](const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen[peerId].push_back(message->getPing()->nonce);
+        }
+        handled++;
+    });
+    scheduler.start();
+
+    // Two reader threads, each owning half the peers, as transport loops do;
+    // a refused message is offered again, as the transport does after a pause
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&scheduler, r]() {
+            for (int i = 0; i < perPeer; ++i) {
+                for (int p = r; p < peers; p += 2) {
+                    auto message = P2PMessage::createPing(i);
+                    while (!scheduler.submit("peer" + std::to_string(p), message)) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_TRUE(waitFor([&] { return handled.load() == peers * perPeer; }));
+    scheduler.stop();
+
+    for (int p = 0; p < peers; ++p) {
+        const auto& nonces = seen["peer" + std::to_string(p)];
+        ASSERT_EQ(nonces.size(), static_cast<size_t>(perPeer));
+        for (int i = 0; i < perPeer; ++i) {
+            EXPECT_EQ(nonces[i], static_cast<uint64_t>(i));
+        }
+    }
+
+    uint64_t processed = 0;
+    for (const auto& stats : scheduler.getShardStats()) {
+        processed += stats.processed;
+    }
+    EXPECT_EQ(processed, static_cast<uint64_t>(peers * perPeer));
+}
+
+TEST_F(MessageSchedulerTest, FullLaneRefusesWithoutStallingOtherShards) {
+    // Find a peer on each of the two shards
+    std::string slow = "slow";
+    std::string fast = "fast0";
+    for (int i = 1; std::hash<std::string>{}(fast) % 2 == std::hash<std::string>{}(slow) % 2; ++i) {
+        fast = "fast" + std::to_string(i);
+    }
+
+    std::atomic<bool> release{false};
+    std::atomic<int> fastHandled{0};
+    std::atomic<int> slowHandled{0};
+    MessageScheduler scheduler(2, [&](const std::string& peerId, std::shared_ptr<P2PMessage>) {
+        if (peerId == fast) {
+            fastHandled++;
+            return;
+        }
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        slowHandled++;
+    });
+    scheduler.start();
+
+    // The slow shard takes a ring and a backlog's worth, then says no
+    int accepted = 0;
+    auto refused = P2PMessage::createPing(0);
+    while (accepted < static_cast<int>(4 * MessageScheduler::LANE_CAPACITY) && scheduler.submit(slow, refused)) {
+        accepted++;
+        refused = P2PMessage::createPing(accepted);
+    }
+    ASSERT_LT(accepted, static_cast<int>(4 * MessageScheduler::LANE_CAPACITY));
+    EXPECT_GE(accepted, static_cast<int>(MessageScheduler::LANE_CAPACITY));
+    EXPECT_FALSE(scheduler.submit(slow, refused));
+
+    // The other shard keeps going while the slow one is stuck
+    EXPECT_TRUE(scheduler.submit(fast, P2PMessage::createPing(1)));
+    ASSERT_TRUE(waitFor([&] { return fastHandled.load() == 1; }));
+    EXPECT_EQ(slowHandled.load(), 0);
+
+    // Once it drains the refused message goes through
+    release = true;
+    ASSERT_TRUE(waitFor([&] { return scheduler.submit(slow, refused); }));
+    ASSERT_TRUE(waitFor([&] { return slowHandled.load() == accepted + 1; }));
+    scheduler.stop();
+}
+
+TEST_F(MessageSchedulerTest, BlocksOvertakeOtherPeersTransactionBacklog) {
+    std::atomic<bool> release{false};
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::atomic<int> handled{0};
+    MessageScheduler scheduler(1, [&](const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+        // The first transaction holds the only shard while the rest queue up
+        while (!release.load() && handled.load() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(peerId + (message->header.command == MessageType::BLOCK ? ":block" : ":tx"));
+        }
+        handled++;
+    });
+    scheduler.start();
+
+    auto tx = std::make_shared<Transaction>(Transaction::createCoinbase("miner", 50));
+    scheduler.submit("relayer", P2PMessage::createTx(tx));
+    ASSERT_TRUE(waitFor([&] { return scheduler.getShardStats()[0].queued == 0; }));
+    for (int i = 0; i < 10; ++i) {
+        scheduler.submit("relayer", P2PMessage::createTx(tx));
+    }
+    auto block = std::make_shared<Block>(Block::createGenesis("miner", 50));
+    scheduler.submit("miner", P2PMessage::createBlock(block));
+    EXPECT_EQ(scheduler.getShardStats()[0].queued, 11u);
+    release = true;
+    ASSERT_TRUE(waitFor([&] { return handled.load() == 12; }));
+    scheduler.stop();
+
+    // Handled right after the transaction that was already running
+    ASSERT_EQ(order.size(), 12u);
+    EXPECT_EQ(order[0], "relayer:tx");
+    EXPECT_EQ(order[1], "miner:block");
+    EXPECT_EQ(std::count(order.begin(), order.end(), "relayer:tx"), 11);
+}
+
+TEST_F(MessageSchedulerTest, NeverReordersAPeersOwnMessages) {
+    EXPECT_TRUE(MessageScheduler::isPriorityMessage(MessageType::HEADERS));
+    EXPECT_TRUE(MessageScheduler::isPriorityMessage(MessageType::CMPCTBLOCK));
+    EXPECT_FALSE(MessageScheduler::isPriorityMessage(MessageType::TX));
+
+    std::atomic<bool> release{false};
+    std::vector<std::pair<std::string, MessageType>> order;
+    std::mutex mutex;
+    std::atomic<int> handled{0};
+    MessageScheduler scheduler(1, [&](const std::string& peerId, std::shared_ptr<P2PMessage> message) {
+        while (!release.load() && handled.load() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.emplace_back(peerId, message->header.command);
+        }
+        handled++;
+    });
+    scheduler.start();
+
+    // Both peers have transactions queued ahead of a block; each peer's
+    // transactions still come before its own block
+    auto tx = std::make_shared<Transaction>(Transaction::createCoinbase("miner", 50));
+    auto block = std::make_shared<Block>(Block::createGenesis("m", 50));
+    scheduler.submit("busy", P2PMessage::createPing(1));
+    ASSERT_TRUE(waitFor([&] { return scheduler.getShardStats()[0].queued == 0; }));
+    scheduler.submit("busy", P2PMessage::createTx(tx));
+    scheduler.submit("busy", P2PMessage::createTx(tx));
+    scheduler.submit("peer", P2PMessage::createVerack());
+    scheduler.submit("peer", P2PMessage::createTx(tx));
+    scheduler.submit("peer", P2PMessage::createBlock(block));
+    scheduler.submit("peer", P2PMessage::createPing(2));
+    release = true;
+    ASSERT_TRUE(waitFor([&] { return handled.load() == 7; }));
+    scheduler.stop();
+
+    std::vector<std::pair<std::string, MessageType>> expected = {
+        {"busy", MessageType::PING},
+        {"peer", MessageType::VERACK},      // The block's peer goes first, in its own order
+        {"peer", MessageType::TX},
+        {"peer", MessageType::BLOCK},
+        {"busy", MessageType::TX},          // Then peers take turns
+        {"peer", MessageType::PING},
+        {"busy", MessageType::TX},
+    };
+    EXPECT_EQ(order, expected);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "network/outbound_queue.h"
+
+using namespace pragma;
+
+class OutboundQueueTest : public ::testing::Test {
+protected:
+    using Clock = OutboundQueue::Clock;
+
+    Clock::time_point start;
+
+    void SetUp() override {
+        start = Clock::now();
+    }
+
+    void TearDown() override {}
+
+    static std::shared_ptr<P2PMessage> txInv(int i) {
+        return P2PMessage::createInv({ InventoryVector(InventoryType::TX, "tx" + std::to_string(i)) });
+    }
+
+    static std::shared_ptr<P2PMessage> blockInv(const std::string& hash) {
+        return P2PMessage::createInv({ InventoryVector(InventoryType::BLOCK, hash) });
+    }
+};
+
+TEST_F(OutboundQueueTest, BlockOvertakesTransactionBacklog) {
+    OutboundQueue queue;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(queue.push(txInv(i), 100, start));
+    }
+    queue.push(blockInv("newblock"), 100, start);
+    queue.push(P2PMessage::createPing(1), 40, start);
+
+    auto first = queue.pop(0, start);
+    auto second = queue.pop(0, start);
+    ASSERT_TRUE(first && second);
+    EXPECT_TRUE(first->isPing());
+    ASSERT_TRUE(second->isInv());
+    EXPECT_EQ(second->getInv()->inventory[0].hash, "newblock");
+    EXPECT_EQ(queue.size(), 1000u);
+}
+
+TEST_F(OutboundQueueTest, TransactionsStillGetAShare) {
+    OutboundQueue::Config config;
+    config.quantum = {{0, 1000, 100}};
+    OutboundQueue queue(config);
+
+    for (int i = 0; i < 50; ++i) {
+        queue.push(blockInv("b" + std::to_string(i)), 100, start);
+        queue.push(txInv(i), 100, start);
+    }
+
+    // One tx per ten blocks with these weights
+    int txs = 0;
+    for (int i = 0; i < 22; ++i) {
+        auto message = queue.pop(0, start);
+        ASSERT_TRUE(message);
+        txs += (message->getInv()->inventory[0].type == InventoryType::TX) ? 1 : 0;
+    }
+    EXPECT_EQ(txs, 2);
+}
+
+TEST_F(OutboundQueueTest, StaleAndOverflowingTransactionsAreDropped) {
+    OutboundQueue::Config config;
+    config.maxBytes = {{1000, 1000, 500}};
+    config.maxTxAge = std::chrono::milliseconds(1000);
+    OutboundQueue queue(config);
+
+    for (int i = 0; i < 10; ++i) {
+        queue.push(txInv(i), 100, start);
+    }
+    EXPECT_EQ(queue.getQueuedCount(TrafficClass::TX), 5u);
+    EXPECT_EQ(queue.getQueuedBytes(TrafficClass::TX), 500u);
+    EXPECT_EQ(queue.getDroppedCount(), 5u);
+
+    // The oldest were evicted, and the rest age out
+    auto next = queue.pop(0, start);
+    EXPECT_EQ(next->getInv()->inventory[0].hash, "tx5");
+    EXPECT_EQ(queue.pop(0, start + std::chrono::seconds(2)), nullptr);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(OutboundQueueTest, FullBlockClassRefusesAndExclusionSkips) {
+    OutboundQueue::Config config;
+    config.maxBytes = {{1000, 1000, 1000}};
+    OutboundQueue queue(config);
+
+    EXPECT_TRUE(queue.push(blockInv("a"), 800, start));
+    EXPECT_FALSE(queue.push(blockInv("b"), 800, start));
+    queue.push(txInv(1), 100, start);
+
+    auto message = queue.pop(OutboundQueue::classBit(TrafficClass::BLOCK), start);
+    ASSERT_TRUE(message);
+    EXPECT_EQ(message->getInv()->inventory[0].hash, "tx1");
+    EXPECT_EQ(queue.pop(OutboundQueue::classBit(TrafficClass::BLOCK), start), nullptr);
+    EXPECT_EQ(queue.size(), 1u);
+}
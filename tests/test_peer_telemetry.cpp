@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "network/peer.h"
+#include "network/peer_telemetry.h"
+#include <chrono>
+
+using namespace pragma;
+using namespace std::chrono_literals;
+
+class PeerTelemetryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        start = PeerTelemetry::Clock::now();
+    }
+
+    PeerTelemetry::Clock::time_point start;
+
+    static std::vector<InventoryVector> items(InventoryType type, const std::vector<std::string>& hashes) {
+        std::vector<InventoryVector> result;
+        for (const auto& hash : hashes) {
+            result.emplace_back(type, hash);
+        }
+        return result;
+    }
+};
+
+TEST_F(PeerTelemetryTest, HistogramBucketsArePowersOfTwo) {
+    LatencyHistogram histogram;
+    histogram.add(0.5);     // Bucket 0
+    histogram.add(3.0);     // [2, 4)
+    histogram.add(3.9);
+    histogram.add(100000);  // Open-ended last bucket
+
+    EXPECT_EQ(histogram.total(), 4u);
+    EXPECT_EQ(histogram.counts[0], 1u);
+    EXPECT_EQ(histogram.counts[2], 2u);
+    EXPECT_EQ(histogram.counts[LatencyHistogram::BUCKETS - 1], 1u);
+    EXPECT_DOUBLE_EQ(histogram.percentile(0.5), 4.0);
+    EXPECT_DOUBLE_EQ(LatencyHistogram().percentile(0.5), 0.0);
+}
+
+TEST_F(PeerTelemetryTest, MeasuresResponsesToOurRequests) {
+    PeerTelemetry telemetry;
+    telemetry.recordRequested(items(InventoryType::BLOCK, {"block1"}), start);
+    telemetry.recordRequested(items(InventoryType::TX, {"tx1"}), start);
+
+    telemetry.recordReceived("tx1", 0, false, start + 50ms);
+    telemetry.recordReceived("block1", 500000, true, start + 500ms);
+    telemetry.recordReceived("unsolicited", 1000, true, start + 600ms);
+    telemetry.recordReceived("block1", 500000, true, start + 700ms); // Already answered
+
+    auto snapshot = telemetry.getSnapshot();
+    EXPECT_EQ(snapshot.responseTime.samples, 2u);
+    EXPECT_EQ(snapshot.responseHistogram.total(), 2u);
+    EXPECT_EQ(snapshot.blockThroughput.samples, 1u);
+    EXPECT_NEAR(snapshot.blockThroughput.value, 1000000.0, 1.0);
+    EXPECT_EQ(snapshot.blockBytes, 500000u);
+    EXPECT_TRUE(snapshot.hasMeasurements());
+}
+
+TEST_F(PeerTelemetryTest, MeasuresRequestDelayForAnnouncements) {
+    PeerTelemetry telemetry;
+    telemetry.recordAnnounced(items(InventoryType::TX, {"a", "b"}), start);
+    telemetry.recordGetData(items(InventoryType::TX, {"a", "c"}), start + 200ms);
+
+    auto snapshot = telemetry.getSnapshot();
+    EXPECT_EQ(snapshot.requestDelay.samples, 1u);
+    EXPECT_NEAR(snapshot.requestDelay.value, 200.0, 0.001);
+    EXPECT_FALSE(snapshot.hasMeasurements()); // Says nothing about how fast the peer serves us
+}
+
+TEST_F(PeerTelemetryTest, TracksOnlyRecentItems) {
+    PeerTelemetry telemetry;
+    telemetry.recordRequested(items(InventoryType::TX, {"oldest"}), start);
+    for (size_t i = 0; i < PeerTelemetry::TRACKED_ITEMS; ++i) {
+        telemetry.recordRequested(items(InventoryType::TX, {"tx" + std::to_string(i)}), start);
+    }
+
+    telemetry.recordReceived("oldest", 0, false, start + 10ms);
+    telemetry.recordReceived("tx0", 0, false, start + 10ms);
+    EXPECT_EQ(telemetry.getSnapshot().responseTime.samples, 1u);
+}
+
+TEST_F(PeerTelemetryTest, FasterPeersAndFewerStallsRankFirst) {
+    PeerTelemetry fast, slow, unmeasured;
+    fast.recordPing(20ms);
+    fast.recordRequested(items(InventoryType::BLOCK, {"b"}), start);
+    fast.recordReceived("b", 1000000, true, start + 200ms);
+    slow.recordPing(400ms);
+    slow.recordRequested(items(InventoryType::BLOCK, {"b"}), start);
+    slow.recordReceived("b", 1000000, true, start + 4s);
+
+    double fastSeconds = fast.getSnapshot().estimatedBlockSeconds();
+    EXPECT_LT(fastSeconds, slow.getSnapshot().estimatedBlockSeconds());
+    EXPECT_LT(fastSeconds, unmeasured.getSnapshot().estimatedBlockSeconds());
+
+    fast.recordStall();
+    EXPECT_DOUBLE_EQ(fast.getSnapshot().estimatedBlockSeconds(), 2 * fastSeconds);
+    EXPECT_EQ(fast.getSnapshot().stalls, 1u);
+
+    // The penalty wears off as later requests are answered; the count stays
+    for (int i = 0; i < 20; ++i) {
+        std::string hash = "next" + std::to_string(i);
+        fast.recordRequested(items(InventoryType::TX, {hash}), start);
+        fast.recordReceived(hash, 0, false, start + 200ms);
+    }
+    EXPECT_LT(fast.getSnapshot().estimatedBlockSeconds(), 1.1 * fastSeconds);
+    EXPECT_EQ(fast.getSnapshot().stalls, 1u);
+}
+
+TEST_F(PeerTelemetryTest, PeerTimesQueuedRequestsAndPings) {
+    Peer peer("peer1", NetworkAddress("127.0.0.1", 8333), false);
+    peer.queueOutboundMessage(P2PMessage::createGetData(items(InventoryType::TX, {"tx1"})));
+    peer.queueOutboundMessage(P2PMessage::createInv(items(InventoryType::TX, {"tx2"})));
+    peer.addPendingPing(42);
+    ASSERT_TRUE(peer.handlePong(42));
+
+    peer.getTelemetry().recordReceived("tx1", 0, false);
+    peer.getTelemetry().recordGetData(items(InventoryType::TX, {"tx2"}));
+
+    auto snapshot = peer.getTelemetry().getSnapshot();
+    EXPECT_EQ(snapshot.responseTime.samples, 1u);
+    EXPECT_EQ(snapshot.requestDelay.samples, 1u);
+    EXPECT_EQ(snapshot.pingTime.samples, 1u);
+    EXPECT_EQ(snapshot.pingHistogram.total(), 1u);
+}
+
+TEST_F(PeerTelemetryTest, FollowsASubstitutedClock) {
+    Peer peer("peer1", NetworkAddress("127.0.0.1", 8333), false);
+    auto virtualNow = start;
+    peer.getTelemetry().setClock([&virtualNow]() { return virtualNow; });
+
+    peer.queueOutboundMessage(P2PMessage::createGetData(items(InventoryType::TX, {"tx1"})));
+    peer.addPendingPing(42);
+    virtualNow += 3s;
+    peer.getTelemetry().recordReceived("tx1", 0, false);
+    ASSERT_TRUE(peer.handlePong(42));
+
+    auto snapshot = peer.getTelemetry().getSnapshot();
+    EXPECT_DOUBLE_EQ(snapshot.responseTime.value, 3000.0);
+    EXPECT_DOUBLE_EQ(snapshot.pingTime.value, 3000.0);
+}
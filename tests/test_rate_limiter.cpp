@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "network/rate_limiter.h"
+
+using namespace pragma;
+
+class RateLimiterTest : public ::testing::Test {
+protected:
+    using Clock = TokenBucket::Clock;
+
+    Clock::time_point start;
+
+    void SetUp() override {
+        start = Clock::now();
+    }
+
+    void TearDown() override {}
+};
+
+TEST_F(RateLimiterTest, BucketStartsFullAndRefillsAtRate) {
+    TokenBucket bucket(1000.0, 500.0);
+    EXPECT_FALSE(bucket.isUnlimited());
+
+    EXPECT_TRUE(bucket.tryConsume(500.0, start));
+    EXPECT_EQ(bucket.available(start), 0.0);
+    EXPECT_FALSE(bucket.tryConsume(1.0, start));
+
+    auto later = start + std::chrono::milliseconds(100);
+    EXPECT_NEAR(bucket.available(later), 100.0, 1.0);
+
+    // Never refills past the burst size
+    EXPECT_EQ(bucket.available(start + std::chrono::seconds(10)), 500.0);
+}
+
+TEST_F(RateLimiterTest, LargeChargeGoesIntoDebt) {
+    TokenBucket bucket(1000.0, 100.0);
+
+    // A message larger than the burst is allowed once, then the debt is repaid
+    EXPECT_TRUE(bucket.tryConsume(600.0, start));
+    EXPECT_FALSE(bucket.tryConsume(1.0, start));
+
+    auto wait = bucket.timeUntilAvailable(start);
+    EXPECT_GE(wait, std::chrono::milliseconds(500));
+    EXPECT_LE(wait, std::chrono::milliseconds(502));
+    EXPECT_TRUE(bucket.tryConsume(1.0, start + wait));
+}
+
+TEST_F(RateLimiterTest, ZeroRateIsUnlimited) {
+    TokenBucket bucket;
+    EXPECT_TRUE(bucket.isUnlimited());
+    bucket.consume(1e12, start);
+    EXPECT_TRUE(bucket.tryConsume(1e12, start));
+    EXPECT_EQ(bucket.timeUntilAvailable(start), Clock::duration::zero());
+}
+
+TEST_F(RateLimiterTest, BlockAndTxTrafficHaveSeparateBudgets) {
+    EXPECT_EQ(trafficClassOf(MessageType::BLOCK), TrafficClass::BLOCK);
+    EXPECT_EQ(trafficClassOf(MessageType::CMPCTBLOCK), TrafficClass::BLOCK);
+    EXPECT_EQ(trafficClassOf(MessageType::TX), TrafficClass::TX);
+    EXPECT_EQ(trafficClassOf(MessageType::INV), TrafficClass::TX);
+    EXPECT_EQ(trafficClassOf(MessageType::PING), TrafficClass::CONTROL);
+
+    RateLimitConfig config;
+    config.peerSendBytesPerSecondByClass = {{0, 1000, 1000}};
+    config.burstSeconds = 1.0;
+    PeerRateLimiter limiter;
+    limiter.configure(config);
+
+    auto& blocks = limiter.sendBytesByClass[static_cast<size_t>(TrafficClass::BLOCK)];
+    auto& txs = limiter.sendBytesByClass[static_cast<size_t>(TrafficClass::TX)];
+    auto& control = limiter.sendBytesByClass[static_cast<size_t>(TrafficClass::CONTROL)];
+
+    // Serving a big block exhausts the block budget only
+    EXPECT_TRUE(blocks.tryConsume(100000.0));
+    EXPECT_FALSE(blocks.tryConsume(1.0));
+    EXPECT_TRUE(txs.tryConsume(500.0));
+    EXPECT_TRUE(control.isUnlimited());
+}
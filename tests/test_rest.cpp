@@ -0,0 +1,258 @@
+#include <gtest/gtest.h>
+#include "rpc/rest.h"
+#include "primitives/hash.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+
+using namespace pragma;
+
+namespace {
+
+struct Response {
+    int status = 0;
+    std::string headers;
+    std::string body;           // Chunked bodies decoded
+};
+
+// One GET with Connection: close, read until the server hangs up
+Response get(uint16_t port, const std::string& target, const std::string& method = "GET") {
+    Response response;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return response;
+    }
+
+    std::string request = method + " " + target + " HTTP/1.1\r\nConnection: close\r\n\r\n";
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string raw;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        raw.append(buffer, static_cast<size_t>(n));
+    }
+    close(fd);
+
+    size_t headerEnd = raw.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) {
+        return response;
+    }
+    response.status = std::stoi(raw.substr(9, 3));
+    response.headers = raw.substr(0, headerEnd);
+    std::string body = raw.substr(headerEnd + 4);
+    if (response.headers.find("Transfer-Encoding: chunked") == std::string::npos) {
+        response.body = body;
+        return response;
+    }
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t lineEnd = body.find("\r\n", pos);
+        size_t size = std::stoul(body.substr(pos, lineEnd - pos), nullptr, 16);
+        response.body.append(body, lineEnd + 2, size);
+        pos = lineEnd + 2 + size + 2;
+        if (size == 0) break;
+    }
+    return response;
+}
+
+std::string bytesToString(const std::vector<uint8_t>& bytes) {
+    return std::string(bytes.begin(), bytes.end());
+}
+
+} // namespace
+
+class RESTServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        chainState = std::make_shared<ChainState>();
+        chainState->setCheckProofOfWork(false);
+        genesis = Block::createGenesis("1GenesisAddress", 5000000000ULL);
+        ASSERT_TRUE(chainState->setGenesis(genesis));
+
+        // Large enough that its encoding is streamed rather than sent in one piece
+        std::vector<Transaction> txs;
+        for (int i = 0; i < 2000; ++i) {
+            std::vector<TxIn> inputs{TxIn(OutPoint(genesis.transactions[0].txid, 0), "sig", "pubkey")};
+            std::vector<TxOut> outputs{TxOut(1000 + i, "1Recipient" + std::to_string(i))};
+            txs.push_back(Transaction::create(inputs, outputs));
+        }
+        block1 = Block::create(genesis, txs, "1MinerAddress", 5000000000ULL);
+        block1.header.timestamp = genesis.header.timestamp + 1;
+        block1.computeHash();
+        ASSERT_TRUE(chainState->addBlock(block1));
+
+        utxoSet = std::make_shared<UTXOSet>();
+        utxoSet->addUTXO(OutPoint(block1.transactions[0].txid, 0), block1.transactions[0].vout[0], 1, true);
+
+        RESTServer::Config config;
+        config.port = 0;
+        config.maxHeadersCount = 10;
+        server = std::make_unique<RESTServer>(config);
+        server->setChainState(chainState);
+        server->setUTXOSet(utxoSet);
+        ASSERT_TRUE(server->start());
+    }
+
+    void TearDown() override {
+        server->stop();
+    }
+
+    std::shared_ptr<ChainState> chainState;
+    std::shared_ptr<UTXOSet> utxoSet;
+    std::unique_ptr<RESTServer> server;
+    Block genesis;
+    Block block1;
+};
+
+TEST_F(RESTServerTest, ServesStoredBlockBytesInEveryFormat) {
+    auto stored = chainState->getSerializedBlock(block1.hash);
+    ASSERT_NE(stored, nullptr);
+    ASSERT_GT(stored->size(), 64u * 1024);
+
+    Response bin = get(server->getPort(), "/rest/block/" + block1.hash + ".bin");
+    EXPECT_EQ(bin.status, 200);
+    EXPECT_NE(bin.headers.find("Content-Type: application/octet-stream"), std::string::npos);
+    EXPECT_NE(bin.headers.find("Content-Length: " + std::to_string(stored->size())), std::string::npos);
+    EXPECT_EQ(bin.body, bytesToString(*stored));
+
+    Response hex = get(server->getPort(), "/rest/block/" + block1.hash + ".hex");
+    EXPECT_EQ(hex.body, Hash::toHex(*stored) + "\n");
+
+    Response json = get(server->getPort(), "/rest/block/" + block1.hash + ".json");
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(json.body)) << document.getError();
+    EXPECT_EQ(document.root()["hash"].getString(), block1.hash);
+    EXPECT_EQ(document.root()["height"].getInt64(), 1);
+    EXPECT_EQ(document.root()["previousblockhash"].getString(), genesis.hash);
+    EXPECT_EQ(document.root()["size"].getInt64(), static_cast<int64_t>(stored->size()));
+    ASSERT_EQ(document.root()["tx"].size(), block1.transactions.size());
+    EXPECT_EQ(document.root()["tx"][1]["txid"].getString(), block1.transactions[1].txid);
+
+    // No extension means JSON
+    EXPECT_EQ(get(server->getPort(), "/rest/block/" + genesis.hash).headers.find("application/json") !=
+              std::string::npos, true);
+}
+
+TEST_F(RESTServerTest, ServesHeadersAlongTheBestChain) {
+    Response bin = get(server->getPort(), "/rest/headers/5/" + genesis.hash + ".bin");
+    EXPECT_EQ(bin.status, 200);
+    EXPECT_EQ(bin.body, bytesToString(genesis.header.serialize()) + bytesToString(block1.header.serialize()));
+
+    Response json = get(server->getPort(), "/rest/headers/1/" + block1.hash + ".json");
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(json.body)) << document.getError();
+    ASSERT_EQ(document.root().size(), 1u);
+    EXPECT_EQ(document.root()[0]["hash"].getString(), block1.hash);
+
+    EXPECT_EQ(get(server->getPort(), "/rest/headers/0/" + genesis.hash + ".bin").status, 400);
+    EXPECT_EQ(get(server->getPort(), "/rest/headers/11/" + genesis.hash + ".bin").status, 400);
+}
+
+TEST_F(RESTServerTest, ServesTransactionsAndUtxos) {
+    const Transaction& tx = block1.transactions[5];
+    Response bin = get(server->getPort(), "/rest/tx/" + tx.txid + ".bin");
+    EXPECT_EQ(bin.status, 200);
+    EXPECT_EQ(bin.body, bytesToString(tx.serialize()));
+
+    Response json = get(server->getPort(), "/rest/tx/" + tx.txid + ".json");
+    JsonDocument document;
+    ASSERT_TRUE(document.parse(json.body)) << document.getError();
+    EXPECT_EQ(document.root()["txid"].getString(), tx.txid);
+    EXPECT_EQ(document.root()["blockhash"].getString(), block1.hash);
+
+    const std::string coinbase = block1.transactions[0].txid;
+    Response utxos = get(server->getPort(), "/rest/getutxos/" + coinbase + "-0/" + coinbase + "-7.json");
+    ASSERT_TRUE(document.parse(utxos.body)) << document.getError();
+    EXPECT_EQ(document.root()["chainHeight"].getInt64(), 1);
+    EXPECT_EQ(document.root()["chaintipHash"].getString(), block1.hash);
+    EXPECT_EQ(document.root()["bitmap"].getString(), "10");
+    ASSERT_EQ(document.root()["utxos"].size(), 1u);
+    EXPECT_TRUE(document.root()["utxos"][0]["coinbase"].getBool());
+
+    // Height, tip, bitmap and the one output, in the node's own encoding
+    Response utxosBin = get(server->getPort(), "/rest/getutxos/" + coinbase + "-0/" + coinbase + "-7.bin");
+    std::vector<uint8_t> expected;
+    Serialize::appendUint32LE(expected, 1);
+    Serialize::appendString(expected, block1.hash);
+    Serialize::appendVarInt(expected, 1);
+    expected.push_back(0x01);
+    Serialize::appendVarInt(expected, 1);
+    auto encoded = utxoSet->getUTXO(OutPoint(coinbase, 0))->serialize();
+    expected.insert(expected.end(), encoded.begin(), encoded.end());
+    EXPECT_EQ(utxosBin.body, bytesToString(expected));
+}
+
+TEST_F(RESTServerTest, RejectsBadRequests) {
+    EXPECT_EQ(get(server->getPort(), "/rest/block/" + block1.hash + ".bin", "POST").status, 405);
+    EXPECT_EQ(get(server->getPort(), "/rest/block/nothex.bin").status, 400);
+    EXPECT_EQ(get(server->getPort(), "/rest/block/" + std::string(64, '0') + ".bin").status, 404);
+    EXPECT_EQ(get(server->getPort(), "/rest/block/" + block1.hash + ".xml").status, 404);
+    EXPECT_EQ(get(server->getPort(), "/rest/tx/" + std::string(64, 'a') + ".json").status, 404);
+    EXPECT_EQ(get(server->getPort(), "/rest/getutxos.json").status, 400);
+    EXPECT_EQ(get(server->getPort(), "/rest/getutxos/nonsense.json").status, 400);
+    EXPECT_EQ(get(server->getPort(), "/rpc").status, 404);
+}
+
+TEST_F(RESTServerTest, ForgetsTransactionsLeftOnAStaleBranch) {
+    // A heavier branch from genesis replaces block1; it carries one of
+    // block1's transactions again plus one of its own
+    const Transaction& moved = block1.transactions[5];
+    const Transaction& dropped = block1.transactions[6];
+    std::vector<TxIn> inputs{TxIn(OutPoint(genesis.transactions[0].txid, 0), "sig", "pubkey")};
+    Transaction fresh = Transaction::create(inputs, {TxOut(424242, "1OtherRecipient")});
+
+    Block fork1 = Block::create(genesis, {moved, fresh}, "1OtherMiner", 5000000000ULL);
+    fork1.header.timestamp = genesis.header.timestamp + 2;
+    fork1.computeHash();
+    ASSERT_TRUE(chainState->addBlock(fork1));
+    EXPECT_EQ(chainState->getBestHash(), block1.hash);
+    EXPECT_EQ(get(server->getPort(), "/rest/tx/" + fresh.txid + ".json").status, 404);
+
+    Block fork2 = Block::create(fork1, {}, "1OtherMiner", 5000000000ULL);
+    fork2.header.timestamp = fork1.header.timestamp + 1;
+    fork2.computeHash();
+    ASSERT_TRUE(chainState->addBlock(fork2));
+    ASSERT_EQ(chainState->getBestHash(), fork2.hash);
+
+    EXPECT_EQ(get(server->getPort(), "/rest/tx/" + dropped.txid + ".json").status, 404);
+    JsonDocument document;
+    for (const auto& txid : {moved.txid, fresh.txid}) {
+        Response json = get(server->getPort(), "/rest/tx/" + txid + ".json");
+        ASSERT_EQ(json.status, 200) << txid;
+        ASSERT_TRUE(document.parse(json.body)) << document.getError();
+        EXPECT_EQ(document.root()["blockhash"].getString(), fork1.hash);
+    }
+}
+
+TEST_F(RESTServerTest, LookupsWaitForTheWritersLock) {
+    auto chainLock = std::make_shared<std::shared_mutex>();
+    server->setChainLock(chainLock);
+
+    // A writer such as sendtoaddress holds the lock; the lookup waits for it
+    std::unique_lock<std::shared_mutex> writer(*chainLock);
+    std::atomic<bool> answered{false};
+    Response response;
+    std::thread reader([&]() {
+        response = get(server->getPort(), "/rest/tx/" + block1.transactions[3].txid + ".json");
+        answered = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(answered.load());
+    writer.unlock();
+    reader.join();
+    EXPECT_EQ(response.status, 200);
+
+    // Readers share it
+    std::shared_lock<std::shared_mutex> otherReader(*chainLock);
+    EXPECT_EQ(get(server->getPort(), "/rest/block/" + genesis.hash + ".bin").status, 200);
+}
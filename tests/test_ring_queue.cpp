@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "network/ring_queue.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace pragma;
+
+class RingQueueTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(RingQueueTest, KeepsOrderAndRefusesWhenFull) {
+    MpscRingQueue<int> queue(3);
+    EXPECT_EQ(queue.capacity(), 4u); // Rounded up to a power of two
+
+    for (int i = 0; i < 4; ++i) {
+        int value = i;
+        EXPECT_TRUE(queue.tryPush(std::move(value)));
+    }
+    int extra = 99;
+    EXPECT_FALSE(queue.tryPush(std::move(extra)));
+    EXPECT_EQ(extra, 99);
+
+    int out = -1;
+    ASSERT_TRUE(queue.tryPop(out));
+    EXPECT_EQ(out, 0);
+    EXPECT_TRUE(queue.tryPush(std::move(extra)));
+
+    std::vector<int> batch;
+    EXPECT_EQ(queue.popBatch(batch, 10), 4u);
+    EXPECT_EQ(batch, (std::vector<int>{1, 2, 3, 99}));
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.tryPop(out));
+}
+
+TEST_F(RingQueueTest, PoppedSlotsReleaseTheirObjects) {
+    MpscRingQueue<std::shared_ptr<int>> queue(4);
+    auto value = std::make_shared<int>(7);
+    std::weak_ptr<int> watch = value;
+
+    auto copy = value;
+    ASSERT_TRUE(queue.tryPush(std::move(copy)));
+    value.reset();
+
+    std::shared_ptr<int> out;
+    ASSERT_TRUE(queue.tryPop(out));
+    EXPECT_EQ(*out, 7);
+    out.reset();
+    EXPECT_TRUE(watch.expired());
+}
+
+TEST_F(RingQueueTest, MpscDeliversEveryItemOnceUnderContention) {
+    constexpr int producers = 4;
+    constexpr int perProducer = 50000;
+    MpscRingQueue<int> queue(256);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < perProducer; ++i) {
+                int value = p * perProducer + i;
+                while (!queue.tryPush(std::move(value))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // Each producer's items must come out in the order it pushed them
+    std::vector<int> lastSeen(producers, -1);
+    std::vector<int> batch;
+    int received = 0;
+    while (received < producers * perProducer) {
+        batch.clear();
+        if (queue.popBatch(batch, 64) == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (int value : batch) {
+            int producer = value / perProducer;
+            EXPECT_GT(value % perProducer, lastSeen[producer]);
+            lastSeen[producer] = value % perProducer;
+        }
+        received += static_cast<int>(batch.size());
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (int p = 0; p < producers; ++p) {
+        EXPECT_EQ(lastSeen[p], perProducer - 1);
+    }
+    EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "primitives/rolling_bloom.h"
+#include <string>
+
+using namespace pragma;
+
+class RollingBloomTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static std::string key(int i) {
+        return "inventory" + std::to_string(i);
+    }
+};
+
+TEST_F(RollingBloomTest, RemembersRecentInsertions) {
+    RollingBloomFilter filter(1000, 0.000001);
+
+    for (int i = 0; i < 1000; ++i) {
+        filter.insert(key(i));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(filter.contains(key(i))) << key(i);
+    }
+}
+
+TEST_F(RollingBloomTest, OldestGenerationAgesOut) {
+    RollingBloomFilter filter(100, 0.000001);
+
+    for (int i = 0; i < 100; ++i) {
+        filter.insert(key(i));
+    }
+    // Two more full generations push the first keys out
+    for (int i = 100; i < 250; ++i) {
+        filter.insert(key(i));
+    }
+
+    int remembered = 0;
+    for (int i = 0; i < 50; ++i) {
+        remembered += filter.contains(key(i)) ? 1 : 0;
+    }
+    EXPECT_EQ(remembered, 0);
+    for (int i = 150; i < 250; ++i) {
+        EXPECT_TRUE(filter.contains(key(i)));
+    }
+}
+
+TEST_F(RollingBloomTest, FalsePositiveRateIsBounded) {
+    RollingBloomFilter filter(10000, 0.001);
+
+    for (int i = 0; i < 15000; ++i) {
+        filter.insert(key(i));
+    }
+    int falsePositives = 0;
+    for (int i = 0; i < 100000; ++i) {
+        falsePositives += filter.contains("other" + std::to_string(i)) ? 1 : 0;
+    }
+    EXPECT_LT(falsePositives, 300); // 0.1% expected, allow slack
+}
+
+TEST_F(RollingBloomTest, ResetForgetsEverything) {
+    RollingBloomFilter filter(100, 0.0001);
+    filter.insert("abc");
+    ASSERT_TRUE(filter.contains("abc"));
+
+    size_t memory = filter.getMemoryUsage();
+    filter.reset();
+    EXPECT_FALSE(filter.contains("abc"));
+    EXPECT_EQ(filter.getMemoryUsage(), memory);
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "network/tx_reconciliation.h"
+#include <algorithm>
+#include <set>
+
+using namespace pragma;
+
+class TxReconciliationTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static std::string txid(int i) {
+        return "tx" + std::to_string(i);
+    }
+
+    // Links an initiator (outbound side) and a responder as the handshake would
+    static void link(TxReconciliationTracker& initiator, TxReconciliationTracker& responder) {
+        uint64_t initiatorSalt = initiator.preRegisterPeer("responder");
+        uint64_t responderSalt = responder.preRegisterPeer("initiator");
+        ASSERT_TRUE(initiator.registerPeer("responder", false, TxReconciliationTracker::VERSION, responderSalt));
+        ASSERT_TRUE(responder.registerPeer("initiator", true, TxReconciliationTracker::VERSION, initiatorSalt));
+    }
+};
+
+TEST_F(TxReconciliationTest, SketchDecodesSymmetricDifference) {
+    TxSketch local(10);
+    TxSketch remote(10);
+    for (uint32_t id = 1; id <= 500; ++id) {
+        local.add(id);
+        remote.add(id);
+    }
+    local.add(1001);
+    local.add(1002);
+    remote.add(2001);
+
+    TxSketch received;
+    ASSERT_TRUE(TxSketch::deserialize(remote.serialize(), received));
+    local.subtract(received);
+
+    std::vector<uint32_t> onlyLocal, onlyRemote;
+    ASSERT_TRUE(local.decode(onlyLocal, onlyRemote));
+    std::sort(onlyLocal.begin(), onlyLocal.end());
+    EXPECT_EQ(onlyLocal, (std::vector<uint32_t>{1001, 1002}));
+    EXPECT_EQ(onlyRemote, (std::vector<uint32_t>{2001}));
+}
+
+TEST_F(TxReconciliationTest, SketchReportsOverflow) {
+    TxSketch local(2);
+    for (uint32_t id = 1; id <= 200; ++id) {
+        local.add(id);
+    }
+    std::vector<uint32_t> onlyLocal, onlyRemote;
+    EXPECT_FALSE(local.decode(onlyLocal, onlyRemote));
+}
+
+TEST_F(TxReconciliationTest, RoundFindsMissingTransactions) {
+    TxReconciliationTracker::Config config;
+    config.floodOutboundPeers = 0;
+    TxReconciliationTracker initiator(config), responder(config);
+    link(initiator, responder);
+    EXPECT_FALSE(initiator.shouldFlood("responder"));
+
+    // Both sides heard of most transactions; a few only reached one side
+    for (int i = 0; i < 100; ++i) {
+        initiator.addToSet("responder", txid(i));
+        responder.addToSet("initiator", txid(i));
+    }
+    initiator.addToSet("responder", txid(500));
+    responder.addToSet("initiator", txid(600));
+    responder.addToSet("initiator", txid(601));
+
+    ASSERT_EQ(initiator.nextPeerToReconcile(), "responder");
+    ReqReconMessage request;
+    ASSERT_TRUE(initiator.initiateReconciliation("responder", request));
+
+    SketchMessage sketch;
+    ASSERT_TRUE(responder.handleReconciliationRequest("initiator", request, sketch));
+
+    std::vector<std::string> announce;
+    ReconcilDiffMessage diff;
+    auto result = initiator.handleSketch("responder", sketch, announce, diff.askShortIds);
+    ASSERT_EQ(result, TxReconciliationTracker::SketchResult::SUCCESS);
+    EXPECT_EQ(announce, std::vector<std::string>{txid(500)});
+    EXPECT_EQ(diff.askShortIds.size(), 2u);
+    EXPECT_EQ(initiator.getSetSize("responder"), 0u);
+
+    diff.success = true;
+    auto requested = responder.handleReconciliationDiff("initiator", diff);
+    EXPECT_EQ(std::set<std::string>(requested.begin(), requested.end()),
+              (std::set<std::string>{txid(600), txid(601)}));
+}
+
+TEST_F(TxReconciliationTest, RejectsUnsolicitedSketchAndReversedRoles) {
+    TxReconciliationTracker initiator, responder;
+    link(initiator, responder);
+
+    std::vector<std::string> announce;
+    std::vector<uint32_t> ask;
+    EXPECT_EQ(initiator.handleSketch("responder", SketchMessage(), announce, ask),
+              TxReconciliationTracker::SketchResult::UNEXPECTED);
+
+    SketchMessage sketch;
+    EXPECT_FALSE(initiator.handleReconciliationRequest("responder", ReqReconMessage(), sketch));
+}
+
+TEST_F(TxReconciliationTest, FirstOutboundPeersKeepFlooding) {
+    TxReconciliationTracker::Config config;
+    config.floodOutboundPeers = 1;
+    TxReconciliationTracker tracker(config);
+
+    for (const std::string peer : {"out1", "out2", "in1"}) {
+        tracker.preRegisterPeer(peer);
+    }
+    tracker.registerPeer("out1", false, 1, 7);
+    tracker.registerPeer("out2", false, 1, 8);
+    tracker.registerPeer("in1", true, 1, 9);
+
+    EXPECT_TRUE(tracker.shouldFlood("out1"));
+    EXPECT_FALSE(tracker.shouldFlood("out2"));
+    EXPECT_FALSE(tracker.shouldFlood("in1"));
+    EXPECT_TRUE(tracker.shouldFlood("unknown"));
+
+    // A departing flood peer hands its slot to a remaining outbound peer
+    tracker.forgetPeer("out1");
+    EXPECT_TRUE(tracker.shouldFlood("out2"));
+    EXPECT_FALSE(tracker.shouldFlood("in1"));
+}
+
+TEST_F(TxReconciliationTest, ForgottenPeersAreNotRecreated) {
+    TxReconciliationTracker tracker;
+    tracker.preRegisterPeer("out1");
+    tracker.registerPeer("out1", false, 1, 7);
+    tracker.forgetPeer("out1");
+
+    ReqReconMessage request;
+    EXPECT_FALSE(tracker.initiateReconciliation("out1", request));
+    EXPECT_EQ(tracker.nextPeerToReconcile(), "");
+    EXPECT_FALSE(tracker.isPeerRegistered("out1"));
+    EXPECT_EQ(tracker.getSetSize("out1"), 0u);
+}
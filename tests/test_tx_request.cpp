@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+#include "network/tx_request.h"
+#include "network/p2p.h"
+#include "core/utxo.h"
+#include "core/validator.h"
+#include <chrono>
+
+using namespace pragma;
+using namespace std::chrono_literals;
+
+class TxRequestTrackerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        config.requestTimeout = 1000ms;
+        config.maxAnnouncers = 2;
+        start = TxRequestTracker::Clock::now();
+    }
+
+    TxRequestTracker::Config config;
+    TxRequestTracker::Clock::time_point start;
+};
+
+TEST_F(TxRequestTrackerTest, RequestsEachTransactionFromOnePeer) {
+    TxRequestTracker tracker(config);
+
+    EXPECT_TRUE(tracker.onAnnounced("peerA", "tx1", start));
+    EXPECT_FALSE(tracker.onAnnounced("peerB", "tx1", start));
+    EXPECT_FALSE(tracker.onAnnounced("peerA", "tx1", start)); // Re-announced by the peer we asked
+    EXPECT_TRUE(tracker.onAnnounced("peerB", "tx2", start));
+    EXPECT_EQ(tracker.getRequestPeer("tx1"), "peerA");
+    EXPECT_EQ(tracker.size(), 2u);
+
+    // Once it arrives, the next announcement starts a new request
+    tracker.onReceived("tx1");
+    EXPECT_EQ(tracker.getRequestPeer("tx1"), "");
+    EXPECT_TRUE(tracker.onAnnounced("peerC", "tx1", start));
+}
+
+TEST_F(TxRequestTrackerTest, TimeoutFallsBackToOtherAnnouncers) {
+    TxRequestTracker tracker(config);
+    tracker.onAnnounced("peerA", "tx1", start);
+    tracker.onAnnounced("peerB", "tx1", start);
+    tracker.onAnnounced("peerC", "tx1", start);
+    tracker.onAnnounced("peerD", "tx1", start); // Over maxAnnouncers
+
+    EXPECT_TRUE(tracker.expire(start + 500ms).empty());
+
+    auto retry = tracker.expire(start + 1000ms);
+    ASSERT_EQ(retry.size(), 1u);
+    EXPECT_EQ(retry["peerB"], std::vector<std::string>{"tx1"});
+    EXPECT_EQ(tracker.getRequestPeer("tx1"), "peerB");
+
+    retry = tracker.expire(start + 2000ms);
+    EXPECT_EQ(retry["peerC"], std::vector<std::string>{"tx1"});
+
+    // Nobody left to ask: forgotten
+    EXPECT_TRUE(tracker.expire(start + 3000ms).empty());
+    EXPECT_EQ(tracker.size(), 0u);
+}
+
+TEST_F(TxRequestTrackerTest, DisconnectReassignsRequests) {
+    TxRequestTracker tracker(config);
+    tracker.onAnnounced("peerA", "tx1", start);
+    tracker.onAnnounced("peerB", "tx1", start);
+    tracker.onAnnounced("peerA", "tx2", start);
+    tracker.onAnnounced("peerC", "tx3", start);
+    tracker.onAnnounced("peerA", "tx3", start);
+
+    tracker.removePeer("peerA");
+    auto retry = tracker.expire(start + 10ms);
+    EXPECT_EQ(retry.size(), 1u);
+    EXPECT_EQ(retry["peerB"], std::vector<std::string>{"tx1"});
+    EXPECT_EQ(tracker.getRequestPeer("tx2"), ""); // No fallback
+    EXPECT_EQ(tracker.getRequestPeer("tx3"), "peerC");
+
+    // The removed peer is no longer a fallback for tx3
+    EXPECT_TRUE(tracker.expire(start + 1005ms).empty());
+    EXPECT_EQ(tracker.size(), 1u);
+}
+
+TEST_F(TxRequestTrackerTest, OrphanedRequestGoesToNextAnnouncer) {
+    TxRequestTracker tracker(config);
+    tracker.onAnnounced("peerA", "tx1", start);
+    tracker.removePeer("peerA");
+
+    EXPECT_TRUE(tracker.onAnnounced("peerB", "tx1", start));
+    EXPECT_EQ(tracker.getRequestPeer("tx1"), "peerB");
+}
+
+TEST_F(TxRequestTrackerTest, RequestsUntrackedWhenFull) {
+    config.maxTracked = 1;
+    TxRequestTracker tracker(config);
+    EXPECT_TRUE(tracker.onAnnounced("peerA", "tx1", start));
+    EXPECT_TRUE(tracker.onAnnounced("peerA", "tx2", start));
+    EXPECT_TRUE(tracker.onAnnounced("peerB", "tx2", start));
+    EXPECT_EQ(tracker.size(), 1u);
+}
+
+TEST_F(TxRequestTrackerTest, NotFoundMovesToNextAnnouncerAtOnce) {
+    TxRequestTracker tracker(config);
+    tracker.onAnnounced("peerA", "tx1", start);
+    tracker.onAnnounced("peerB", "tx1", start);
+
+    // Only the peer holding the request can give it up
+    EXPECT_EQ(tracker.onNotFound("peerB", "tx1", start), "");
+    EXPECT_EQ(tracker.onNotFound("peerA", "unknown", start), "");
+    EXPECT_EQ(tracker.getRequestPeer("tx1"), "peerA");
+
+    EXPECT_EQ(tracker.onNotFound("peerA", "tx1", start + 10ms), "peerB");
+    EXPECT_EQ(tracker.getRequestPeer("tx1"), "peerB");
+    EXPECT_TRUE(tracker.expire(start + 1005ms).empty()); // A fresh timeout from the switch
+
+    // Nobody left to ask: forgotten
+    EXPECT_EQ(tracker.onNotFound("peerB", "tx1", start + 20ms), "");
+    EXPECT_EQ(tracker.size(), 0u);
+}
+
+TEST_F(TxRequestTrackerTest, NetworkRerequestsOnNotFound) {
+    NetworkConfig networkConfig;
+    networkConfig.randomSeed = 1;
+    ChainState chainState;
+    UTXOSet utxoSet;
+    BlockValidator validator(&utxoSet, &chainState);
+    Mempool mempool(&utxoSet, &validator);
+    P2PNetwork network(networkConfig, &chainState, &mempool);
+
+    std::vector<std::shared_ptr<Peer>> peers;
+    for (int i = 0; i < 2; ++i) {
+        auto peer = network.getPeerManager()->addPeer(NetworkAddress("10.0.0." + std::to_string(i + 1), 8333), false);
+        ASSERT_NE(peer, nullptr);
+        peer->setState(PeerState::READY);
+        peers.push_back(peer);
+    }
+    auto takeGetData = [](Peer& peer) -> std::vector<InventoryVector> {
+        while (auto message = peer.getNextOutboundMessage()) {
+            if (auto* getData = message->getGetData()) return getData->inventory;
+        }
+        return {};
+    };
+
+    const std::vector<InventoryVector> tx{InventoryVector(InventoryType::TX, "tx1")};
+    network.simulateMessage(peers[0]->getId(), P2PMessage::createInv(tx));
+    network.simulateMessage(peers[1]->getId(), P2PMessage::createInv(tx));
+    ASSERT_EQ(takeGetData(*peers[0]).size(), 1u);
+    EXPECT_TRUE(takeGetData(*peers[1]).empty());
+
+    network.simulateMessage(peers[0]->getId(), P2PMessage::createNotFound(tx));
+    auto retry = takeGetData(*peers[1]);
+    ASSERT_EQ(retry.size(), 1u);
+    EXPECT_EQ(retry[0].hash, "tx1");
+}
+
+TEST_F(TxRequestTrackerTest, NetworkRequestsAnnouncedBlocksOnce) {
+    NetworkConfig networkConfig;
+    networkConfig.randomSeed = 1;
+    ChainState chainState;
+    UTXOSet utxoSet;
+    BlockValidator validator(&utxoSet, &chainState);
+    Mempool mempool(&utxoSet, &validator);
+    P2PNetwork network(networkConfig, &chainState, &mempool);
+    auto start = std::chrono::steady_clock::now();
+    network.setSimulatedTime(start);
+
+    std::vector<std::shared_ptr<Peer>> peers;
+    for (int i = 0; i < 3; ++i) {
+        auto peer = network.getPeerManager()->addPeer(NetworkAddress("10.0.1." + std::to_string(i + 1), 8333), false);
+        ASSERT_NE(peer, nullptr);
+        peer->setState(PeerState::READY);
+        peers.push_back(peer);
+    }
+    auto countGetData = [](Peer& peer) {
+        size_t count = 0;
+        while (auto message = peer.getNextOutboundMessage()) {
+            count += message->getGetData() ? 1 : 0;
+        }
+        return count;
+    };
+
+    // Only the first announcer is asked while its request is outstanding
+    const std::vector<InventoryVector> block{InventoryVector(InventoryType::BLOCK, "block1")};
+    for (const auto& peer : peers) {
+        network.simulateMessage(peer->getId(), P2PMessage::createInv(block));
+    }
+    EXPECT_EQ(countGetData(*peers[0]), 1u);
+    EXPECT_EQ(countGetData(*peers[1]), 0u);
+    EXPECT_EQ(countGetData(*peers[2]), 0u);
+
+    // Once that request expires the next announcement goes through
+    network.simulateAnnouncements(start + 11s);
+    network.simulateMessage(peers[1]->getId(), P2PMessage::createInv(block));
+    EXPECT_EQ(countGetData(*peers[1]), 1u);
+}